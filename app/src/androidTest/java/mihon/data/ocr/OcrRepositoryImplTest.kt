@@ -12,6 +12,7 @@ import mihon.data.ocr.di.OcrModule
 import mihon.domain.ocr.interactor.OcrProcessor
 import org.junit.Assert.assertEquals
 import org.junit.Assert.assertNotNull
+import org.junit.Assume.assumeTrue
 import org.junit.Before
 import org.junit.Test
 import org.junit.runner.RunWith
@@ -69,6 +70,24 @@ class OcrRepositoryImplTest {
         assertEquals("Text did not match after cleanup re-initialization", expectedText, secondRunText)
     }
 
+    @Test
+    fun steadyStateRecognizeDoesNotAllocate() = runTest(timeout = 4.minutes) {
+        val bitmap = getBitmap("mihon/data/ocr/ocr_test_image.base64")
+
+        // The first request sizes every reused buffer
+        ocrRepository.recognizeText(bitmap)
+        assumeTrue("Built without -PocrAllocTracking=ON", ocrRepository.getAllocationCounts() != null)
+
+        ocrRepository.resetAllocationCounts()
+        ocrRepository.recognizeText(bitmap)
+        val counts = ocrRepository.getAllocationCounts()!!
+
+        // LiteRT runtime calls are reported separately and not held to this guarantee
+        for (phase in listOf("preprocess", "encoder", "decoder", "postprocess")) {
+            assertEquals("Heap allocations in $phase: $counts", 0L, counts[phase])
+        }
+    }
+
     private fun getBitmap(resourceName: String): Bitmap {
         val inputStream = javaClass.classLoader?.getResourceAsStream(resourceName)
         require(inputStream != null) { "Test image not found: $resourceName" }
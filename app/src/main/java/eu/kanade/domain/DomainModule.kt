@@ -28,7 +28,7 @@ import eu.kanade.domain.track.interactor.TrackChapter
 import mihon.data.repository.ExtensionRepoRepositoryImpl
 import mihon.data.dictionary.DictionaryParserImpl
 import mihon.data.dictionary.DictionaryRepositoryImpl
-import mihon.data.ocr.OcrRepositoryImpl
+import mihon.data.ocr.di.OcrModule
 import mihon.domain.chapter.interactor.FilterChaptersForDownload
 import mihon.domain.dictionary.interactor.DictionaryInteractor
 import mihon.domain.dictionary.interactor.ImportDictionary
@@ -220,11 +220,7 @@ class DomainModule : InjektModule {
         addFactory { SearchDictionaryTerms(get()) }
         addFactory { ImportDictionary(get()) }
         
-        addSingletonFactory<OcrRepository> {
-            OcrRepositoryImpl(
-                context = get()
-            )
-        }
+        addFactory<OcrRepository> { OcrModule.provideOcrRepository(get()) }
         addFactory { OcrProcessor(get()) }
     }
 }
@@ -369,6 +369,11 @@ object SettingsAdvancedScreen : SearchableSettings {
                     title = stringResource(MR.strings.pref_always_decode_long_strip_with_ssiv_2),
                     subtitle = stringResource(MR.strings.pref_always_decode_long_strip_with_ssiv_summary),
                 ),
+                Preference.PreferenceItem.SwitchPreference(
+                    preference = basePreferences.ocrOutOfProcess(),
+                    title = stringResource(MR.strings.pref_ocr_out_of_process),
+                    subtitle = stringResource(MR.strings.pref_ocr_out_of_process_summary),
+                ),
                 Preference.PreferenceItem.TextPreference(
                     title = stringResource(MR.strings.pref_display_profile),
                     subtitle = basePreferences.displayProfile().get(),
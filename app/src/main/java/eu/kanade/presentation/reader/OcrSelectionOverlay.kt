@@ -29,11 +29,16 @@ import kotlin.math.abs
 import kotlin.math.max
 import kotlin.math.min
 
+/**
+ * Lets the user drag out a region to recognize. [onSelectionChanged] reports the selection while
+ * it is being dragged, once it is large enough, so recognition can start before [onRegionSelected].
+ */
 @Composable
 fun OcrSelectionOverlay(
     onRegionSelected: (RectF) -> Unit,
     onCancel: () -> Unit,
     modifier: Modifier = Modifier,
+    onSelectionChanged: (RectF) -> Unit = {},
 ) {
     var startPoint by remember { mutableStateOf<Offset?>(null) }
     var endPoint by remember { mutableStateOf<Offset?>(null) }
@@ -50,6 +55,13 @@ fun OcrSelectionOverlay(
                     },
                     onDrag = { change, _ ->
                         endPoint = change.position
+                        val start = startPoint
+                        val end = change.position
+                        if (start != null && abs(end.x - start.x) > 20 && abs(end.y - start.y) > 20) {
+                            onSelectionChanged(
+                                RectF(min(start.x, end.x), min(start.y, end.y), max(start.x, end.x), max(start.y, end.y)),
+                            )
+                        }
                     },
                     onDragEnd = {
                         val start = startPoint
@@ -154,6 +154,11 @@ class App : Application(), DefaultLifecycleObserver, SingletonImageLoader.Factor
             .onEach { ImageUtil.hardwareBitmapThreshold = it }
             .launchIn(scope)
 
+        OcrModule.runOutOfProcess = basePreferences.ocrOutOfProcess().get()
+        basePreferences.ocrOutOfProcess().changes()
+            .onEach { OcrModule.runOutOfProcess = it }
+            .launchIn(scope)
+
         setAppCompatDelegateThemeMode(Injekt.get<UiPreferences>().themeMode().get())
 
         // Updates widget update
@@ -7,6 +7,7 @@ import android.content.ClipData
 import android.content.ClipboardManager
 import android.content.Context
 import android.content.Intent
+import android.graphics.Bitmap
 import android.graphics.Color
 import android.graphics.ColorMatrix
 import android.graphics.ColorMatrixColorFilter
@@ -88,6 +89,9 @@ import eu.kanade.tachiyomi.util.system.openInBrowser
 import eu.kanade.tachiyomi.util.system.toShareIntent
 import eu.kanade.tachiyomi.util.system.toast
 import eu.kanade.tachiyomi.util.view.setComposeContent
+import kotlinx.coroutines.CancellationException
+import kotlinx.coroutines.Job
+import kotlinx.coroutines.delay
 import kotlinx.coroutines.flow.distinctUntilChanged
 import kotlinx.coroutines.flow.drop
 import kotlinx.coroutines.flow.filterNotNull
@@ -115,6 +119,9 @@ import kotlinx.coroutines.suspendCancellableCoroutine
 class ReaderActivity : BaseActivity() {
 
     companion object {
+        // Pause in the selection drag before its current rectangle is recognized speculatively
+        private const val OCR_SPECULATION_DEBOUNCE_MS = 150L
+
         fun newIntent(context: Context, mangaId: Long?, chapterId: Long?): Intent {
             return Intent(context, ReaderActivity::class.java).apply {
                 putExtra("manga", mangaId)
@@ -147,6 +154,8 @@ class ReaderActivity : BaseActivity() {
 
     private var loadingIndicator: ReaderProgressIndicator? = null
 
+    private var ocrSpeculationJob: Job? = null
+
     var isScrollingThroughPages = false
         private set
 
@@ -463,7 +472,11 @@ class ReaderActivity : BaseActivity() {
                     onRegionSelected = { rect ->
                         captureRegionAndProcessOcr(rect)
                     },
-                    onCancel = viewModel::exitOcrMode,
+                    onCancel = {
+                        ocrSpeculationJob?.cancel()
+                        viewModel.exitOcrMode()
+                    },
+                    onSelectionChanged = ::speculateOcrRegion,
                 )
             }
 
@@ -755,45 +768,71 @@ class ReaderActivity : BaseActivity() {
     }
 
     /**
-     * Captures a bitmap from the specified region and processes it with OCR.
+     * Copies the specified region of the window into a new bitmap.
      */
-    private fun captureRegionAndProcessOcr(rect: android.graphics.RectF) {
-        lifecycleScope.launchIO {
-            try {
-                val viewerContainer = binding.viewerContainer
+    private suspend fun captureRegion(rect: android.graphics.RectF): Bitmap {
+        val viewerContainer = binding.viewerContainer
 
-                val location = IntArray(2)
-                viewerContainer.getLocationOnScreen(location)
-                val (containerX,containerY) = location
+        val location = IntArray(2)
+        viewerContainer.getLocationOnScreen(location)
+        val (containerX,containerY) = location
 
 
-                // Crop to the selected region
-                val left = (containerX + rect.left.toInt()).coerceAtLeast(0)
-                val top = (containerY + rect.top.toInt()).coerceAtLeast(0)
-                val width = (rect.width().toInt()).coerceAtLeast(1)
-                val height = (rect.height().toInt()).coerceAtLeast(1)
+        // Crop to the selected region
+        val left = (containerX + rect.left.toInt()).coerceAtLeast(0)
+        val top = (containerY + rect.top.toInt()).coerceAtLeast(0)
+        val width = (rect.width().toInt()).coerceAtLeast(1)
+        val height = (rect.height().toInt()).coerceAtLeast(1)
 
-                val croppedBitmap = createBitmap(width, height)
+        val croppedBitmap = createBitmap(width, height)
 
-                val srcRect = android.graphics.Rect(left, top, left + width, top + height)
+        val srcRect = android.graphics.Rect(left, top, left + width, top + height)
 
-                val copyResult = suspendCancellableCoroutine { continuation ->
-                    android.view.PixelCopy.request(
-                        window,
-                        srcRect,
-                        croppedBitmap,
-                        { result -> continuation.resume(result) { cause, _, _ -> } },
-                        Handler(Looper.getMainLooper())
-                    )
-                }
+        val copyResult = suspendCancellableCoroutine { continuation ->
+            android.view.PixelCopy.request(
+                window,
+                srcRect,
+                croppedBitmap,
+                { result -> continuation.resume(result) { cause, _, _ -> } },
+                Handler(Looper.getMainLooper())
+            )
+        }
 
-                if (copyResult != android.view.PixelCopy.SUCCESS) {
-                    croppedBitmap.recycle()
-                    throw IllegalStateException("PixelCopy failed with result: $copyResult")
-                }
+        if (copyResult != android.view.PixelCopy.SUCCESS) {
+            croppedBitmap.recycle()
+            throw IllegalStateException("PixelCopy failed with result: $copyResult")
+        }
+        return croppedBitmap
+    }
 
+    /**
+     * Recognizes the selection while it is still being dragged, once it has held still for
+     * [OCR_SPECULATION_DEBOUNCE_MS], so the final result is ready sooner.
+     */
+    private fun speculateOcrRegion(rect: android.graphics.RectF) {
+        ocrSpeculationJob?.cancel()
+        ocrSpeculationJob = lifecycleScope.launchIO {
+            delay(OCR_SPECULATION_DEBOUNCE_MS)
+            try {
+                // The ViewModel takes ownership of the bitmap
+                viewModel.speculateOcrRegion(captureRegion(rect), rect)
+            } catch (e: CancellationException) {
+                throw e
+            } catch (e: Exception) {
+                logcat(LogPriority.WARN, e) { "Failed to capture region for speculative OCR" }
+            }
+        }
+    }
+
+    /**
+     * Captures a bitmap from the specified region and processes it with OCR.
+     */
+    private fun captureRegionAndProcessOcr(rect: android.graphics.RectF) {
+        ocrSpeculationJob?.cancel()
+        lifecycleScope.launchIO {
+            try {
                 // Process OCR (the ViewModel takes ownership of the bitmap)
-                viewModel.processOcrRegion(croppedBitmap)
+                viewModel.processOcrRegion(captureRegion(rect), rect)
             } catch (e: Exception) {
                 logcat(LogPriority.ERROR, e) { "Failed to capture region for OCR" }
                 withUIContext {
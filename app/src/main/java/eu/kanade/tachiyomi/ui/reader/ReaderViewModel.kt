@@ -41,6 +41,7 @@ import eu.kanade.tachiyomi.util.lang.byteSize
 import eu.kanade.tachiyomi.util.lang.takeBytes
 import eu.kanade.tachiyomi.util.storage.DiskUtil
 import android.graphics.Bitmap
+import android.graphics.RectF
 import kotlinx.coroutines.CancellationException
 import kotlinx.coroutines.Dispatchers
 import kotlinx.coroutines.channels.Channel
@@ -149,6 +150,13 @@ class ReaderViewModel @JvmOverloads constructor(
 
     private var chapterToDownload: Download? = null
 
+    // Identifies the current OCR selection, so speculative work is never reused across selections
+    @Volatile
+    private var ocrSelectionSession = 0L
+
+    @Volatile
+    private var ocrSpeculated = false
+
     private val ocrProcessor: OcrProcessor
         get() = OcrModule.provideOcrProcessor(application)
 
@@ -800,18 +808,47 @@ class ReaderViewModel @JvmOverloads constructor(
     }
 
     fun enterOcrMode() {
+        ocrSelectionSession++
         mutableState.update { it.copy(ocrSelectionMode = true, menuVisible = false) }
     }
 
     fun exitOcrMode() {
+        if (ocrSpeculated) {
+            ocrSpeculated = false
+            ocrProcessor.cancelSpeculation()
+        }
         mutableState.update { it.copy(ocrSelectionMode = false) }
     }
 
-    fun processOcrRegion(bitmap: Bitmap) {
+    /**
+     * Recognizes [bitmap], the crop of the OCR selection [rect] while it is still being dragged, so
+     * [processOcrRegion] can reuse the work. Takes ownership of the bitmap.
+     */
+    fun speculateOcrRegion(bitmap: Bitmap, rect: RectF) {
+        val session = ocrSelectionSession
+        ocrSpeculated = true
+        viewModelScope.launchIO {
+            try {
+                ocrProcessor.speculate(bitmap, session, rect)
+            } catch (e: CancellationException) {
+                throw e
+            } catch (e: Exception) {
+                logcat(LogPriority.WARN, e) { "Speculative OCR failed" }
+            } finally {
+                if (!bitmap.isRecycled) {
+                    bitmap.recycle()
+                }
+            }
+        }
+    }
+
+    fun processOcrRegion(bitmap: Bitmap, rect: RectF) {
+        val session = ocrSelectionSession
+        ocrSpeculated = false
         viewModelScope.launchIO {
                 mutableState.update { it.copy(isProcessingOcr = true, ocrSelectionMode = false) }
             try {
-                val text = ocrProcessor.getText(bitmap)
+                val text = ocrProcessor.getSelectionText(bitmap, session, rect)
                 withUIContext {
                     if (text.isNotBlank()) {
                         mutableState.update { it.copy(dialog = Dialog.OcrResult(text), isProcessingOcr = false) }
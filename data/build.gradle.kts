@@ -16,7 +16,9 @@ android {
                 cppFlags += "-std=c++20"
                 arguments += listOf(
                     "-DANDROID_STL=c++_shared",
-                    "-DLITERT_VERSION=${libs.versions.litert.get()}"
+                    "-DLITERT_VERSION=${libs.versions.litert.get()}",
+                    // -PocrAllocTracking=ON builds the native allocation counters
+                    "-DMIHON_OCR_ALLOC_TRACKING=${providers.gradleProperty("ocrAllocTracking").getOrElse("OFF")}",
                 )
             }
         }
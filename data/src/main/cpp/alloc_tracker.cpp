@@ -0,0 +1,124 @@
+#include "alloc_tracker.h"
+#include <algorithm>
+
+#ifdef MIHON_OCR_ALLOC_TRACKING
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#endif
+
+namespace mihon {
+
+#ifdef MIHON_OCR_ALLOC_TRACKING
+
+static std::atomic<int64_t> g_allocCounts[kAllocPhaseCount];
+static std::atomic<int64_t> g_allocBytes[kAllocPhaseCount];
+static thread_local AllocPhase t_allocPhase = AllocPhase::kOther;
+
+static void RecordAllocation(size_t size) noexcept {
+    const int phase = static_cast<int>(t_allocPhase);
+    g_allocCounts[phase].fetch_add(1, std::memory_order_relaxed);
+    g_allocBytes[phase].fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+}
+
+ScopedAllocPhase::ScopedAllocPhase(AllocPhase phase) : previous_(t_allocPhase) {
+    t_allocPhase = phase;
+}
+
+ScopedAllocPhase::~ScopedAllocPhase() {
+    t_allocPhase = previous_;
+}
+
+bool AllocTrackingEnabled() {
+    return true;
+}
+
+void ResetAllocCounts() {
+    for (int i = 0; i < kAllocPhaseCount; ++i) {
+        g_allocCounts[i].store(0, std::memory_order_relaxed);
+        g_allocBytes[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void GetAllocCounts(int64_t* counts, int64_t* bytes) {
+    for (int i = 0; i < kAllocPhaseCount; ++i) {
+        counts[i] = g_allocCounts[i].load(std::memory_order_relaxed);
+        bytes[i] = g_allocBytes[i].load(std::memory_order_relaxed);
+    }
+}
+
+#else
+
+bool AllocTrackingEnabled() {
+    return false;
+}
+
+void ResetAllocCounts() {}
+
+void GetAllocCounts(int64_t* counts, int64_t* bytes) {
+    std::fill(counts, counts + kAllocPhaseCount, 0);
+    std::fill(bytes, bytes + kAllocPhaseCount, 0);
+}
+
+#endif
+
+} // namespace mihon
+
+#ifdef MIHON_OCR_ALLOC_TRACKING
+
+// Counting replacements for the global allocation functions
+
+static void* TrackedAlloc(size_t size) noexcept {
+    mihon::RecordAllocation(size);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+static void* TrackedAlignedAlloc(size_t size, std::align_val_t alignment) noexcept {
+    mihon::RecordAllocation(size);
+    void* ptr = nullptr;
+    const size_t align = std::max(static_cast<size_t>(alignment), sizeof(void*));
+    return posix_memalign(&ptr, align, size == 0 ? 1 : size) == 0 ? ptr : nullptr;
+}
+
+void* operator new(size_t size) {
+    void* ptr = TrackedAlloc(size);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return TrackedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return TrackedAlloc(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    void* ptr = TrackedAlignedAlloc(size, alignment);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { std::free(ptr); }
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef MIHON_ALLOC_TRACKER_H
+#define MIHON_ALLOC_TRACKER_H
+
+#include <cstdint>
+
+namespace mihon {
+
+// Pipeline phases heap allocations are attributed to
+enum class AllocPhase : int {
+    kOther = 0,
+    kPreprocess,
+    kEncoder,
+    kDecoder,
+    kPostprocess,
+    // Calls into the LiteRT runtime (runs, buffer reads and writes)
+    kRuntime,
+};
+
+inline constexpr int kAllocPhaseCount = 6;
+
+// Allocation tracking replaces the global operator new of libmihon_ocr and is only
+// compiled in with MIHON_OCR_ALLOC_TRACKING; otherwise these are no-ops.
+bool AllocTrackingEnabled();
+void ResetAllocCounts();
+// Fills kAllocPhaseCount allocation counts and byte totals, indexed by AllocPhase
+void GetAllocCounts(int64_t* counts, int64_t* bytes);
+
+#ifdef MIHON_OCR_ALLOC_TRACKING
+// Attributes allocations on this thread to `phase` for the scope's lifetime
+class ScopedAllocPhase {
+public:
+    explicit ScopedAllocPhase(AllocPhase phase);
+    ~ScopedAllocPhase();
+
+    ScopedAllocPhase(const ScopedAllocPhase&) = delete;
+    ScopedAllocPhase& operator=(const ScopedAllocPhase&) = delete;
+
+private:
+    AllocPhase previous_;
+};
+#else
+class ScopedAllocPhase {
+public:
+    explicit ScopedAllocPhase(AllocPhase) {}
+};
+#endif
+
+} // namespace mihon
+
+#endif // MIHON_ALLOC_TRACKER_H
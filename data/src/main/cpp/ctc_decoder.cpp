@@ -0,0 +1,149 @@
+#include "ctc_decoder.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace mihon {
+
+static constexpr float kLogZero = -std::numeric_limits<float>::infinity();
+static constexpr int kMaxBeamWidth = 16;
+// Classes below this probability are not expanded by the prefix beam search
+static constexpr float kPruneLogProb = -9.2f; // ~1e-4
+
+static float LogAdd(float a, float b) {
+    if (a == kLogZero) return b;
+    if (b == kLogZero) return a;
+    const float hi = std::max(a, b);
+    return hi + std::log1p(std::exp(std::min(a, b) - hi));
+}
+
+// log(sum(exp(row))) computed stably
+static float LogSumExp(const float* row, int count, float max_value) {
+    double sum = 0.0;
+    for (int i = 0; i < count; ++i) {
+        sum += std::exp(static_cast<double>(row[i] - max_value));
+    }
+    return max_value + static_cast<float>(std::log(sum));
+}
+
+int CtcGreedyDecode(
+    const float* logits,
+    int time_steps,
+    int num_classes,
+    int blank_id,
+    int* out_tokens,
+    int max_tokens,
+    float* confidence) {
+
+    int token_count = 0;
+    int previous = blank_id;
+    double path_log_prob = 0.0;
+
+    for (int t = 0; t < time_steps; ++t) {
+        const float* row = logits + static_cast<size_t>(t) * num_classes;
+        const int best = static_cast<int>(std::max_element(row, row + num_classes) - row);
+        path_log_prob += row[best] - LogSumExp(row, num_classes, row[best]);
+
+        if (best != blank_id && best != previous && token_count < max_tokens) {
+            out_tokens[token_count++] = best;
+        }
+        previous = best;
+    }
+
+    if (confidence) {
+        *confidence = time_steps > 0 ? static_cast<float>(std::exp(path_log_prob / time_steps)) : 0.0f;
+    }
+    return token_count;
+}
+
+int CtcPrefixBeamDecode(
+    const float* logits,
+    int time_steps,
+    int num_classes,
+    int blank_id,
+    int beam_width,
+    int* out_tokens,
+    int max_tokens,
+    float* confidence) {
+
+    struct Prefix {
+        std::vector<int> tokens;
+        float blank = kLogZero;     // paths ending in blank
+        float non_blank = kLogZero; // paths ending in the last token
+        float Total() const { return LogAdd(blank, non_blank); }
+    };
+
+    beam_width = std::clamp(beam_width, 1, kMaxBeamWidth);
+
+    std::vector<Prefix> beams(1);
+    beams[0].blank = 0.0f;
+    std::vector<Prefix> next;
+    std::vector<float> log_probs(num_classes);
+    std::vector<int> candidates;
+
+    auto find_or_add = [&next](const std::vector<int>& tokens) -> Prefix& {
+        for (auto& prefix : next) {
+            if (prefix.tokens == tokens) {
+                return prefix;
+            }
+        }
+        next.push_back(Prefix{tokens});
+        return next.back();
+    };
+
+    for (int t = 0; t < time_steps; ++t) {
+        const float* row = logits + static_cast<size_t>(t) * num_classes;
+        const float max_logit = *std::max_element(row, row + num_classes);
+        const float log_norm = LogSumExp(row, num_classes, max_logit);
+
+        candidates.clear();
+        for (int c = 0; c < num_classes; ++c) {
+            log_probs[c] = row[c] - log_norm;
+            if (c != blank_id && log_probs[c] > kPruneLogProb) {
+                candidates.push_back(c);
+            }
+        }
+
+        next.clear();
+        next.reserve(beams.size() * (candidates.size() + 1));
+        for (const Prefix& prefix : beams) {
+            const float total = prefix.Total();
+            const int last = prefix.tokens.empty() ? -1 : prefix.tokens.back();
+
+            Prefix& same = find_or_add(prefix.tokens);
+            same.blank = LogAdd(same.blank, total + log_probs[blank_id]);
+            // Repeating the last token without a blank collapses into the same prefix
+            if (last >= 0) {
+                same.non_blank = LogAdd(same.non_blank, prefix.non_blank + log_probs[last]);
+            }
+
+            for (int c : candidates) {
+                std::vector<int> extended = prefix.tokens;
+                extended.push_back(c);
+                Prefix& grown = find_or_add(extended);
+                // A repeated token is only a new emission after a blank
+                const float source = c == last ? prefix.blank : total;
+                grown.non_blank = LogAdd(grown.non_blank, source + log_probs[c]);
+            }
+        }
+
+        std::sort(next.begin(), next.end(),
+                  [](const Prefix& a, const Prefix& b) { return a.Total() > b.Total(); });
+        if (static_cast<int>(next.size()) > beam_width) {
+            next.resize(beam_width);
+        }
+        beams.swap(next);
+    }
+
+    const Prefix& best = beams.front();
+    const int token_count = std::min(static_cast<int>(best.tokens.size()), max_tokens);
+    std::copy(best.tokens.begin(), best.tokens.begin() + token_count, out_tokens);
+
+    if (confidence) {
+        *confidence = time_steps > 0 ? std::exp(best.Total() / time_steps) : 0.0f;
+    }
+    return token_count;
+}
+
+} // namespace mihon
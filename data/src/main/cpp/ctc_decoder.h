@@ -0,0 +1,33 @@
+#ifndef MIHON_CTC_DECODER_H
+#define MIHON_CTC_DECODER_H
+
+namespace mihon {
+
+// Decoders for CTC logits laid out as [time_steps, num_classes].
+// Both return the number of tokens written to out_tokens and set confidence to the
+// geometric-mean per-step probability of the chosen path (0..1).
+
+int CtcGreedyDecode(
+    const float* logits,
+    int time_steps,
+    int num_classes,
+    int blank_id,
+    int* out_tokens,
+    int max_tokens,
+    float* confidence
+);
+
+int CtcPrefixBeamDecode(
+    const float* logits,
+    int time_steps,
+    int num_classes,
+    int blank_id,
+    int beam_width,
+    int* out_tokens,
+    int max_tokens,
+    float* confidence
+);
+
+} // namespace mihon
+
+#endif // MIHON_CTC_DECODER_H
@@ -0,0 +1,151 @@
+#include "encoded_image_decoder.h"
+#include <android/bitmap.h>
+#include <android/imagedecoder.h>
+#include <algorithm>
+#include <unistd.h>
+
+namespace mihon {
+
+namespace {
+
+constexpr int MAX_SAMPLE_SIZE = 64;
+
+struct DecoderDeleter {
+    void operator()(AImageDecoder* decoder) const {
+        if (__builtin_available(android 30, *)) {
+            AImageDecoder_delete(decoder);
+        }
+    }
+};
+
+using DecoderPtr = std::unique_ptr<AImageDecoder, DecoderDeleter>;
+
+} // namespace
+
+bool EncodedImageDecoder::IsAvailable() {
+    if (__builtin_available(android 30, *)) {
+        return true;
+    }
+    return false;
+}
+
+std::unique_ptr<EncodedImageDecoder> EncodedImageDecoder::FromBuffer(const void* data, size_t size) {
+    std::unique_ptr<EncodedImageDecoder> decoder(new EncodedImageDecoder());
+    decoder->data_ = data;
+    decoder->size_ = size;
+    return decoder->ReadHeader() ? std::move(decoder) : nullptr;
+}
+
+std::unique_ptr<EncodedImageDecoder> EncodedImageDecoder::FromFd(int fd) {
+    std::unique_ptr<EncodedImageDecoder> decoder(new EncodedImageDecoder());
+    const off_t offset = lseek(fd, 0, SEEK_CUR);
+    if (offset < 0) {
+        return nullptr;
+    }
+    decoder->fd_ = fd;
+    decoder->fd_offset_ = offset;
+    return decoder->ReadHeader() ? std::move(decoder) : nullptr;
+}
+
+EncodedImageDecoder::~EncodedImageDecoder() {
+    if (fd_ >= 0) {
+        lseek(fd_, fd_offset_, SEEK_SET);
+    }
+}
+
+AImageDecoder* EncodedImageDecoder::Open() {
+    if (__builtin_available(android 30, *)) {
+        AImageDecoder* decoder = nullptr;
+        int result;
+        if (fd_ >= 0) {
+            // Every decoder consumes the stream, so rewind to where the image starts
+            if (lseek(fd_, fd_offset_, SEEK_SET) != fd_offset_) {
+                return nullptr;
+            }
+            result = AImageDecoder_createFromFd(fd_, &decoder);
+        } else {
+            result = AImageDecoder_createFromBuffer(data_, size_, &decoder);
+        }
+        if (result != ANDROID_IMAGE_DECODER_SUCCESS) {
+            return nullptr;
+        }
+        AImageDecoder_setAndroidBitmapFormat(decoder, ANDROID_BITMAP_FORMAT_RGBA_8888);
+        return decoder;
+    }
+    return nullptr;
+}
+
+bool EncodedImageDecoder::ReadHeader() {
+    if (__builtin_available(android 30, *)) {
+        DecoderPtr decoder(Open());
+        if (!decoder) {
+            return false;
+        }
+        const AImageDecoderHeaderInfo* info = AImageDecoder_getHeaderInfo(decoder.get());
+        width_ = AImageDecoderHeaderInfo_getWidth(info);
+        height_ = AImageDecoderHeaderInfo_getHeight(info);
+        return width_ > 0 && height_ > 0;
+    }
+    return false;
+}
+
+bool EncodedImageDecoder::DecodeRegion(
+    int x, int y, int width, int height, int min_size,
+    std::vector<uint8_t>* pixels, int* out_width, int* out_height, size_t* out_stride) {
+
+    if (x < 0 || y < 0 || width <= 0 || height <= 0 || width > width_ - x || height > height_ - y) {
+        return false;
+    }
+
+    if (__builtin_available(android 30, *)) {
+        // A fresh decoder per region, since the crop and target size cannot be changed after decoding
+        DecoderPtr decoder(Open());
+        if (!decoder) {
+            return false;
+        }
+
+        int sample = 1;
+        while (sample < MAX_SAMPLE_SIZE && width / (sample * 2) >= min_size && height / (sample * 2) >= min_size) {
+            sample *= 2;
+        }
+        int32_t scaled_width = width_;
+        int32_t scaled_height = height_;
+        if (sample > 1) {
+            // The codec reports the size it can produce natively for this sample size
+            if (AImageDecoder_computeSampledSize(decoder.get(), sample, &scaled_width, &scaled_height) !=
+                    ANDROID_IMAGE_DECODER_SUCCESS ||
+                AImageDecoder_setTargetSize(decoder.get(), scaled_width, scaled_height) !=
+                    ANDROID_IMAGE_DECODER_SUCCESS) {
+                scaled_width = width_;
+                scaled_height = height_;
+            }
+        }
+
+        // The crop is given in scaled coordinates
+        const double scale_x = static_cast<double>(scaled_width) / width_;
+        const double scale_y = static_cast<double>(scaled_height) / height_;
+        ARect crop;
+        crop.left = static_cast<int32_t>(x * scale_x);
+        crop.top = static_cast<int32_t>(y * scale_y);
+        crop.right = std::clamp(static_cast<int32_t>((x + width) * scale_x + 0.5), crop.left + 1, scaled_width);
+        crop.bottom = std::clamp(static_cast<int32_t>((y + height) * scale_y + 0.5), crop.top + 1, scaled_height);
+        if (AImageDecoder_setCrop(decoder.get(), crop) != ANDROID_IMAGE_DECODER_SUCCESS) {
+            return false;
+        }
+
+        const size_t stride = AImageDecoder_getMinimumStride(decoder.get());
+        const int crop_height = crop.bottom - crop.top;
+        pixels->resize(stride * crop_height);
+        if (AImageDecoder_decodeImage(decoder.get(), pixels->data(), stride, pixels->size()) !=
+                ANDROID_IMAGE_DECODER_SUCCESS) {
+            return false;
+        }
+        *out_width = crop.right - crop.left;
+        *out_height = crop_height;
+        *out_stride = stride;
+        return true;
+    }
+    return false;
+}
+
+} // namespace mihon
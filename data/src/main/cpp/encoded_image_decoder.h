@@ -0,0 +1,59 @@
+#ifndef MIHON_ENCODED_IMAGE_DECODER_H
+#define MIHON_ENCODED_IMAGE_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <sys/types.h>
+#include <vector>
+
+struct AImageDecoder;
+
+namespace mihon {
+
+// Decodes regions of an encoded page (JPEG, PNG, WebP, ...) with the platform codecs, without
+// decoding the full page. Each region is decoded at the coarsest scale the codec supports
+// natively (JPEG DCT scaling, WebP/PNG sampling) that still keeps it `min_size` pixels on
+// both sides, so downscaling to the model input loses nothing.
+class EncodedImageDecoder {
+public:
+    // The NDK image decoder is available from API 30
+    static bool IsAvailable();
+
+    // `data` must stay valid while the decoder is used
+    static std::unique_ptr<EncodedImageDecoder> FromBuffer(const void* data, size_t size);
+    // Reads the image starting at the current offset of `fd`, which stays owned by the caller
+    // and is left at that offset again once the decoder is destroyed
+    static std::unique_ptr<EncodedImageDecoder> FromFd(int fd);
+
+    ~EncodedImageDecoder();
+
+    EncodedImageDecoder(const EncodedImageDecoder&) = delete;
+    EncodedImageDecoder& operator=(const EncodedImageDecoder&) = delete;
+
+    int Width() const { return width_; }
+    int Height() const { return height_; }
+
+    // Decodes the `width` x `height` rectangle at (`x`, `y`) as ARGB_8888 into `pixels`,
+    // reusing its capacity. Returns the decoded size and row stride in bytes.
+    bool DecodeRegion(int x, int y, int width, int height, int min_size,
+                      std::vector<uint8_t>* pixels, int* out_width, int* out_height, size_t* out_stride);
+
+private:
+    EncodedImageDecoder() = default;
+
+    // A fresh platform decoder positioned at the start of the image; the caller deletes it
+    AImageDecoder* Open();
+    bool ReadHeader();
+
+    const void* data_ = nullptr;
+    size_t size_ = 0;
+    int fd_ = -1;
+    off_t fd_offset_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+};
+
+} // namespace mihon
+
+#endif // MIHON_ENCODED_IMAGE_DECODER_H
@@ -0,0 +1,170 @@
+#include "frame_tracker.h"
+#include "selection_speculation.h"
+#include "work_pool.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace mihon {
+
+static constexpr uint64_t HASH_MULTIPLIER = 0x9E3779B97F4A7C15ull;
+static constexpr size_t HASH_ROWS_PER_CHUNK = 32;
+
+static inline uint64_t MixHash(uint64_t hash, uint64_t value) {
+    hash = (hash ^ value) * HASH_MULTIPLIER;
+    return hash ^ (hash >> 31);
+}
+
+// Hashes `bytes` bytes of pixels, eight at a time
+static uint64_t HashBytes(const uint8_t* data, size_t bytes) {
+    uint64_t hash = bytes;
+    size_t offset = 0;
+    for (; offset + sizeof(uint64_t) <= bytes; offset += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data + offset, sizeof(word));
+        hash = MixHash(hash, word);
+    }
+    if (offset < bytes) {
+        uint64_t word = 0;
+        std::memcpy(&word, data + offset, bytes - offset);
+        hash = MixHash(hash, word);
+    }
+    return hash;
+}
+
+int FrameTracker::BeginFrame(
+    int64_t stream, int profile, const uint8_t* pixels, int width, int height, size_t stride) {
+    const bool continues = stream == stream_ && profile == profile_ && width == width_ && height == height_ && !blocks_.empty();
+    if (continues) {
+        blocks_.swap(previous_blocks_);
+        rows_.swap(previous_rows_);
+    }
+    if (!continues || frame_open_) {
+        previous_regions_.clear();
+    }
+    has_previous_ = continues;
+    frame_open_ = true;
+    regions_.clear();
+
+    stream_ = stream;
+    profile_ = profile;
+    width_ = width;
+    height_ = height;
+    columns_ = (width + BLOCK_WIDTH - 1) / BLOCK_WIDTH;
+    blocks_.resize(static_cast<size_t>(height) * columns_);
+    rows_.resize(height);
+
+    WorkPool::Shared().ParallelFor(
+        WorkClass::kDetection, static_cast<size_t>(height), HASH_ROWS_PER_CHUNK, [&](size_t begin, size_t end) {
+            for (size_t y = begin; y < end; ++y) {
+                const uint8_t* row = pixels + y * stride;
+                uint64_t* blocks = blocks_.data() + y * columns_;
+                uint64_t row_hash = 0;
+                for (int c = 0; c < columns_; ++c) {
+                    const int x0 = c * BLOCK_WIDTH;
+                    const int x1 = std::min(width, x0 + BLOCK_WIDTH);
+                    blocks[c] = HashBytes(row + static_cast<size_t>(x0) * 4, static_cast<size_t>(x1 - x0) * 4);
+                    row_hash = MixHash(row_hash, blocks[c]);
+                }
+                rows_[y] = row_hash;
+            }
+        });
+
+    scroll_ = has_previous_ ? EstimateScroll() : 0;
+    return scroll_;
+}
+
+int FrameTracker::EstimateScroll() const {
+    // Repeated rows, such as blank margins, match anywhere and do not vote
+    std::unordered_map<uint64_t, int> previous;
+    previous.reserve(previous_rows_.size());
+    for (int y = 0; y < height_; ++y) {
+        auto [it, inserted] = previous.emplace(previous_rows_[y], y);
+        if (!inserted) {
+            it->second = -1;
+        }
+    }
+
+    std::unordered_map<int, int> votes;
+    for (int y = 0; y < height_; ++y) {
+        const auto it = previous.find(rows_[y]);
+        if (it != previous.end() && it->second >= 0) {
+            votes[y - it->second]++;
+        }
+    }
+
+    int scroll = 0;
+    int best = 0;
+    for (const auto& [offset, count] : votes) {
+        if (count > best || (count == best && offset == 0)) {
+            scroll = offset;
+            best = count;
+        }
+    }
+    return best >= SCROLL_MIN_VOTES ? scroll : 0;
+}
+
+bool FrameTracker::BlocksUnchanged(const FrameRegion& region) const {
+    if (region.y - scroll_ < 0 || region.y + region.height - scroll_ > height_) {
+        return false;
+    }
+    const int first_column = region.x / BLOCK_WIDTH;
+    const int end_column = (region.x + region.width - 1) / BLOCK_WIDTH + 1;
+    for (int y = region.y; y < region.y + region.height; ++y) {
+        const uint64_t* blocks = blocks_.data() + static_cast<size_t>(y) * columns_;
+        const uint64_t* previous = previous_blocks_.data() + static_cast<size_t>(y - scroll_) * columns_;
+        if (!std::equal(blocks + first_column, blocks + end_column, previous + first_column)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const std::string* FrameTracker::FindUnchanged(const FrameRegion& region) const {
+    if (!has_previous_) {
+        return nullptr;
+    }
+    const SelectionRect rect{
+        static_cast<float>(region.x), static_cast<float>(region.y),
+        static_cast<float>(region.x + region.width), static_cast<float>(region.y + region.height)};
+    for (const Tracked& tracked : previous_regions_) {
+        const SelectionRect scrolled{
+            static_cast<float>(tracked.region.x), static_cast<float>(tracked.region.y + scroll_),
+            static_cast<float>(tracked.region.x + tracked.region.width),
+            static_cast<float>(tracked.region.y + tracked.region.height + scroll_)};
+        if (SelectionOverlap(rect, scrolled) >= MATCH_MIN_OVERLAP) {
+            return BlocksUnchanged(region) ? &tracked.text : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+void FrameTracker::Track(const FrameRegion& region, const std::string& text) {
+    regions_.push_back({region, text});
+}
+
+void FrameTracker::EndFrame() {
+    previous_regions_.swap(regions_);
+    regions_.clear();
+    frame_open_ = false;
+}
+
+void FrameTracker::Reset() {
+    *this = FrameTracker{};
+}
+
+void FrameTracker::AccountMemory(MemoryUsage& usage) const {
+    usage.AddRegion(MemoryComponent::kScratch, blocks_.data(), blocks_.capacity() * sizeof(uint64_t));
+    usage.AddRegion(MemoryComponent::kScratch, rows_.data(), rows_.capacity() * sizeof(uint64_t));
+    usage.AddRegion(MemoryComponent::kScratch, previous_blocks_.data(), previous_blocks_.capacity() * sizeof(uint64_t));
+    usage.AddRegion(MemoryComponent::kScratch, previous_rows_.data(), previous_rows_.capacity() * sizeof(uint64_t));
+    size_t text_bytes = (previous_regions_.capacity() + regions_.capacity()) * sizeof(Tracked);
+    for (const auto* regions : {&previous_regions_, &regions_}) {
+        for (const Tracked& tracked : *regions) {
+            text_bytes += tracked.text.capacity();
+        }
+    }
+    usage.AddResident(MemoryComponent::kScratch, text_bytes);
+}
+
+} // namespace mihon
@@ -0,0 +1,88 @@
+#ifndef MIHON_FRAME_TRACKER_H
+#define MIHON_FRAME_TRACKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "memory_accounting.h"
+
+namespace mihon {
+
+// Text region of a frame in pixels
+struct FrameRegion {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+};
+
+// Change detection over successive frames of one screen, so streaming OCR only recognizes
+// regions that are new or whose pixels changed.
+//
+// Every frame is hashed in blocks of one row by BLOCK_WIDTH pixels on the work pool. The vertical
+// scroll since the previous frame is the row offset that most rows with a unique hash agree on.
+// A region keeps the text of the previous frame's region it overlaps after scrolling when every
+// block it touches hashes the same as the block scrolled onto it. Edge blocks also cover pixels
+// just outside a region, so nearby changes can mark it changed, but a change inside never goes
+// unnoticed short of a hash collision.
+// Guarded by the caller's inference lock.
+class FrameTracker {
+public:
+    static constexpr int BLOCK_WIDTH = 32;
+    // Regions overlapping a scrolled region of the previous frame at least this much are tracked as it
+    static constexpr float MATCH_MIN_OVERLAP = 0.9f;
+    // Fewest rows that must agree on a scroll before one is reported
+    static constexpr int SCROLL_MIN_VOTES = 8;
+
+    // Hashes a `width` x `height` ARGB_8888 frame of `stream`, recognized with `profile`, and makes
+    // it the current frame. A new stream, profile or frame size drops what was tracked. Returns the vertical scroll since the
+    // previous frame in pixels, positive when content moved down.
+    int BeginFrame(int64_t stream, int profile, const uint8_t* pixels, int width, int height, size_t stride);
+
+    // Text of the previous frame's region that `region` of the current frame tracks, when its
+    // pixels are unchanged; null when it is new or changed
+    const std::string* FindUnchanged(const FrameRegion& region) const;
+
+    // Tracks `region` of the current frame with `text`, for the next frame
+    void Track(const FrameRegion& region, const std::string& text);
+
+    // Replaces the previous frame's regions with the ones tracked since BeginFrame
+    void EndFrame();
+
+    void Reset();
+
+    void AccountMemory(MemoryUsage& usage) const;
+
+private:
+    struct Tracked {
+        FrameRegion region;
+        std::string text;
+    };
+
+    int EstimateScroll() const;
+    bool BlocksUnchanged(const FrameRegion& region) const;
+
+    int64_t stream_ = 0;
+    int profile_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+    int columns_ = 0;
+    int scroll_ = 0;
+    bool has_previous_ = false;
+    // BeginFrame was called without EndFrame, so the tracked regions may belong to an older frame
+    bool frame_open_ = false;
+
+    // Row-major block hashes and per-row hashes of the current and previous frames
+    std::vector<uint64_t> blocks_;
+    std::vector<uint64_t> rows_;
+    std::vector<uint64_t> previous_blocks_;
+    std::vector<uint64_t> previous_rows_;
+
+    std::vector<Tracked> previous_regions_;
+    std::vector<Tracked> regions_;
+};
+
+} // namespace mihon
+
+#endif // MIHON_FRAME_TRACKER_H
@@ -0,0 +1,48 @@
+#include "host_asset.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct AAsset {
+    void* data;
+    size_t size;
+};
+
+const void* AAsset_getBuffer(AAsset* asset) {
+    return asset->data;
+}
+
+off_t AAsset_getLength(AAsset* asset) {
+    return static_cast<off_t>(asset->size);
+}
+
+void AAsset_close(AAsset* asset) {
+    if (asset->size > 0) {
+        munmap(asset->data, asset->size);
+    }
+    delete asset;
+}
+
+namespace mihon {
+
+AAsset* OpenHostAsset(const char* path) {
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    // The mapping keeps the file alive, like an uncompressed asset inside the APK
+    void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return nullptr;
+    }
+    return new AAsset{data, static_cast<size_t>(st.st_size)};
+}
+
+} // namespace mihon
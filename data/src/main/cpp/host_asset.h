@@ -0,0 +1,21 @@
+#ifndef MIHON_HOST_ASSET_H
+#define MIHON_HOST_ASSET_H
+
+#include <sys/types.h>
+
+// Host stand-in for the part of the NDK asset API the engine reads models through, so the
+// native core builds outside Android. A host asset is a read-only mapping of a model file.
+struct AAsset;
+
+const void* AAsset_getBuffer(AAsset* asset);
+off_t AAsset_getLength(AAsset* asset);
+void AAsset_close(AAsset* asset);
+
+namespace mihon {
+
+// Maps the file at `path`, or returns nullptr if it cannot be opened
+AAsset* OpenHostAsset(const char* path);
+
+} // namespace mihon
+
+#endif // MIHON_HOST_ASSET_H
@@ -0,0 +1,193 @@
+#include "host_image_decoder.h"
+#include <algorithm>
+#include <cctype>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#ifdef MIHON_OCR_HAVE_PNG
+#include <png.h>
+#endif
+#ifdef MIHON_OCR_HAVE_JPEG
+#include <jpeglib.h>
+#endif
+
+namespace mihon {
+
+namespace {
+
+using FilePtr = std::unique_ptr<FILE, int (*)(FILE*)>;
+
+FilePtr OpenFile(const std::string& path) {
+    return FilePtr(std::fopen(path.c_str(), "rb"), std::fclose);
+}
+
+#ifdef MIHON_OCR_HAVE_PNG
+bool DecodePng(const std::string& path, DecodedImage* image) {
+    png_image png;
+    std::memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_file(&png, path.c_str())) {
+        return false;
+    }
+    png.format = PNG_FORMAT_RGBA;
+    image->width = static_cast<int>(png.width);
+    image->height = static_cast<int>(png.height);
+    image->pixels.resize(PNG_IMAGE_SIZE(png));
+    if (!png_image_finish_read(&png, nullptr, image->pixels.data(), 0, nullptr)) {
+        png_image_free(&png);
+        return false;
+    }
+    return true;
+}
+#endif
+
+#ifdef MIHON_OCR_HAVE_JPEG
+struct JpegErrorManager {
+    jpeg_error_mgr base;
+    std::jmp_buf jump;
+};
+
+void OnJpegError(j_common_ptr info) {
+    std::longjmp(reinterpret_cast<JpegErrorManager*>(info->err)->jump, 1);
+}
+
+bool DecodeJpeg(FILE* file, DecodedImage* image) {
+    jpeg_decompress_struct info;
+    JpegErrorManager error;
+    // Declared before setjmp so a decode error does not jump over its destructor
+    std::vector<uint8_t> row;
+    info.err = jpeg_std_error(&error.base);
+    error.base.error_exit = OnJpegError;
+    if (setjmp(error.jump)) {
+        jpeg_destroy_decompress(&info);
+        return false;
+    }
+
+    jpeg_create_decompress(&info);
+    jpeg_stdio_src(&info, file);
+    jpeg_read_header(&info, TRUE);
+    // Grayscale is expanded by hand so every libjpeg flavour works
+    const bool gray = info.jpeg_color_space == JCS_GRAYSCALE;
+    info.out_color_space = gray ? JCS_GRAYSCALE : JCS_RGB;
+    jpeg_start_decompress(&info);
+
+    image->width = static_cast<int>(info.output_width);
+    image->height = static_cast<int>(info.output_height);
+    image->pixels.resize(static_cast<size_t>(image->width) * image->height * 4);
+    row.resize(static_cast<size_t>(image->width) * info.output_components);
+    while (info.output_scanline < info.output_height) {
+        uint8_t* dst = image->pixels.data() + static_cast<size_t>(info.output_scanline) * image->width * 4;
+        JSAMPROW rows[] = {row.data()};
+        jpeg_read_scanlines(&info, rows, 1);
+        for (int x = 0; x < image->width; ++x) {
+            const uint8_t* src = row.data() + x * info.output_components;
+            dst[x * 4] = src[0];
+            dst[x * 4 + 1] = gray ? src[0] : src[1];
+            dst[x * 4 + 2] = gray ? src[0] : src[2];
+            dst[x * 4 + 3] = 255;
+        }
+    }
+    jpeg_finish_decompress(&info);
+    jpeg_destroy_decompress(&info);
+    return true;
+}
+#endif
+
+// Reads the next header integer of a PNM file, skipping whitespace and comments
+bool ReadPnmValue(FILE* file, int* value) {
+    int c = std::fgetc(file);
+    while (c != EOF && (std::isspace(c) || c == '#')) {
+        if (c == '#') {
+            while (c != EOF && c != '\n') {
+                c = std::fgetc(file);
+            }
+        }
+        c = std::fgetc(file);
+    }
+    if (c == EOF || !std::isdigit(c)) {
+        return false;
+    }
+    *value = 0;
+    while (c != EOF && std::isdigit(c)) {
+        *value = *value * 10 + (c - '0');
+        if (*value > (1 << 20)) {
+            return false;
+        }
+        c = std::fgetc(file);
+    }
+    // Exactly one whitespace byte separates the header from the pixels
+    return c != EOF && std::isspace(c);
+}
+
+bool DecodePnm(FILE* file, char kind, DecodedImage* image) {
+    int width = 0, height = 0, max_value = 0;
+    if (!ReadPnmValue(file, &width) || !ReadPnmValue(file, &height) || !ReadPnmValue(file, &max_value) ||
+        width <= 0 || height <= 0 || max_value != 255) {
+        return false;
+    }
+    const int channels = kind == '6' ? 3 : 1;
+    std::vector<uint8_t> data(static_cast<size_t>(width) * height * channels);
+    if (std::fread(data.data(), 1, data.size(), file) != data.size()) {
+        return false;
+    }
+    image->width = width;
+    image->height = height;
+    image->pixels.resize(static_cast<size_t>(width) * height * 4);
+    for (size_t i = 0, count = static_cast<size_t>(width) * height; i < count; ++i) {
+        const uint8_t* src = data.data() + i * channels;
+        image->pixels[i * 4] = src[0];
+        image->pixels[i * 4 + 1] = src[channels == 3 ? 1 : 0];
+        image->pixels[i * 4 + 2] = src[channels == 3 ? 2 : 0];
+        image->pixels[i * 4 + 3] = 255;
+    }
+    return true;
+}
+
+} // namespace
+
+bool HasImageExtension(const std::string& path) {
+    const size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos) {
+        return false;
+    }
+    std::string ext = path.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    return ext == "png" || ext == "jpg" || ext == "jpeg" || ext == "ppm" || ext == "pgm";
+}
+
+bool DecodeImageFile(const std::string& path, DecodedImage* image) {
+    FilePtr file = OpenFile(path);
+    if (!file) {
+        return false;
+    }
+    uint8_t magic[4] = {};
+    if (std::fread(magic, 1, sizeof(magic), file.get()) != sizeof(magic)) {
+        return false;
+    }
+    std::rewind(file.get());
+
+    if (magic[0] == 0x89 && magic[1] == 'P' && magic[2] == 'N' && magic[3] == 'G') {
+#ifdef MIHON_OCR_HAVE_PNG
+        file.reset();
+        return DecodePng(path, image);
+#else
+        return false;
+#endif
+    }
+    if (magic[0] == 0xFF && magic[1] == 0xD8) {
+#ifdef MIHON_OCR_HAVE_JPEG
+        return DecodeJpeg(file.get(), image);
+#else
+        return false;
+#endif
+    }
+    if (magic[0] == 'P' && (magic[1] == '5' || magic[1] == '6')) {
+        std::fseek(file.get(), 2, SEEK_SET);
+        return DecodePnm(file.get(), static_cast<char>(magic[1]), image);
+    }
+    return false;
+}
+
+} // namespace mihon
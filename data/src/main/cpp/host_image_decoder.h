@@ -0,0 +1,25 @@
+#ifndef MIHON_HOST_IMAGE_DECODER_H
+#define MIHON_HOST_IMAGE_DECODER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mihon {
+
+// Pixels in the ARGB_8888 bitmap layout the preprocessor takes (R, G, B, A bytes), rows tightly packed
+struct DecodedImage {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+// True for file extensions the decoder may handle; the format itself is detected from the content
+bool HasImageExtension(const std::string& path);
+
+// Decodes a PNG or JPEG (when built with libpng/libjpeg) or binary PGM/PPM file
+bool DecodeImageFile(const std::string& path, DecodedImage* image);
+
+} // namespace mihon
+
+#endif // MIHON_HOST_IMAGE_DECODER_H
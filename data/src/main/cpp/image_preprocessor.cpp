@@ -0,0 +1,430 @@
+#include "image_preprocessor.h"
+#include "work_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace mihon {
+
+static constexpr float NORMALIZATION_FACTOR = 1.0f / (255.0f * 0.5f);
+static constexpr float NORMALIZED_MEAN = 0.5f / 0.5f;
+
+// Patches need both to be kept: variance alone keeps soft shading, edges alone keep JPEG noise
+static constexpr float PATCH_MIN_LUMA_VARIANCE = 25.0f;
+static constexpr float PATCH_MIN_EDGE_ENERGY = 3.0f;
+
+// Downscales reading fewer source pixels than this stay on the calling thread, as handing
+// rows to the work pool would cost more than it saves
+static constexpr size_t PARALLEL_MIN_SOURCE_PIXELS = 512 * 512;
+static constexpr size_t PARALLEL_ROWS_PER_CHUNK = 16;
+
+// Batch crops are ordered by bands of this many source rows, then left to right
+static constexpr int BATCH_ROW_BAND = 64;
+static constexpr size_t BATCH_SLOT_ALIGNMENT = 64;
+
+size_t ImageInputBytes(ImageInputFormat format, int width, int height) {
+    const size_t pixels = static_cast<size_t>(width) * height;
+    switch (format) {
+        case ImageInputFormat::kFloat32Rgb:
+            return pixels * 3 * sizeof(float);
+        case ImageInputFormat::kUint8Rgb:
+            return pixels * 3;
+        case ImageInputFormat::kUint8Rgba:
+            return pixels * 4;
+    }
+    return 0;
+}
+
+void PreprocessPixels(
+    const uint8_t* pixels,
+    int width,
+    int height,
+    size_t stride,
+    ImageInputFormat format,
+    void* output) {
+
+    // Channel order matches the float path the base encoder was exported with
+    for (int y = 0; y < height; ++y) {
+        const auto* row = reinterpret_cast<const uint32_t*>(pixels + y * stride);
+
+        if (format == ImageInputFormat::kUint8Rgba) {
+            auto* out = static_cast<uint8_t*>(output) + static_cast<size_t>(y) * width * 4;
+            for (int x = 0; x < width; ++x) {
+                const uint32_t pixel = row[x];
+                *out++ = static_cast<uint8_t>(pixel >> 16);
+                *out++ = static_cast<uint8_t>(pixel >> 8);
+                *out++ = static_cast<uint8_t>(pixel);
+                *out++ = static_cast<uint8_t>(pixel >> 24);
+            }
+            continue;
+        }
+
+        const size_t out_offset = static_cast<size_t>(y) * width * 3;
+        if (format == ImageInputFormat::kUint8Rgb) {
+            auto* out = static_cast<uint8_t*>(output) + out_offset;
+            for (int x = 0; x < width; ++x) {
+                const uint32_t pixel = row[x];
+                *out++ = static_cast<uint8_t>(pixel >> 16);
+                *out++ = static_cast<uint8_t>(pixel >> 8);
+                *out++ = static_cast<uint8_t>(pixel);
+            }
+        } else {
+            auto* out = static_cast<float*>(output) + out_offset;
+            for (int x = 0; x < width; ++x) {
+                const uint32_t pixel = row[x];
+                *out++ = ((pixel >> 16) & 0xFF) * NORMALIZATION_FACTOR - NORMALIZED_MEAN;
+                *out++ = ((pixel >> 8) & 0xFF) * NORMALIZATION_FACTOR - NORMALIZED_MEAN;
+                *out++ = (pixel & 0xFF) * NORMALIZATION_FACTOR - NORMALIZED_MEAN;
+            }
+        }
+    }
+}
+
+static inline int Luma(uint32_t pixel) {
+    // Symmetric in the red and blue channels, so the byte order does not matter
+    return (((pixel >> 16) & 0xFF) + 2 * ((pixel >> 8) & 0xFF) + (pixel & 0xFF)) >> 2;
+}
+
+void ComputePatchMask(const uint8_t* pixels, int width, int height, size_t stride, PatchMask& mask) {
+    const int grid = mask.grid;
+    mask.keep.assign(static_cast<size_t>(grid) * grid, 0);
+    mask.kept_count = 0;
+    const int patch_width = width / grid;
+    const int patch_height = height / grid;
+    const float patch_pixels = static_cast<float>(patch_width) * patch_height;
+
+    for (int py = 0; py < grid; ++py) {
+        for (int px = 0; px < grid; ++px) {
+            // Gradients to the right and below, staying inside the image
+            uint64_t sum = 0;
+            uint64_t sum_squares = 0;
+            uint64_t edges = 0;
+            for (int y = py * patch_height; y < (py + 1) * patch_height; ++y) {
+                const auto* row = reinterpret_cast<const uint32_t*>(pixels + y * stride);
+                const auto* next_row = y + 1 < height ? reinterpret_cast<const uint32_t*>(pixels + (y + 1) * stride) : row;
+                for (int x = px * patch_width; x < (px + 1) * patch_width; ++x) {
+                    const int luma = Luma(row[x]);
+                    sum += luma;
+                    sum_squares += static_cast<uint64_t>(luma * luma);
+                    const int right = x + 1 < width ? Luma(row[x + 1]) : luma;
+                    edges += std::abs(right - luma) + std::abs(Luma(next_row[x]) - luma);
+                }
+            }
+            const float mean = sum / patch_pixels;
+            const float variance = sum_squares / patch_pixels - mean * mean;
+            const float edge_energy = edges / patch_pixels;
+            if (variance >= PATCH_MIN_LUMA_VARIANCE && edge_energy >= PATCH_MIN_EDGE_ENERGY) {
+                mask.keep[static_cast<size_t>(py) * grid + px] = 1;
+                mask.kept_count++;
+            }
+        }
+    }
+}
+
+// Box filter over the source footprint of every output pixel in rows [first_row, end_row)
+static void BoxFilterRows(
+    const uint8_t* pixels,
+    size_t stride,
+    int x,
+    int y,
+    float scale_x,
+    float scale_y,
+    uint8_t* output,
+    int out_width,
+    int first_row,
+    int end_row) {
+    for (int oy = first_row; oy < end_row; ++oy) {
+        const int y0 = y + static_cast<int>(oy * scale_y);
+        const int y1 = std::max(y0 + 1, y + static_cast<int>((oy + 1) * scale_y));
+        for (int ox = 0; ox < out_width; ++ox) {
+            const int x0 = x + static_cast<int>(ox * scale_x);
+            const int x1 = std::max(x0 + 1, x + static_cast<int>((ox + 1) * scale_x));
+
+            uint32_t sum[4] = {0, 0, 0, 0};
+            for (int sy = y0; sy < y1; ++sy) {
+                const uint8_t* src = pixels + static_cast<size_t>(sy) * stride + static_cast<size_t>(x0) * 4;
+                for (int sx = x0; sx < x1; ++sx, src += 4) {
+                    sum[0] += src[0];
+                    sum[1] += src[1];
+                    sum[2] += src[2];
+                    sum[3] += src[3];
+                }
+            }
+            const uint32_t count = static_cast<uint32_t>((y1 - y0) * (x1 - x0));
+            uint8_t* out = output + (static_cast<size_t>(oy) * out_width + ox) * 4;
+            for (int c = 0; c < 4; ++c) {
+                out[c] = static_cast<uint8_t>((sum[c] + count / 2) / count);
+            }
+        }
+    }
+}
+
+// ResizeRegion; `parallel` lets large downscales split their rows across the work pool
+static void ResampleRegion(
+    const uint8_t* pixels,
+    size_t stride,
+    int x,
+    int y,
+    int width,
+    int height,
+    uint8_t* output,
+    int out_width,
+    int out_height,
+    bool parallel) {
+
+    const float scale_x = static_cast<float>(width) / out_width;
+    const float scale_y = static_cast<float>(height) / out_height;
+
+    if (scale_x > 1.0f || scale_y > 1.0f) {
+        // Output rows are independent, so large footprints are split across the work pool
+        if (!parallel || static_cast<size_t>(width) * height < PARALLEL_MIN_SOURCE_PIXELS) {
+            BoxFilterRows(pixels, stride, x, y, scale_x, scale_y, output, out_width, 0, out_height);
+            return;
+        }
+        WorkPool::Shared().ParallelFor(
+            WorkClass::kPreprocess, static_cast<size_t>(out_height), PARALLEL_ROWS_PER_CHUNK,
+            [&](size_t begin, size_t end) {
+                BoxFilterRows(pixels, stride, x, y, scale_x, scale_y, output, out_width,
+                              static_cast<int>(begin), static_cast<int>(end));
+            });
+        return;
+    }
+
+    // Bilinear interpolation with pixel-center alignment
+    for (int oy = 0; oy < out_height; ++oy) {
+        const float fy = std::clamp((oy + 0.5f) * scale_y - 0.5f, 0.0f, static_cast<float>(height - 1));
+        const int y0 = static_cast<int>(fy);
+        const int y1 = std::min(y0 + 1, height - 1);
+        const float wy = fy - y0;
+        const uint8_t* row0 = pixels + static_cast<size_t>(y + y0) * stride;
+        const uint8_t* row1 = pixels + static_cast<size_t>(y + y1) * stride;
+
+        for (int ox = 0; ox < out_width; ++ox) {
+            const float fx = std::clamp((ox + 0.5f) * scale_x - 0.5f, 0.0f, static_cast<float>(width - 1));
+            const int x0 = static_cast<int>(fx);
+            const int x1 = std::min(x0 + 1, width - 1);
+            const float wx = fx - x0;
+
+            const uint8_t* p00 = row0 + static_cast<size_t>(x + x0) * 4;
+            const uint8_t* p01 = row0 + static_cast<size_t>(x + x1) * 4;
+            const uint8_t* p10 = row1 + static_cast<size_t>(x + x0) * 4;
+            const uint8_t* p11 = row1 + static_cast<size_t>(x + x1) * 4;
+            uint8_t* out = output + (static_cast<size_t>(oy) * out_width + ox) * 4;
+            for (int c = 0; c < 4; ++c) {
+                const float top = p00[c] + (p01[c] - p00[c]) * wx;
+                const float bottom = p10[c] + (p11[c] - p10[c]) * wx;
+                out[c] = static_cast<uint8_t>(std::lround(top + (bottom - top) * wy));
+            }
+        }
+    }
+}
+
+void ResizeRegion(
+    const uint8_t* pixels,
+    size_t stride,
+    int x,
+    int y,
+    int width,
+    int height,
+    uint8_t* output,
+    int out_width,
+    int out_height) {
+    ResampleRegion(pixels, stride, x, y, width, height, output, out_width, out_height, true);
+}
+
+size_t ImagePyramid::Bytes() const {
+    size_t bytes = 0;
+    for (const Level& level : levels) {
+        bytes += level.pixels.capacity();
+    }
+    return bytes;
+}
+
+// Averages each 2x2 block of `source` in rows [first_row, end_row) of `level`; blocks past the
+// right or bottom edge repeat the last column or row
+static void HalveRows(const uint8_t* source, size_t stride, int width, int height,
+                      ImagePyramid::Level& level, int first_row, int end_row) {
+    for (int oy = first_row; oy < end_row; ++oy) {
+        const uint8_t* row0 = source + static_cast<size_t>(2 * oy) * stride;
+        const uint8_t* row1 = source + static_cast<size_t>(std::min(2 * oy + 1, height - 1)) * stride;
+        uint8_t* out = level.pixels.data() + static_cast<size_t>(oy) * level.width * 4;
+        for (int ox = 0; ox < level.width; ++ox, out += 4) {
+            const size_t x0 = static_cast<size_t>(2 * ox) * 4;
+            const size_t x1 = static_cast<size_t>(std::min(2 * ox + 1, width - 1)) * 4;
+            for (int c = 0; c < 4; ++c) {
+                out[c] = static_cast<uint8_t>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+            }
+        }
+    }
+}
+
+size_t ImagePyramidBytes(int width, int height, int min_side) {
+    size_t bytes = 0;
+    for (int w = (width + 1) / 2, h = (height + 1) / 2; std::max(w, h) >= min_side; w = (w + 1) / 2, h = (h + 1) / 2) {
+        bytes += static_cast<size_t>(w) * h * 4;
+    }
+    return bytes;
+}
+
+void BuildImagePyramid(const uint8_t* pixels, int width, int height, size_t stride, int min_side, ImagePyramid& pyramid) {
+    pyramid.width = width;
+    pyramid.height = height;
+    size_t level_count = 0;
+    for (int w = width, h = height; std::max((w + 1) / 2, (h + 1) / 2) >= min_side; w = (w + 1) / 2, h = (h + 1) / 2) {
+        ++level_count;
+    }
+    // Buffers of a previous page are reused
+    pyramid.levels.resize(level_count);
+
+    const uint8_t* source = pixels;
+    size_t source_stride = stride;
+    int source_width = width;
+    int source_height = height;
+    for (ImagePyramid::Level& level : pyramid.levels) {
+        level.width = (source_width + 1) / 2;
+        level.height = (source_height + 1) / 2;
+        level.pixels.resize(static_cast<size_t>(level.width) * level.height * 4);
+        WorkPool::Shared().ParallelFor(
+            WorkClass::kPreprocess, static_cast<size_t>(level.height), PARALLEL_ROWS_PER_CHUNK,
+            [&](size_t begin, size_t end) {
+                HalveRows(source, source_stride, source_width, source_height, level,
+                          static_cast<int>(begin), static_cast<int>(end));
+            });
+        source = level.pixels.data();
+        source_stride = static_cast<size_t>(level.width) * 4;
+        source_width = level.width;
+        source_height = level.height;
+    }
+}
+
+// Level of `pyramid` to resample the rectangle from, and the rectangle in its coordinates
+static int SelectPyramidLevel(const ImagePyramid& pyramid, int& x, int& y, int& width, int& height,
+                              int out_width, int out_height) {
+    int selected = 0;
+    int level_x = x, level_y = y, level_width = width, level_height = height;
+    for (size_t k = 0; k < pyramid.levels.size(); ++k) {
+        const ImagePyramid::Level& level = pyramid.levels[k];
+        const int shift = static_cast<int>(k) + 1;
+        const int x0 = x >> shift;
+        const int y0 = y >> shift;
+        const int x1 = std::min(level.width, (x + width + (1 << shift) - 1) >> shift);
+        const int y1 = std::min(level.height, (y + height + (1 << shift) - 1) >> shift);
+        if (x1 - x0 < out_width || y1 - y0 < out_height) {
+            break;
+        }
+        selected = shift;
+        level_x = x0;
+        level_y = y0;
+        level_width = x1 - x0;
+        level_height = y1 - y0;
+    }
+    x = level_x;
+    y = level_y;
+    width = level_width;
+    height = level_height;
+    return selected;
+}
+
+// ResampleRegion through the pyramid level SelectPyramidLevel picks
+static void ResamplePyramidRegion(
+    const ImagePyramid& pyramid,
+    const uint8_t* pixels,
+    size_t stride,
+    int x,
+    int y,
+    int width,
+    int height,
+    uint8_t* output,
+    int out_width,
+    int out_height,
+    bool parallel) {
+    const int level = SelectPyramidLevel(pyramid, x, y, width, height, out_width, out_height);
+    if (level > 0) {
+        const ImagePyramid::Level& source = pyramid.levels[level - 1];
+        pixels = source.pixels.data();
+        stride = static_cast<size_t>(source.width) * 4;
+    }
+    ResampleRegion(pixels, stride, x, y, width, height, output, out_width, out_height, parallel);
+}
+
+void ResizeRegion(
+    const ImagePyramid& pyramid,
+    const uint8_t* pixels,
+    size_t stride,
+    int x,
+    int y,
+    int width,
+    int height,
+    uint8_t* output,
+    int out_width,
+    int out_height) {
+    ResamplePyramidRegion(pyramid, pixels, stride, x, y, width, height, output, out_width, out_height, true);
+}
+
+size_t BatchInputOffsets(const RegionCrop* crops, size_t count, ImageInputFormat format, size_t* offsets) {
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        offsets[i] = total;
+        const size_t bytes = ImageInputBytes(format, crops[i].input_size, crops[i].input_size);
+        total += (bytes + BATCH_SLOT_ALIGNMENT - 1) / BATCH_SLOT_ALIGNMENT * BATCH_SLOT_ALIGNMENT;
+    }
+    return total;
+}
+
+void PreprocessRegions(
+    const uint8_t* pixels,
+    size_t stride,
+    const RegionCrop* crops,
+    size_t count,
+    ImageInputFormat format,
+    uint8_t* output,
+    const size_t* offsets,
+    PatchMask* masks,
+    RegionBatchScratch& scratch,
+    const ImagePyramid* pyramid) {
+
+    std::vector<size_t>& order = scratch.order;
+    order.resize(count);
+    scratch.scaled_offsets.resize(count);
+    size_t scaled_bytes = 0;
+    for (size_t i = 0; i < count; ++i) {
+        order[i] = i;
+        scratch.scaled_offsets[i] = scaled_bytes;
+        scaled_bytes += static_cast<size_t>(crops[i].input_size) * crops[i].input_size * 4;
+        // Workers then only write into buffers that are already large enough
+        if (masks && masks[i].grid > 0) {
+            masks[i].keep.reserve(static_cast<size_t>(masks[i].grid) * masks[i].grid);
+        }
+    }
+    if (scratch.scaled.size() < scaled_bytes) {
+        scratch.scaled.resize(scaled_bytes);
+    }
+    std::stable_sort(order.begin(), order.end(), [crops](size_t a, size_t b) {
+        const int band_a = crops[a].y / BATCH_ROW_BAND;
+        const int band_b = crops[b].y / BATCH_ROW_BAND;
+        return band_a != band_b ? band_a < band_b : crops[a].x < crops[b].x;
+    });
+
+    // Each crop is resampled on one thread; the batch itself is the parallelism
+    WorkPool::Shared().ParallelFor(WorkClass::kPreprocess, count, 1, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            const size_t i = order[k];
+            const RegionCrop& crop = crops[i];
+            const size_t row_bytes = static_cast<size_t>(crop.input_size) * 4;
+            uint8_t* scaled = scratch.scaled.data() + scratch.scaled_offsets[i];
+            if (pyramid) {
+                ResamplePyramidRegion(*pyramid, pixels, stride, crop.x, crop.y, crop.width, crop.height,
+                                      scaled, crop.input_size, crop.input_size, false);
+            } else {
+                ResampleRegion(pixels, stride, crop.x, crop.y, crop.width, crop.height,
+                               scaled, crop.input_size, crop.input_size, false);
+            }
+            PreprocessPixels(scaled, crop.input_size, crop.input_size, row_bytes, format, output + offsets[i]);
+            if (masks && masks[i].grid > 0) {
+                ComputePatchMask(scaled, crop.input_size, crop.input_size, row_bytes, masks[i]);
+            }
+        }
+    });
+}
+
+} // namespace mihon
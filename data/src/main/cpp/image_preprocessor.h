@@ -0,0 +1,153 @@
+#ifndef MIHON_IMAGE_PREPROCESSOR_H
+#define MIHON_IMAGE_PREPROCESSOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mihon {
+
+// Element layout of the encoder image input
+// Every format feeds the colour channels as B, G, R: the base encoder was exported against
+// RGBA_8888 bitmaps read as little-endian words, and the other variants come from the same graph
+enum class ImageInputFormat {
+    // (x / 127.5) - 1 normalized floats, 3 channels
+    kFloat32Rgb,
+    // Raw bytes, 3 channels; the encoder normalizes in-graph
+    kUint8Rgb,
+    // Raw bytes, 3 channels followed by alpha; the encoder normalizes in-graph
+    kUint8Rgba,
+};
+
+size_t ImageInputBytes(ImageInputFormat format, int width, int height);
+
+// Converts ARGB_8888 bitmap pixels into the encoder input layout.
+// `stride` is the source row length in bytes.
+void PreprocessPixels(
+    const uint8_t* pixels,
+    int width,
+    int height,
+    size_t stride,
+    ImageInputFormat format,
+    void* output
+);
+
+// Informativeness of each patch of a `grid` x `grid` split of the model input
+struct PatchMask {
+    int grid = 0;
+    // Row-major, 1 where the patch has both the luma variance and the edge energy of ink;
+    // empty until computed
+    std::vector<uint8_t> keep;
+    int kept_count = 0;
+
+    bool IsComputed() const { return grid > 0 && keep.size() == static_cast<size_t>(grid) * grid; }
+};
+
+// Fills `mask` for `mask.grid` from ARGB_8888 pixels; `width` and `height` must be multiples
+// of the grid. Blank bubble interiors and smooth shading are left out.
+void ComputePatchMask(const uint8_t* pixels, int width, int height, size_t stride, PatchMask& mask);
+
+// Resamples the `width` x `height` rectangle at (`x`, `y`) of ARGB_8888 pixels to
+// `out_width` x `out_height` tightly packed pixels. Downscaling averages each output
+// pixel's source footprint; upscaling interpolates bilinearly.
+void ResizeRegion(
+    const uint8_t* pixels,
+    size_t stride,
+    int x,
+    int y,
+    int width,
+    int height,
+    uint8_t* output,
+    int out_width,
+    int out_height
+);
+
+// 2x box-filtered reductions of an ARGB_8888 page. Level k is the page scaled by 1 / 2^k,
+// rounding sizes up; level 0 is the page itself and is not stored.
+struct ImagePyramid {
+    struct Level {
+        int width = 0;
+        int height = 0;
+        // Tightly packed
+        std::vector<uint8_t> pixels;
+    };
+
+    int width = 0;
+    int height = 0;
+    // Levels 1 and up
+    std::vector<Level> levels;
+
+    size_t Bytes() const;
+};
+
+// Bytes of the levels BuildImagePyramid makes for a `width` x `height` page
+size_t ImagePyramidBytes(int width, int height, int min_side);
+
+// Builds levels of `pyramid` until the next would have no side of at least `min_side`
+void BuildImagePyramid(const uint8_t* pixels, int width, int height, size_t stride, int min_side, ImagePyramid& pyramid);
+
+// ResizeRegion of the page `pixels` that `pyramid` was built from, reading the coarsest level
+// that still has at least `out_width` x `out_height` pixels across the rectangle
+void ResizeRegion(
+    const ImagePyramid& pyramid,
+    const uint8_t* pixels,
+    size_t stride,
+    int x,
+    int y,
+    int width,
+    int height,
+    uint8_t* output,
+    int out_width,
+    int out_height
+);
+
+// One region of a preprocessing batch: the `width` x `height` rectangle at (`x`, `y`) of the
+// source, scaled to an `input_size` x `input_size` encoder input
+struct RegionCrop {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+    int input_size = 0;
+};
+
+// Fills `offsets` with where each crop's input starts in a contiguous batch buffer, each slot
+// aligned for float inputs; returns the buffer size in bytes
+size_t BatchInputOffsets(const RegionCrop* crops, size_t count, ImageInputFormat format, size_t* offsets);
+
+// Buffers PreprocessRegions works in, owned by the caller so they keep their capacity across
+// batches and show up in its memory accounting
+struct RegionBatchScratch {
+    // Crops in processing order
+    std::vector<size_t> order;
+    // Scaled pixels of every crop of the batch, at `scaled_offsets`
+    std::vector<uint8_t> scaled;
+    std::vector<size_t> scaled_offsets;
+
+    size_t Bytes() const {
+        return order.capacity() * sizeof(size_t) + scaled.capacity() + scaled_offsets.capacity() * sizeof(size_t);
+    }
+};
+
+// Crops, resizes and converts every crop of ARGB_8888 `pixels` into `output` at `offsets`.
+// Crops are spread over the work pool in source row bands, so crops running at the same time
+// read neighbouring parts of the page. `masks`, when set, holds a PatchMask per crop whose
+// `grid` was chosen by the caller; those with a non-zero grid are computed. `pyramid`, when
+// set, was built from `pixels` and crops are resampled from its levels. Only grows `scratch`
+// and the masks' buffers when they are too small, on the calling thread.
+void PreprocessRegions(
+    const uint8_t* pixels,
+    size_t stride,
+    const RegionCrop* crops,
+    size_t count,
+    ImageInputFormat format,
+    uint8_t* output,
+    const size_t* offsets,
+    PatchMask* masks,
+    RegionBatchScratch& scratch,
+    const ImagePyramid* pyramid = nullptr
+);
+
+} // namespace mihon
+
+#endif // MIHON_IMAGE_PREPROCESSOR_H
@@ -0,0 +1,62 @@
+#include "memory_accounting.h"
+#include <algorithm>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace mihon {
+
+size_t CountResidentBytes(const void* data, size_t size) {
+    if (!data || size == 0) {
+        return 0;
+    }
+
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(data) & ~(page_size - 1);
+    const uintptr_t end = reinterpret_cast<uintptr_t>(data) + size;
+
+    // Queried in fixed chunks so accounting does not allocate
+    constexpr size_t CHUNK_PAGES = 1024;
+    unsigned char residency[CHUNK_PAGES];
+    size_t resident_pages = 0;
+    for (uintptr_t chunk = begin; chunk < end; chunk += CHUNK_PAGES * page_size) {
+        const size_t chunk_bytes = std::min<size_t>(end - chunk, CHUNK_PAGES * page_size);
+        if (mincore(reinterpret_cast<void*>(chunk), chunk_bytes, residency) != 0) {
+            continue;
+        }
+        const size_t pages = (chunk_bytes + page_size - 1) / page_size;
+        for (size_t i = 0; i < pages; ++i) {
+            resident_pages += residency[i] & 1;
+        }
+    }
+    return std::min(resident_pages * page_size, end - begin);
+}
+
+void MemoryUsage::AddRegion(MemoryComponent component, const void* data, size_t size) {
+    ComponentMemory& memory = components[static_cast<int>(component)];
+    memory.mapped_bytes += static_cast<int64_t>(size);
+    memory.resident_bytes += static_cast<int64_t>(std::min(CountResidentBytes(data, size), size));
+}
+
+void MemoryUsage::AddResident(MemoryComponent component, size_t size) {
+    ComponentMemory& memory = components[static_cast<int>(component)];
+    memory.mapped_bytes += static_cast<int64_t>(size);
+    memory.resident_bytes += static_cast<int64_t>(size);
+}
+
+int64_t MemoryUsage::MappedBytes() const {
+    int64_t total = 0;
+    for (const auto& memory : components) {
+        total += memory.mapped_bytes;
+    }
+    return total;
+}
+
+int64_t MemoryUsage::ResidentBytes() const {
+    int64_t total = 0;
+    for (const auto& memory : components) {
+        total += memory.resident_bytes;
+    }
+    return total;
+}
+
+} // namespace mihon
@@ -0,0 +1,48 @@
+#ifndef MIHON_MEMORY_ACCOUNTING_H
+#define MIHON_MEMORY_ACCOUNTING_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace mihon {
+
+// Native memory owners reported to Kotlin; values match the JNI array layout
+enum class MemoryComponent : int {
+    // Memory-mapped .tflite assets
+    kModels = 0,
+    // Memory-mapped token embeddings table
+    kEmbeddings,
+    // LiteRT input/output tensor buffers (host or device)
+    kTensorBuffers,
+    // Engine-owned host buffers: hidden states, logits, decoder inputs
+    kHostBuffers,
+    // Per-session scratch: image/token buffers, request arena, vocabulary
+    kScratch,
+};
+
+inline constexpr int kMemoryComponentCount = 5;
+
+struct ComponentMemory {
+    int64_t mapped_bytes = 0;
+    int64_t resident_bytes = 0;
+};
+
+struct MemoryUsage {
+    std::array<ComponentMemory, kMemoryComponentCount> components{};
+
+    // Adds an address range, counting its resident pages with mincore
+    void AddRegion(MemoryComponent component, const void* data, size_t size);
+    // Adds memory whose residency cannot be queried (e.g. driver allocations); counted as resident
+    void AddResident(MemoryComponent component, size_t size);
+
+    int64_t MappedBytes() const;
+    int64_t ResidentBytes() const;
+};
+
+// Resident bytes of the pages overlapping [data, data + size)
+size_t CountResidentBytes(const void* data, size_t size);
+
+} // namespace mihon
+
+#endif // MIHON_MEMORY_ACCOUNTING_H
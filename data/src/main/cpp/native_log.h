@@ -0,0 +1,41 @@
+#ifndef MIHON_NATIVE_LOG_H
+#define MIHON_NATIVE_LOG_H
+
+// Logging for sources shared with host builds: logcat on Android, stderr elsewhere.
+// Use as MIHON_LOG_PRINT(INFO, LOG_TAG, fmt, ...) with INFO, WARN or ERROR.
+#ifdef __ANDROID__
+
+#include <android/log.h>
+#define MIHON_LOG_PRINT(level, tag, ...) __android_log_print(ANDROID_LOG_##level, tag, __VA_ARGS__)
+
+#else
+
+#include <atomic>
+#include <cstdio>
+
+namespace mihon {
+
+// Same values as the Android log priorities
+enum HostLogLevel : int {
+    HOST_LOG_INFO = 4,
+    HOST_LOG_WARN = 5,
+    HOST_LOG_ERROR = 6,
+};
+
+// Messages below this level are dropped; host tools raise it to keep their own output readable
+inline std::atomic<int> g_hostLogLevel{HOST_LOG_INFO};
+
+} // namespace mihon
+
+#define MIHON_LOG_PRINT(level, tag, ...)                                                   \
+    do {                                                                                  \
+        if (::mihon::HOST_LOG_##level >= ::mihon::g_hostLogLevel.load(std::memory_order_relaxed)) { \
+            std::fprintf(stderr, "%c/%s: ", #level[0], tag);                              \
+            std::fprintf(stderr, __VA_ARGS__);                                            \
+            std::fputc('\n', stderr);                                                     \
+        }                                                                                 \
+    } while (0)
+
+#endif
+
+#endif // MIHON_NATIVE_LOG_H
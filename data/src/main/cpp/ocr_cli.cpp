@@ -0,0 +1,822 @@
+// Batch OCR of page images or crops on a host machine, built on the same native core as the app.
+//
+//   mihon_ocr_cli --models DIR [options] <image or directory>...
+//   mihon_ocr_cli --models DIR [options] --replay CAPTURE
+//
+// Directories are walked recursively. Every worker owns one engine and claims `--batch` images
+// at a time from a shared queue. Results are written as JSONL (one object per image, in
+// completion order) or as a `.txt` sidecar next to each image. A summary with throughput and
+// latency percentiles goes to stderr.
+//
+// With --replay the requests of a capture recorded on device are re-run with their original
+// arrival gaps, reporting latency from each scheduled arrival and whether the tokens match.
+//
+// With --bench-preprocess no model is loaded: the regions of every image are preprocessed as
+// batches on the shared work pool at each worker count in turn, printing the scaling curve.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "host_asset.h"
+#include "host_image_decoder.h"
+#include "image_preprocessor.h"
+#include "native_log.h"
+#include "ocr_inference.h"
+#include "ocr_profile.h"
+#include "request_capture.h"
+#include "text_postprocessor.h"
+#include "vocab_data.h"
+#include "work_pool.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr int IMAGE_SIZE = 224;
+constexpr int MAX_SEQUENCE_LENGTH = 300;
+constexpr int SPECIAL_TOKEN_THRESHOLD = 5;
+// Each worker count of --bench-preprocess repeats the batch for at least this long
+constexpr double BENCH_MIN_SECONDS = 1.0;
+// Same rule as the app: an image's pyramid is built once regions that downscale at least 2x read
+// this many times its area
+constexpr double PYRAMID_MIN_PAGE_COVERAGE = 1.0;
+constexpr int PYRAMID_MIN_LEVEL_SIDE = 64;
+
+enum class OutputFormat { kJsonl, kSidecar };
+
+struct CliOptions {
+    std::string model_dir;
+    std::string cache_dir = fs::temp_directory_path().string();
+    std::string lib_dir;
+    mihon::OcrProfile profile = mihon::kDefaultOcrProfile;
+    int jobs = 0;
+    int batch = 1;
+    int threads = 0;
+    // Per-region time limit in milliseconds, 0 for none
+    int deadline_ms = 0;
+    // Regions whose predicted output cannot finish by the deadline are skipped, not cut short
+    bool complete_only = false;
+    OutputFormat format = OutputFormat::kJsonl;
+    std::string output;
+    bool regions = false;
+    bool verbose = false;
+    bool bench_preprocess = false;
+    // Capture file to replay instead of recognizing images
+    std::string replay;
+    std::vector<std::string> inputs;
+};
+
+struct Region {
+    int left = 0;
+    int top = 0;
+    int width = 0;
+    int height = 0;
+};
+
+struct ImageResult {
+    bool ok = false;
+    int width = 0;
+    int height = 0;
+    std::vector<Region> regions;
+    std::vector<std::string> texts;
+    // Per region: decoding stopped at the deadline
+    std::vector<bool> partial;
+    double decode_ms = 0;
+    double ocr_ms = 0;
+};
+
+void PrintUsage() {
+    std::fprintf(stderr,
+        "Usage: mihon_ocr_cli --models DIR [options] <image or directory>...\n"
+        "       mihon_ocr_cli --models DIR [options] --replay CAPTURE\n"
+        "\n"
+        "  --models DIR      directory with encoder.tflite, decoder.tflite and embeddings.bin\n"
+        "  --profile NAME    fast, balanced or accurate (default: balanced)\n"
+        "  --jobs N          engines running concurrently (default: cores / threads per engine)\n"
+        "  --batch N         images a worker claims from the queue at a time (default: 1)\n"
+        "  --threads N       CPU threads per engine (default: the profile's setting)\n"
+        "  --deadline MS     time limit per region; text decoded by then is reported as partial\n"
+        "  --complete-only   with --deadline, skip regions whose predicted output length cannot\n"
+        "                    be decoded in time instead of reporting partial text\n"
+        "  --format F        jsonl or sidecar (default: jsonl)\n"
+        "  --output PATH     JSONL output file (default: stdout)\n"
+        "  --regions         recognize the rectangles listed in <image>.regions, one\n"
+        "                    \"left top width height\" per line, instead of the whole image\n"
+        "  --cache-dir DIR   compilation cache directory (default: system temp)\n"
+        "  --lib-dir DIR     directory holding LiteRT accelerator libraries\n"
+        "  --replay CAPTURE  re-run the requests of a capture file with their recorded arrival\n"
+        "                    gaps; prints latency and token matches as JSONL, needs no images\n"
+        "  --bench-preprocess  measure batch region preprocessing at every work pool size\n"
+        "                    instead of running OCR; --models is not needed\n"
+        "  --verbose         keep the engine's info logging\n");
+}
+
+bool ParseInt(const char* text, int min_value, int* value) {
+    char* end = nullptr;
+    const long parsed = std::strtol(text, &end, 10);
+    if (!end || *end != '\0' || parsed < min_value || parsed > 4096) {
+        return false;
+    }
+    *value = static_cast<int>(parsed);
+    return true;
+}
+
+bool ParseProfile(const std::string& name, mihon::OcrProfile* profile) {
+    for (int i = 0; i < mihon::kOcrProfileCount; ++i) {
+        const auto candidate = static_cast<mihon::OcrProfile>(i);
+        if (name == mihon::GetProfileConfig(candidate).name) {
+            *profile = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ParseArgs(int argc, char** argv, CliOptions* options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--help" || arg == "-h") {
+            return false;
+        } else if (arg == "--regions") {
+            options->regions = true;
+        } else if (arg == "--verbose") {
+            options->verbose = true;
+        } else if (arg == "--complete-only") {
+            options->complete_only = true;
+        } else if (arg == "--bench-preprocess") {
+            options->bench_preprocess = true;
+        } else if (arg.rfind("--", 0) == 0 && !has_value) {
+            std::fprintf(stderr, "Missing value for %s\n", arg.c_str());
+            return false;
+        } else if (arg == "--models") {
+            options->model_dir = argv[++i];
+        } else if (arg == "--cache-dir") {
+            options->cache_dir = argv[++i];
+        } else if (arg == "--lib-dir") {
+            options->lib_dir = argv[++i];
+        } else if (arg == "--output") {
+            options->output = argv[++i];
+        } else if (arg == "--replay") {
+            options->replay = argv[++i];
+        } else if (arg == "--profile") {
+            if (!ParseProfile(argv[++i], &options->profile)) {
+                std::fprintf(stderr, "Unknown profile %s\n", argv[i]);
+                return false;
+            }
+        } else if (arg == "--format") {
+            const std::string format = argv[++i];
+            if (format == "jsonl") {
+                options->format = OutputFormat::kJsonl;
+            } else if (format == "sidecar") {
+                options->format = OutputFormat::kSidecar;
+            } else {
+                std::fprintf(stderr, "Unknown format %s\n", format.c_str());
+                return false;
+            }
+        } else if (arg == "--jobs" || arg == "--batch" || arg == "--threads" || arg == "--deadline") {
+            int* target = arg == "--jobs" ? &options->jobs
+                : arg == "--batch" ? &options->batch
+                : arg == "--threads" ? &options->threads
+                : &options->deadline_ms;
+            if (!ParseInt(argv[++i], arg == "--jobs" || arg == "--batch" ? 1 : 0, target)) {
+                std::fprintf(stderr, "Invalid value for %s\n", arg.c_str());
+                return false;
+            }
+        } else if (arg.rfind("--", 0) == 0) {
+            std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return false;
+        } else {
+            options->inputs.push_back(arg);
+        }
+    }
+    if (!options->replay.empty()) {
+        return !options->model_dir.empty();
+    }
+    return (!options->model_dir.empty() || options->bench_preprocess) && !options->inputs.empty();
+}
+
+// Expands directories recursively; the result is sorted so runs are reproducible
+std::vector<std::string> CollectImages(const std::vector<std::string>& inputs) {
+    std::vector<std::string> images;
+    for (const std::string& input : inputs) {
+        std::error_code error;
+        if (fs::is_directory(input, error)) {
+            for (auto it = fs::recursive_directory_iterator(input, fs::directory_options::skip_permission_denied, error);
+                 it != fs::recursive_directory_iterator(); it.increment(error)) {
+                if (it->is_regular_file(error) && mihon::HasImageExtension(it->path().string())) {
+                    images.push_back(it->path().string());
+                }
+            }
+        } else if (fs::is_regular_file(input, error)) {
+            images.push_back(input);
+        } else {
+            std::fprintf(stderr, "Skipping %s: not found\n", input.c_str());
+        }
+    }
+    std::sort(images.begin(), images.end());
+    return images;
+}
+
+// Reads "<image>.regions"; a missing file means the whole image
+std::vector<Region> ReadRegions(const std::string& image_path, int width, int height) {
+    std::vector<Region> regions;
+    std::ifstream file(image_path + ".regions");
+    Region region;
+    while (file >> region.left >> region.top >> region.width >> region.height) {
+        regions.push_back(region);
+    }
+    if (regions.empty()) {
+        regions.push_back({0, 0, width, height});
+    }
+    return regions;
+}
+
+void CloseAssets(mihon::ModelAssets& assets) {
+    for (AAsset* asset : {assets.encoder, assets.decoder, assets.embeddings, assets.ctc_head, assets.decoder_loop,
+                          assets.decoder_cross_kv, assets.encoder_exit_tail, assets.length_predictor}) {
+        if (asset) {
+            AAsset_close(asset);
+        }
+    }
+    for (AAsset* asset : assets.encoder_pruned) {
+        AAsset_close(asset);
+    }
+    for (const mihon::ResolutionAssets& resolution : assets.resolutions) {
+        AAsset_close(resolution.encoder);
+        AAsset_close(resolution.decoder);
+    }
+    for (const mihon::EncoderExitAssets& exit : assets.encoder_exits) {
+        AAsset_close(exit.segment);
+        AAsset_close(exit.decoder);
+    }
+    for (AAsset* asset : assets.decoder_buckets) {
+        AAsset_close(asset);
+    }
+    assets = {};
+}
+
+// Same file layout as the "ocr/" asset directory of the app
+bool OpenAssets(const std::string& dir, const mihon::ProfileConfig& config, mihon::ModelAssets& assets) {
+    auto open = [&dir](const std::string& name) { return mihon::OpenHostAsset((dir + "/" + name).c_str()); };
+    assets.encoder = open("encoder.tflite");
+    assets.decoder = open("decoder.tflite");
+    assets.embeddings = open("embeddings.bin");
+    if (!assets.encoder || !assets.decoder || !assets.embeddings) {
+        std::fprintf(stderr, "Missing encoder.tflite, decoder.tflite or embeddings.bin in %s\n", dir.c_str());
+        CloseAssets(assets);
+        return false;
+    }
+    for (int budget : config.encoder_patch_budgets) {
+        if (budget > 0) {
+            if (AAsset* pruned = open("encoder_pruned_" + std::to_string(budget) + ".tflite")) {
+                assets.encoder_pruned.push_back(pruned);
+            }
+        }
+    }
+    for (int size : config.input_sizes) {
+        if (size > 0) {
+            const std::string suffix = "_" + std::to_string(size) + "px.tflite";
+            mihon::ResolutionAssets resolution{open("encoder" + suffix), open("decoder" + suffix)};
+            if (resolution.encoder && resolution.decoder) {
+                assets.resolutions.push_back(resolution);
+            } else {
+                if (resolution.encoder) AAsset_close(resolution.encoder);
+                if (resolution.decoder) AAsset_close(resolution.decoder);
+            }
+        }
+    }
+    // Exit segments chain into each other, so all of them and the tail are needed
+    for (int layer : config.exit_layers) {
+        if (layer > 0) {
+            const std::string suffix = "_exit_" + std::to_string(layer) + ".tflite";
+            assets.encoder_exits.push_back({layer, open("encoder" + suffix), open("decoder" + suffix)});
+        }
+    }
+    if (!assets.encoder_exits.empty()) {
+        assets.encoder_exit_tail = open("encoder_exit_tail.tflite");
+        bool complete = assets.encoder_exit_tail != nullptr;
+        for (const mihon::EncoderExitAssets& exit : assets.encoder_exits) {
+            complete = complete && exit.segment && exit.decoder;
+        }
+        if (!complete) {
+            for (const mihon::EncoderExitAssets& exit : assets.encoder_exits) {
+                if (exit.segment) AAsset_close(exit.segment);
+                if (exit.decoder) AAsset_close(exit.decoder);
+            }
+            if (assets.encoder_exit_tail) AAsset_close(assets.encoder_exit_tail);
+            assets.encoder_exits.clear();
+            assets.encoder_exit_tail = nullptr;
+        }
+    }
+    for (int length : config.decoder_buckets) {
+        if (length > 0) {
+            if (AAsset* bucket = open("decoder_" + std::to_string(length) + ".tflite")) {
+                assets.decoder_buckets.push_back(bucket);
+            }
+        }
+    }
+    assets.ctc_head = open("ctc_head.tflite");
+    assets.decoder_loop = open("decoder_loop.tflite");
+    assets.decoder_cross_kv = open("decoder_cross_kv.tflite");
+    assets.length_predictor = open("length_predictor.bin");
+    return true;
+}
+
+void AppendJsonString(std::string& out, const std::string& text) {
+    out += '"';
+    for (const char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+std::string FormatJsonLine(const std::string& path, const ImageResult& result) {
+    std::string line = "{\"path\":";
+    AppendJsonString(line, path);
+    char numbers[128];
+    std::snprintf(numbers, sizeof(numbers), ",\"ok\":%s,\"width\":%d,\"height\":%d,\"decode_ms\":%.2f,\"ocr_ms\":%.2f",
+                  result.ok ? "true" : "false", result.width, result.height, result.decode_ms, result.ocr_ms);
+    line += numbers;
+    line += ",\"regions\":[";
+    for (size_t i = 0; i < result.texts.size(); ++i) {
+        const Region& region = result.regions[i];
+        std::snprintf(numbers, sizeof(numbers), "%s{\"box\":[%d,%d,%d,%d],\"text\":", i > 0 ? "," : "",
+                      region.left, region.top, region.width, region.height);
+        line += numbers;
+        AppendJsonString(line, result.texts[i]);
+        if (result.partial[i]) {
+            line += ",\"partial\":true";
+        }
+        line += '}';
+    }
+    line += "]}\n";
+    return line;
+}
+
+// One engine plus the scratch it reuses for every image
+class Worker {
+public:
+    explicit Worker(const CliOptions& options) : options_(options) {}
+
+    bool Initialize() {
+        const mihon::ProfileConfig& config = mihon::GetProfileConfig(options_.profile);
+        mihon::ModelAssets assets;
+        if (!OpenAssets(options_.model_dir, config, assets)) {
+            return false;
+        }
+        mihon::EngineOptions engine_options = config.engine;
+        if (options_.threads > 0) {
+            engine_options.num_threads = options_.threads;
+        }
+        if (!engine_.Initialize(assets, engine_options, options_.cache_dir.c_str(), options_.lib_dir.c_str())) {
+            CloseAssets(assets);
+            return false;
+        }
+        input_.resize(mihon::ImageInputBytes(engine_.InputFormat(), IMAGE_SIZE, IMAGE_SIZE));
+        scaled_.resize(static_cast<size_t>(IMAGE_SIZE) * IMAGE_SIZE * 4);
+        tokens_.resize(MAX_SEQUENCE_LENGTH);
+        return true;
+    }
+
+    ImageResult Process(const std::string& path) {
+        ImageResult result;
+        const auto decode_start = std::chrono::steady_clock::now();
+        mihon::DecodedImage image;
+        if (!mihon::DecodeImageFile(path, &image)) {
+            std::fprintf(stderr, "Failed to decode %s\n", path.c_str());
+            return result;
+        }
+        result.width = image.width;
+        result.height = image.height;
+        result.regions = options_.regions ? ReadRegions(path, image.width, image.height)
+                                          : std::vector<Region>{{0, 0, image.width, image.height}};
+        const auto ocr_start = std::chrono::steady_clock::now();
+        result.decode_ms = std::chrono::duration<double, std::milli>(ocr_start - decode_start).count();
+
+        const size_t stride = static_cast<size_t>(image.width) * 4;
+        double downscaled_area = 0;
+        for (const Region& region : result.regions) {
+            const int input_size = region.width > 0 && region.height > 0
+                ? engine_.SelectInputSize(region.width, region.height) : 0;
+            if (input_size > 0 && region.width >= 2 * input_size && region.height >= 2 * input_size) {
+                downscaled_area += static_cast<double>(region.width) * region.height;
+            }
+        }
+        const bool use_pyramid =
+            downscaled_area >= PYRAMID_MIN_PAGE_COVERAGE * image.width * image.height;
+        if (use_pyramid) {
+            mihon::BuildImagePyramid(image.pixels.data(), image.width, image.height, stride,
+                                     PYRAMID_MIN_LEVEL_SIDE, pyramid_);
+        }
+
+        result.ok = true;
+        for (const Region& region : result.regions) {
+            const bool in_bounds = region.left >= 0 && region.top >= 0 && region.width > 0 && region.height > 0 &&
+                region.left + region.width <= image.width && region.top + region.height <= image.height;
+            if (!in_bounds) {
+                result.texts.emplace_back();
+                result.partial.push_back(false);
+                continue;
+            }
+            const auto region_start = std::chrono::steady_clock::now();
+            const int input_size = engine_.SelectInputSize(region.width, region.height);
+            const size_t input_stride = static_cast<size_t>(input_size) * 4;
+            if (use_pyramid) {
+                mihon::ResizeRegion(pyramid_, image.pixels.data(), stride, region.left, region.top,
+                                    region.width, region.height, scaled_.data(), input_size, input_size);
+            } else {
+                mihon::ResizeRegion(image.pixels.data(), stride, region.left, region.top, region.width,
+                                    region.height, scaled_.data(), input_size, input_size);
+            }
+            mihon::PreprocessPixels(scaled_.data(), input_size, input_size, input_stride,
+                                    engine_.InputFormat(), input_.data());
+            patch_mask_.grid = input_size == IMAGE_SIZE ? engine_.PatchGrid() : 0;
+            if (patch_mask_.grid > 0) {
+                mihon::ComputePatchMask(scaled_.data(), input_size, input_size, input_stride, patch_mask_);
+            }
+
+            mihon::DecodeOptions decode = mihon::GetProfileConfig(options_.profile).decode;
+            decode.source_width = region.width;
+            decode.source_height = region.height;
+            decode.input_size = input_size;
+            decode.patch_mask = patch_mask_.grid > 0 ? &patch_mask_ : nullptr;
+            if (options_.deadline_ms > 0) {
+                decode.deadline = region_start + std::chrono::milliseconds(options_.deadline_ms);
+                decode.complete_only = options_.complete_only;
+            }
+            mihon::InferenceStats stats;
+            const int token_count =
+                engine_.InferTokens(input_.data(), tokens_.data(), MAX_SEQUENCE_LENGTH, decode, &stats);
+            if (token_count <= 0 && !stats.partial) {
+                result.ok = false;
+            }
+            result.texts.push_back(Detokenize(token_count));
+            result.partial.push_back(stats.partial);
+        }
+        result.ocr_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - ocr_start).count();
+        return result;
+    }
+
+private:
+    std::string Detokenize(int token_count) {
+        raw_text_.clear();
+        for (int i = 0; i < token_count; ++i) {
+            const int token = tokens_[i];
+            if (token >= SPECIAL_TOKEN_THRESHOLD && token < static_cast<int>(vocab_.size())) {
+                raw_text_ += vocab_[token];
+            }
+        }
+        return postprocessor_.postprocess(raw_text_);
+    }
+
+    const CliOptions& options_;
+    mihon::OcrInference engine_;
+    mihon::TextPostprocessor postprocessor_;
+    std::vector<std::string> vocab_ = mihon::getVocabulary();
+    std::vector<uint8_t> input_;
+    std::vector<uint8_t> scaled_;
+    mihon::ImagePyramid pyramid_;
+    mihon::PatchMask patch_mask_;
+    std::vector<int> tokens_;
+    std::string raw_text_;
+};
+
+// Preprocesses the regions of every image into one contiguous float batch per image with 0 up
+// to all pool workers helping, and prints regions per second and the speedup for each
+int RunPreprocessBenchmark(const CliOptions& options, const std::vector<std::string>& images) {
+    struct Page {
+        mihon::DecodedImage image;
+        std::vector<mihon::RegionCrop> crops;
+        std::vector<size_t> offsets;
+    };
+    std::vector<Page> pages;
+    size_t batch_bytes = 0;
+    size_t region_count = 0;
+    for (const std::string& path : images) {
+        Page page;
+        if (!mihon::DecodeImageFile(path, &page.image)) {
+            std::fprintf(stderr, "Failed to decode %s\n", path.c_str());
+            continue;
+        }
+        const std::vector<Region> regions = options.regions
+            ? ReadRegions(path, page.image.width, page.image.height)
+            : std::vector<Region>{{0, 0, page.image.width, page.image.height}};
+        for (const Region& region : regions) {
+            const bool in_bounds = region.left >= 0 && region.top >= 0 && region.width > 0 && region.height > 0 &&
+                region.left + region.width <= page.image.width && region.top + region.height <= page.image.height;
+            if (in_bounds) {
+                page.crops.push_back({region.left, region.top, region.width, region.height, IMAGE_SIZE});
+            }
+        }
+        page.offsets.resize(page.crops.size());
+        batch_bytes = std::max(batch_bytes, mihon::BatchInputOffsets(page.crops.data(), page.crops.size(),
+                                                                     mihon::ImageInputFormat::kFloat32Rgb,
+                                                                     page.offsets.data()));
+        region_count += page.crops.size();
+        pages.push_back(std::move(page));
+    }
+    if (region_count == 0) {
+        std::fprintf(stderr, "No regions to preprocess\n");
+        return 1;
+    }
+
+    mihon::WorkPool& pool = mihon::WorkPool::Shared();
+    const int saved_quota = pool.Quota(mihon::WorkClass::kPreprocess);
+    std::vector<uint8_t> batch(batch_bytes);
+    mihon::RegionBatchScratch scratch;
+    std::fprintf(stderr, "Preprocessing %zu regions of %zu images\n", region_count, pages.size());
+    double serial_rate = 0;
+    for (int workers = 0; workers <= pool.WorkerCount(); ++workers) {
+        pool.SetQuota(mihon::WorkClass::kPreprocess, workers);
+        size_t rounds = 0;
+        const auto start = std::chrono::steady_clock::now();
+        double elapsed_s = 0;
+        do {
+            for (const Page& page : pages) {
+                mihon::PreprocessRegions(page.image.pixels.data(), static_cast<size_t>(page.image.width) * 4,
+                                         page.crops.data(), page.crops.size(), mihon::ImageInputFormat::kFloat32Rgb,
+                                         batch.data(), page.offsets.data(), nullptr, scratch);
+            }
+            ++rounds;
+            elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        } while (elapsed_s < BENCH_MIN_SECONDS);
+        const double rate = rounds * region_count / elapsed_s;
+        if (workers == 0) {
+            serial_rate = rate;
+        }
+        std::printf("threads %d: %.1f regions/s, %.2fx\n", workers + 1, rate, rate / serial_rate);
+    }
+
+    // Same batches resampled from a pyramid built for every page, with all threads
+    mihon::ImagePyramid pyramid;
+    size_t rounds = 0;
+    const auto start = std::chrono::steady_clock::now();
+    double elapsed_s = 0;
+    do {
+        for (const Page& page : pages) {
+            const size_t stride = static_cast<size_t>(page.image.width) * 4;
+            mihon::BuildImagePyramid(page.image.pixels.data(), page.image.width, page.image.height, stride,
+                                     PYRAMID_MIN_LEVEL_SIDE, pyramid);
+            mihon::PreprocessRegions(page.image.pixels.data(), stride, page.crops.data(), page.crops.size(),
+                                     mihon::ImageInputFormat::kFloat32Rgb, batch.data(), page.offsets.data(), nullptr,
+                                     scratch, &pyramid);
+        }
+        ++rounds;
+        elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (elapsed_s < BENCH_MIN_SECONDS);
+    const double pyramid_rate = rounds * region_count / elapsed_s;
+    std::printf("threads %d with page pyramids: %.1f regions/s, %.2fx\n", pool.WorkerCount() + 1, pyramid_rate,
+                pyramid_rate / serial_rate);
+    pool.SetQuota(mihon::WorkClass::kPreprocess, saved_quota);
+    return 0;
+}
+
+double Percentile(std::vector<double>& values, double fraction) {
+    if (values.empty()) {
+        return 0;
+    }
+    const size_t index = std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+// Same as the app's replay: each request waits for its recorded arrival, then runs through an
+// engine of its profile built with its recorded engine options
+int RunReplay(const CliOptions& options) {
+    std::vector<mihon::CaptureRecord> records;
+    if (!mihon::ReadCaptureFile(options.replay, &records)) {
+        std::fprintf(stderr, "Failed to read capture file %s\n", options.replay.c_str());
+        return 1;
+    }
+    std::fprintf(stderr, "Replaying %zu captured requests\n", records.size());
+
+    // Engines are compiled up front so compile time does not delay the first arrivals
+    std::unique_ptr<mihon::OcrInference> engines[mihon::kOcrProfileCount];
+    for (const mihon::CaptureRecord& record : records) {
+        if (record.profile < 0 || record.profile >= mihon::kOcrProfileCount || engines[record.profile]) {
+            continue;
+        }
+        const mihon::ProfileConfig& config = mihon::GetProfileConfig(static_cast<mihon::OcrProfile>(record.profile));
+        mihon::ModelAssets assets;
+        if (!OpenAssets(options.model_dir, config, assets)) {
+            return 1;
+        }
+        auto engine = std::make_unique<mihon::OcrInference>();
+        if (!engine->Initialize(assets, record.engine, options.cache_dir.c_str(), options.lib_dir.c_str())) {
+            std::fprintf(stderr, "Engine for the %s profile failed to initialize\n", config.name);
+            CloseAssets(assets);
+            continue;
+        }
+        engines[record.profile] = std::move(engine);
+    }
+
+    std::vector<uint8_t> scaled;
+    std::vector<uint8_t> input;
+    std::vector<int> tokens(MAX_SEQUENCE_LENGTH);
+    mihon::PatchMask patch_mask;
+    std::vector<double> latencies;
+    size_t mismatches = 0;
+    size_t failures = 0;
+
+    const auto replay_start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < records.size(); ++i) {
+        const mihon::CaptureRecord& record = records[i];
+        const auto arrival = replay_start + std::chrono::microseconds(record.arrival_us);
+        std::this_thread::sleep_until(arrival);
+
+        mihon::OcrInference* engine = record.profile >= 0 && record.profile < mihon::kOcrProfileCount
+            ? engines[record.profile].get() : nullptr;
+        const bool valid_pixels = record.image_width == IMAGE_SIZE && record.image_height == IMAGE_SIZE &&
+            record.pixels.size() == static_cast<size_t>(IMAGE_SIZE) * IMAGE_SIZE * 4;
+        long long latency_ms = -1;
+        bool matches = false;
+        if (engine && valid_pixels) {
+            // The app's PrepareInput: scaled down for a lower input size, patch mask at full size
+            const int input_size = engine->SelectInputSize(record.decode.source_width, record.decode.source_height);
+            const uint8_t* pixels = record.pixels.data();
+            if (input_size != IMAGE_SIZE) {
+                scaled.resize(static_cast<size_t>(input_size) * input_size * 4);
+                mihon::ResizeRegion(pixels, static_cast<size_t>(IMAGE_SIZE) * 4, 0, 0, IMAGE_SIZE, IMAGE_SIZE,
+                                    scaled.data(), input_size, input_size);
+                pixels = scaled.data();
+            }
+            const size_t stride = static_cast<size_t>(input_size) * 4;
+            input.resize(mihon::ImageInputBytes(engine->InputFormat(), input_size, input_size));
+            mihon::PreprocessPixels(pixels, input_size, input_size, stride, engine->InputFormat(), input.data());
+            patch_mask.grid = input_size == IMAGE_SIZE ? engine->PatchGrid() : 0;
+            patch_mask.keep.clear();
+            if (patch_mask.grid > 0) {
+                mihon::ComputePatchMask(pixels, input_size, input_size, stride, patch_mask);
+            }
+
+            mihon::DecodeOptions decode = record.decode;
+            if (record.deadline_us >= 0) {
+                decode.deadline = arrival + std::chrono::microseconds(record.deadline_us);
+            }
+            decode.input_size = input_size;
+            decode.patch_mask = patch_mask.IsComputed() ? &patch_mask : nullptr;
+            const int token_count = engine->InferTokens(input.data(), tokens.data(), MAX_SEQUENCE_LENGTH, decode);
+            matches = token_count == static_cast<int>(record.tokens.size()) &&
+                std::equal(record.tokens.begin(), record.tokens.end(), tokens.begin());
+            latency_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - arrival).count();
+            latencies.push_back(static_cast<double>(latency_ms));
+        }
+        failures += latency_ms < 0 ? 1 : 0;
+        mismatches += latency_ms >= 0 && !matches ? 1 : 0;
+        std::printf("{\"index\":%zu,\"profile\":%d,\"latency_ms\":%lld,\"recorded_ms\":%lld,\"tokens_match\":%s}\n",
+                    i, record.profile, latency_ms, static_cast<long long>(record.total_ms),
+                    matches ? "true" : "false");
+    }
+
+    std::fprintf(stderr,
+        "%zu requests, %zu failed, %zu with different tokens\n"
+        "latency from arrival: p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+        records.size(), failures, mismatches, Percentile(latencies, 0.5), Percentile(latencies, 0.9),
+        Percentile(latencies, 0.99), Percentile(latencies, 1.0));
+    return failures == 0 && mismatches == 0 ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    CliOptions options;
+    if (!ParseArgs(argc, argv, &options)) {
+        PrintUsage();
+        return 2;
+    }
+    if (!options.verbose) {
+        mihon::g_hostLogLevel = mihon::HOST_LOG_WARN;
+    }
+    if (!options.replay.empty()) {
+        return RunReplay(options);
+    }
+
+    const std::vector<std::string> images = CollectImages(options.inputs);
+    if (images.empty()) {
+        std::fprintf(stderr, "No images found\n");
+        return 1;
+    }
+    if (options.bench_preprocess) {
+        return RunPreprocessBenchmark(options, images);
+    }
+
+    if (options.jobs == 0) {
+        const int cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        // Engines use at most 4 CPU threads unless the profile or --threads says otherwise
+        const int profile_threads = mihon::GetProfileConfig(options.profile).engine.num_threads;
+        const int per_engine = options.threads > 0 ? options.threads : profile_threads > 0 ? profile_threads : 4;
+        options.jobs = std::max(1, cores / per_engine);
+    }
+    options.jobs = std::min<int>(options.jobs, static_cast<int>(images.size()));
+
+    FILE* output = stdout;
+    if (options.format == OutputFormat::kJsonl && !options.output.empty()) {
+        output = std::fopen(options.output.c_str(), "w");
+        if (!output) {
+            std::fprintf(stderr, "Cannot open %s\n", options.output.c_str());
+            return 1;
+        }
+    }
+
+    std::fprintf(stderr, "OCR of %zu images with %d engines (%s profile, batch %d)\n", images.size(), options.jobs,
+                 mihon::GetProfileConfig(options.profile).name, options.batch);
+
+    std::atomic<size_t> next_image{0};
+    std::atomic<int> ready_workers{0};
+    std::mutex output_mutex;
+    std::vector<double> latencies;
+    size_t failures = 0;
+    size_t region_count = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int w = 0; w < options.jobs; ++w) {
+        threads.emplace_back([&] {
+            auto worker = std::make_unique<Worker>(options);
+            if (!worker->Initialize()) {
+                std::fprintf(stderr, "Engine failed to initialize\n");
+                return;
+            }
+            ready_workers.fetch_add(1);
+
+            std::vector<std::pair<size_t, ImageResult>> batch;
+            for (;;) {
+                const size_t first = next_image.fetch_add(options.batch);
+                if (first >= images.size()) {
+                    break;
+                }
+                const size_t last = std::min(images.size(), first + options.batch);
+                batch.clear();
+                for (size_t i = first; i < last; ++i) {
+                    batch.emplace_back(i, worker->Process(images[i]));
+                }
+
+                std::string lines;
+                for (const auto& [index, result] : batch) {
+                    if (options.format == OutputFormat::kSidecar && result.ok) {
+                        std::ofstream sidecar{fs::path(images[index]).replace_extension(".txt")};
+                        for (const std::string& text : result.texts) {
+                            sidecar << text << '\n';
+                        }
+                    } else if (options.format == OutputFormat::kJsonl) {
+                        lines += FormatJsonLine(images[index], result);
+                    }
+                }
+
+                std::lock_guard<std::mutex> lock(output_mutex);
+                std::fputs(lines.c_str(), output);
+                for (const auto& [index, result] : batch) {
+                    latencies.push_back(result.decode_ms + result.ocr_ms);
+                    failures += result.ok ? 0 : 1;
+                    region_count += result.texts.size();
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (output != stdout) {
+        std::fclose(output);
+    }
+
+    if (ready_workers.load() == 0) {
+        std::fprintf(stderr, "No engine could be initialized\n");
+        return 1;
+    }
+
+    std::fprintf(stderr,
+        "%zu images, %zu regions, %zu failed in %.2f s: %.2f images/s, %.2f regions/s\n"
+        "latency per image: p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+        latencies.size(), region_count, failures, elapsed_s, latencies.size() / elapsed_s, region_count / elapsed_s,
+        Percentile(latencies, 0.5), Percentile(latencies, 0.9), Percentile(latencies, 0.99),
+        Percentile(latencies, 1.0));
+    return failures == 0 ? 0 : 1;
+}
@@ -1,5 +1,4 @@
 #include "ocr_inference.h"
-#include <android/log.h>
 #include <fstream>
 #include <cstring>
 #include <optional>
@@ -7,7 +6,14 @@
 #include <thread>
 #include <future>
 #include <mutex> // Added for singleton synchronization
+#include <set>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
 
 // LiteRT Next C++ API headers
 #include "litert/cc/litert_compiled_model.h"
@@ -19,10 +25,16 @@
 
 #include "litert/c/litert_common.h"
 
+#include "ctc_decoder.h"
+#include "vocab_data.h"
+#include "alloc_tracker.h"
+#include "native_log.h"
+#include "work_pool.h"
+
 #define LOG_TAG "MihonOCR_Inference"
-#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
-#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+#define LOGI(...) MIHON_LOG_PRINT(INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) MIHON_LOG_PRINT(ERROR, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) MIHON_LOG_PRINT(WARN, LOG_TAG, __VA_ARGS__)
 
 namespace mihon {
 
@@ -31,6 +43,16 @@ namespace mihon {
 static std::optional<litert::Environment> g_persist_env;
 static std::mutex g_env_mutex;
 
+// XNNPack packed-weight cache files shared by every CPU engine in the process, one per model
+// under the cache directory of the engines; the set keeps the paths alive for LiteRT
+static std::mutex g_weight_cache_mutex;
+static std::string g_weight_cache_dir;
+static std::set<std::string> g_weight_cache_paths;
+
+// Cache files are touched whenever a compile uses them; ones unused for this long are pruned,
+// which keeps the caches of profiles compiled only now and then across process starts
+static constexpr time_t WEIGHT_CACHE_MAX_AGE_S = 30 * 24 * 60 * 60;
+
 // Helper to log duration with a consistent message format
 static void LogDurationMs(const char* label, const std::chrono::steady_clock::time_point& start) {
     const long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -57,12 +79,278 @@ static void ReleaseSystemPages(const void* ptr, size_t size) {
     }
 }
 
+static litert::GpuOptions::Precision ToGpuPrecision(ModelPrecision precision) {
+    return precision == ModelPrecision::kFp32
+        ? litert::GpuOptions::Precision::kFp32
+        : litert::GpuOptions::Precision::kFp16;
+}
+
+// Builds compilation options for a single model on the requested accelerator
+static std::optional<litert::Options> CreateCompileOptions(bool use_gpu, const EngineOptions& engine_options, int num_threads) {
+    auto options_result = litert::Options::Create();
+    if (!options_result.HasValue()) {
+        return std::nullopt;
+    }
+    auto options = std::move(options_result.Value());
+    auto hw_result = options.SetHardwareAccelerators(
+        use_gpu ? litert::HwAccelerators::kGpu : litert::HwAccelerators::kCpu
+    );
+    if (!hw_result.HasValue()) {
+        return std::nullopt;
+    }
+    if (use_gpu) {
+        auto gpu_opts_result = options.GetGpuOptions();
+        if (gpu_opts_result.HasValue()) {
+            gpu_opts_result.Value().SetPrecision(ToGpuPrecision(engine_options.precision));
+        }
+    } else {
+        auto cpu_opts_result = options.GetCpuOptions();
+        if (cpu_opts_result.HasValue()) {
+            cpu_opts_result.Value().SetNumThreads(num_threads);
+        }
+    }
+    return options;
+}
+
+// Starts a model run, asynchronously when the backend supports it. `async` reports whether
+// the outputs carry completion events that must be awaited with WaitForOutputs.
+// A backend that rejects async execution is switched to the synchronous path for good.
+static bool StartRun(
+    const litert::CompiledModel& compiled,
+    size_t signature,
+    const std::vector<litert::TensorBuffer>& inputs,
+    const std::vector<litert::TensorBuffer>& outputs,
+    bool& async_supported,
+    bool& async
+) {
+    ScopedAllocPhase runtime_phase(AllocPhase::kRuntime);
+    async = false;
+    if (async_supported) {
+        auto run_result = compiled.RunAsync(signature, inputs, outputs, async);
+        if (run_result.HasValue()) {
+            return true;
+        }
+        LOGW("Async execution unavailable (%s); using synchronous runs",
+             run_result.Error().Message().c_str());
+        async_supported = false;
+    }
+
+    auto run_result = compiled.Run(signature, inputs, outputs);
+    if (!run_result.HasValue()) {
+        LOGE("Model run failed: %s", run_result.Error().Message().c_str());
+        return false;
+    }
+    return true;
+}
+
+static bool WaitForOutputs(const std::vector<litert::TensorBuffer>& outputs) {
+    ScopedAllocPhase runtime_phase(AllocPhase::kRuntime);
+    for (const auto& buffer : outputs) {
+        if (!buffer.HasEvent()) {
+            continue;
+        }
+        auto event = buffer.GetEvent();
+        if (!event.HasValue()) {
+            LOGE("Failed to get output completion event");
+            return false;
+        }
+        auto wait_result = event.Value().Wait(-1);
+        if (!wait_result.HasValue()) {
+            LOGE("Waiting for model completion failed: %s", wait_result.Error().Message().c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool WriteImageInput(litert::TensorBuffer& buffer, ImageInputFormat format, const void* image_data, size_t bytes) {
+    ScopedAllocPhase runtime_phase(AllocPhase::kRuntime);
+    if (format == ImageInputFormat::kFloat32Rgb) {
+        return buffer.Write<float>(
+            absl::MakeConstSpan(static_cast<const float*>(image_data), bytes / sizeof(float))
+        ).HasValue();
+    }
+    return buffer.Write<uint8_t>(
+        absl::MakeConstSpan(static_cast<const uint8_t*>(image_data), bytes)
+    ).HasValue();
+}
+
+// Hash of every byte of a model, so models differing only in a small tensor get different
+// weight caches. Four independent lanes keep it at memory speed; it runs once per compile.
+static uint64_t ModelFingerprint(const uint8_t* data, size_t size) {
+    static constexpr uint64_t MULTIPLIER = 0x9E3779B97F4A7C15ull;
+    uint64_t lanes[4] = {size, size ^ 0x243F6A8885A308D3ull, size ^ 0x13198A2E03707344ull, size ^ 0xA4093822299F31D0ull};
+    auto mix = [](uint64_t hash, uint64_t value) {
+        hash = (hash ^ value) * MULTIPLIER;
+        return hash ^ (hash >> 29);
+    };
+    size_t offset = 0;
+    for (; offset + 4 * sizeof(uint64_t) <= size; offset += 4 * sizeof(uint64_t)) {
+        uint64_t words[4];
+        std::memcpy(words, data + offset, sizeof(words));
+        for (int lane = 0; lane < 4; ++lane) {
+            lanes[lane] = mix(lanes[lane], words[lane]);
+        }
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, data + offset, std::min(size - offset, sizeof(tail)));
+    uint64_t hash = mix(lanes[0], tail);
+    for (size_t i = offset + sizeof(tail); i < size; ++i) {
+        hash = mix(hash, data[i]);
+    }
+    for (int lane = 1; lane < 4; ++lane) {
+        hash = mix(hash, lanes[lane]);
+    }
+    return hash;
+}
+
+// Compiles a model; CPU compiles pack their weights into the model's shared cache file, which
+// later compiles of the same model map instead of packing another copy
+static litert::Expected<litert::CompiledModel> CreateCompiledModel(
+    litert::Environment& env,
+    bool use_gpu,
+    const uint8_t* data,
+    size_t size,
+    litert::Options& options
+) {
+    if (use_gpu) {
+        return litert::CompiledModel::Create(env, litert::BufferRef<uint8_t>(data, size), options);
+    }
+
+    // Serialized so that a cache file is complete before another compile maps it
+    std::lock_guard<std::mutex> lock(g_weight_cache_mutex);
+    auto cpu_opts_result = options.GetCpuOptions();
+    if (!g_weight_cache_dir.empty() && cpu_opts_result.HasValue()) {
+        char name[64];
+        std::snprintf(name, sizeof(name), "/xnnpack_%016llx_%zu.cache",
+                      static_cast<unsigned long long>(ModelFingerprint(data, size)), size);
+        const std::string& path = *g_weight_cache_paths.insert(g_weight_cache_dir + name).first;
+        auto cache_result = cpu_opts_result.Value().SetXNNPackWeightCachePath(path.c_str());
+        if (!cache_result.HasValue()) {
+            LOGW("Packing weights without a shared cache: %s", cache_result.Error().Message().c_str());
+        }
+        auto compiled = litert::CompiledModel::Create(env, litert::BufferRef<uint8_t>(data, size), options);
+        // Marks the cache used, as mapping it does not update its times
+        utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+        return compiled;
+    }
+    return litert::CompiledModel::Create(env, litert::BufferRef<uint8_t>(data, size), options);
+}
+
+// Compiles an optional model on the same accelerator as the decoder
+static std::optional<litert::CompiledModel> CompileAuxiliaryModel(
+    litert::Environment& env,
+    bool use_gpu,
+    const EngineOptions& engine_options,
+    int num_threads,
+    const uint8_t* data,
+    size_t size,
+    const char* label
+) {
+    auto options = CreateCompileOptions(use_gpu, engine_options, num_threads);
+    if (!options) {
+        LOGW("Failed to create options for %s", label);
+        return std::nullopt;
+    }
+
+    auto compiled_result = CreateCompiledModel(env, use_gpu, data, size, *options);
+    if (!compiled_result.HasValue()) {
+        LOGW("Failed to compile %s: %s", label, compiled_result.Error().Message().c_str());
+        return std::nullopt;
+    }
+    if (use_gpu) {
+        auto accel_result = compiled_result.Value().IsFullyAccelerated();
+        if (accel_result.HasValue() && !accel_result.Value()) {
+            LOGW("%s is not fully GPU-accelerated; skipping", label);
+            return std::nullopt;
+        }
+    }
+    return std::move(compiled_result.Value());
+}
+
+void OcrInference::PruneWeightCache() {
+    std::lock_guard<std::mutex> lock(g_weight_cache_mutex);
+    if (g_weight_cache_dir.empty()) {
+        return;
+    }
+    DIR* dir = opendir(g_weight_cache_dir.c_str());
+    if (!dir) {
+        return;
+    }
+    const time_t now = time(nullptr);
+    static constexpr char PREFIX[] = "xnnpack_";
+    static constexpr char SUFFIX[] = ".cache";
+    while (const dirent* entry = readdir(dir)) {
+        const std::string name = entry->d_name;
+        const bool is_cache = name.size() > sizeof(PREFIX) + sizeof(SUFFIX) - 2 &&
+            name.compare(0, sizeof(PREFIX) - 1, PREFIX) == 0 &&
+            name.compare(name.size() - (sizeof(SUFFIX) - 1), sizeof(SUFFIX) - 1, SUFFIX) == 0;
+        if (!is_cache) {
+            continue;
+        }
+        const std::string path = g_weight_cache_dir + "/" + name;
+        struct stat info;
+        if (g_weight_cache_paths.count(path) == 0 && stat(path.c_str(), &info) == 0 &&
+            now - info.st_mtime > WEIGHT_CACHE_MAX_AGE_S) {
+            if (unlink(path.c_str()) == 0) {
+                LOGI("Deleted unused weight cache %s", name.c_str());
+            } else {
+                LOGW("Failed to delete unused weight cache %s", name.c_str());
+            }
+        }
+    }
+    closedir(dir);
+}
+
 int OcrInference::GetOptimalThreadCount() noexcept {
     const unsigned int hw_threads = std::thread::hardware_concurrency();
     if (hw_threads == 0) return 2; // Fallback if detection fails
     return static_cast<int>(std::min(hw_threads, 4u));
 }
 
+// Encoder over a fixed number of kept patches, used when the request's patch mask fits
+struct PrunedEncoder {
+    int patch_budget = 0;
+    std::optional<litert::CompiledModel> compiled;
+    std::vector<litert::TensorBuffer> input_buffers;
+    std::vector<litert::TensorBuffer> output_buffers;
+};
+
+// Encoder and matching decoder at a lower input resolution, used for small crops
+struct ResolutionVariant {
+    int input_size = 0;
+    std::optional<litert::CompiledModel> encoder;
+    std::optional<litert::CompiledModel> decoder;
+    std::vector<litert::TensorBuffer> encoder_input_buffers;
+    std::vector<litert::TensorBuffer> encoder_output_buffers;
+    std::vector<litert::TensorBuffer> decoder_input_buffers;
+    std::vector<litert::TensorBuffer> decoder_output_buffers;
+    std::vector<float> hidden_states;
+    bool hidden_states_loaded = false;
+};
+
+// Encoder segment ending at an exit layer, with the decoder over that layer's hidden states
+struct EncoderExit {
+    int layer = 0;
+    std::optional<litert::CompiledModel> segment;
+    std::optional<litert::CompiledModel> decoder;
+    std::vector<litert::TensorBuffer> segment_input_buffers;
+    std::vector<litert::TensorBuffer> segment_output_buffers;
+    std::vector<litert::TensorBuffer> decoder_input_buffers;
+    std::vector<litert::TensorBuffer> decoder_output_buffers;
+    bool hidden_states_loaded = false;
+};
+
+// Decoder compiled at a shorter sequence length, used while the output still fits
+struct DecoderBucket {
+    int seq_len = 0;
+    size_t logits_size = 0;
+    std::optional<litert::CompiledModel> compiled;
+    std::vector<litert::TensorBuffer> input_buffers;
+    std::vector<litert::TensorBuffer> output_buffers;
+    bool hidden_states_loaded = false;
+};
+
 // Internal structure to hold LiteRT objects
 struct OcrInference::LiteRtObjects {
     std::optional<litert::Environment> cpu_env; // Dedicated environment for CPU
@@ -73,6 +361,57 @@ struct OcrInference::LiteRtObjects {
     std::vector<litert::TensorBuffer> encoder_output_buffers;
     std::vector<litert::TensorBuffer> decoder_input_buffers;
     std::vector<litert::TensorBuffer> decoder_output_buffers;
+    bool decoder_hidden_states_loaded = false;
+
+    // Ascending by patch budget, all below the patch count
+    std::vector<PrunedEncoder> pruned_encoders;
+    std::vector<int32_t> patch_indices;
+
+    // Ascending by input size, all below IMAGE_SIZE
+    std::vector<ResolutionVariant> resolution_variants;
+
+    // Ascending by layer; the input of every segment after the first, and of the tail, shares
+    // the previous segment's hidden states output, so they never leave the accelerator
+    std::vector<EncoderExit> encoder_exits;
+    std::optional<litert::CompiledModel> compiled_exit_tail;
+    std::vector<litert::TensorBuffer> exit_tail_input_buffers;
+    std::vector<litert::TensorBuffer> exit_tail_output_buffers;
+
+    // Ascending by sequence length, all shorter than MAX_SEQUENCE_LENGTH
+    std::vector<DecoderBucket> decoder_buckets;
+
+    // Async execution state; cleared once the backend rejects RunAsync
+    bool async_supported = true;
+
+    // Decoder run started by LaunchDecoder and not yet finished
+    struct PendingDecoderRun {
+        std::vector<litert::TensorBuffer>* outputs = nullptr;
+        size_t logits_size = 0;
+        int length = 0;
+        bool async = false;
+        std::chrono::steady_clock::time_point start;
+    } pending_decoder;
+
+    std::optional<litert::CompiledModel> compiled_ctc_head;
+    std::vector<litert::TensorBuffer> ctc_input_buffers;
+    std::vector<litert::TensorBuffer> ctc_output_buffers;
+    std::vector<float> ctc_logits;
+    int ctc_time_steps = 0;
+    int ctc_num_classes = 0;
+
+    std::optional<litert::CompiledModel> compiled_decoder_loop;
+    std::vector<litert::TensorBuffer> decoder_loop_input_buffers;
+    std::vector<litert::TensorBuffer> decoder_loop_output_buffers;
+    std::vector<int32_t> decoder_loop_tokens;
+
+    // Split decoder; the leading step inputs share the prefill outputs, so the keys and values
+    // stay wherever the prefill wrote them until the next request's prefill replaces them
+    std::optional<litert::CompiledModel> compiled_cross_kv;
+    std::vector<litert::TensorBuffer> cross_kv_prefill_input_buffers;
+    std::vector<litert::TensorBuffer> cross_kv_prefill_output_buffers;
+    std::vector<litert::TensorBuffer> cross_kv_step_input_buffers;
+    std::vector<litert::TensorBuffer> cross_kv_step_output_buffers;
+    bool cross_kv_loaded = false;
 
     // Pre-allocated output buffers for reading
     std::vector<float> encoder_hidden_states;
@@ -91,9 +430,8 @@ OcrInference::~OcrInference() {
 }
 
 bool OcrInference::Initialize(
-    AAsset* encoder_asset,
-    AAsset* decoder_asset,
-    AAsset* embeddings_asset,
+    const ModelAssets& assets,
+    const EngineOptions& options,
     const char* cache_dir,
     const char* native_lib_dir
 ) {
@@ -106,9 +444,19 @@ bool OcrInference::Initialize(
 
     try {
         // Take ownership of model assets to prevent destruction
-        encoder_asset_ = encoder_asset;
-        decoder_asset_ = decoder_asset;
-        embeddings_asset_ = embeddings_asset;
+        encoder_asset_ = assets.encoder;
+        decoder_asset_ = assets.decoder;
+        encoder_pruned_assets_ = assets.encoder_pruned;
+        resolution_assets_ = assets.resolutions;
+        encoder_exit_assets_ = assets.encoder_exits;
+        encoder_exit_tail_asset_ = assets.encoder_exit_tail;
+        embeddings_asset_ = assets.embeddings;
+        decoder_bucket_assets_ = assets.decoder_buckets;
+        ctc_head_asset_ = assets.ctc_head;
+        decoder_loop_asset_ = assets.decoder_loop;
+        decoder_cross_kv_asset_ = assets.decoder_cross_kv;
+        length_predictor_asset_ = assets.length_predictor;
+        options_ = options;
 
         const auto* encoder_data = static_cast<const uint8_t*>(AAsset_getBuffer(encoder_asset_));
         size_t encoder_size = AAsset_getLength(encoder_asset_);
@@ -122,8 +470,21 @@ bool OcrInference::Initialize(
         embeddings_data_ = static_cast<const float*>(raw_emb_buffer);
         embedding_count_ = raw_emb_size / sizeof(float);
 
+        if (length_predictor_asset_) {
+            if (AAsset_getLength(length_predictor_asset_) == (HIDDEN_SIZE + 1) * sizeof(float)) {
+                length_predictor_ = static_cast<const float*>(AAsset_getBuffer(length_predictor_asset_));
+            } else {
+                LOGW("Length predictor has unexpected size; skipping");
+            }
+        }
+
         litert_ = std::make_unique<LiteRtObjects>();
 
+        if (cache_dir && *cache_dir) {
+            std::lock_guard<std::mutex> lock(g_weight_cache_mutex);
+            g_weight_cache_dir = cache_dir;
+        }
+
         {
             std::lock_guard<std::mutex> lock(g_env_mutex);
 
@@ -164,11 +525,7 @@ bool OcrInference::Initialize(
 
         if (opencl_available) {
             compiled = TryCompileWithGpu(encoder_data, encoder_size, decoder_data, decoder_size);
-            if (compiled) {
-                // Release encoder and decoder assets, as they are no longer needed
-                ReleaseSystemPages(encoder_data, encoder_size);
-                ReleaseSystemPages(decoder_data, decoder_size);
-            } else {
+            if (!compiled) {
                 LOGW("GPU compilation failed, attempting CPU compilation...");
             }
         }
@@ -181,21 +538,39 @@ bool OcrInference::Initialize(
             }
         }
 
+        // Both accelerators keep their own copy of the weights, in GPU memory or as XNNPack's
+        // packed weights, so the model pages are released and only read back for op metadata
+        ReleaseSystemPages(encoder_data, encoder_size);
+        ReleaseSystemPages(decoder_data, decoder_size);
+
         litert_->using_gpu = (litert_->encoder_using_gpu && litert_->decoder_using_gpu);
+        cpu_threads_ = litert_->using_gpu ? 0
+            : (options_.num_threads > 0 ? options_.num_threads : GetOptimalThreadCount());
 
         if (!CreateBuffers()) {
             LOGE("Failed to create buffers");
             return false;
         }
 
+        // Pruned encoders and buckets are validated against the shapes found by CreateBuffers
+        CompilePrunedEncoders();
+        CompileResolutions();
+        CompileEncoderExits();
+        CompileDecoderBuckets();
+
+        CompileCtcHead();
+        CompileDecoderLoop();
+        CompileCrossKvDecoder();
+
+        // Allocated before warmup, which reuses them instead of its own temporaries
+        embeddings_input_.resize(MAX_SEQUENCE_LENGTH * HIDDEN_SIZE, 0.0f);
+        attention_mask_.resize(MAX_SEQUENCE_LENGTH, 0.0f);
+
         if (!PerformWarmup()) {
             LOGE("Model warmup failed; unable to verify execution");
             return false;
         }
 
-        embeddings_input_.resize(MAX_SEQUENCE_LENGTH * HIDDEN_SIZE, 0.0f);
-        attention_mask_.resize(MAX_SEQUENCE_LENGTH, 0.0f);
-
         initialized_ = true;
         LogDurationMs("Overall OcrInference Initialize", overall_init_start);
 
@@ -222,6 +597,34 @@ bool OcrInference::CreateBuffers() {
     }
     litert_->encoder_input_buffers = std::move(encoder_input_result.Value());
 
+    // uint8 encoders normalize in-graph, so the host only copies bytes
+    auto encoder_input_type = litert_->encoder_input_buffers[0].TensorType();
+    auto encoder_input_bytes = litert_->encoder_input_buffers[0].Size();
+    if (!encoder_input_type.HasValue() || !encoder_input_bytes.HasValue()) {
+        LOGE("Failed to inspect encoder input tensor");
+        return false;
+    }
+    switch (encoder_input_type.Value().ElementType()) {
+        case litert::ElementType::Float32:
+            input_format_ = ImageInputFormat::kFloat32Rgb;
+            break;
+        case litert::ElementType::UInt8:
+            input_format_ = encoder_input_bytes.Value() == ImageInputBytes(ImageInputFormat::kUint8Rgba, IMAGE_SIZE, IMAGE_SIZE)
+                ? ImageInputFormat::kUint8Rgba
+                : ImageInputFormat::kUint8Rgb;
+            break;
+        default:
+            LOGE("Unsupported encoder input element type");
+            return false;
+    }
+    if (encoder_input_bytes.Value() != ImageInputBytes(input_format_, IMAGE_SIZE, IMAGE_SIZE)) {
+        LOGE("Encoder input has unexpected size: %zu bytes", encoder_input_bytes.Value());
+        return false;
+    }
+    LOGI("Encoder input format: %s",
+         input_format_ == ImageInputFormat::kFloat32Rgb ? "float32 RGB"
+         : input_format_ == ImageInputFormat::kUint8Rgb ? "uint8 RGB" : "uint8 RGBA");
+
     auto encoder_output_result = litert_->compiled_encoder->CreateOutputBuffers();
     if (!encoder_output_result.HasValue()) {
         LOGE("Failed to create encoder output buffers: %s",
@@ -262,6 +665,21 @@ bool OcrInference::CreateBuffers() {
         return false;
     }
 
+    // A compact output head omits the empty vocab placeholders
+    output_vocab_ids_.clear();
+    if (decoder_output_size_ == static_cast<size_t>(MAX_SEQUENCE_LENGTH) * VOCAB_SIZE) {
+        output_vocab_size_ = VOCAB_SIZE;
+    } else {
+        std::vector<int> compact_ids = getCompactVocabularyIds();
+        if (decoder_output_size_ != static_cast<size_t>(MAX_SEQUENCE_LENGTH) * compact_ids.size()) {
+            LOGE("Decoder output has unexpected size: %zu", decoder_output_size_);
+            return false;
+        }
+        output_vocab_size_ = static_cast<int>(compact_ids.size());
+        output_vocab_ids_ = std::move(compact_ids);
+        LOGI("Decoder uses a compact output head (%d of %d tokens)", output_vocab_size_, VOCAB_SIZE);
+    }
+
     litert_->encoder_hidden_states.resize(encoder_output_size_);
     litert_->decoder_logits.resize(decoder_output_size_);
 
@@ -273,12 +691,12 @@ bool OcrInference::CreateBuffers() {
 bool OcrInference::PerformWarmup() {
     const auto warmup_start = std::chrono::steady_clock::now();
 
-    std::vector<float> dummy_image(IMAGE_SIZE * IMAGE_SIZE * 3, 0.0f);
+    // Zero bytes are a valid image in every input format; the still-zero embeddings
+    // buffer is larger than any encoder input and serves as the dummy image
+    static_assert(sizeof(float) * MAX_SEQUENCE_LENGTH * HIDDEN_SIZE >= sizeof(float) * IMAGE_SIZE * IMAGE_SIZE * 3);
+    std::fill(embeddings_input_.begin(), embeddings_input_.end(), 0.0f);
 
-    auto write_result = litert_->encoder_input_buffers[0].Write<float>(
-        absl::MakeConstSpan(dummy_image)
-    );
-    if (!write_result.HasValue()) {
+    if (!WriteEncoderInput(embeddings_input_.data())) {
         LOGE("Warmup: Failed to write encoder input");
         return false;
     }
@@ -302,7 +720,7 @@ bool OcrInference::PerformWarmup() {
         return false;
     }
 
-    std::vector<float> warmup_hidden_states(encoder_output_floats, 0.0f);
+    std::vector<float>& warmup_hidden_states = litert_->encoder_hidden_states;
     auto warmup_read = litert_->encoder_output_buffers[0].Read<float>(
         absl::MakeSpan(warmup_hidden_states)
     );
@@ -311,8 +729,10 @@ bool OcrInference::PerformWarmup() {
         return false;
     }
 
-    std::vector<float> warmup_attention(MAX_SEQUENCE_LENGTH, 0.0f);
-    std::vector<float> warmup_embeddings(MAX_SEQUENCE_LENGTH * HIDDEN_SIZE, 0.0f);
+    // Requests reset both buffers before decoding
+    std::vector<float>& warmup_attention = attention_mask_;
+    std::vector<float>& warmup_embeddings = embeddings_input_;
+    std::fill(warmup_attention.begin(), warmup_attention.end(), 0.0f);
     warmup_attention[0] = 1.0f;
 
     auto write_hidden_result = litert_->decoder_input_buffers[0].Write<float>(
@@ -348,6 +768,138 @@ bool OcrInference::PerformWarmup() {
         return false;
     }
 
+    // Same for pruned encoders, run over their first patches on the zero image, which the
+    // decoder runs above left untouched; the full encoder covers any mask
+    const size_t image_bytes = ImageInputBytes(input_format_, IMAGE_SIZE, IMAGE_SIZE);
+    auto& pruned_encoders = litert_->pruned_encoders;
+    for (auto it = pruned_encoders.begin(); it != pruned_encoders.end();) {
+        auto& indices = litert_->patch_indices;
+        for (int i = 0; i < it->patch_budget; ++i) {
+            indices[i] = i;
+        }
+        const bool ok =
+            WriteImageInput(it->input_buffers[0], input_format_, warmup_embeddings.data(), image_bytes) &&
+            it->input_buffers[1].Write<int32_t>(absl::MakeConstSpan(indices.data(), it->patch_budget)).HasValue() &&
+            it->compiled->Run(it->input_buffers, it->output_buffers).HasValue();
+        if (ok) {
+            ++it;
+        } else {
+            LOGW("Warmup: Dropping pruned encoder for %d patches", it->patch_budget);
+            it = pruned_encoders.erase(it);
+        }
+    }
+    if (pruned_encoders.empty()) {
+        patch_grid_ = 0;
+    }
+
+    // Resolution variants run end to end; the base models cover any crop
+    auto& variants = litert_->resolution_variants;
+    for (auto it = variants.begin(); it != variants.end();) {
+        const size_t variant_bytes = ImageInputBytes(input_format_, it->input_size, it->input_size);
+        const bool ok =
+            WriteImageInput(it->encoder_input_buffers[0], input_format_, warmup_embeddings.data(), variant_bytes) &&
+            it->encoder->Run(it->encoder_input_buffers, it->encoder_output_buffers).HasValue() &&
+            it->encoder_output_buffers[0].Read<float>(absl::MakeSpan(it->hidden_states)).HasValue() &&
+            it->decoder_input_buffers[0].Write<float>(absl::MakeConstSpan(it->hidden_states)).HasValue() &&
+            it->decoder_input_buffers[1].Write<float>(absl::MakeConstSpan(warmup_attention)).HasValue() &&
+            it->decoder_input_buffers[2].Write<float>(absl::MakeConstSpan(warmup_embeddings)).HasValue() &&
+            it->decoder->Run(it->decoder_input_buffers, it->decoder_output_buffers).HasValue();
+        if (ok) {
+            ++it;
+        } else {
+            LOGW("Warmup: Dropping input size %d", it->input_size);
+            it = variants.erase(it);
+        }
+    }
+
+    // Early exits run as a chain through every exit decoder and the tail; the base encoder
+    // covers any crop if one of them fails
+    auto& exits = litert_->encoder_exits;
+    if (!exits.empty()) {
+        bool ok = WriteImageInput(exits[0].segment_input_buffers[0], input_format_, warmup_embeddings.data(), image_bytes);
+        for (size_t e = 0; ok && e < exits.size(); ++e) {
+            EncoderExit& exit = exits[e];
+            ok = exit.segment->Run(exit.segment_input_buffers, exit.segment_output_buffers).HasValue() &&
+                exit.decoder_input_buffers[0].Write<float>(absl::MakeConstSpan(warmup_hidden_states)).HasValue() &&
+                exit.decoder_input_buffers[1].Write<float>(absl::MakeConstSpan(warmup_attention)).HasValue() &&
+                exit.decoder_input_buffers[2].Write<float>(absl::MakeConstSpan(warmup_embeddings)).HasValue() &&
+                exit.decoder->Run(exit.decoder_input_buffers, exit.decoder_output_buffers).HasValue();
+        }
+        ok = ok && litert_->compiled_exit_tail->Run(
+            litert_->exit_tail_input_buffers, litert_->exit_tail_output_buffers).HasValue();
+        if (!ok) {
+            LOGW("Warmup: Dropping early exits");
+            litert_->exit_tail_input_buffers.clear();
+            litert_->exit_tail_output_buffers.clear();
+            litert_->compiled_exit_tail.reset();
+            exits.clear();
+        }
+    }
+
+    // A bucket that cannot run is dropped; the full-length decoder still covers its range
+    auto& buckets = litert_->decoder_buckets;
+    for (auto it = buckets.begin(); it != buckets.end();) {
+        const size_t seq_len = static_cast<size_t>(it->seq_len);
+        const bool ok =
+            it->input_buffers[0].Write<float>(absl::MakeConstSpan(warmup_hidden_states)).HasValue() &&
+            it->input_buffers[1].Write<float>(absl::MakeConstSpan(warmup_attention.data(), seq_len)).HasValue() &&
+            it->input_buffers[2].Write<float>(absl::MakeConstSpan(warmup_embeddings.data(), seq_len * HIDDEN_SIZE)).HasValue() &&
+            it->compiled->Run(it->input_buffers, it->output_buffers).HasValue();
+        if (ok) {
+            ++it;
+        } else {
+            LOGW("Warmup: Dropping decoder bucket of length %d", it->seq_len);
+            it = buckets.erase(it);
+        }
+    }
+
+    if (litert_->compiled_decoder_loop) {
+        const bool ok =
+            litert_->decoder_loop_input_buffers[0].Write<float>(absl::MakeConstSpan(warmup_hidden_states)).HasValue() &&
+            litert_->compiled_decoder_loop->Run(litert_->decoder_loop_input_buffers, litert_->decoder_loop_output_buffers).HasValue();
+        if (!ok) {
+            LOGW("Warmup: Dropping in-graph decoder");
+            litert_->decoder_loop_input_buffers.clear();
+            litert_->decoder_loop_output_buffers.clear();
+            litert_->compiled_decoder_loop.reset();
+        }
+    }
+
+    // The step inputs alias the prefill outputs, so a backend that cannot share them fails here
+    if (litert_->compiled_cross_kv) {
+        const size_t kv_count = litert_->cross_kv_prefill_output_buffers.size();
+        auto& step_inputs = litert_->cross_kv_step_input_buffers;
+        const bool ok =
+            litert_->cross_kv_prefill_input_buffers[0].Write<float>(absl::MakeConstSpan(warmup_hidden_states)).HasValue() &&
+            litert_->compiled_cross_kv->Run(CROSS_KV_PREFILL_SIGNATURE, litert_->cross_kv_prefill_input_buffers,
+                                            litert_->cross_kv_prefill_output_buffers).HasValue() &&
+            WaitForOutputs(litert_->cross_kv_prefill_output_buffers) &&
+            step_inputs[kv_count].Write<float>(absl::MakeConstSpan(warmup_attention)).HasValue() &&
+            step_inputs[kv_count + 1].Write<float>(absl::MakeConstSpan(warmup_embeddings)).HasValue() &&
+            litert_->compiled_cross_kv->Run(CROSS_KV_STEP_SIGNATURE, step_inputs,
+                                            litert_->cross_kv_step_output_buffers).HasValue();
+        if (!ok) {
+            LOGW("Warmup: Dropping cross-KV decoder");
+            litert_->cross_kv_step_input_buffers.clear();
+            litert_->cross_kv_step_output_buffers.clear();
+            litert_->cross_kv_prefill_input_buffers.clear();
+            litert_->cross_kv_prefill_output_buffers.clear();
+            litert_->compiled_cross_kv.reset();
+        }
+    }
+
+    if (litert_->compiled_ctc_head) {
+        const bool ok =
+            litert_->ctc_input_buffers[0].Write<float>(absl::MakeConstSpan(warmup_hidden_states)).HasValue() &&
+            litert_->compiled_ctc_head->Run(litert_->ctc_input_buffers, litert_->ctc_output_buffers).HasValue();
+        if (!ok) {
+            LOGW("Warmup: Dropping CTC head");
+            litert_->ctc_input_buffers.clear();
+            litert_->ctc_output_buffers.clear();
+            litert_->compiled_ctc_head.reset();
+        }
+    }
+
     LogDurationMs("PerformWarmup total", warmup_start);
     return true;
 }
@@ -369,7 +921,7 @@ bool OcrInference::TryCompileWithGpu(const uint8_t* encoder_data, size_t encoder
     auto gpu_opts_result = options.GetGpuOptions();
     if (gpu_opts_result.HasValue()) {
         auto& gpu_opts = gpu_opts_result.Value();
-        gpu_opts.SetPrecision(litert::GpuOptions::Precision::kFp16);
+        gpu_opts.SetPrecision(ToGpuPrecision(options_.precision));
     }
 
     // Prepare options for Decoder
@@ -383,7 +935,7 @@ bool OcrInference::TryCompileWithGpu(const uint8_t* encoder_data, size_t encoder
     auto decoder_gpu_opts_result = decoder_options.GetGpuOptions();
     if (decoder_gpu_opts_result.HasValue()) {
         auto& decoder_gpu_opts = decoder_gpu_opts_result.Value();
-        decoder_gpu_opts.SetPrecision(litert::GpuOptions::Precision::kFp16);
+        decoder_gpu_opts.SetPrecision(ToGpuPrecision(options_.precision));
     }
 
     // Launch Encoder compilation asynchronously
@@ -450,7 +1002,7 @@ bool OcrInference::TryCompileWithGpu(const uint8_t* encoder_data, size_t encoder
 
 bool OcrInference::TryCompileWithCpu(const uint8_t* encoder_data, size_t encoder_size, const uint8_t* decoder_data, size_t decoder_size) {
     const auto try_compile_start = std::chrono::steady_clock::now();
-    const int num_threads = GetOptimalThreadCount(); // Revert to optimal threads
+    const int num_threads = options_.num_threads > 0 ? options_.num_threads : GetOptimalThreadCount();
     LOGI("Attempting CPU compilation with %d threads", num_threads);
 
     // Create a separate environment for CPU
@@ -501,20 +1053,14 @@ bool OcrInference::TryCompileWithCpu(const uint8_t* encoder_data, size_t encoder
 
     // Compile Encoder synchronously on the calling thread (to ensure thread affinity)
     const auto encoder_compile_start = std::chrono::steady_clock::now();
-    auto compiled_encoder_result = litert::CompiledModel::Create(
-        *litert_->cpu_env,
-        litert::BufferRef<uint8_t>(encoder_data, encoder_size),
-        encoder_options
-    );
+    auto compiled_encoder_result = CreateCompiledModel(
+        *litert_->cpu_env, false, encoder_data, encoder_size, encoder_options);
     LogDurationMs("Encoder CPU compile (Sync)", encoder_compile_start);
 
     // Compile Decoder synchronously
     const auto decoder_compile_start = std::chrono::steady_clock::now();
-    auto compiled_decoder_result = litert::CompiledModel::Create(
-        *litert_->cpu_env,
-        litert::BufferRef<uint8_t>(decoder_data, decoder_size),
-        decoder_options
-    );
+    auto compiled_decoder_result = CreateCompiledModel(
+        *litert_->cpu_env, false, decoder_data, decoder_size, decoder_options);
     LogDurationMs("Decoder CPU compile (Sync)", decoder_compile_start);
 
     // Check Encoder results
@@ -544,184 +1090,1645 @@ bool OcrInference::TryCompileWithCpu(const uint8_t* encoder_data, size_t encoder
     return true;
 }
 
-bool OcrInference::IsEncoderUsingGpu() const {
-    if (!litert_) return false;
-    return litert_->encoder_using_gpu;
-}
-
-bool OcrInference::IsDecoderUsingGpu() const {
-    if (!litert_) return false;
-    return litert_->decoder_using_gpu;
-}
-
-void OcrInference::UpdateEmbedding(int token_id, int index) noexcept {
-    const int embed_offset = token_id * HIDDEN_SIZE;
-    const int output_offset = index * HIDDEN_SIZE;
-    std::memcpy(
-        embeddings_input_.data() + output_offset,
-        embeddings_data_ + embed_offset,
-        HIDDEN_SIZE * sizeof(float)
-    );
-}
+void OcrInference::CompilePrunedEncoders() {
+    if (encoder_pruned_assets_.empty()) {
+        return;
+    }
 
-int OcrInference::FindMaxLogitToken(int seq_len) const noexcept {
-    const int last_token_pos = seq_len - 1;
-    const float* logits = litert_->decoder_logits.data() + (last_token_pos * VOCAB_SIZE);
+    // One hidden state per patch, plus an optional class token
+    const int tokens = static_cast<int>(encoder_output_size_ / HIDDEN_SIZE);
+    const int grid = static_cast<int>(std::sqrt(static_cast<double>(tokens)));
+    const int patch_count = grid * grid;
+    if (grid <= 0 || (patch_count != tokens && patch_count + 1 != tokens) || IMAGE_SIZE % grid != 0) {
+        LOGW("Encoder output of %d positions is not a patch grid; skipping pruned encoders", tokens);
+        return;
+    }
 
-    float max_logit = logits[0];
-    int max_token = 0;
+    const auto start = std::chrono::steady_clock::now();
+    const bool use_gpu = litert_->encoder_using_gpu;
+    const int num_threads = options_.num_threads > 0 ? options_.num_threads : GetOptimalThreadCount();
+    auto& env = use_gpu ? *g_persist_env : *litert_->cpu_env;
+    const size_t image_bytes = ImageInputBytes(input_format_, IMAGE_SIZE, IMAGE_SIZE);
+
+    for (AAsset* asset : encoder_pruned_assets_) {
+        const auto* data = static_cast<const uint8_t*>(AAsset_getBuffer(asset));
+        const size_t size = AAsset_getLength(asset);
+        if (!data || size == 0) {
+            continue;
+        }
 
-    for (int vocab_idx = 1; vocab_idx < VOCAB_SIZE; ++vocab_idx) {
-        const float logit = logits[vocab_idx];
-        if (logit > max_logit) {
-            max_logit = logit;
-            max_token = vocab_idx;
+        PrunedEncoder encoder;
+        encoder.compiled = CompileAuxiliaryModel(env, use_gpu, options_, num_threads, data, size, "pruned encoder");
+        if (!encoder.compiled) {
+            continue;
+        }
+        auto inputs = encoder.compiled->CreateInputBuffers();
+        auto outputs = encoder.compiled->CreateOutputBuffers();
+        if (!inputs.HasValue() || !outputs.HasValue() || inputs.Value().size() != 2 || outputs.Value().empty()) {
+            LOGW("Failed to create pruned encoder buffers");
+            continue;
+        }
+        encoder.input_buffers = std::move(inputs.Value());
+        encoder.output_buffers = std::move(outputs.Value());
+
+        auto input_bytes = encoder.input_buffers[0].Size();
+        auto indices_bytes = encoder.input_buffers[1].Size();
+        auto indices_type = encoder.input_buffers[1].TensorType();
+        auto output_bytes = encoder.output_buffers[0].Size();
+        if (!input_bytes.HasValue() || !indices_bytes.HasValue() || !indices_type.HasValue() || !output_bytes.HasValue()) {
+            continue;
+        }
+        encoder.patch_budget = static_cast<int>(indices_bytes.Value() / sizeof(int32_t));
+        if (input_bytes.Value() != image_bytes ||
+            indices_type.Value().ElementType() != litert::ElementType::Int32 ||
+            encoder.patch_budget <= 0 || encoder.patch_budget >= patch_count ||
+            output_bytes.Value() != encoder_output_size_ * sizeof(float)) {
+            LOGW("Pruned encoder has unexpected tensor shapes; skipping");
+            continue;
         }
+
+        ReleaseSystemPages(data, size);
+        LOGI("Pruned encoder for %d of %d patches ready (%s)", encoder.patch_budget, patch_count, use_gpu ? "GPU" : "CPU");
+        litert_->pruned_encoders.push_back(std::move(encoder));
     }
 
-    return max_token;
+    if (litert_->pruned_encoders.empty()) {
+        return;
+    }
+    std::sort(litert_->pruned_encoders.begin(), litert_->pruned_encoders.end(),
+              [](const PrunedEncoder& a, const PrunedEncoder& b) { return a.patch_budget < b.patch_budget; });
+    litert_->patch_indices.resize(litert_->pruned_encoders.back().patch_budget);
+    patch_grid_ = grid;
+    LogDurationMs("CompilePrunedEncoders", start);
 }
 
-int OcrInference::InferTokens(const float* image_data, int* out_tokens, int max_tokens) {
-    if (!initialized_) {
-        LOGE("OcrInference not initialized");
-        return 0;
+void OcrInference::CompileResolutions() {
+    if (resolution_assets_.empty()) {
+        return;
     }
 
-    try {
-        // Run encoder
-        const size_t image_data_size = IMAGE_SIZE * IMAGE_SIZE * 3;
-
-        auto write_result = litert_->encoder_input_buffers[0].Write<float>(
-            absl::MakeConstSpan(image_data, image_data_size)
-        );
-
-        if (!write_result.HasValue()) {
-            LOGE("Failed to write encoder input");
-            return 0;
+    const auto start = std::chrono::steady_clock::now();
+    const bool encoder_gpu = litert_->encoder_using_gpu;
+    const bool decoder_gpu = litert_->decoder_using_gpu;
+    const int num_threads = options_.num_threads > 0 ? options_.num_threads : GetOptimalThreadCount();
+    auto& encoder_env = encoder_gpu ? *g_persist_env : *litert_->cpu_env;
+    auto& decoder_env = decoder_gpu ? *g_persist_env : *litert_->cpu_env;
+    const size_t pixel_bytes = ImageInputBytes(input_format_, 1, 1);
+    const auto input_element = input_format_ == ImageInputFormat::kFloat32Rgb
+        ? litert::ElementType::Float32
+        : litert::ElementType::UInt8;
+
+    for (const ResolutionAssets& assets : resolution_assets_) {
+        const auto* encoder_data = static_cast<const uint8_t*>(AAsset_getBuffer(assets.encoder));
+        const size_t encoder_size = AAsset_getLength(assets.encoder);
+        const auto* decoder_data = static_cast<const uint8_t*>(AAsset_getBuffer(assets.decoder));
+        const size_t decoder_size = AAsset_getLength(assets.decoder);
+        if (!encoder_data || encoder_size == 0 || !decoder_data || decoder_size == 0) {
+            continue;
         }
 
-        auto encoder_run_start = std::chrono::steady_clock::now();
-        LOGI("About to run encoder...");
-        auto encoder_run_result = litert_->compiled_encoder->Run(
-            litert_->encoder_input_buffers,
-            litert_->encoder_output_buffers
-        );
-        LOGI("Encoder run finished.");
-        if (!encoder_run_result.HasValue()) {
-            LOGE("Failed to run encoder: %s", encoder_run_result.Error().Message().c_str());
-            return 0;
+        ResolutionVariant variant;
+        variant.encoder = CompileAuxiliaryModel(
+            encoder_env, encoder_gpu, options_, num_threads, encoder_data, encoder_size, "resolution encoder");
+        variant.decoder = CompileAuxiliaryModel(
+            decoder_env, decoder_gpu, options_, num_threads, decoder_data, decoder_size, "resolution decoder");
+        if (!variant.encoder || !variant.decoder) {
+            continue;
+        }
+        auto encoder_inputs = variant.encoder->CreateInputBuffers();
+        auto encoder_outputs = variant.encoder->CreateOutputBuffers();
+        auto decoder_inputs = variant.decoder->CreateInputBuffers();
+        auto decoder_outputs = variant.decoder->CreateOutputBuffers();
+        if (!encoder_inputs.HasValue() || !encoder_outputs.HasValue() ||
+            !decoder_inputs.HasValue() || !decoder_outputs.HasValue() ||
+            encoder_inputs.Value().empty() || encoder_outputs.Value().empty() ||
+            decoder_inputs.Value().size() < 3 || decoder_outputs.Value().empty()) {
+            LOGW("Failed to create resolution variant buffers");
+            continue;
+        }
+        variant.encoder_input_buffers = std::move(encoder_inputs.Value());
+        variant.encoder_output_buffers = std::move(encoder_outputs.Value());
+        variant.decoder_input_buffers = std::move(decoder_inputs.Value());
+        variant.decoder_output_buffers = std::move(decoder_outputs.Value());
+
+        auto input_bytes = variant.encoder_input_buffers[0].Size();
+        auto input_type = variant.encoder_input_buffers[0].TensorType();
+        auto hidden_bytes = variant.encoder_output_buffers[0].Size();
+        auto decoder_hidden_bytes = variant.decoder_input_buffers[0].Size();
+        auto mask_bytes = variant.decoder_input_buffers[1].Size();
+        auto embeddings_bytes = variant.decoder_input_buffers[2].Size();
+        auto logits_bytes = variant.decoder_output_buffers[0].Size();
+        if (!input_bytes.HasValue() || !input_type.HasValue() || !hidden_bytes.HasValue() ||
+            !decoder_hidden_bytes.HasValue() || !mask_bytes.HasValue() || !embeddings_bytes.HasValue() ||
+            !logits_bytes.HasValue()) {
+            continue;
         }
 
-        // Read encoder hidden states
-        auto read_result = litert_->encoder_output_buffers[0].Read<float>(
-            absl::MakeSpan(litert_->encoder_hidden_states)
-        );
-        if (!read_result.HasValue()) {
-            LOGE("Failed to read encoder output");
-            return 0;
+        // Same element layout as the base encoder over a smaller square; the decoder differs
+        // from the base one only in the length of the hidden states it attends to
+        variant.input_size = static_cast<int>(std::lround(std::sqrt(static_cast<double>(input_bytes.Value() / pixel_bytes))));
+        if (input_type.Value().ElementType() != input_element ||
+            variant.input_size <= 0 || variant.input_size >= IMAGE_SIZE ||
+            input_bytes.Value() != ImageInputBytes(input_format_, variant.input_size, variant.input_size) ||
+            hidden_bytes.Value() == 0 || hidden_bytes.Value() % (HIDDEN_SIZE * sizeof(float)) != 0 ||
+            decoder_hidden_bytes.Value() != hidden_bytes.Value() ||
+            mask_bytes.Value() != MAX_SEQUENCE_LENGTH * sizeof(float) ||
+            embeddings_bytes.Value() != static_cast<size_t>(MAX_SEQUENCE_LENGTH) * HIDDEN_SIZE * sizeof(float) ||
+            logits_bytes.Value() != decoder_output_size_ * sizeof(float)) {
+            LOGW("Resolution variant has unexpected tensor shapes; skipping");
+            continue;
         }
+        variant.hidden_states.resize(hidden_bytes.Value() / sizeof(float));
 
-        auto encoder_run_end = std::chrono::steady_clock::now();
-        const auto encoder_run_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-            encoder_run_end - encoder_run_start
-        ).count();
-        LOGI("[PERF] Encoder runtime took %lld ms (%s)", static_cast<long long>(encoder_run_ms),
-             litert_->encoder_using_gpu ? "GPU" : "CPU");
+        ReleaseSystemPages(encoder_data, encoder_size);
+        ReleaseSystemPages(decoder_data, decoder_size);
+        LOGI("Input size %d ready: %zu encoder positions", variant.input_size,
+             variant.hidden_states.size() / HIDDEN_SIZE);
+        litert_->resolution_variants.push_back(std::move(variant));
+    }
 
-        // Initialize decoder state
-        std::fill(embeddings_input_.begin(), embeddings_input_.end(), 0.0f);
-        std::fill(attention_mask_.begin(), attention_mask_.end(), 0.0f);
+    std::sort(litert_->resolution_variants.begin(), litert_->resolution_variants.end(),
+              [](const ResolutionVariant& a, const ResolutionVariant& b) { return a.input_size < b.input_size; });
+    LogDurationMs("CompileResolutions", start);
+}
 
-        out_tokens[0] = START_TOKEN_ID;
-        UpdateEmbedding(START_TOKEN_ID, 0);
-        attention_mask_[0] = 1.0f;
-        int token_count = 1;
-        long long decoder_run_ms = 0;
-        int decoder_iterations = 0;
+void OcrInference::CompileEncoderExits() {
+    if (encoder_exit_assets_.empty() || !encoder_exit_tail_asset_) {
+        return;
+    }
 
-        auto write_hidden_result = litert_->decoder_input_buffers[0].Write<float>(
-            absl::MakeConstSpan(litert_->encoder_hidden_states)
-        );
-        if (!write_hidden_result.HasValue()) {
-            LOGE("Failed to write decoder hidden states input");
-            return 0;
+    const auto start = std::chrono::steady_clock::now();
+    const bool encoder_gpu = litert_->encoder_using_gpu;
+    const bool decoder_gpu = litert_->decoder_using_gpu;
+    const int num_threads = options_.num_threads > 0 ? options_.num_threads : GetOptimalThreadCount();
+    auto& encoder_env = encoder_gpu ? *g_persist_env : *litert_->cpu_env;
+    auto& decoder_env = decoder_gpu ? *g_persist_env : *litert_->cpu_env;
+    const size_t hidden_bytes = encoder_output_size_ * sizeof(float);
+
+    std::vector<EncoderExitAssets> sorted = encoder_exit_assets_;
+    std::sort(sorted.begin(), sorted.end(),
+              [](const EncoderExitAssets& a, const EncoderExitAssets& b) { return a.layer < b.layer; });
+
+    // Segments chain into each other, so a single one that cannot be used disables them all
+    std::vector<EncoderExit> exits;
+    for (const EncoderExitAssets& assets : sorted) {
+        const auto* segment_data = static_cast<const uint8_t*>(AAsset_getBuffer(assets.segment));
+        const size_t segment_size = AAsset_getLength(assets.segment);
+        const auto* decoder_data = static_cast<const uint8_t*>(AAsset_getBuffer(assets.decoder));
+        const size_t decoder_size = AAsset_getLength(assets.decoder);
+        if (assets.layer <= 0 || !segment_data || segment_size == 0 || !decoder_data || decoder_size == 0) {
+            LOGW("Early exit at layer %d is incomplete; skipping early exits", assets.layer);
+            return;
         }
 
-        for (int step = 0; step < MAX_SEQUENCE_LENGTH - 1; ++step) {
-            auto write_mask_result = litert_->decoder_input_buffers[1].Write<float>(
-                absl::MakeConstSpan(attention_mask_.data(), MAX_SEQUENCE_LENGTH)
-            );
-            if (!write_mask_result.HasValue()) {
-                LOGE("Failed to write decoder attention mask input");
-                break;
-            }
-
-            auto write_emb_result = litert_->decoder_input_buffers[2].Write<float>(
-                absl::MakeConstSpan(embeddings_input_.data(), MAX_SEQUENCE_LENGTH * HIDDEN_SIZE)
-            );
-            if (!write_emb_result.HasValue()) {
-                LOGE("Failed to write decoder embeddings input");
-                break;
+        EncoderExit exit;
+        exit.layer = assets.layer;
+        exit.segment = CompileAuxiliaryModel(
+            encoder_env, encoder_gpu, options_, num_threads, segment_data, segment_size, "encoder exit segment");
+        exit.decoder = CompileAuxiliaryModel(
+            decoder_env, decoder_gpu, options_, num_threads, decoder_data, decoder_size, "encoder exit decoder");
+        if (!exit.segment || !exit.decoder) {
+            return;
+        }
+        auto segment_inputs = exit.segment->CreateInputBuffers();
+        auto segment_outputs = exit.segment->CreateOutputBuffers();
+        auto decoder_inputs = exit.decoder->CreateInputBuffers();
+        auto decoder_outputs = exit.decoder->CreateOutputBuffers();
+        if (!segment_inputs.HasValue() || !segment_outputs.HasValue() ||
+            !decoder_inputs.HasValue() || !decoder_outputs.HasValue() ||
+            segment_inputs.Value().size() != 1 || segment_outputs.Value().size() != 2 ||
+            decoder_inputs.Value().size() < 3 || decoder_outputs.Value().empty()) {
+            LOGW("Failed to create buffers for the exit at layer %d; skipping early exits", exit.layer);
+            return;
+        }
+        exit.segment_input_buffers = std::move(segment_inputs.Value());
+        exit.segment_output_buffers = std::move(segment_outputs.Value());
+        exit.decoder_input_buffers = std::move(decoder_inputs.Value());
+        exit.decoder_output_buffers = std::move(decoder_outputs.Value());
+
+        // The first segment takes the image like the base encoder, the others the hidden states
+        // of the previous exit; all exits keep the base encoder's output shape
+        const size_t expected_input = exits.empty()
+            ? ImageInputBytes(input_format_, IMAGE_SIZE, IMAGE_SIZE)
+            : hidden_bytes;
+        auto input_bytes = exit.segment_input_buffers[0].Size();
+        auto output_bytes = exit.segment_output_buffers[0].Size();
+        auto confidence_bytes = exit.segment_output_buffers[1].Size();
+        auto decoder_hidden_bytes = exit.decoder_input_buffers[0].Size();
+        auto mask_bytes = exit.decoder_input_buffers[1].Size();
+        auto embeddings_bytes = exit.decoder_input_buffers[2].Size();
+        auto logits_bytes = exit.decoder_output_buffers[0].Size();
+        if (!input_bytes.HasValue() || !output_bytes.HasValue() || !confidence_bytes.HasValue() ||
+            !decoder_hidden_bytes.HasValue() || !mask_bytes.HasValue() || !embeddings_bytes.HasValue() ||
+            !logits_bytes.HasValue() ||
+            input_bytes.Value() != expected_input ||
+            output_bytes.Value() != hidden_bytes ||
+            confidence_bytes.Value() != sizeof(float) ||
+            decoder_hidden_bytes.Value() != hidden_bytes ||
+            mask_bytes.Value() != MAX_SEQUENCE_LENGTH * sizeof(float) ||
+            embeddings_bytes.Value() != static_cast<size_t>(MAX_SEQUENCE_LENGTH) * HIDDEN_SIZE * sizeof(float) ||
+            logits_bytes.Value() != decoder_output_size_ * sizeof(float)) {
+            LOGW("Exit at layer %d has unexpected tensor shapes; skipping early exits", exit.layer);
+            return;
+        }
+        if (!exits.empty()) {
+            auto shared = exits.back().segment_output_buffers[0].Duplicate();
+            if (!shared.HasValue()) {
+                LOGW("Failed to share hidden states into layer %d; skipping early exits", exit.layer);
+                return;
             }
+            exit.segment_input_buffers[0] = std::move(shared.Value());
+        }
+        exits.push_back(std::move(exit));
+    }
 
-            auto decoder_run_start = std::chrono::steady_clock::now();
-            auto decoder_run_result = litert_->compiled_decoder->Run(
-                litert_->decoder_input_buffers,
-                litert_->decoder_output_buffers
-            );
-            if (!decoder_run_result.HasValue()) {
-                LOGE("Failed to run decoder at step %d: %s", step, decoder_run_result.Error().Message().c_str());
-                break;
-            }
-            decoder_iterations++;
+    const auto* tail_data = static_cast<const uint8_t*>(AAsset_getBuffer(encoder_exit_tail_asset_));
+    const size_t tail_size = AAsset_getLength(encoder_exit_tail_asset_);
+    if (!tail_data || tail_size == 0) {
+        return;
+    }
+    auto tail = CompileAuxiliaryModel(encoder_env, encoder_gpu, options_, num_threads, tail_data, tail_size, "encoder exit tail");
+    if (!tail) {
+        return;
+    }
+    auto tail_inputs = tail->CreateInputBuffers();
+    auto tail_outputs = tail->CreateOutputBuffers();
+    if (!tail_inputs.HasValue() || !tail_outputs.HasValue() ||
+        tail_inputs.Value().size() != 1 || tail_outputs.Value().empty()) {
+        LOGW("Failed to create encoder exit tail buffers; skipping early exits");
+        return;
+    }
+    auto tail_input_bytes = tail_inputs.Value()[0].Size();
+    auto tail_output_bytes = tail_outputs.Value()[0].Size();
+    auto shared = exits.back().segment_output_buffers[0].Duplicate();
+    if (!tail_input_bytes.HasValue() || !tail_output_bytes.HasValue() || !shared.HasValue() ||
+        tail_input_bytes.Value() != hidden_bytes || tail_output_bytes.Value() != hidden_bytes) {
+        LOGW("Encoder exit tail does not continue the last exit; skipping early exits");
+        return;
+    }
+    tail_inputs.Value()[0] = std::move(shared.Value());
 
-            auto logits_result = litert_->decoder_output_buffers[0].Read<float>(
-                absl::MakeSpan(litert_->decoder_logits)
-            );
-            auto decoder_run_end = std::chrono::steady_clock::now();
-            decoder_run_ms += std::chrono::duration_cast<std::chrono::milliseconds>(
-                decoder_run_end - decoder_run_start
-            ).count();
+    litert_->encoder_exits = std::move(exits);
+    litert_->compiled_exit_tail = std::move(tail);
+    litert_->exit_tail_input_buffers = std::move(tail_inputs.Value());
+    litert_->exit_tail_output_buffers = std::move(tail_outputs.Value());
 
-            if (!logits_result.HasValue()) {
-                LOGE("Failed to read decoder output at step %d", step);
-                break;
-            }
+    for (const EncoderExitAssets& assets : encoder_exit_assets_) {
+        ReleaseSystemPages(AAsset_getBuffer(assets.segment), AAsset_getLength(assets.segment));
+        ReleaseSystemPages(AAsset_getBuffer(assets.decoder), AAsset_getLength(assets.decoder));
+    }
+    ReleaseSystemPages(tail_data, tail_size);
+    LOGI("Early exits ready: %zu, from layer %d to %d (%s)", litert_->encoder_exits.size(),
+         litert_->encoder_exits.front().layer, litert_->encoder_exits.back().layer, encoder_gpu ? "GPU" : "CPU");
+    LogDurationMs("CompileEncoderExits", start);
+}
 
-            const int next_token = FindMaxLogitToken(token_count);
+void OcrInference::CompileDecoderBuckets() {
+    if (decoder_bucket_assets_.empty()) {
+        return;
+    }
 
-            if (next_token < 0 || next_token == END_TOKEN_ID) {
-                break;
-            }
-            out_tokens[token_count] = next_token;
-            UpdateEmbedding(next_token, token_count);
-            attention_mask_[token_count] = 1.0f;
+    const auto start = std::chrono::steady_clock::now();
+    const bool use_gpu = litert_->decoder_using_gpu;
+    const int num_threads = options_.num_threads > 0 ? options_.num_threads : GetOptimalThreadCount();
+    auto& env = use_gpu ? *g_persist_env : *litert_->cpu_env;
+
+    for (AAsset* asset : decoder_bucket_assets_) {
+        const auto* data = static_cast<const uint8_t*>(AAsset_getBuffer(asset));
+        const size_t size = AAsset_getLength(asset);
+        if (!data || size == 0) {
+            continue;
+        }
 
-            token_count++;
-            if (token_count >= max_tokens || token_count >= MAX_SEQUENCE_LENGTH) {
-                break;
-            }
+        DecoderBucket bucket;
+        bucket.compiled = CompileAuxiliaryModel(env, use_gpu, options_, num_threads, data, size, "decoder bucket");
+        if (!bucket.compiled) {
+            continue;
+        }
+        auto inputs = bucket.compiled->CreateInputBuffers();
+        auto outputs = bucket.compiled->CreateOutputBuffers();
+        if (!inputs.HasValue() || !outputs.HasValue() || inputs.Value().size() < 3 || outputs.Value().empty()) {
+            LOGW("Failed to create decoder bucket buffers");
+            continue;
+        }
+        bucket.input_buffers = std::move(inputs.Value());
+        bucket.output_buffers = std::move(outputs.Value());
+
+        auto mask_bytes = bucket.input_buffers[1].Size();
+        auto embeddings_bytes = bucket.input_buffers[2].Size();
+        auto logits_bytes = bucket.output_buffers[0].Size();
+        if (!mask_bytes.HasValue() || !embeddings_bytes.HasValue() || !logits_bytes.HasValue()) {
+            continue;
+        }
+        bucket.seq_len = static_cast<int>(mask_bytes.Value() / sizeof(float));
+        bucket.logits_size = logits_bytes.Value() / sizeof(float);
+        if (bucket.seq_len <= 0 || bucket.seq_len >= MAX_SEQUENCE_LENGTH ||
+            embeddings_bytes.Value() != static_cast<size_t>(bucket.seq_len) * HIDDEN_SIZE * sizeof(float) ||
+            bucket.logits_size != static_cast<size_t>(bucket.seq_len) * output_vocab_size_) {
+            LOGW("Decoder bucket has unexpected tensor shapes; skipping");
+            continue;
         }
 
-        LOGI("[PERF] Decoder runtime: %lld ms across %d steps (%s)",
-             static_cast<long long>(decoder_run_ms), decoder_iterations,
-             litert_->decoder_using_gpu ? "GPU" : "CPU");
+        ReleaseSystemPages(data, size);
+        LOGI("Decoder bucket of length %d ready (%s)", bucket.seq_len, use_gpu ? "GPU" : "CPU");
+        litert_->decoder_buckets.push_back(std::move(bucket));
+    }
 
-        const long long total_inference_ms = encoder_run_ms + decoder_run_ms;
-        LOGI("[PERF] Total inference runtime: %lld ms", total_inference_ms);
+    std::sort(litert_->decoder_buckets.begin(), litert_->decoder_buckets.end(),
+              [](const DecoderBucket& a, const DecoderBucket& b) { return a.seq_len < b.seq_len; });
+    LogDurationMs("CompileDecoderBuckets", start);
+}
 
-        return token_count;
-    } catch (const std::exception& e) {
-        LOGE("Exception during inference: %s", e.what());
-        return 0;
+void OcrInference::CompileCtcHead() {
+    if (!ctc_head_asset_) {
+        return;
     }
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto* data = static_cast<const uint8_t*>(AAsset_getBuffer(ctc_head_asset_));
+    const size_t size = AAsset_getLength(ctc_head_asset_);
+    if (!data || size == 0) {
+        return;
+    }
+
+    const bool use_gpu = litert_->decoder_using_gpu;
+    const int num_threads = options_.num_threads > 0 ? options_.num_threads : GetOptimalThreadCount();
+    auto& env = use_gpu ? *g_persist_env : *litert_->cpu_env;
+    auto compiled = CompileAuxiliaryModel(env, use_gpu, options_, num_threads, data, size, "CTC head");
+    if (!compiled) {
+        return;
+    }
+
+    auto inputs = compiled->CreateInputBuffers();
+    auto outputs = compiled->CreateOutputBuffers();
+    if (!inputs.HasValue() || !outputs.HasValue() || inputs.Value().empty() || outputs.Value().empty()) {
+        LOGW("Failed to create CTC head buffers");
+        return;
+    }
+
+    auto input_bytes = inputs.Value()[0].Size();
+    auto output_bytes = outputs.Value()[0].Size();
+    if (!input_bytes.HasValue() || !output_bytes.HasValue() ||
+        input_bytes.Value() != encoder_output_size_ * sizeof(float)) {
+        LOGW("CTC head input does not match the encoder output; skipping");
+        return;
+    }
+
+    // Logits are [time_steps, classes] with one step per encoder position
+    const int time_steps = static_cast<int>(encoder_output_size_ / HIDDEN_SIZE);
+    const size_t logits_size = output_bytes.Value() / sizeof(float);
+    if (time_steps <= 0 || logits_size % time_steps != 0) {
+        LOGW("CTC head output has unexpected shape; skipping");
+        return;
+    }
+
+    litert_->compiled_ctc_head = std::move(compiled);
+    litert_->ctc_input_buffers = std::move(inputs.Value());
+    litert_->ctc_output_buffers = std::move(outputs.Value());
+    litert_->ctc_logits.resize(logits_size);
+    litert_->ctc_time_steps = time_steps;
+    litert_->ctc_num_classes = static_cast<int>(logits_size / time_steps);
+
+    ReleaseSystemPages(data, size);
+    LOGI("CTC head ready: %d steps x %d classes (%s)",
+         litert_->ctc_time_steps, litert_->ctc_num_classes, use_gpu ? "GPU" : "CPU");
+    LogDurationMs("CompileCtcHead", start);
+}
+
+void OcrInference::CompileDecoderLoop() {
+    if (!decoder_loop_asset_) {
+        return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto* data = static_cast<const uint8_t*>(AAsset_getBuffer(decoder_loop_asset_));
+    const size_t size = AAsset_getLength(decoder_loop_asset_);
+    if (!data || size == 0) {
+        return;
+    }
+
+    // Partially delegated control flow would bounce between CPU and GPU every step,
+    // so the loop is only used when it compiles fully on the decoder's accelerator
+    const bool use_gpu = litert_->decoder_using_gpu;
+    const int num_threads = options_.num_threads > 0 ? options_.num_threads : GetOptimalThreadCount();
+    auto& env = use_gpu ? *g_persist_env : *litert_->cpu_env;
+    auto compiled = CompileAuxiliaryModel(env, use_gpu, options_, num_threads, data, size, "in-graph decoder");
+    if (!compiled) {
+        return;
+    }
+
+    auto inputs = compiled->CreateInputBuffers();
+    auto outputs = compiled->CreateOutputBuffers();
+    if (!inputs.HasValue() || !outputs.HasValue() || inputs.Value().empty() || outputs.Value().empty()) {
+        LOGW("Failed to create in-graph decoder buffers");
+        return;
+    }
+
+    auto input_bytes = inputs.Value()[0].Size();
+    auto output_bytes = outputs.Value()[0].Size();
+    auto output_type = outputs.Value()[0].TensorType();
+    if (!input_bytes.HasValue() || !output_bytes.HasValue() || !output_type.HasValue() ||
+        input_bytes.Value() != encoder_output_size_ * sizeof(float) ||
+        output_type.Value().ElementType() != litert::ElementType::Int32) {
+        LOGW("In-graph decoder signature does not match; skipping");
+        return;
+    }
+
+    litert_->compiled_decoder_loop = std::move(compiled);
+    litert_->decoder_loop_input_buffers = std::move(inputs.Value());
+    litert_->decoder_loop_output_buffers = std::move(outputs.Value());
+    litert_->decoder_loop_tokens.resize(output_bytes.Value() / sizeof(int32_t));
+
+    ReleaseSystemPages(data, size);
+    LOGI("In-graph decoder ready: up to %zu tokens (%s)",
+         litert_->decoder_loop_tokens.size(), use_gpu ? "GPU" : "CPU");
+    LogDurationMs("CompileDecoderLoop", start);
+}
+
+void OcrInference::CompileCrossKvDecoder() {
+    if (!decoder_cross_kv_asset_) {
+        return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto* data = static_cast<const uint8_t*>(AAsset_getBuffer(decoder_cross_kv_asset_));
+    const size_t size = AAsset_getLength(decoder_cross_kv_asset_);
+    if (!data || size == 0) {
+        return;
+    }
+
+    const bool use_gpu = litert_->decoder_using_gpu;
+    const int num_threads = options_.num_threads > 0 ? options_.num_threads : GetOptimalThreadCount();
+    auto& env = use_gpu ? *g_persist_env : *litert_->cpu_env;
+    auto compiled = CompileAuxiliaryModel(env, use_gpu, options_, num_threads, data, size, "cross-KV decoder");
+    if (!compiled) {
+        return;
+    }
+
+    auto prefill_inputs = compiled->CreateInputBuffers(CROSS_KV_PREFILL_SIGNATURE);
+    auto prefill_outputs = compiled->CreateOutputBuffers(CROSS_KV_PREFILL_SIGNATURE);
+    auto step_inputs = compiled->CreateInputBuffers(CROSS_KV_STEP_SIGNATURE);
+    auto step_outputs = compiled->CreateOutputBuffers(CROSS_KV_STEP_SIGNATURE);
+    if (!prefill_inputs.HasValue() || !prefill_outputs.HasValue() ||
+        !step_inputs.HasValue() || !step_outputs.HasValue() ||
+        prefill_inputs.Value().empty() || prefill_outputs.Value().empty() || step_outputs.Value().empty() ||
+        step_inputs.Value().size() != prefill_outputs.Value().size() + 2) {
+        LOGW("Cross-KV decoder signatures do not match; skipping");
+        return;
+    }
+
+    // The step takes one tensor per prefill output, then the attention mask and embeddings
+    // of the full-length decoder, and returns logits of the same shape
+    const size_t kv_count = prefill_outputs.Value().size();
+    auto hidden_bytes = prefill_inputs.Value()[0].Size();
+    auto mask_bytes = step_inputs.Value()[kv_count].Size();
+    auto embeddings_bytes = step_inputs.Value()[kv_count + 1].Size();
+    auto logits_bytes = step_outputs.Value()[0].Size();
+    if (!hidden_bytes.HasValue() || !mask_bytes.HasValue() || !embeddings_bytes.HasValue() || !logits_bytes.HasValue() ||
+        hidden_bytes.Value() != encoder_output_size_ * sizeof(float) ||
+        mask_bytes.Value() != MAX_SEQUENCE_LENGTH * sizeof(float) ||
+        embeddings_bytes.Value() != static_cast<size_t>(MAX_SEQUENCE_LENGTH) * HIDDEN_SIZE * sizeof(float) ||
+        logits_bytes.Value() != decoder_output_size_ * sizeof(float)) {
+        LOGW("Cross-KV decoder has unexpected tensor shapes; skipping");
+        return;
+    }
+
+    size_t kv_bytes = 0;
+    for (size_t i = 0; i < kv_count; ++i) {
+        auto prefill_bytes = prefill_outputs.Value()[i].Size();
+        auto step_bytes = step_inputs.Value()[i].Size();
+        if (!prefill_bytes.HasValue() || !step_bytes.HasValue() || prefill_bytes.Value() != step_bytes.Value()) {
+            LOGW("Cross-KV tensor %zu differs between prefill and step; skipping", i);
+            return;
+        }
+        auto shared = prefill_outputs.Value()[i].Duplicate();
+        if (!shared.HasValue()) {
+            LOGW("Failed to share cross-KV tensor %zu; skipping", i);
+            return;
+        }
+        step_inputs.Value()[i] = std::move(shared.Value());
+        kv_bytes += prefill_bytes.Value();
+    }
+
+    litert_->compiled_cross_kv = std::move(compiled);
+    litert_->cross_kv_prefill_input_buffers = std::move(prefill_inputs.Value());
+    litert_->cross_kv_prefill_output_buffers = std::move(prefill_outputs.Value());
+    litert_->cross_kv_step_input_buffers = std::move(step_inputs.Value());
+    litert_->cross_kv_step_output_buffers = std::move(step_outputs.Value());
+
+    ReleaseSystemPages(data, size);
+    LOGI("Cross-KV decoder ready: %zu tensors, %zu KB (%s)",
+         kv_count, kv_bytes / 1024, use_gpu ? "GPU" : "CPU");
+    LogDurationMs("CompileCrossKvDecoder", start);
+}
+
+bool OcrInference::HasInGraphDecoder() const {
+    return litert_ && litert_->compiled_decoder_loop.has_value();
+}
+
+bool OcrInference::HasEarlyExits() const {
+    return litert_ && !litert_->encoder_exits.empty();
+}
+
+bool OcrInference::HasCtcHead() const {
+    return litert_ && litert_->compiled_ctc_head.has_value();
+}
+
+bool OcrInference::IsEncoderUsingGpu() const {
+    if (!litert_) return false;
+    return litert_->encoder_using_gpu;
+}
+
+bool OcrInference::IsDecoderUsingGpu() const {
+    if (!litert_) return false;
+    return litert_->decoder_using_gpu;
+}
+
+void OcrInference::UpdateEmbedding(int token_id, int index) noexcept {
+    const int embed_offset = token_id * HIDDEN_SIZE;
+    const int output_offset = index * HIDDEN_SIZE;
+    std::memcpy(
+        embeddings_input_.data() + output_offset,
+        embeddings_data_ + embed_offset,
+        HIDDEN_SIZE * sizeof(float)
+    );
+}
+
+int OcrInference::FindMaxLogitToken(int seq_len) const noexcept {
+    const int last_token_pos = seq_len - 1;
+    const float* logits = litert_->decoder_logits.data() + (static_cast<size_t>(last_token_pos) * output_vocab_size_);
+
+    float max_logit = logits[0];
+    int max_token = 0;
+
+    for (int vocab_idx = 1; vocab_idx < output_vocab_size_; ++vocab_idx) {
+        const float logit = logits[vocab_idx];
+        if (logit > max_logit) {
+            max_logit = logit;
+            max_token = vocab_idx;
+        }
+    }
+
+    return ToVocabId(max_token);
+}
+
+bool OcrInference::LaunchDecoder(int length) {
+    litert::CompiledModel* compiled = &*litert_->compiled_decoder;
+    std::vector<litert::TensorBuffer>* inputs = &litert_->decoder_input_buffers;
+    std::vector<litert::TensorBuffer>* outputs = &litert_->decoder_output_buffers;
+    bool* hidden_states_loaded = &litert_->decoder_hidden_states_loaded;
+    const std::vector<float>* hidden_states = &litert_->encoder_hidden_states;
+    int seq_len = MAX_SEQUENCE_LENGTH;
+    size_t logits_size = decoder_output_size_;
+    size_t signature = 0;
+    size_t mask_input = 1;
+    bool covered = false;
+
+    // Lower resolutions have a single full-length decoder of their own
+    if (active_resolution_ >= 0) {
+        ResolutionVariant& variant = litert_->resolution_variants[active_resolution_];
+        compiled = &*variant.decoder;
+        inputs = &variant.decoder_input_buffers;
+        outputs = &variant.decoder_output_buffers;
+        hidden_states_loaded = &variant.hidden_states_loaded;
+        hidden_states = &variant.hidden_states;
+        covered = true;
+    }
+
+    // So does every early exit, over the hidden states the encoder stopped at
+    if (active_exit_ >= 0) {
+        EncoderExit& exit = litert_->encoder_exits[active_exit_];
+        compiled = &*exit.decoder;
+        inputs = &exit.decoder_input_buffers;
+        outputs = &exit.decoder_output_buffers;
+        hidden_states_loaded = &exit.hidden_states_loaded;
+        covered = true;
+    }
+
+    // Starting at the predicted length saves uploading the hidden states to buckets the
+    // output would soon outgrow
+    const int bucket_length = std::max(length, predicted_tokens_);
+    for (size_t b = 0; !covered && b < litert_->decoder_buckets.size(); ++b) {
+        auto& bucket = litert_->decoder_buckets[b];
+        if (bucket.seq_len >= bucket_length) {
+            compiled = &*bucket.compiled;
+            inputs = &bucket.input_buffers;
+            outputs = &bucket.output_buffers;
+            hidden_states_loaded = &bucket.hidden_states_loaded;
+            seq_len = bucket.seq_len;
+            logits_size = bucket.logits_size;
+            covered = true;
+            break;
+        }
+    }
+
+    // Beyond the buckets the split decoder replaces the full-length one; its hidden states are
+    // the prefilled keys and values, produced once per request by the first step that needs them
+    if (!covered && litert_->compiled_cross_kv) {
+        if (!litert_->cross_kv_loaded && !PrefillCrossKv()) {
+            return false;
+        }
+        compiled = &*litert_->compiled_cross_kv;
+        inputs = &litert_->cross_kv_step_input_buffers;
+        outputs = &litert_->cross_kv_step_output_buffers;
+        hidden_states_loaded = &litert_->cross_kv_loaded;
+        signature = CROSS_KV_STEP_SIGNATURE;
+        mask_input = litert_->cross_kv_prefill_output_buffers.size();
+    }
+
+    // Everything below is buffer uploads and the run itself
+    ScopedAllocPhase runtime_phase(AllocPhase::kRuntime);
+    if (!*hidden_states_loaded) {
+        auto write_hidden_result = (*inputs)[0].Write<float>(
+            absl::MakeConstSpan(*hidden_states)
+        );
+        if (!write_hidden_result.HasValue()) {
+            LOGE("Failed to write decoder hidden states input");
+            return false;
+        }
+        *hidden_states_loaded = true;
+    }
+
+    auto write_mask_result = (*inputs)[mask_input].Write<float>(
+        absl::MakeConstSpan(attention_mask_.data(), seq_len)
+    );
+    if (!write_mask_result.HasValue()) {
+        LOGE("Failed to write decoder attention mask input");
+        return false;
+    }
+
+    auto write_emb_result = (*inputs)[mask_input + 1].Write<float>(
+        absl::MakeConstSpan(embeddings_input_.data(), static_cast<size_t>(seq_len) * HIDDEN_SIZE)
+    );
+    if (!write_emb_result.HasValue()) {
+        LOGE("Failed to write decoder embeddings input");
+        return false;
+    }
+
+    auto& pending = litert_->pending_decoder;
+    pending.start = std::chrono::steady_clock::now();
+    if (!StartRun(*compiled, signature, *inputs, *outputs, litert_->async_supported, pending.async)) {
+        LOGE("Failed to run decoder at length %d", length);
+        return false;
+    }
+    pending.outputs = outputs;
+    pending.logits_size = logits_size;
+    pending.length = length;
+    return true;
+}
+
+bool OcrInference::PrefillCrossKv() {
+    ScopedAllocPhase runtime_phase(AllocPhase::kRuntime);
+    auto write_result = litert_->cross_kv_prefill_input_buffers[0].Write<float>(
+        absl::MakeConstSpan(litert_->encoder_hidden_states)
+    );
+    if (!write_result.HasValue()) {
+        LOGE("Failed to write cross-KV prefill input");
+        return false;
+    }
+
+    // Synchronous: the step that follows reads these outputs
+    auto run_result = litert_->compiled_cross_kv->Run(
+        CROSS_KV_PREFILL_SIGNATURE,
+        litert_->cross_kv_prefill_input_buffers,
+        litert_->cross_kv_prefill_output_buffers
+    );
+    if (!run_result.HasValue() || !WaitForOutputs(litert_->cross_kv_prefill_output_buffers)) {
+        LOGE("Failed to run cross-KV prefill");
+        return false;
+    }
+    litert_->cross_kv_loaded = true;
+    return true;
+}
+
+bool OcrInference::FinishDecoder(InferenceStats& stats) {
+    auto& pending = litert_->pending_decoder;
+    if (!pending.outputs) {
+        return false;
+    }
+    auto* outputs = pending.outputs;
+    pending.outputs = nullptr;
+
+    if (pending.async && !WaitForOutputs(*outputs)) {
+        LOGE("Decoder did not complete at length %d", pending.length);
+        return false;
+    }
+    stats.decoder_runs++;
+
+    ScopedAllocPhase runtime_phase(AllocPhase::kRuntime);
+    auto logits_result = (*outputs)[0].Read<float>(
+        absl::MakeSpan(litert_->decoder_logits.data(), pending.logits_size)
+    );
+    auto decoder_run_end = std::chrono::steady_clock::now();
+    stats.decoder_ms += std::chrono::duration_cast<std::chrono::milliseconds>(
+        decoder_run_end - pending.start
+    ).count();
+    UpdateEstimate(step_estimate_us_, std::chrono::duration_cast<std::chrono::microseconds>(
+        decoder_run_end - pending.start
+    ).count());
+
+    if (!logits_result.HasValue()) {
+        LOGE("Failed to read decoder output at length %d", pending.length);
+        return false;
+    }
+    return true;
+}
+
+bool OcrInference::RunDecoder(int length, InferenceStats& stats) {
+    return LaunchDecoder(length) && FinishDecoder(stats);
+}
+
+void OcrInference::ResetDecoderState() noexcept {
+    std::fill(embeddings_input_.begin(), embeddings_input_.end(), 0.0f);
+    std::fill(attention_mask_.begin(), attention_mask_.end(), 0.0f);
+    UpdateEmbedding(START_TOKEN_ID, 0);
+    attention_mask_[0] = 1.0f;
+
+    // Hidden states are uploaded lazily to whichever decoder runs first
+    litert_->decoder_hidden_states_loaded = false;
+    for (auto& bucket : litert_->decoder_buckets) {
+        bucket.hidden_states_loaded = false;
+    }
+    litert_->cross_kv_loaded = false;
+    for (auto& variant : litert_->resolution_variants) {
+        variant.hidden_states_loaded = false;
+    }
+    for (auto& exit : litert_->encoder_exits) {
+        exit.hidden_states_loaded = false;
+    }
+}
+
+// Prompt-lookup drafting: propose the tokens that followed the latest earlier occurrence
+// of the trailing bigram (or unigram). Repeats are common in manga (sound effects, ellipses).
+int OcrInference::ProposeDraft(const int* tokens, int token_count, int max_draft, int* draft) noexcept {
+    if (max_draft <= 0 || token_count < 2) {
+        return 0;
+    }
+
+    for (int ngram = 2; ngram >= 1; --ngram) {
+        if (token_count - 1 < ngram) {
+            continue;
+        }
+        const int* tail = tokens + token_count - ngram;
+        // Position 0 holds START, so matches begin at 1
+        for (int i = token_count - ngram - 1; i >= 1; --i) {
+            if (std::equal(tail, tail + ngram, tokens + i)) {
+                int count = 0;
+                while (count < max_draft && i + ngram + count < token_count) {
+                    draft[count] = tokens[i + ngram + count];
+                    count++;
+                }
+                if (count > 0) {
+                    return count;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+int OcrInference::PredictTokenCount() const noexcept {
+    if (!length_predictor_) {
+        return 0;
+    }
+    // Linear in the mean over positions, so each position is projected and the sum scaled
+    const size_t positions = encoder_output_size_ / HIDDEN_SIZE;
+    const float* hidden = litert_->encoder_hidden_states.data();
+    float sum = 0.0f;
+    for (size_t p = 0; p < positions; ++p, hidden += HIDDEN_SIZE) {
+        for (int i = 0; i < HIDDEN_SIZE; ++i) {
+            sum += hidden[i] * length_predictor_[i];
+        }
+    }
+    const float predicted = sum / static_cast<float>(positions) + length_predictor_[HIDDEN_SIZE];
+    if (!std::isfinite(predicted)) {
+        return 0;
+    }
+    return std::clamp(static_cast<int>(std::lround(predicted)), 1, MAX_SEQUENCE_LENGTH);
+}
+
+bool OcrInference::ShouldStop(const DecodeOptions& options, int runs, InferenceStats& stats) const noexcept {
+    if (options.IsCancelled()) {
+        stats.cancelled = true;
+        return true;
+    }
+    if (options.HasDeadline()) {
+        const auto expected_end = std::chrono::steady_clock::now() +
+            std::chrono::microseconds(static_cast<long long>(step_estimate_us_ * runs));
+        if (expected_end > options.deadline) {
+            stats.partial = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Exponential moving average; the first sample is taken as is
+void OcrInference::UpdateEstimate(double& estimate_us, long long elapsed_us) noexcept {
+    static constexpr double WEIGHT = 0.25;
+    estimate_us = estimate_us == 0.0
+        ? static_cast<double>(elapsed_us)
+        : estimate_us + WEIGHT * (static_cast<double>(elapsed_us) - estimate_us);
+}
+
+int OcrInference::DecodeGreedy(
+    int* out_tokens,
+    int max_tokens,
+    const DecodeOptions& options,
+    int draft_length,
+    InferenceStats& stats) {
+    static constexpr int MAX_DRAFT_LENGTH = 8;
+    const int limit = std::min(max_tokens, MAX_SEQUENCE_LENGTH);
+    draft_length = std::clamp(draft_length, 0, MAX_DRAFT_LENGTH);
+
+    // Embeddings and mask were reset by ResetDecoderState while the encoder ran
+    out_tokens[0] = START_TOKEN_ID;
+    int token_count = 1;
+
+    int draft[MAX_DRAFT_LENGTH];
+    while (token_count < limit && !ShouldStop(options, 1, stats)) {
+        // Draft tokens are written past the prefix; causal attention keeps the prefix logits unchanged
+        const int draft_count = ProposeDraft(
+            out_tokens, token_count, std::min(draft_length, limit - token_count - 1), draft
+        );
+        for (int i = 0; i < draft_count; ++i) {
+            UpdateEmbedding(draft[i], token_count + i);
+            attention_mask_[token_count + i] = 1.0f;
+        }
+        const int drafted_end = token_count + draft_count;
+
+        if (!RunDecoder(drafted_end, stats)) {
+            break;
+        }
+
+        bool finished = false;
+        for (int i = 0; i <= draft_count; ++i) {
+            const int next_token = FindMaxLogitToken(token_count);
+            if (next_token < 0 || next_token == END_TOKEN_ID) {
+                finished = true;
+                break;
+            }
+
+            const bool draft_accepted = i < draft_count && draft[i] == next_token;
+            out_tokens[token_count] = next_token;
+            if (!draft_accepted) {
+                UpdateEmbedding(next_token, token_count);
+            }
+            attention_mask_[token_count] = 1.0f;
+            token_count++;
+
+            if (!draft_accepted || token_count >= limit) {
+                break;
+            }
+        }
+
+        // Hide rejected draft positions from the next run
+        for (int i = token_count; i < drafted_end; ++i) {
+            attention_mask_[i] = 0.0f;
+        }
+        if (finished) {
+            break;
+        }
+    }
+
+    return token_count;
+}
+
+int OcrInference::DecodeBeam(int* out_tokens, int max_tokens, const DecodeOptions& options, InferenceStats& stats) {
+    struct Hypothesis {
+        std::vector<int> tokens;
+        float log_prob = 0.0f;
+    };
+    struct Candidate {
+        int parent;
+        int token;
+        float log_prob;
+    };
+
+    const int limit = std::min(max_tokens, MAX_SEQUENCE_LENGTH);
+    const int beam_width = std::clamp(options.beam_width, 1, MAX_BEAM_WIDTH);
+
+    std::vector<Hypothesis> alive(1);
+    alive[0].tokens.push_back(START_TOKEN_ID);
+    std::vector<Hypothesis> next;
+    std::vector<Candidate> candidates;
+    std::vector<int> best_finished;
+    float best_finished_score = -INFINITY;
+    int finished_count = 0;
+    bool failed = false;
+
+    // Scores one hypothesis' next-token row into candidates
+    auto expand = [&](const float* logits, int parent) {
+        const float max_logit = *std::max_element(logits, logits + output_vocab_size_);
+        double sum = 0.0;
+        for (int v = 0; v < output_vocab_size_; ++v) {
+            sum += std::exp(static_cast<double>(logits[v] - max_logit));
+        }
+        const float log_norm = max_logit + static_cast<float>(std::log(sum));
+
+        // Keep the top beam_width tokens of this hypothesis, best first
+        int top_tokens[MAX_BEAM_WIDTH];
+        float top_logits[MAX_BEAM_WIDTH];
+        int top_count = 0;
+        for (int v = 0; v < output_vocab_size_; ++v) {
+            const float logit = logits[v];
+            if (top_count == beam_width && logit <= top_logits[top_count - 1]) {
+                continue;
+            }
+            int pos = top_count < beam_width ? top_count++ : top_count - 1;
+            while (pos > 0 && top_logits[pos - 1] < logit) {
+                top_logits[pos] = top_logits[pos - 1];
+                top_tokens[pos] = top_tokens[pos - 1];
+                pos--;
+            }
+            top_logits[pos] = logit;
+            top_tokens[pos] = v;
+        }
+
+        for (int k = 0; k < top_count; ++k) {
+            candidates.push_back({parent, ToVocabId(top_tokens[k]), alive[parent].log_prob + top_logits[k] - log_norm});
+        }
+    };
+
+    // Row of the previous hypothesis, scored while the next one runs on the device
+    std::vector<float> pending_row(output_vocab_size_);
+
+    while (!alive.empty() && !failed && !ShouldStop(options, static_cast<int>(alive.size()), stats)) {
+        candidates.clear();
+        int pending_parent = -1;
+
+        for (size_t b = 0; b < alive.size(); ++b) {
+            const Hypothesis& hyp = alive[b];
+            const int length = static_cast<int>(hyp.tokens.size());
+
+            std::fill(attention_mask_.begin(), attention_mask_.end(), 0.0f);
+            for (int i = 0; i < length; ++i) {
+                UpdateEmbedding(hyp.tokens[i], i);
+                attention_mask_[i] = 1.0f;
+            }
+            if (!LaunchDecoder(length)) {
+                failed = true;
+                break;
+            }
+            if (pending_parent >= 0) {
+                expand(pending_row.data(), pending_parent);
+            }
+            if (!FinishDecoder(stats)) {
+                failed = true;
+                break;
+            }
+
+            const float* logits = litert_->decoder_logits.data() + static_cast<size_t>(length - 1) * output_vocab_size_;
+            std::copy(logits, logits + output_vocab_size_, pending_row.begin());
+            pending_parent = static_cast<int>(b);
+        }
+        if (failed) {
+            break;
+        }
+        if (pending_parent >= 0) {
+            expand(pending_row.data(), pending_parent);
+        }
+
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const Candidate& a, const Candidate& c) { return a.log_prob > c.log_prob; });
+
+        next.clear();
+        for (const Candidate& candidate : candidates) {
+            if (static_cast<int>(next.size()) >= beam_width) {
+                break;
+            }
+            const Hypothesis& parent = alive[candidate.parent];
+            const bool ends = candidate.token == END_TOKEN_ID;
+
+            Hypothesis hyp{parent.tokens, candidate.log_prob};
+            if (!ends) {
+                hyp.tokens.push_back(candidate.token);
+            }
+            if (ends || static_cast<int>(hyp.tokens.size()) >= limit) {
+                // Length-normalised so short outputs are not favoured
+                const float score = hyp.log_prob / static_cast<float>(hyp.tokens.size());
+                if (score > best_finished_score) {
+                    best_finished_score = score;
+                    best_finished = std::move(hyp.tokens);
+                }
+                finished_count++;
+                continue;
+            }
+            next.push_back(std::move(hyp));
+        }
+        alive.swap(next);
+
+        if (finished_count >= beam_width) {
+            break;
+        }
+    }
+
+    const std::vector<int>* result = nullptr;
+    if (!best_finished.empty()) {
+        result = &best_finished;
+    } else if (!alive.empty()) {
+        result = &alive[0].tokens;
+    }
+    if (!result) {
+        out_tokens[0] = START_TOKEN_ID;
+        return 1;
+    }
+
+    const int token_count = std::min(static_cast<int>(result->size()), limit);
+    std::copy(result->begin(), result->begin() + token_count, out_tokens);
+    return token_count;
+}
+
+// Smallest compiled input resolution that keeps the crop legible
+int OcrInference::SelectInputSize(int source_width, int source_height) const {
+    // Encoding above the crop's own resolution only interpolates, so some downscaling is tolerated;
+    // characters of a line squeezed along the long side need a minimum width each
+    static constexpr float MIN_INPUT_SCALE = 0.85f;
+    static constexpr int MIN_PIXELS_PER_CHARACTER = 20;
+
+    if (!litert_ || litert_->resolution_variants.empty() || source_width <= 0 || source_height <= 0) {
+        return IMAGE_SIZE;
+    }
+    const int long_side = std::max(source_width, source_height);
+    const int short_side = std::min(source_width, source_height);
+    const int detail_size = static_cast<int>(std::ceil(long_side * MIN_INPUT_SCALE));
+    const int density_size = MIN_PIXELS_PER_CHARACTER * ((long_side + short_side - 1) / short_side);
+    const int needed = std::max(detail_size, density_size);
+    for (const auto& variant : litert_->resolution_variants) {
+        if (variant.input_size >= needed) {
+            return variant.input_size;
+        }
+    }
+    return IMAGE_SIZE;
+}
+
+// Single-line crops (one row or column of text, or a tiny sound effect) suit the CTC head
+bool OcrInference::IsSingleLineCrop(int width, int height) noexcept {
+    static constexpr int SMALL_CROP_SIZE = 96;
+    static constexpr float SINGLE_LINE_ASPECT = 2.0f;
+
+    if (width <= 0 || height <= 0) {
+        return false;
+    }
+    const int long_side = std::max(width, height);
+    const int short_side = std::min(width, height);
+    return long_side <= SMALL_CROP_SIZE ||
+           static_cast<float>(long_side) / static_cast<float>(short_side) >= SINGLE_LINE_ASPECT;
+}
+
+int OcrInference::DecodeCtc(int* out_tokens, int max_tokens, const DecodeOptions& options, float* confidence, InferenceStats& stats) {
+    const auto ctc_start = std::chrono::steady_clock::now();
+    {
+        ScopedAllocPhase runtime_phase(AllocPhase::kRuntime);
+        auto write_result = litert_->ctc_input_buffers[0].Write<float>(
+            absl::MakeConstSpan(litert_->encoder_hidden_states)
+        );
+        if (!write_result.HasValue()) {
+            LOGE("Failed to write CTC head input");
+            return 0;
+        }
+
+        auto run_result = litert_->compiled_ctc_head->Run(
+            litert_->ctc_input_buffers,
+            litert_->ctc_output_buffers
+        );
+        if (!run_result.HasValue()) {
+            LOGE("Failed to run CTC head: %s", run_result.Error().Message().c_str());
+            return 0;
+        }
+        auto read_result = litert_->ctc_output_buffers[0].Read<float>(
+            absl::MakeSpan(litert_->ctc_logits)
+        );
+        if (!read_result.HasValue()) {
+            LOGE("Failed to read CTC head output");
+            return 0;
+        }
+    }
+
+    // The CTC blank shares the [PAD] id; START is prepended to match the decoder output layout
+    out_tokens[0] = START_TOKEN_ID;
+    const int limit = std::min(max_tokens, MAX_SEQUENCE_LENGTH) - 1;
+    const int decoded = options.ctc_beam_width > 1
+        ? CtcPrefixBeamDecode(litert_->ctc_logits.data(), litert_->ctc_time_steps, litert_->ctc_num_classes,
+                              PAD_TOKEN_ID, options.ctc_beam_width, out_tokens + 1, limit, confidence)
+        : CtcGreedyDecode(litert_->ctc_logits.data(), litert_->ctc_time_steps, litert_->ctc_num_classes,
+                          PAD_TOKEN_ID, out_tokens + 1, limit, confidence);
+
+    const long long ctc_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - ctc_start
+    ).count();
+    stats.decoder_ms += ctc_ms;
+    stats.decoder_runs++;
+    LOGI("[PERF] CTC head took %lld ms, %d tokens, confidence %.3f", ctc_ms, decoded, *confidence);
+
+    return decoded + 1;
+}
+
+// One invocation runs the greedy loop in the graph; only the token ids come back
+int OcrInference::DecodeInGraph(int* out_tokens, int max_tokens, InferenceStats& stats) {
+    const auto run_start = std::chrono::steady_clock::now();
+    {
+        ScopedAllocPhase runtime_phase(AllocPhase::kRuntime);
+        auto write_result = litert_->decoder_loop_input_buffers[0].Write<float>(
+            absl::MakeConstSpan(litert_->encoder_hidden_states)
+        );
+        if (!write_result.HasValue()) {
+            LOGE("Failed to write in-graph decoder input");
+            return 0;
+        }
+
+        auto run_result = litert_->compiled_decoder_loop->Run(
+            litert_->decoder_loop_input_buffers,
+            litert_->decoder_loop_output_buffers
+        );
+        if (!run_result.HasValue()) {
+            LOGE("Failed to run in-graph decoder: %s", run_result.Error().Message().c_str());
+            return 0;
+        }
+        auto read_result = litert_->decoder_loop_output_buffers[0].Read<int32_t>(
+            absl::MakeSpan(litert_->decoder_loop_tokens)
+        );
+        if (!read_result.HasValue()) {
+            LOGE("Failed to read in-graph decoder output");
+            return 0;
+        }
+    }
+    stats.decoder_ms += std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - run_start
+    ).count();
+    stats.decoder_runs++;
+
+    // Output may or may not start with START; it ends at END or padding
+    const auto& ids = litert_->decoder_loop_tokens;
+    const int limit = std::min(max_tokens, MAX_SEQUENCE_LENGTH);
+    out_tokens[0] = START_TOKEN_ID;
+    int token_count = 1;
+    for (size_t i = (!ids.empty() && ids[0] == START_TOKEN_ID) ? 1 : 0; i < ids.size() && token_count < limit; ++i) {
+        const int token = ids[i];
+        if (token == END_TOKEN_ID || token == PAD_TOKEN_ID) {
+            break;
+        }
+        out_tokens[token_count++] = token;
+    }
+    return token_count;
+}
+
+template <typename T>
+static void AddVector(MemoryUsage& usage, const std::vector<T>& values) {
+    usage.AddRegion(MemoryComponent::kHostBuffers, values.data(), values.capacity() * sizeof(T));
+}
+
+static void AddTensorBuffers(MemoryUsage& usage, const std::vector<litert::TensorBuffer>& buffers) {
+    for (const auto& buffer : buffers) {
+        auto size = buffer.Size();
+        if (size.HasValue()) {
+            usage.AddResident(MemoryComponent::kTensorBuffers, size.Value());
+        }
+    }
+}
+
+void OcrInference::AccountMemory(MemoryUsage& usage) const {
+    auto add_asset = [&usage](MemoryComponent component, AAsset* asset) {
+        if (asset) {
+            usage.AddRegion(component, AAsset_getBuffer(asset), AAsset_getLength(asset));
+        }
+    };
+    add_asset(MemoryComponent::kModels, encoder_asset_);
+    add_asset(MemoryComponent::kModels, decoder_asset_);
+    for (AAsset* asset : encoder_pruned_assets_) {
+        add_asset(MemoryComponent::kModels, asset);
+    }
+    for (const ResolutionAssets& assets : resolution_assets_) {
+        add_asset(MemoryComponent::kModels, assets.encoder);
+        add_asset(MemoryComponent::kModels, assets.decoder);
+    }
+    for (const EncoderExitAssets& assets : encoder_exit_assets_) {
+        add_asset(MemoryComponent::kModels, assets.segment);
+        add_asset(MemoryComponent::kModels, assets.decoder);
+    }
+    add_asset(MemoryComponent::kModels, encoder_exit_tail_asset_);
+    for (AAsset* asset : decoder_bucket_assets_) {
+        add_asset(MemoryComponent::kModels, asset);
+    }
+    add_asset(MemoryComponent::kModels, ctc_head_asset_);
+    add_asset(MemoryComponent::kModels, decoder_loop_asset_);
+    add_asset(MemoryComponent::kModels, decoder_cross_kv_asset_);
+    add_asset(MemoryComponent::kModels, length_predictor_asset_);
+    add_asset(MemoryComponent::kEmbeddings, embeddings_asset_);
+
+    AddVector(usage, embeddings_input_);
+    AddVector(usage, attention_mask_);
+    AddVector(usage, output_vocab_ids_);
+    if (!litert_) {
+        return;
+    }
+
+    AddTensorBuffers(usage, litert_->encoder_input_buffers);
+    AddTensorBuffers(usage, litert_->encoder_output_buffers);
+    AddTensorBuffers(usage, litert_->decoder_input_buffers);
+    AddTensorBuffers(usage, litert_->decoder_output_buffers);
+    for (const auto& encoder : litert_->pruned_encoders) {
+        AddTensorBuffers(usage, encoder.input_buffers);
+        AddTensorBuffers(usage, encoder.output_buffers);
+    }
+    for (const auto& variant : litert_->resolution_variants) {
+        AddTensorBuffers(usage, variant.encoder_input_buffers);
+        AddTensorBuffers(usage, variant.encoder_output_buffers);
+        AddTensorBuffers(usage, variant.decoder_input_buffers);
+        AddTensorBuffers(usage, variant.decoder_output_buffers);
+        AddVector(usage, variant.hidden_states);
+    }
+    // Later segment inputs and the tail input are the previous segment outputs counted here
+    if (!litert_->encoder_exits.empty()) {
+        AddTensorBuffers(usage, litert_->encoder_exits.front().segment_input_buffers);
+    }
+    for (const auto& exit : litert_->encoder_exits) {
+        AddTensorBuffers(usage, exit.segment_output_buffers);
+        AddTensorBuffers(usage, exit.decoder_input_buffers);
+        AddTensorBuffers(usage, exit.decoder_output_buffers);
+    }
+    AddTensorBuffers(usage, litert_->exit_tail_output_buffers);
+    for (const auto& bucket : litert_->decoder_buckets) {
+        AddTensorBuffers(usage, bucket.input_buffers);
+        AddTensorBuffers(usage, bucket.output_buffers);
+    }
+    AddTensorBuffers(usage, litert_->ctc_input_buffers);
+    AddTensorBuffers(usage, litert_->ctc_output_buffers);
+    AddTensorBuffers(usage, litert_->decoder_loop_input_buffers);
+    AddTensorBuffers(usage, litert_->decoder_loop_output_buffers);
+    AddTensorBuffers(usage, litert_->cross_kv_prefill_input_buffers);
+    AddTensorBuffers(usage, litert_->cross_kv_prefill_output_buffers);
+    AddTensorBuffers(usage, litert_->cross_kv_step_output_buffers);
+    // The leading step inputs are the prefill outputs counted above
+    const auto& step_inputs = litert_->cross_kv_step_input_buffers;
+    for (size_t i = litert_->cross_kv_prefill_output_buffers.size(); i < step_inputs.size(); ++i) {
+        auto size = step_inputs[i].Size();
+        if (size.HasValue()) {
+            usage.AddResident(MemoryComponent::kTensorBuffers, size.Value());
+        }
+    }
+
+    AddVector(usage, litert_->encoder_hidden_states);
+    AddVector(usage, litert_->decoder_logits);
+    AddVector(usage, litert_->ctc_logits);
+    AddVector(usage, litert_->decoder_loop_tokens);
+    AddVector(usage, litert_->patch_indices);
+}
+
+bool OcrInference::WriteEncoderInput(const void* image_data) {
+    return WriteImageInput(litert_->encoder_input_buffers[0], input_format_, image_data,
+                           ImageInputBytes(input_format_, IMAGE_SIZE, IMAGE_SIZE));
+}
+
+int OcrInference::SelectPrunedEncoder(const PatchMask* mask) {
+    if (!mask || patch_grid_ == 0 || mask->grid != patch_grid_ || !mask->IsComputed()) {
+        return -1;
+    }
+    const auto& encoders = litert_->pruned_encoders;
+    for (size_t e = 0; e < encoders.size(); ++e) {
+        const int budget = encoders[e].patch_budget;
+        if (budget < mask->kept_count) {
+            continue;
+        }
+        // Kept patches in row-major order, then padding the model masks out
+        auto& indices = litert_->patch_indices;
+        int count = 0;
+        for (size_t i = 0; i < mask->keep.size(); ++i) {
+            if (mask->keep[i]) {
+                indices[count++] = static_cast<int32_t>(i);
+            }
+        }
+        std::fill(indices.begin() + count, indices.begin() + budget, -1);
+        return static_cast<int>(e);
+    }
+    return -1;
+}
+
+bool OcrInference::RunEncoderExits(const void* image_data, float min_confidence, InferenceStats& stats) {
+    ScopedAllocPhase runtime_phase(AllocPhase::kRuntime);
+    auto& exits = litert_->encoder_exits;
+    if (!WriteImageInput(exits[0].segment_input_buffers[0], input_format_, image_data,
+                         ImageInputBytes(input_format_, IMAGE_SIZE, IMAGE_SIZE))) {
+        LOGE("Failed to write encoder input");
+        return false;
+    }
+
+    // Synchronous: each segment continues from the previous one's outputs, and only the
+    // exit confidence is read back between them
+    litert::TensorBuffer* hidden_output = nullptr;
+    for (size_t e = 0; e < exits.size() && !hidden_output; ++e) {
+        EncoderExit& exit = exits[e];
+        auto run_result = exit.segment->Run(exit.segment_input_buffers, exit.segment_output_buffers);
+        float confidence = 0.0f;
+        if (!run_result.HasValue() || !WaitForOutputs(exit.segment_output_buffers) ||
+            !exit.segment_output_buffers[1].Read<float>(absl::MakeSpan(&confidence, 1)).HasValue()) {
+            LOGE("Failed to run the encoder up to layer %d", exit.layer);
+            return false;
+        }
+        if (confidence >= min_confidence) {
+            active_exit_ = static_cast<int>(e);
+            stats.exit_layer = exit.layer;
+            hidden_output = &exit.segment_output_buffers[0];
+        }
+    }
+    if (!hidden_output) {
+        auto run_result = litert_->compiled_exit_tail->Run(
+            litert_->exit_tail_input_buffers, litert_->exit_tail_output_buffers);
+        if (!run_result.HasValue() || !WaitForOutputs(litert_->exit_tail_output_buffers)) {
+            LOGE("Failed to run the encoder past the last exit");
+            return false;
+        }
+        hidden_output = &litert_->exit_tail_output_buffers[0];
+    }
+
+    auto read_result = hidden_output->Read<float>(
+        absl::MakeSpan(litert_->encoder_hidden_states));
+    if (!read_result.HasValue()) {
+        LOGE("Failed to read encoder output");
+        return false;
+    }
+    return true;
+}
+
+int OcrInference::InferTokens(
+    const void* image_data,
+    int* out_tokens,
+    int max_tokens,
+    const DecodeOptions& options,
+    InferenceStats* stats
+) {
+    if (!initialized_) {
+        LOGE("OcrInference not initialized");
+        return 0;
+    }
+
+    InferenceStats local_stats;
+    InferenceStats& run_stats = stats ? *stats : local_stats;
+    run_stats = {};
+    hidden_states_valid_ = false;
+
+    if (options.HasDeadline() &&
+        std::chrono::steady_clock::now() + std::chrono::microseconds(static_cast<long long>(encoder_estimate_us_)) >
+            options.deadline) {
+        LOGW("Deadline too close to run the encoder");
+        run_stats.partial = true;
+        return 0;
+    }
+
+    try {
+        ScopedAllocPhase encoder_phase(AllocPhase::kEncoder);
+        WorkPool::InferenceScope inference_scope(WorkPool::Shared(), cpu_threads_);
+
+        // Run encoder at the request's input size, or at full size pruned to the informative
+        // patches when one fits them
+        litert::CompiledModel* encoder = &*litert_->compiled_encoder;
+        std::vector<litert::TensorBuffer>* encoder_inputs = &litert_->encoder_input_buffers;
+        std::vector<litert::TensorBuffer>* encoder_outputs = &litert_->encoder_output_buffers;
+        std::vector<float>* hidden_states = &litert_->encoder_hidden_states;
+        const int input_size = options.input_size > 0 ? options.input_size : IMAGE_SIZE;
+        active_resolution_ = -1;
+        if (input_size != IMAGE_SIZE) {
+            auto& variants = litert_->resolution_variants;
+            for (size_t v = 0; v < variants.size(); ++v) {
+                if (variants[v].input_size == input_size) {
+                    active_resolution_ = static_cast<int>(v);
+                    break;
+                }
+            }
+            if (active_resolution_ < 0) {
+                LOGE("No encoder for input size %d", input_size);
+                return 0;
+            }
+            ResolutionVariant& variant = variants[active_resolution_];
+            encoder = &*variant.encoder;
+            encoder_inputs = &variant.encoder_input_buffers;
+            encoder_outputs = &variant.encoder_output_buffers;
+            hidden_states = &variant.hidden_states;
+        }
+        const int pruned = active_resolution_ < 0 ? SelectPrunedEncoder(options.patch_mask) : -1;
+        // Pruned encoders already skip most of the work, so early exits only replace the full one
+        const bool early_exit = active_resolution_ < 0 && pruned < 0 &&
+            options.exit_min_confidence > 0.0f && HasEarlyExits();
+        active_exit_ = -1;
+        if (pruned >= 0) {
+            PrunedEncoder& selected = litert_->pruned_encoders[pruned];
+            encoder = &*selected.compiled;
+            encoder_inputs = &selected.input_buffers;
+            encoder_outputs = &selected.output_buffers;
+            run_stats.encoder_patches = selected.patch_budget;
+            ScopedAllocPhase runtime_phase(AllocPhase::kRuntime);
+            if (!selected.input_buffers[1].Write<int32_t>(
+                    absl::MakeConstSpan(litert_->patch_indices.data(), selected.patch_budget)).HasValue()) {
+                LOGE("Failed to write pruned encoder patch indices");
+                return 0;
+            }
+        }
+        auto encoder_run_start = std::chrono::steady_clock::now();
+        if (early_exit) {
+            ResetDecoderState();
+            if (!RunEncoderExits(image_data, options.exit_min_confidence, run_stats)) {
+                return 0;
+            }
+        } else {
+            if (!WriteImageInput((*encoder_inputs)[0], input_format_, image_data,
+                                 ImageInputBytes(input_format_, input_size, input_size))) {
+                LOGE("Failed to write encoder input");
+                return 0;
+            }
+
+            LOGI("About to run encoder...");
+            bool encoder_async = false;
+            if (!StartRun(*encoder, 0, *encoder_inputs, *encoder_outputs, litert_->async_supported, encoder_async)) {
+                LOGE("Failed to run encoder");
+                return 0;
+            }
+
+            // Decoder state does not depend on the encoder output, so it is reset while the encoder runs
+            ResetDecoderState();
+
+            if (encoder_async && !WaitForOutputs(*encoder_outputs)) {
+                LOGE("Encoder did not complete");
+                return 0;
+            }
+            LOGI("Encoder run finished (%s).", encoder_async ? "async" : "sync");
+
+            // Read encoder hidden states
+            ScopedAllocPhase runtime_phase(AllocPhase::kRuntime);
+            auto read_result = (*encoder_outputs)[0].Read<float>(
+                absl::MakeSpan(*hidden_states)
+            );
+            if (!read_result.HasValue()) {
+                LOGE("Failed to read encoder output");
+                return 0;
+            }
+        }
+        // Only full-depth base encoder states can be decoded again through DecodeTokens
+        hidden_states_valid_ = active_resolution_ < 0 && active_exit_ < 0;
+
+        auto encoder_run_end = std::chrono::steady_clock::now();
+        run_stats.encoder_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            encoder_run_end - encoder_run_start
+        ).count();
+        UpdateEstimate(encoder_estimate_us_, std::chrono::duration_cast<std::chrono::microseconds>(
+            encoder_run_end - encoder_run_start
+        ).count());
+        LOGI("[PERF] Encoder runtime took %lld ms (%s, %dpx, %d patches, exit layer %d)", run_stats.encoder_ms,
+             litert_->encoder_using_gpu ? "GPU" : "CPU", input_size,
+             pruned >= 0 ? run_stats.encoder_patches : patch_grid_ * patch_grid_, run_stats.exit_layer);
+
+        return Decode(out_tokens, max_tokens, options, run_stats);
+    } catch (const std::exception& e) {
+        LOGE("Exception during inference: %s", e.what());
+        return 0;
+    }
+}
+
+int OcrInference::DecodeTokens(
+    const std::vector<float>& hidden_states,
+    int* out_tokens,
+    int max_tokens,
+    const DecodeOptions& options,
+    InferenceStats* stats
+) {
+    if (!initialized_) {
+        LOGE("OcrInference not initialized");
+        return 0;
+    }
+    if (hidden_states.size() != encoder_output_size_) {
+        LOGE("Hidden states have %zu values, expected %zu", hidden_states.size(), encoder_output_size_);
+        return 0;
+    }
+
+    InferenceStats local_stats;
+    InferenceStats& run_stats = stats ? *stats : local_stats;
+    run_stats = {};
+
+    try {
+        WorkPool::InferenceScope inference_scope(WorkPool::Shared(), cpu_threads_);
+        std::copy(hidden_states.begin(), hidden_states.end(), litert_->encoder_hidden_states.begin());
+        hidden_states_valid_ = true;
+        active_resolution_ = -1;
+        active_exit_ = -1;
+        ResetDecoderState();
+        return Decode(out_tokens, max_tokens, options, run_stats);
+    } catch (const std::exception& e) {
+        LOGE("Exception during decoding: %s", e.what());
+        return 0;
+    }
+}
+
+bool OcrInference::CopyHiddenStates(std::vector<float>& out) const {
+    if (!hidden_states_valid_ || !litert_) {
+        return false;
+    }
+    out.assign(litert_->encoder_hidden_states.begin(), litert_->encoder_hidden_states.end());
+    return true;
+}
+
+int OcrInference::Decode(int* out_tokens, int max_tokens, const DecodeOptions& options, InferenceStats& stats) {
+    ScopedAllocPhase decoder_phase(AllocPhase::kDecoder);
+    if (options.IsCancelled()) {
+        stats.cancelled = true;
+        LOGI("Request cancelled before decoding");
+        return 0;
+    }
+
+    // The CTC head, in-graph decoder and length predictor only take the base encoder's
+    // full-depth hidden states
+    const bool base_encoder = active_resolution_ < 0 && active_exit_ < 0;
+    predicted_tokens_ = base_encoder ? PredictTokenCount() : 0;
+    stats.predicted_tokens = predicted_tokens_;
+    if (options.complete_only && predicted_tokens_ > 1) {
+        // Every token after the start one takes a decoder run per live beam
+        const int beams = options.strategy == DecodingStrategy::kBeam ? std::max(options.beam_width, 1) : 1;
+        if (ShouldStop(options, (predicted_tokens_ - 1) * beams, stats)) {
+            LOGW("Predicted %d tokens cannot be decoded by the deadline; rejecting", predicted_tokens_);
+            return 0;
+        }
+    }
+    if (base_encoder && options.ctc_mode != CtcMode::kOff && HasCtcHead() &&
+        (options.ctc_mode == CtcMode::kAlways || IsSingleLineCrop(options.source_width, options.source_height))) {
+        float confidence = 0.0f;
+        const int ctc_count = DecodeCtc(out_tokens, max_tokens, options, &confidence, stats);
+        if (ctc_count > 1 &&
+            (options.ctc_mode == CtcMode::kAlways || confidence >= options.ctc_min_confidence)) {
+            stats.used_ctc = true;
+            LOGI("[PERF] Total inference runtime: %lld ms (CTC)", stats.encoder_ms + stats.decoder_ms);
+            return ctc_count;
+        }
+    }
+
+    int token_count = 0;
+    // A single in-graph run cannot stop at a deadline, so deadline requests use the host loop
+    const bool greedy_output = options.strategy != DecodingStrategy::kBeam;
+    if (base_encoder && greedy_output && HasInGraphDecoder() && !options.HasDeadline()) {
+        token_count = DecodeInGraph(out_tokens, max_tokens, stats);
+        if (token_count > 0) {
+            LOGI("[PERF] In-graph decoder runtime: %lld ms (%s)", stats.decoder_ms,
+                 litert_->decoder_using_gpu ? "GPU" : "CPU");
+            LOGI("[PERF] Total inference runtime: %lld ms", stats.encoder_ms + stats.decoder_ms);
+            return token_count;
+        }
+        LOGW("In-graph decoding failed, falling back to the host loop");
+    }
+
+    switch (options.strategy) {
+        case DecodingStrategy::kBeam:
+            token_count = DecodeBeam(out_tokens, max_tokens, options, stats);
+            break;
+        case DecodingStrategy::kSpeculative:
+            token_count = DecodeGreedy(out_tokens, max_tokens, options, options.draft_length, stats);
+            break;
+        case DecodingStrategy::kGreedy:
+            token_count = DecodeGreedy(out_tokens, max_tokens, options, 0, stats);
+            break;
+    }
+
+    if (stats.cancelled) {
+        LOGI("Request cancelled after %d decoder steps", stats.decoder_runs);
+        return 0;
+    }
+    if (stats.partial) {
+        LOGW("Deadline reached after %d decoder steps, returning %d tokens", stats.decoder_runs, token_count);
+    }
+
+    LOGI("[PERF] Decoder runtime: %lld ms across %d steps (%s)",
+         stats.decoder_ms, stats.decoder_runs,
+         litert_->decoder_using_gpu ? "GPU" : "CPU");
+    if (predicted_tokens_ > 0) {
+        LOGI("[PERF] Predicted %d tokens, decoded %d", predicted_tokens_, token_count);
+    }
+
+    const long long total_inference_ms = stats.encoder_ms + stats.decoder_ms;
+    LOGI("[PERF] Total inference runtime: %lld ms", total_inference_ms);
+
+    return token_count;
 }
 
 void OcrInference::Close() {
     const auto close_start = std::chrono::steady_clock::now();
 
     if (litert_) {
+        litert_->pruned_encoders.clear();
+        litert_->resolution_variants.clear();
+        // The tail input aliases the last segment output, so it goes first
+        litert_->exit_tail_input_buffers.clear();
+        litert_->exit_tail_output_buffers.clear();
+        litert_->compiled_exit_tail.reset();
+        litert_->encoder_exits.clear();
+        litert_->decoder_buckets.clear();
+        litert_->ctc_input_buffers.clear();
+        litert_->ctc_output_buffers.clear();
+        litert_->compiled_ctc_head.reset();
+        litert_->decoder_loop_input_buffers.clear();
+        litert_->decoder_loop_output_buffers.clear();
+        litert_->compiled_decoder_loop.reset();
+        // Step inputs alias the prefill outputs, so they go first
+        litert_->cross_kv_step_input_buffers.clear();
+        litert_->cross_kv_step_output_buffers.clear();
+        litert_->cross_kv_prefill_input_buffers.clear();
+        litert_->cross_kv_prefill_output_buffers.clear();
+        litert_->compiled_cross_kv.reset();
         litert_->encoder_input_buffers.clear();
         litert_->encoder_output_buffers.clear();
         litert_->decoder_input_buffers.clear();
@@ -754,10 +2761,54 @@ void OcrInference::Close() {
         AAsset_close(embeddings_asset_);
         embeddings_asset_ = nullptr;
     }
+    for (AAsset* asset : encoder_pruned_assets_) {
+        AAsset_close(asset);
+    }
+    encoder_pruned_assets_.clear();
+    for (const ResolutionAssets& assets : resolution_assets_) {
+        AAsset_close(assets.encoder);
+        AAsset_close(assets.decoder);
+    }
+    resolution_assets_.clear();
+    for (const EncoderExitAssets& assets : encoder_exit_assets_) {
+        AAsset_close(assets.segment);
+        AAsset_close(assets.decoder);
+    }
+    encoder_exit_assets_.clear();
+    if (encoder_exit_tail_asset_) {
+        AAsset_close(encoder_exit_tail_asset_);
+        encoder_exit_tail_asset_ = nullptr;
+    }
+    for (AAsset* asset : decoder_bucket_assets_) {
+        AAsset_close(asset);
+    }
+    decoder_bucket_assets_.clear();
+    if (ctc_head_asset_) {
+        AAsset_close(ctc_head_asset_);
+        ctc_head_asset_ = nullptr;
+    }
+    if (decoder_loop_asset_) {
+        AAsset_close(decoder_loop_asset_);
+        decoder_loop_asset_ = nullptr;
+    }
+    if (decoder_cross_kv_asset_) {
+        AAsset_close(decoder_cross_kv_asset_);
+        decoder_cross_kv_asset_ = nullptr;
+    }
+    if (length_predictor_asset_) {
+        AAsset_close(length_predictor_asset_);
+        length_predictor_asset_ = nullptr;
+    }
+    length_predictor_ = nullptr;
 
     // Clear and release memory back to OS
     attention_mask_.clear();
     attention_mask_.shrink_to_fit();
+    patch_grid_ = 0;
+    cpu_threads_ = 0;
+    active_resolution_ = -1;
+    active_exit_ = -1;
+    predicted_tokens_ = 0;
 
     if (initialized_) {
         initialized_ = false;
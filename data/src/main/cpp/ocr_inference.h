@@ -4,11 +4,151 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#ifdef __ANDROID__
 #include <android/asset_manager.h>
+#else
+#include "host_asset.h"
+#endif
+#include "image_preprocessor.h"
+#include "memory_accounting.h"
 
 namespace mihon {
 
+enum class ModelPrecision {
+    kFp16,
+    kFp32,
+};
+
+enum class DecodingStrategy {
+    kGreedy,
+    // Greedy-equivalent output; drafts tokens by prompt lookup and verifies them in one decoder run
+    kSpeculative,
+    kBeam,
+};
+
+enum class CtcMode {
+    kOff,
+    // Use the CTC head for single-line crops when its confidence clears the threshold
+    kAuto,
+    kAlways,
+};
+
+// Encoder compiled at a lower input resolution, with a decoder over its shorter hidden states
+struct ResolutionAssets {
+    AAsset* encoder = nullptr;
+    AAsset* decoder = nullptr;
+};
+
+// Early exit of the encoder after `layer` layers
+struct EncoderExitAssets {
+    int layer = 0;
+    // Layers since the previous exit, taking its hidden states (the image for the first exit);
+    // outputs the hidden states at `layer` and a scalar exit confidence
+    AAsset* segment = nullptr;
+    // Decoder over the hidden states at `layer`
+    AAsset* decoder = nullptr;
+};
+
+// Model assets for one engine; OcrInference takes ownership of every non-null asset
+struct ModelAssets {
+    AAsset* encoder = nullptr;
+    AAsset* decoder = nullptr;
+    AAsset* embeddings = nullptr;
+    // Optional encoders over a fixed number of kept patches: they take the image and the int32
+    // row-major indices of the patches to keep (-1 padded), and output the full encoder's shape
+    std::vector<AAsset*> encoder_pruned;
+    // Optional encoder and decoder pairs below the base input size, which is found from the
+    // encoder input; these requests skip the CTC head, in-graph and cross-KV decoders and buckets
+    std::vector<ResolutionAssets> resolutions;
+    // Optional early-exit encoder, used with DecodeOptions::exit_min_confidence: the exit
+    // segments and a tail running the remaining layers for the base decoder. Requests that exit
+    // early skip the CTC head, in-graph and cross-KV decoders and buckets.
+    std::vector<EncoderExitAssets> encoder_exits;
+    AAsset* encoder_exit_tail = nullptr;
+    // Optional decoders compiled at shorter sequence lengths
+    std::vector<AAsset*> decoder_buckets;
+    // Optional non-autoregressive CTC head over the encoder hidden states
+    AAsset* ctc_head = nullptr;
+    // Optional decoder running the whole greedy loop in-graph; outputs int32 token ids
+    AAsset* decoder_loop = nullptr;
+    // Optional decoder with a cross-KV prefill signature (0), projecting the hidden states into
+    // every layer's cross-attention keys and values, and a step signature (1) taking them
+    AAsset* decoder_cross_kv = nullptr;
+    // Optional linear regressor of the token count InferTokens returns over the mean-pooled
+    // hidden states: HIDDEN_SIZE float32 weights, then the bias
+    AAsset* length_predictor = nullptr;
+};
+
+// Compile-time settings; engines with equal options and assets can be shared
+struct EngineOptions {
+    ModelPrecision precision = ModelPrecision::kFp16; // GPU only
+    int num_threads = 0; // CPU only, 0 selects GetOptimalThreadCount()
+};
+
+// Per-request decoding settings
+struct DecodeOptions {
+    DecodingStrategy strategy = DecodingStrategy::kGreedy;
+    int beam_width = 1;
+    int draft_length = 0;
+    CtcMode ctc_mode = CtcMode::kOff;
+    int ctc_beam_width = 1; // 1 selects greedy CTC decoding
+    float ctc_min_confidence = 0.9f;
+    // Exit confidence that stops the early-exit encoder at a layer, 0 to always run full depth
+    float exit_min_confidence = 0.0f;
+
+    // Per request: crop size before scaling to the model input, 0 when unknown
+    int source_width = 0;
+    int source_height = 0;
+
+    // Per request: side of the square image passed to InferTokens, 0 for InputSize().
+    // Smaller sizes are the ones SelectInputSize returns.
+    int input_size = 0;
+
+    // Per request, optional: polled between model runs, the request is abandoned once
+    // `*cancel_generation` no longer equals `generation`
+    const std::atomic<uint64_t>* cancel_generation = nullptr;
+    uint64_t generation = 0;
+
+    bool IsCancelled() const noexcept {
+        return cancel_generation && cancel_generation->load(std::memory_order_relaxed) != generation;
+    }
+
+    // Per request, optional: decoding stops before a step that would end past the deadline and
+    // returns the tokens produced so far
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+
+    bool HasDeadline() const noexcept { return deadline != std::chrono::steady_clock::time_point::max(); }
+
+    // Per request, with a deadline: returns no tokens, without decoding, when the predicted
+    // output length cannot finish by the deadline, instead of decoding a prefix
+    bool complete_only = false;
+
+    // Per request, optional: patch mask of the image for PatchGrid(); the smallest pruned
+    // encoder holding every kept patch runs instead of the full one
+    const PatchMask* patch_mask = nullptr;
+};
+
+// Timings of a single InferTokens call
+struct InferenceStats {
+    long long encoder_ms = 0;
+    long long decoder_ms = 0;
+    int decoder_runs = 0;
+    bool used_ctc = false;
+    // Abandoned through DecodeOptions::cancel_generation; no tokens are returned
+    bool cancelled = false;
+    // Stopped at DecodeOptions::deadline; the tokens are a prefix of the full output
+    bool partial = false;
+    // Patch budget of the pruned encoder that ran, 0 for the full encoder
+    int encoder_patches = 0;
+    // Layer the encoder exited at, 0 for full depth
+    int exit_layer = 0;
+    // Token count predicted before decoding, 0 without a length predictor
+    int predicted_tokens = 0;
+};
+
 class OcrInference {
 public:
     OcrInference();
@@ -17,17 +157,39 @@ public:
     // Initialize with model data from memory buffers
     // Returns true on success, false on failure
     bool Initialize(
-        AAsset* encoder_asset,
-        AAsset* decoder_asset,
-        AAsset* embeddings_asset,
+        const ModelAssets& assets,
+        const EngineOptions& options,
         const char* cache_dir,
         const char* native_lib_dir
     );
 
+    // Deletes packed-weight cache files in the cache directory that no compile has used for a
+    // month, such as those of models no longer shipped
+    static void PruneWeightCache();
+
     // Main inference method
-    // Takes preprocessed image data (224x224x3 float array)
+    // Takes preprocessed 224x224 image data in the layout reported by InputFormat()
     // Returns the number of tokens generated, fills outTokens array
-    int InferTokens(const float* image_data, int* out_tokens, int max_tokens);
+    int InferTokens(
+        const void* image_data,
+        int* out_tokens,
+        int max_tokens,
+        const DecodeOptions& options = {},
+        InferenceStats* stats = nullptr
+    );
+
+    // Like InferTokens, but decodes `hidden_states` saved by CopyHiddenStates instead of running the encoder
+    int DecodeTokens(
+        const std::vector<float>& hidden_states,
+        int* out_tokens,
+        int max_tokens,
+        const DecodeOptions& options = {},
+        InferenceStats* stats = nullptr
+    );
+
+    // Copies the encoder output of the last InferTokens call, even a cancelled one.
+    // Returns false if the encoder did not finish.
+    bool CopyHiddenStates(std::vector<float>& out) const;
 
     // Cleanup resources
     void Close();
@@ -37,6 +199,23 @@ public:
     // Per-model GPU status checks
     bool IsEncoderUsingGpu() const;
     bool IsDecoderUsingGpu() const;
+    bool HasCtcHead() const;
+    bool HasInGraphDecoder() const;
+    bool HasEarlyExits() const;
+
+    // Encoder input layout, detected from the encoder's input tensor
+    ImageInputFormat InputFormat() const { return input_format_; }
+    int InputSize() const { return IMAGE_SIZE; }
+
+    // Patch grid side that DecodeOptions::patch_mask is computed for, 0 without pruned encoders
+    int PatchGrid() const { return patch_grid_; }
+
+    // Smallest loaded input size that keeps the detail of a `source_width` x `source_height`
+    // crop and gives each character of a single line enough pixels; InputSize() by default
+    int SelectInputSize(int source_width, int source_height) const;
+
+    // Adds this engine's mapped models, tensor buffers and host buffers to `usage`
+    void AccountMemory(MemoryUsage& usage) const;
 
 private:
     // Model constants
@@ -47,6 +226,10 @@ private:
     static constexpr int START_TOKEN_ID = 2;
     static constexpr int END_TOKEN_ID = 3;
     static constexpr int PAD_TOKEN_ID = 0;
+    static constexpr int MAX_BEAM_WIDTH = 8;
+    // Signatures of the split cross-KV decoder
+    static constexpr size_t CROSS_KV_PREFILL_SIGNATURE = 0;
+    static constexpr size_t CROSS_KV_STEP_SIGNATURE = 1;
 
     // Opaque pointers to LiteRT objects (forward declared to avoid exposing LiteRT headers)
     struct LiteRtObjects;
@@ -54,6 +237,18 @@ private:
 
     AAsset* encoder_asset_ = nullptr;
     AAsset* decoder_asset_ = nullptr;
+    std::vector<AAsset*> encoder_pruned_assets_;
+    std::vector<ResolutionAssets> resolution_assets_;
+    std::vector<EncoderExitAssets> encoder_exit_assets_;
+    AAsset* encoder_exit_tail_asset_ = nullptr;
+    std::vector<AAsset*> decoder_bucket_assets_;
+    AAsset* ctc_head_asset_ = nullptr;
+    AAsset* decoder_loop_asset_ = nullptr;
+    AAsset* decoder_cross_kv_asset_ = nullptr;
+    AAsset* length_predictor_asset_ = nullptr;
+    // Weights in length_predictor_asset_, null when it is missing or malformed
+    const float* length_predictor_ = nullptr;
+    EngineOptions options_;
     // Embeddings and working memory
     AAsset* embeddings_asset_ = nullptr;
     const float* embeddings_data_ = nullptr;
@@ -62,19 +257,80 @@ private:
     std::vector<float> attention_mask_;
 
     bool initialized_ = false;
+    // Whether litert_->encoder_hidden_states holds the output of the last encoder run
+    bool hidden_states_valid_ = false;
+    // Running averages of an encoder run and a decoder run, for deadline checks
+    double encoder_estimate_us_ = 0.0;
+    double step_estimate_us_ = 0.0;
+    ImageInputFormat input_format_ = ImageInputFormat::kFloat32Rgb;
+    int patch_grid_ = 0;
+    // Threads CPU inference holds on the shared work pool while models run, 0 when both
+    // models run on the GPU
+    int cpu_threads_ = 0;
+    // Index into the resolution variants of the last encoder run, -1 for the base models
+    int active_resolution_ = -1;
+    // Index into the early exits of the last encoder run, -1 when it ran to full depth
+    int active_exit_ = -1;
+    // Predicted token count of the request being decoded, 0 when unknown
+    int predicted_tokens_ = 0;
 
     // Helper methods
     void UpdateEmbedding(int token_id, int index) noexcept;
     int FindMaxLogitToken(int seq_len) const noexcept;
+    int ToVocabId(int output_id) const noexcept {
+        return output_vocab_ids_.empty() ? output_id : output_vocab_ids_[output_id];
+    }
     bool TryCompileWithGpu(const uint8_t* encoder_data, size_t encoder_size, const uint8_t* decoder_data, size_t decoder_size);
     bool TryCompileWithCpu(const uint8_t* encoder_data, size_t encoder_size, const uint8_t* decoder_data, size_t decoder_size);
+    void CompilePrunedEncoders();
+    void CompileResolutions();
+    void CompileEncoderExits();
+    void CompileDecoderBuckets();
+    void CompileCtcHead();
+    void CompileDecoderLoop();
+    void CompileCrossKvDecoder();
     bool PerformWarmup();
     bool CreateBuffers();
+    bool WriteEncoderInput(const void* image_data);
+    // Index of the smallest pruned encoder holding the patches `mask` keeps, with their indices
+    // staged for it, or -1 to run the full encoder
+    int SelectPrunedEncoder(const PatchMask* mask);
+    // Runs the exit segments until one is confident enough, or the tail after the last, and
+    // reads the hidden states; sets active_exit_
+    bool RunEncoderExits(const void* image_data, float min_confidence, InferenceStats& stats);
     static int GetOptimalThreadCount() noexcept;
+    // Runs the length predictor over litert_->encoder_hidden_states; 0 without one
+    int PredictTokenCount() const noexcept;
+
+    // Decoding helpers; LaunchDecoder picks the smallest bucket covering `length` positions,
+    // or the predicted token count when larger, and starts it asynchronously when supported,
+    // FinishDecoder waits and reads the logits
+    bool LaunchDecoder(int length);
+    bool PrefillCrossKv();
+    bool FinishDecoder(InferenceStats& stats);
+    bool RunDecoder(int length, InferenceStats& stats);
+    void ResetDecoderState() noexcept;
+    int DecodeGreedy(int* out_tokens, int max_tokens, const DecodeOptions& options, int draft_length, InferenceStats& stats);
+    int DecodeBeam(int* out_tokens, int max_tokens, const DecodeOptions& options, InferenceStats& stats);
+    static int ProposeDraft(const int* tokens, int token_count, int max_draft, int* draft) noexcept;
+    int DecodeCtc(int* out_tokens, int max_tokens, const DecodeOptions& options, float* confidence, InferenceStats& stats);
+    static bool IsSingleLineCrop(int width, int height) noexcept;
+    int DecodeInGraph(int* out_tokens, int max_tokens, InferenceStats& stats);
+    // Decodes litert_->encoder_hidden_states with the strategy `options` selects
+    int Decode(int* out_tokens, int max_tokens, const DecodeOptions& options, InferenceStats& stats);
+    // Whether to stop before the next `runs` decoder runs: the request was cancelled, or they
+    // would not finish by its deadline. Sets the matching stats flag.
+    bool ShouldStop(const DecodeOptions& options, int runs, InferenceStats& stats) const noexcept;
+    static void UpdateEstimate(double& estimate_us, long long elapsed_us) noexcept;
 
     // Cached sizes from actual model outputs (determined during buffer creation)
     size_t encoder_output_size_ = 0;
     size_t decoder_output_size_ = 0;
+
+    // Width of the decoder logits rows; smaller than VOCAB_SIZE for compact output heads,
+    // whose ids are mapped back to vocab ids through output_vocab_ids_
+    int output_vocab_size_ = VOCAB_SIZE;
+    std::vector<int> output_vocab_ids_;
 };
 
 } // namespace mihon
@@ -8,35 +8,150 @@
 #include <memory>
 #include <atomic>
 #include <mutex>
+#include <algorithm>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <cerrno>
+#include <sys/resource.h>
+#include <unistd.h>
 #include "text_postprocessor.h"
 #include "vocab_data.h"
 #include "ocr_inference.h"
+#include "ocr_profile.h"
+#include "request_capture.h"
+#include "alloc_tracker.h"
+#include "request_arena.h"
+#include "shared_image_ring.h"
+#include "encoded_image_decoder.h"
+#include "selection_speculation.h"
+#include "page_pyramid_cache.h"
+#include "frame_tracker.h"
 
 #define LOG_TAG "MihonOCR_Native"
 #define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
 
 static std::mutex g_inferenceMutex;
 
 // Constants matching Kotlin implementation
 static constexpr int IMAGE_SIZE = 224;
-static constexpr float NORMALIZATION_FACTOR = 1.0f / (255.0f * 0.5f);
-static constexpr float NORMALIZED_MEAN = 0.5f / 0.5f;
 static constexpr int SPECIAL_TOKEN_THRESHOLD = 5;
 static constexpr int MAX_SEQUENCE_LENGTH = 300;
+static constexpr size_t REQUEST_ARENA_HEADROOM = 64 * 1024;
+// Nice value for speculative requests, so they yield the CPU to the UI and to final requests
+static constexpr int SPECULATIVE_THREAD_NICE = 10;
 
 // Global instances
 static std::unique_ptr<mihon::TextPostprocessor> g_textPostprocessor;
 static std::vector<std::string> g_vocab;
-static std::unique_ptr<mihon::OcrInference> g_ocrInference;
 static std::mutex g_initMutex;
 static std::atomic<int> g_activeOcrClients{0};
 
+// Profiles resolving to the same models and engine options share one compiled engine
+struct EngineSlot {
+    std::string key;
+    std::unique_ptr<mihon::OcrInference> engine;
+    // Engine use order, for evicting the least recently used engine
+    uint64_t last_used = 0;
+};
+static std::vector<EngineSlot> g_engines;
+static mihon::OcrInference* g_profileEngines[mihon::kOcrProfileCount] = {};
+static mihon::ProfileStats g_profileStats[mihon::kOcrProfileCount];
+static std::atomic<int> g_sessionProfile{static_cast<int>(mihon::kDefaultOcrProfile)};
+static uint64_t g_engineUseCounter = 0;
+
+// Resident native memory allowed for OCR in bytes, 0 for no limit. Engines other than the
+// session engine are evicted, or not created, to stay within it.
+static std::atomic<int64_t> g_memoryBudget{0};
+
+// Kept for lazily creating engines of other profiles after init
+static jobject g_assetManagerRef = nullptr;
+static std::string g_cacheDir;
+static std::string g_nativeLibDir;
+
 // Pre-allocated buffers for inference (avoid allocation per call)
-static std::vector<float> g_imageBuffer;
+// Sized for the widest encoder input format (float32 RGB)
+static std::vector<uint8_t> g_imageBuffer;
+// Side of the image in g_imageBuffer and its patch mask, consumed by the request that runs it
+static int g_imageSize = IMAGE_SIZE;
+static mihon::PatchMask g_patchMask;
+// Model-sized pixels scaled down to a lower input size
+static std::vector<uint8_t> g_scaledPixels;
 static std::vector<int> g_tokenBuffer;
+// Scratch for one request or region batch, reset afterwards; guarded by g_inferenceMutex
+static std::unique_ptr<mihon::RequestArena> g_requestArena;
+static size_t g_maxTokenBytes = 0;
+
+// Regions decoded from encoded images; keeps its capacity across requests, guarded by g_inferenceMutex
+static std::vector<uint8_t> g_encodedRegionPixels;
+
+// Encoder inputs of consecutive bitmap regions, preprocessed together; keeps its capacity
+// across requests, guarded by g_inferenceMutex
+static constexpr size_t REGION_BATCH_SIZE = 8;
+static std::vector<uint8_t> g_regionBatchInput;
+// Patch masks and preprocessing scratch of the regions in g_regionBatchInput
+static std::vector<mihon::PatchMask> g_regionBatchMasks;
+static mihon::RegionBatchScratch g_regionBatchScratch;
+
+// Reductions of recently recognized pages, keyed by bitmap generation; guarded by g_inferenceMutex
+static mihon::PagePyramidCache g_pagePyramids;
+// A page's pyramid is built once regions that downscale at least 2x read this many times its area;
+// a cached pyramid is used regardless
+static constexpr float PYRAMID_MIN_PAGE_COVERAGE = 1.0f;
+
+// Regions and block hashes of the latest frame stream; guarded by g_inferenceMutex
+static mihon::FrameTracker g_frameTracker;
+// Values nativeRecognizeFrame reports besides the texts: scroll in pixels, regions recognized
+static constexpr int FRAME_STATS_FIELD_COUNT = 2;
+
+// Opt-in request capture; guarded by g_inferenceMutex
+static mihon::CaptureWriter g_capture;
+
+// Speculative recognition of in-progress selections; its cached result is guarded by g_inferenceMutex
+static mihon::SelectionSpeculation g_selectionSpeculation;
+
+// Replay results per captured request: latency from scheduled arrival, recorded latency, tokens matched
+static constexpr int REPLAY_FIELD_COUNT = 3;
+
+// Preprocesses square ARGB_8888 `pixels` of side `size` into g_imageBuffer at the input size
+// `engine` picks for a `source_width` x `source_height` crop, scaling them down when it is
+// smaller, and computes g_patchMask for full-size inputs.
+// Caller must hold g_inferenceMutex.
+static void PrepareInput(
+    const mihon::OcrInference* engine,
+    const uint8_t* pixels,
+    size_t stride,
+    int size,
+    int source_width,
+    int source_height) {
+    const int input_size = engine->SelectInputSize(source_width, source_height);
+    if (input_size != size) {
+        g_scaledPixels.resize(static_cast<size_t>(input_size) * input_size * 4);
+        mihon::ResizeRegion(pixels, stride, 0, 0, size, size, g_scaledPixels.data(), input_size, input_size);
+        pixels = g_scaledPixels.data();
+        stride = static_cast<size_t>(input_size) * 4;
+    }
+    mihon::PreprocessPixels(pixels, input_size, input_size, stride, engine->InputFormat(), g_imageBuffer.data());
+    g_imageSize = input_size;
+
+    g_patchMask.grid = input_size == IMAGE_SIZE ? engine->PatchGrid() : 0;
+    g_patchMask.keep.clear();
+    if (g_patchMask.grid > 0) {
+        mihon::ComputePatchMask(pixels, input_size, input_size, stride, g_patchMask);
+    }
+}
 
-static void PreprocessBitmap(JNIEnv* env, jobject bitmap, float* output) {
+// Preprocesses into g_imageBuffer for `engine` through PrepareInput.
+// `captured_pixels`, when set, receives the tightly packed source pixels
+static void PreprocessBitmap(
+    JNIEnv* env,
+    jobject bitmap,
+    const mihon::OcrInference* engine,
+    int source_width,
+    int source_height,
+    std::vector<uint8_t>* captured_pixels = nullptr) {
     AndroidBitmapInfo info;
     void* pixels;
 
@@ -51,18 +166,17 @@ static void PreprocessBitmap(JNIEnv* env, jobject bitmap, float* output) {
     }
 
     try {
-        auto* srcPixels = static_cast<uint32_t*>(pixels);
-        int outIndex = 0;
+        PrepareInput(engine, static_cast<const uint8_t*>(pixels), info.stride, IMAGE_SIZE,
+                     source_width, source_height);
 
-        for (int i = 0; i < IMAGE_SIZE * IMAGE_SIZE; i++) {
-            uint32_t pixel = srcPixels[i];
-            int r = (pixel >> 16) & 0xFF;
-            int g = (pixel >> 8) & 0xFF;
-            int b = pixel & 0xFF;
-
-            output[outIndex++] = r * NORMALIZATION_FACTOR - NORMALIZED_MEAN;
-            output[outIndex++] = g * NORMALIZATION_FACTOR - NORMALIZED_MEAN;
-            output[outIndex++] = b * NORMALIZATION_FACTOR - NORMALIZED_MEAN;
+        if (captured_pixels) {
+            const size_t row_bytes = static_cast<size_t>(IMAGE_SIZE) * 4;
+            captured_pixels->resize(row_bytes * IMAGE_SIZE);
+            for (int y = 0; y < IMAGE_SIZE; ++y) {
+                std::memcpy(captured_pixels->data() + y * row_bytes,
+                            static_cast<const uint8_t*>(pixels) + static_cast<size_t>(y) * info.stride,
+                            row_bytes);
+            }
         }
 
     } catch (const std::exception& e) {
@@ -72,6 +186,646 @@ static void PreprocessBitmap(JNIEnv* env, jobject bitmap, float* output) {
     AndroidBitmap_unlockPixels(env, bitmap);
 }
 
+// Runs the calling thread at `nice` for its lifetime
+class ScopedThreadNice {
+public:
+    explicit ScopedThreadNice(int nice) {
+        errno = 0;
+        previous_ = getpriority(PRIO_PROCESS, 0);
+        applied_ = errno == 0 && setpriority(PRIO_PROCESS, 0, nice) == 0;
+        if (!applied_) {
+            LOGW("Failed to lower thread priority: %s", strerror(errno));
+        }
+    }
+    ~ScopedThreadNice() {
+        if (applied_) {
+            setpriority(PRIO_PROCESS, 0, previous_);
+        }
+    }
+    ScopedThreadNice(const ScopedThreadNice&) = delete;
+    ScopedThreadNice& operator=(const ScopedThreadNice&) = delete;
+
+private:
+    int previous_ = 0;
+    bool applied_ = false;
+};
+
+// Converts a System.nanoTime() deadline; both it and steady_clock read CLOCK_MONOTONIC, so the
+// value also holds across processes. 0 means no deadline.
+static std::chrono::steady_clock::time_point DeadlineFromNanos(jlong nanos) {
+    if (nanos <= 0) {
+        return std::chrono::steady_clock::time_point::max();
+    }
+    return std::chrono::steady_clock::time_point(
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(nanos)));
+}
+
+// Stores whether the request stopped at its deadline into `partial[0]`, when given
+static void ReportPartial(JNIEnv* env, jbooleanArray partial, bool value) {
+    if (partial && env->GetArrayLength(partial) > 0) {
+        const jboolean flag = value ? JNI_TRUE : JNI_FALSE;
+        env->SetBooleanArrayRegion(partial, 0, 1, &flag);
+    }
+}
+
+static mihon::OcrProfile SessionProfile() {
+    return mihon::ProfileFromInt(g_sessionProfile.load(), mihon::kDefaultOcrProfile);
+}
+
+// Uses the profile's variant directory if it is bundled, otherwise the base models
+static std::string ResolveModelDir(AAssetManager* mgr, const mihon::ProfileConfig& config) {
+    if (config.model_variant[0] != '\0') {
+        std::string dir = std::string("ocr/") + config.model_variant;
+        AAsset* probe = AAssetManager_open(mgr, (dir + "/encoder.tflite").c_str(), AASSET_MODE_UNKNOWN);
+        if (probe) {
+            AAsset_close(probe);
+            return dir;
+        }
+        LOGI("Model variant '%s' is not bundled, using base models", config.model_variant);
+    }
+    return "ocr";
+}
+
+static std::string EngineKey(const std::string& model_dir, const mihon::ProfileConfig& config) {
+    std::string key = model_dir;
+    key += config.engine.precision == mihon::ModelPrecision::kFp32 ? "|fp32" : "|fp16";
+    key += "|t" + std::to_string(config.engine.num_threads);
+    for (int length : config.decoder_buckets) {
+        if (length > 0) {
+            key += "|" + std::to_string(length);
+        }
+    }
+    for (int budget : config.encoder_patch_budgets) {
+        if (budget > 0) {
+            key += "|p" + std::to_string(budget);
+        }
+    }
+    for (int size : config.input_sizes) {
+        if (size > 0) {
+            key += "|" + std::to_string(size) + "px";
+        }
+    }
+    for (int layer : config.exit_layers) {
+        if (layer > 0) {
+            key += "|e" + std::to_string(layer);
+        }
+    }
+    return key;
+}
+
+static bool OpenModelAssets(
+    AAssetManager* mgr,
+    const std::string& model_dir,
+    const mihon::ProfileConfig& config,
+    mihon::ModelAssets& assets) {
+
+    // Zero-copy asset loading
+    assets.encoder = AAssetManager_open(mgr, (model_dir + "/encoder.tflite").c_str(), AASSET_MODE_BUFFER);
+    assets.decoder = AAssetManager_open(mgr, (model_dir + "/decoder.tflite").c_str(), AASSET_MODE_BUFFER);
+    assets.embeddings = AAssetManager_open(mgr, (model_dir + "/embeddings.bin").c_str(), AASSET_MODE_BUFFER);
+    if (!assets.embeddings) {
+        assets.embeddings = AAssetManager_open(mgr, "ocr/embeddings.bin", AASSET_MODE_BUFFER);
+    }
+
+    if (!assets.encoder || !assets.decoder || !assets.embeddings) {
+        LOGE("Failed to open assets in %s", model_dir.c_str());
+        if (assets.encoder) AAsset_close(assets.encoder);
+        if (assets.decoder) AAsset_close(assets.decoder);
+        if (assets.embeddings) AAsset_close(assets.embeddings);
+        assets = {};
+        return false;
+    }
+
+    for (int budget : config.encoder_patch_budgets) {
+        if (budget <= 0) {
+            continue;
+        }
+        const std::string path = model_dir + "/encoder_pruned_" + std::to_string(budget) + ".tflite";
+        if (AAsset* pruned = AAssetManager_open(mgr, path.c_str(), AASSET_MODE_BUFFER)) {
+            assets.encoder_pruned.push_back(pruned);
+        }
+    }
+    for (int size : config.input_sizes) {
+        if (size <= 0) {
+            continue;
+        }
+        const std::string prefix = model_dir + "/";
+        const std::string suffix = "_" + std::to_string(size) + "px.tflite";
+        mihon::ResolutionAssets resolution;
+        resolution.encoder = AAssetManager_open(mgr, (prefix + "encoder" + suffix).c_str(), AASSET_MODE_BUFFER);
+        resolution.decoder = AAssetManager_open(mgr, (prefix + "decoder" + suffix).c_str(), AASSET_MODE_BUFFER);
+        if (resolution.encoder && resolution.decoder) {
+            assets.resolutions.push_back(resolution);
+        } else {
+            if (resolution.encoder) AAsset_close(resolution.encoder);
+            if (resolution.decoder) AAsset_close(resolution.decoder);
+        }
+    }
+    // Each exit segment continues from the previous one, so they load all together or not at all
+    bool exits_complete = true;
+    for (int layer : config.exit_layers) {
+        if (layer <= 0) {
+            continue;
+        }
+        const std::string suffix = "_exit_" + std::to_string(layer) + ".tflite";
+        mihon::EncoderExitAssets exit;
+        exit.layer = layer;
+        exit.segment = AAssetManager_open(mgr, (model_dir + "/encoder" + suffix).c_str(), AASSET_MODE_BUFFER);
+        exit.decoder = AAssetManager_open(mgr, (model_dir + "/decoder" + suffix).c_str(), AASSET_MODE_BUFFER);
+        exits_complete = exits_complete && exit.segment && exit.decoder;
+        if (exit.segment || exit.decoder) {
+            assets.encoder_exits.push_back(exit);
+        }
+    }
+    if (!assets.encoder_exits.empty()) {
+        assets.encoder_exit_tail =
+            AAssetManager_open(mgr, (model_dir + "/encoder_exit_tail.tflite").c_str(), AASSET_MODE_BUFFER);
+        if (!exits_complete || !assets.encoder_exit_tail) {
+            for (const mihon::EncoderExitAssets& exit : assets.encoder_exits) {
+                if (exit.segment) AAsset_close(exit.segment);
+                if (exit.decoder) AAsset_close(exit.decoder);
+            }
+            if (assets.encoder_exit_tail) AAsset_close(assets.encoder_exit_tail);
+            assets.encoder_exits.clear();
+            assets.encoder_exit_tail = nullptr;
+        }
+    }
+    for (int length : config.decoder_buckets) {
+        if (length <= 0) {
+            continue;
+        }
+        const std::string path = model_dir + "/decoder_" + std::to_string(length) + ".tflite";
+        if (AAsset* bucket = AAssetManager_open(mgr, path.c_str(), AASSET_MODE_BUFFER)) {
+            assets.decoder_buckets.push_back(bucket);
+        }
+    }
+    assets.ctc_head = AAssetManager_open(mgr, (model_dir + "/ctc_head.tflite").c_str(), AASSET_MODE_BUFFER);
+    assets.decoder_loop = AAssetManager_open(mgr, (model_dir + "/decoder_loop.tflite").c_str(), AASSET_MODE_BUFFER);
+    assets.decoder_cross_kv = AAssetManager_open(mgr, (model_dir + "/decoder_cross_kv.tflite").c_str(), AASSET_MODE_BUFFER);
+    assets.length_predictor = AAssetManager_open(mgr, (model_dir + "/length_predictor.bin").c_str(), AASSET_MODE_BUFFER);
+    return true;
+}
+
+static void CloseModelAssets(mihon::ModelAssets& assets) {
+    for (AAsset* asset : {assets.encoder, assets.decoder, assets.embeddings, assets.ctc_head, assets.decoder_loop,
+                          assets.decoder_cross_kv, assets.encoder_exit_tail, assets.length_predictor}) {
+        if (asset) {
+            AAsset_close(asset);
+        }
+    }
+    for (AAsset* asset : assets.encoder_pruned) {
+        AAsset_close(asset);
+    }
+    for (const mihon::ResolutionAssets& resolution : assets.resolutions) {
+        AAsset_close(resolution.encoder);
+        AAsset_close(resolution.decoder);
+    }
+    for (const mihon::EncoderExitAssets& exit : assets.encoder_exits) {
+        AAsset_close(exit.segment);
+        AAsset_close(exit.decoder);
+    }
+    for (AAsset* asset : assets.decoder_buckets) {
+        AAsset_close(asset);
+    }
+    assets = {};
+}
+
+static size_t ModelAssetBytes(const mihon::ModelAssets& assets) {
+    size_t bytes = 0;
+    for (AAsset* asset : {assets.encoder, assets.decoder, assets.embeddings, assets.ctc_head, assets.decoder_loop,
+                          assets.decoder_cross_kv, assets.encoder_exit_tail, assets.length_predictor}) {
+        if (asset) {
+            bytes += AAsset_getLength(asset);
+        }
+    }
+    for (AAsset* asset : assets.encoder_pruned) {
+        bytes += AAsset_getLength(asset);
+    }
+    for (const mihon::ResolutionAssets& resolution : assets.resolutions) {
+        bytes += AAsset_getLength(resolution.encoder) + AAsset_getLength(resolution.decoder);
+    }
+    for (const mihon::EncoderExitAssets& exit : assets.encoder_exits) {
+        bytes += AAsset_getLength(exit.segment) + AAsset_getLength(exit.decoder);
+    }
+    for (AAsset* asset : assets.decoder_buckets) {
+        bytes += AAsset_getLength(asset);
+    }
+    return bytes;
+}
+
+// Caller must hold g_inferenceMutex and g_initMutex.
+static mihon::MemoryUsage CollectMemoryUsage() {
+    mihon::MemoryUsage usage;
+    for (const auto& slot : g_engines) {
+        slot.engine->AccountMemory(usage);
+    }
+
+    usage.AddRegion(mihon::MemoryComponent::kScratch, g_imageBuffer.data(), g_imageBuffer.capacity());
+    usage.AddRegion(mihon::MemoryComponent::kScratch, g_tokenBuffer.data(), g_tokenBuffer.capacity() * sizeof(int));
+    usage.AddRegion(mihon::MemoryComponent::kScratch, g_patchMask.keep.data(), g_patchMask.keep.capacity());
+    usage.AddRegion(mihon::MemoryComponent::kScratch, g_scaledPixels.data(), g_scaledPixels.capacity());
+    usage.AddRegion(mihon::MemoryComponent::kScratch, g_encodedRegionPixels.data(), g_encodedRegionPixels.capacity());
+    usage.AddRegion(mihon::MemoryComponent::kScratch, g_regionBatchInput.data(), g_regionBatchInput.capacity());
+    for (const mihon::PatchMask& mask : g_regionBatchMasks) {
+        usage.AddRegion(mihon::MemoryComponent::kScratch, mask.keep.data(), mask.keep.capacity());
+    }
+    usage.AddRegion(mihon::MemoryComponent::kScratch, g_regionBatchScratch.scaled.data(),
+                    g_regionBatchScratch.scaled.capacity());
+    usage.AddResident(mihon::MemoryComponent::kScratch,
+                      g_regionBatchScratch.Bytes() - g_regionBatchScratch.scaled.capacity());
+    g_selectionSpeculation.AccountMemory(usage);
+    g_pagePyramids.AccountMemory(usage);
+    g_frameTracker.AccountMemory(usage);
+    if (g_requestArena) {
+        usage.AddRegion(mihon::MemoryComponent::kScratch,
+                        g_requestArena->InitialBuffer(), g_requestArena->InitialBytes());
+    }
+    size_t vocab_bytes = g_vocab.capacity() * sizeof(std::string);
+    for (const auto& entry : g_vocab) {
+        vocab_bytes += entry.size();
+    }
+    usage.AddResident(mihon::MemoryComponent::kScratch, vocab_bytes);
+    return usage;
+}
+
+// Drops cached page pyramids, then evicts least recently used engines, never the session engine
+// or `keep` and none unless `evict_engines`, until `extra_bytes` more fit in the memory budget.
+// Returns false if they cannot fit.
+// Caller must hold g_inferenceMutex and g_initMutex.
+static bool FitMemoryBudget(int64_t extra_bytes, const mihon::OcrInference* keep, bool evict_engines = true) {
+    const int64_t budget = g_memoryBudget.load();
+    if (budget <= 0) {
+        return true;
+    }
+
+    const mihon::OcrInference* session_engine = g_profileEngines[static_cast<int>(SessionProfile())];
+    while (true) {
+        const int64_t resident = CollectMemoryUsage().ResidentBytes();
+        if (resident + extra_bytes <= budget) {
+            return true;
+        }
+
+        // Pyramids are rebuilt in milliseconds, engines take a compile
+        if (!g_pagePyramids.Empty()) {
+            LOGI("Dropping page pyramids to stay within the memory budget");
+            g_pagePyramids.Clear();
+            continue;
+        }
+
+        auto victim = g_engines.end();
+        for (auto it = g_engines.begin(); evict_engines && it != g_engines.end(); ++it) {
+            const mihon::OcrInference* engine = it->engine.get();
+            if (engine != session_engine && engine != keep &&
+                (victim == g_engines.end() || it->last_used < victim->last_used)) {
+                victim = it;
+            }
+        }
+        if (victim == g_engines.end()) {
+            LOGW("Memory budget of %lld bytes exceeded (%lld resident, %lld requested)",
+                 static_cast<long long>(budget), static_cast<long long>(resident),
+                 static_cast<long long>(extra_bytes));
+            return false;
+        }
+
+        LOGI("Evicting engine %s to stay within the memory budget", victim->key.c_str());
+        for (auto& profile_engine : g_profileEngines) {
+            if (profile_engine == victim->engine.get()) {
+                profile_engine = nullptr;
+            }
+        }
+        // A cached speculative result may belong to the victim, whose address can be reused
+        g_selectionSpeculation.Clear();
+        victim->engine->Close();
+        g_engines.erase(victim);
+    }
+}
+
+static void TouchEngine(const mihon::OcrInference* engine) {
+    for (auto& slot : g_engines) {
+        if (slot.engine.get() == engine) {
+            slot.last_used = ++g_engineUseCounter;
+            return;
+        }
+    }
+}
+
+// Returns the engine serving a profile, creating it on first use. Engines for profiles
+// other than the session profile are not created if they would exceed the memory budget.
+// Caller must hold g_initMutex.
+static mihon::OcrInference* AcquireProfileEngine(JNIEnv* env, mihon::OcrProfile profile) {
+    const int index = static_cast<int>(profile);
+    if (g_profileEngines[index]) {
+        TouchEngine(g_profileEngines[index]);
+        return g_profileEngines[index];
+    }
+
+    AAssetManager* mgr = g_assetManagerRef ? AAssetManager_fromJava(env, g_assetManagerRef) : nullptr;
+    if (!mgr) {
+        LOGE("Failed to get AAssetManager");
+        return nullptr;
+    }
+
+    const mihon::ProfileConfig& config = mihon::GetProfileConfig(profile);
+    const std::string model_dir = ResolveModelDir(mgr, config);
+    const std::string key = EngineKey(model_dir, config);
+
+    for (const auto& slot : g_engines) {
+        if (slot.key == key) {
+            LOGI("Profile '%s' shares engine %s", config.name, key.c_str());
+            g_profileEngines[index] = slot.engine.get();
+            TouchEngine(g_profileEngines[index]);
+            return g_profileEngines[index];
+        }
+    }
+
+    mihon::ModelAssets assets;
+    if (!OpenModelAssets(mgr, model_dir, config, assets)) {
+        return nullptr;
+    }
+
+    const bool required = profile == SessionProfile();
+    if (!FitMemoryBudget(static_cast<int64_t>(ModelAssetBytes(assets)), nullptr) && !required) {
+        LOGW("Not creating an engine for profile '%s': memory budget exhausted", config.name);
+        CloseModelAssets(assets);
+        return nullptr;
+    }
+
+    // Assets are now owned by OcrInference
+    auto engine = std::make_unique<mihon::OcrInference>();
+    if (!engine->Initialize(assets, config.engine, g_cacheDir.c_str(), g_nativeLibDir.c_str())) {
+        LOGE("Failed to initialize OcrInference for profile '%s'", config.name);
+        return nullptr;
+    }
+
+    LOGI("Profile '%s' engine ready (%s, ACCELERATOR=%s/%s)", config.name, key.c_str(),
+         engine->IsEncoderUsingGpu() ? "GPU" : "CPU",
+         engine->IsDecoderUsingGpu() ? "GPU" : "CPU");
+    g_profileEngines[index] = engine.get();
+    g_engines.push_back({key, std::move(engine), ++g_engineUseCounter});
+
+    // The estimate above only covers the model files; settle the actual footprint
+    FitMemoryBudget(0, g_profileEngines[index]);
+    return g_profileEngines[index];
+}
+
+// Engine for a request's profile, falling back to the session engine.
+// Caller must hold g_inferenceMutex.
+static mihon::OcrInference* AcquireRequestEngine(JNIEnv* env, mihon::OcrProfile request_profile) {
+    std::lock_guard<std::mutex> init_lock(g_initMutex);
+    if (g_activeOcrClients.load() == 0) {
+        return nullptr;
+    }
+    mihon::OcrInference* engine = AcquireProfileEngine(env, request_profile);
+    if (!engine) {
+        LOGW("Profile '%s' unavailable, using the session engine",
+             mihon::GetProfileConfig(request_profile).name);
+        engine = g_profileEngines[static_cast<int>(SessionProfile())];
+    }
+    return engine;
+}
+
+struct RecognitionResult {
+    int token_count = 0;
+    mihon::DecodeOptions decode;
+    mihon::InferenceStats stats;
+    long long total_ms = 0;
+};
+
+// Detokenizes into `raw_text` and postprocesses into `text`; both keep their capacity across calls
+static void DecodeText(const int* tokens, int token_count, std::pmr::string& raw_text, std::pmr::string& text) {
+    mihon::ScopedAllocPhase postprocess_phase(mihon::AllocPhase::kPostprocess);
+    raw_text.clear();
+    raw_text.reserve(static_cast<size_t>(MAX_SEQUENCE_LENGTH) * g_maxTokenBytes);
+
+    const int vocab_size = static_cast<int>(g_vocab.size());
+    for (int i = 0; i < token_count; ++i) {
+        const int tokenId = tokens[i];
+
+        if (tokenId < SPECIAL_TOKEN_THRESHOLD) {
+            continue;
+        }
+
+        if (tokenId < vocab_size) {
+            raw_text += g_vocab[tokenId];
+        }
+    }
+
+    if (g_textPostprocessor) {
+        g_textPostprocessor->postprocess(raw_text, text);
+    } else {
+        text.assign(raw_text);
+    }
+}
+
+// Runs the image preprocessed into g_imageBuffer, or into `image` when given, or decodes
+// `hidden_states` saved from an earlier encoder run when given; `text` is left empty on failure. Past `deadline` it holds
+// the text decoded so far and result.stats.partial is set.
+// Caller must hold g_inferenceMutex.
+static RecognitionResult RunRecognition(
+    mihon::OcrInference* engine,
+    mihon::OcrProfile request_profile,
+    int source_width,
+    int source_height,
+    std::pmr::string& raw_text,
+    std::pmr::string& text,
+    const std::vector<float>* hidden_states = nullptr,
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max(),
+    const void* image = nullptr) {
+
+    RecognitionResult result;
+    result.decode = mihon::GetProfileConfig(request_profile).decode;
+    result.decode.source_width = source_width;
+    result.decode.source_height = source_height;
+    result.decode.deadline = deadline;
+    if (!hidden_states) {
+        result.decode.input_size = g_imageSize;
+        result.decode.patch_mask = g_patchMask.IsComputed() ? &g_patchMask : nullptr;
+    }
+
+    auto t0 = std::chrono::high_resolution_clock::now();
+    if (hidden_states) {
+        result.token_count = engine->DecodeTokens(
+            *hidden_states,
+            g_tokenBuffer.data(),
+            MAX_SEQUENCE_LENGTH,
+            result.decode,
+            &result.stats
+        );
+    } else {
+        result.token_count = engine->InferTokens(
+            image ? image : g_imageBuffer.data(),
+            g_tokenBuffer.data(),
+            MAX_SEQUENCE_LENGTH,
+            result.decode,
+            &result.stats
+        );
+    }
+    g_profileStats[static_cast<int>(request_profile)].Record(result.stats, result.token_count);
+    g_imageSize = IMAGE_SIZE;
+    g_patchMask.keep.clear();
+    result.decode.patch_mask = nullptr;
+    auto t1 = std::chrono::high_resolution_clock::now();
+    result.total_ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
+    LOGI("app.mihonocr.dev: Native inference overall time: %lld ms", result.total_ms);
+
+    text.clear();
+    if (result.token_count <= 0) {
+        if (result.stats.partial) {
+            LOGW("Deadline reached before any tokens were decoded");
+        } else {
+            LOGE("Inference failed or produced no tokens");
+        }
+        return result;
+    }
+    DecodeText(g_tokenBuffer.data(), result.token_count, raw_text, text);
+    return result;
+}
+
+// Scales the `width` x `height` rectangle at (`x`, `y`) of ARGB_8888 `pixels` to the model input
+// through `region_pixels` and recognizes it. `source_width`/`source_height` is the region's size
+// on the page, which differs from `width`/`height` when it was decoded at reduced scale.
+// Caller must hold g_inferenceMutex.
+static void RecognizeRegionPixels(
+    mihon::OcrInference* engine,
+    mihon::OcrProfile request_profile,
+    const uint8_t* pixels,
+    size_t stride,
+    int x, int y, int width, int height,
+    int source_width,
+    int source_height,
+    uint8_t* region_pixels,
+    std::pmr::string& raw_text,
+    std::pmr::string& text) {
+    {
+        mihon::ScopedAllocPhase preprocess_phase(mihon::AllocPhase::kPreprocess);
+        // Scaled straight to the input size PrepareInput will pick, so it does not resample again
+        const int input_size = engine->SelectInputSize(source_width, source_height);
+        mihon::ResizeRegion(pixels, stride, x, y, width, height, region_pixels, input_size, input_size);
+        PrepareInput(engine, region_pixels, static_cast<size_t>(input_size) * 4, input_size,
+                     source_width, source_height);
+    }
+    RunRecognition(engine, request_profile, source_width, source_height, raw_text, text);
+}
+
+// Whether the [left, top, width, height] `rect` is non-empty and inside the bitmap; the edges are
+// summed in 64 bits as the values come straight from the caller
+static bool RegionInBounds(const jint* rect, const AndroidBitmapInfo& info) {
+    return rect[0] >= 0 && rect[1] >= 0 && rect[2] > 0 && rect[3] > 0 &&
+        static_cast<int64_t>(rect[0]) + rect[2] <= info.width &&
+        static_cast<int64_t>(rect[1]) + rect[3] <= info.height;
+}
+
+// Recognizes the `count` in-bounds regions of ARGB_8888 `pixels` at `indices` of `rects`, four
+// [left, top, width, height] values each, calling `on_text(index, text, recognized)` for every one,
+// `recognized` being false when the engine returned no tokens. Regions are
+// preprocessed REGION_BATCH_SIZE at a time across the work pool into g_regionBatchInput, from
+// `pyramid` when set, then run one by one from their slots.
+// Caller must hold g_inferenceMutex.
+template <typename OnText>
+static void RecognizeBitmapRegions(
+    mihon::OcrInference* engine,
+    mihon::OcrProfile request_profile,
+    const uint8_t* pixels,
+    size_t stride,
+    const jint* rects,
+    const jsize* indices,
+    size_t count,
+    const mihon::ImagePyramid* pyramid,
+    std::pmr::memory_resource* arena,
+    OnText&& on_text) {
+    std::pmr::vector<mihon::RegionCrop> crops(arena);
+    std::pmr::vector<size_t> offsets(REGION_BATCH_SIZE, arena);
+    crops.reserve(REGION_BATCH_SIZE);
+    std::pmr::string raw_text(arena);
+    std::pmr::string text(arena);
+
+    for (size_t first = 0; first < count; first += REGION_BATCH_SIZE) {
+        const size_t last = std::min(count, first + REGION_BATCH_SIZE);
+        crops.clear();
+        for (size_t k = first; k < last; ++k) {
+            const jint* rect = rects + static_cast<size_t>(indices[k]) * 4;
+            crops.push_back({rect[0], rect[1], rect[2], rect[3], engine->SelectInputSize(rect[2], rect[3])});
+        }
+
+        {
+            mihon::ScopedAllocPhase preprocess_phase(mihon::AllocPhase::kPreprocess);
+            std::vector<mihon::PatchMask>& masks = g_regionBatchMasks;
+            if (masks.size() < REGION_BATCH_SIZE) {
+                masks.resize(REGION_BATCH_SIZE);
+            }
+            for (size_t c = 0; c < crops.size(); ++c) {
+                masks[c].grid = crops[c].input_size == IMAGE_SIZE ? engine->PatchGrid() : 0;
+                masks[c].keep.clear();
+            }
+            const size_t batch_bytes = mihon::BatchInputOffsets(
+                crops.data(), crops.size(), engine->InputFormat(), offsets.data());
+            if (g_regionBatchInput.size() < batch_bytes) {
+                g_regionBatchInput.resize(batch_bytes);
+            }
+            mihon::PreprocessRegions(pixels, stride, crops.data(), crops.size(), engine->InputFormat(),
+                                     g_regionBatchInput.data(), offsets.data(), masks.data(),
+                                     g_regionBatchScratch, pyramid);
+        }
+
+        for (size_t c = 0; c < crops.size(); ++c) {
+            text.clear();
+            g_imageSize = crops[c].input_size;
+            // Copied, not swapped, so both buffers keep their capacity for the next batch
+            g_patchMask = g_regionBatchMasks[c];
+            const RecognitionResult result =
+                RunRecognition(engine, request_profile, crops[c].width, crops[c].height, raw_text, text,
+                               nullptr, std::chrono::steady_clock::time_point::max(),
+                               g_regionBatchInput.data() + offsets[c]);
+            on_text(indices[first + c], text, result.token_count > 0);
+        }
+    }
+}
+
+static void CaptureRequest(
+    mihon::OcrInference* engine,
+    mihon::OcrProfile request_profile,
+    const RecognitionResult& result,
+    int64_t arrival_us,
+    int64_t preprocess_us,
+    std::vector<uint8_t> pixels) {
+
+    mihon::CaptureRecord record;
+    record.arrival_us = arrival_us;
+    record.profile = static_cast<int32_t>(request_profile);
+    record.engine = mihon::GetProfileConfig(request_profile).engine;
+    record.encoder_using_gpu = engine->IsEncoderUsingGpu();
+    record.decoder_using_gpu = engine->IsDecoderUsingGpu();
+    record.decode = result.decode;
+    record.decode.deadline = std::chrono::steady_clock::time_point::max();
+    if (result.decode.HasDeadline()) {
+        record.deadline_us = std::max<int64_t>(g_capture.OffsetUs(result.decode.deadline) - arrival_us, 0);
+    }
+    record.image_width = IMAGE_SIZE;
+    record.image_height = IMAGE_SIZE;
+    record.pixels = std::move(pixels);
+    record.tokens.assign(g_tokenBuffer.data(), g_tokenBuffer.data() + std::max(result.token_count, 0));
+    record.preprocess_us = preprocess_us;
+    record.stats = result.stats;
+    record.total_ms = result.total_ms;
+    if (!g_capture.Append(record)) {
+        LOGW("Request capture stopped (size limit reached or write failed)");
+        g_capture.Close();
+    }
+}
+
+static void ReleaseEngines(JNIEnv* env) {
+    for (auto& slot : g_engines) {
+        slot.engine->Close();
+    }
+    g_engines.clear();
+    std::fill(std::begin(g_profileEngines), std::end(g_profileEngines), nullptr);
+
+    if (g_assetManagerRef) {
+        env->DeleteGlobalRef(g_assetManagerRef);
+        g_assetManagerRef = nullptr;
+    }
+}
+
 extern "C" {
 
 JNIEXPORT jboolean JNICALL
@@ -84,14 +838,17 @@ Java_mihon_data_ocr_OcrRepositoryImpl_nativeOcrInit(
 
     LOGI("Initializing native OCR engine");
 
+    // Creating the session engine may evict others to fit the memory budget
+    std::lock_guard<std::mutex> inference_lock(g_inferenceMutex);
     std::lock_guard<std::mutex> lock(g_initMutex);
 
     try {
-        if (g_ocrInference && g_ocrInference->IsInitialized()) {
+        mihon::OcrInference* session_engine = g_engines.empty() ? nullptr : g_engines.front().engine.get();
+        if (session_engine && session_engine->IsInitialized()) {
             const int clients = g_activeOcrClients.fetch_add(1) + 1;
             LOGI("Reusing existing native OCR engine (clients=%d, ACCELERATOR=%s/%s)", clients,
-                 g_ocrInference->IsEncoderUsingGpu() ? "GPU" : "CPU",
-                 g_ocrInference->IsDecoderUsingGpu() ? "GPU" : "CPU");
+                 session_engine->IsEncoderUsingGpu() ? "GPU" : "CPU",
+                 session_engine->IsDecoderUsingGpu() ? "GPU" : "CPU");
             return JNI_TRUE;
         }
 
@@ -104,49 +861,42 @@ Java_mihon_data_ocr_OcrRepositoryImpl_nativeOcrInit(
             return JNI_FALSE;
         }
 
-        // Zero-copy asset loading
-        AAsset* enc_asset = AAssetManager_open(mgr, "ocr/encoder.tflite", AASSET_MODE_BUFFER);
-        AAsset* dec_asset = AAssetManager_open(mgr, "ocr/decoder.tflite", AASSET_MODE_BUFFER);
-        AAsset* emb_asset = AAssetManager_open(mgr, "ocr/embeddings.bin", AASSET_MODE_BUFFER);
-
-        if (!enc_asset || !dec_asset || !emb_asset) {
-            LOGE("Failed to open assets");
-            if (enc_asset) AAsset_close(enc_asset);
-            if (dec_asset) AAsset_close(dec_asset);
-            if (emb_asset) AAsset_close(emb_asset);
-            return JNI_FALSE;
-        }
+        g_assetManagerRef = env->NewGlobalRef(assetManager);
 
         const char* cache_dir_str = env->GetStringUTFChars(cacheDir, nullptr);
         const char* native_lib_dir_str = env->GetStringUTFChars(nativeLibDir, nullptr);
-
-        // Create OcrInference instance (assets are now owned by OcrInference)
-        g_ocrInference = std::make_unique<mihon::OcrInference>();
-        bool success = g_ocrInference->Initialize(
-            enc_asset,
-            dec_asset,
-            emb_asset,
-            cache_dir_str,
-            native_lib_dir_str
-        );
-
+        g_cacheDir = cache_dir_str;
+        g_nativeLibDir = native_lib_dir_str;
         env->ReleaseStringUTFChars(cacheDir, cache_dir_str);
         env->ReleaseStringUTFChars(nativeLibDir, native_lib_dir_str);
 
-        if (!success) {
+        session_engine = AcquireProfileEngine(env, SessionProfile());
+        if (!session_engine) {
             LOGE("Failed to initialize OcrInference");
-            g_ocrInference.reset();
+            ReleaseEngines(env);
             g_activeOcrClients.store(0);
             return JNI_FALSE;
         }
         g_activeOcrClients.store(1);
+        mihon::OcrInference::PruneWeightCache();
 
-        g_imageBuffer.resize(IMAGE_SIZE * IMAGE_SIZE * 3);
+        g_imageBuffer.resize(mihon::ImageInputBytes(mihon::ImageInputFormat::kFloat32Rgb, IMAGE_SIZE, IMAGE_SIZE));
         g_tokenBuffer.resize(MAX_SEQUENCE_LENGTH);
 
+        g_maxTokenBytes = 0;
+        for (const auto& entry : g_vocab) {
+            g_maxTokenBytes = std::max(g_maxTokenBytes, entry.size());
+        }
+        // Sized so a request never outgrows it: region pixels, detokenized text and the
+        // postprocessed text (at most three times longer), plus headroom for region lists
+        g_requestArena = std::make_unique<mihon::RequestArena>(
+            static_cast<size_t>(IMAGE_SIZE) * IMAGE_SIZE * 4 +
+            static_cast<size_t>(MAX_SEQUENCE_LENGTH) * g_maxTokenBytes * 4 +
+            REQUEST_ARENA_HEADROOM);
+
         LOGI("app.mihonocr.dev: Native OCR engine initialized successfully (ACCELERATOR=%s/%s)",
-             g_ocrInference->IsEncoderUsingGpu() ? "GPU" : "CPU",
-             g_ocrInference->IsDecoderUsingGpu() ? "GPU" : "CPU");
+             session_engine->IsEncoderUsingGpu() ? "GPU" : "CPU",
+             session_engine->IsDecoderUsingGpu() ? "GPU" : "CPU");
         return JNI_TRUE;
 
     } catch (const std::exception& e) {
@@ -155,66 +905,638 @@ Java_mihon_data_ocr_OcrRepositoryImpl_nativeOcrInit(
     }
 }
 
+// `deadlineNanos` is a System.nanoTime() value, 0 for none. Past it the text decoded so far is
+// returned and `partial[0]` is set.
 JNIEXPORT jstring JNICALL
 Java_mihon_data_ocr_OcrRepositoryImpl_nativeRecognizeText(
     JNIEnv* env,
     jobject /* this */,
-    jobject bitmap) {
+    jobject bitmap,
+    jint profile,
+    jint sourceWidth,
+    jint sourceHeight,
+    jlong deadlineNanos,
+    jbooleanArray partial) {
 
     std::lock_guard<std::mutex> lock(g_inferenceMutex);
 
-    if (!g_ocrInference || !g_ocrInference->IsInitialized()) {
+    const mihon::OcrProfile request_profile = mihon::ProfileFromInt(profile, SessionProfile());
+    mihon::OcrInference* engine = AcquireRequestEngine(env, request_profile);
+    if (!engine || !engine->IsInitialized() || !g_requestArena) {
         LOGE("OcrInference not initialized");
         return env->NewStringUTF("");
     }
 
  try {
-        float* image_data = g_imageBuffer.data();
-        int* tokens = g_tokenBuffer.data();
+        mihon::ScopedArenaReset arena_reset(*g_requestArena);
+        std::pmr::memory_resource* arena = g_requestArena->Resource();
 
-        PreprocessBitmap(env, bitmap, image_data);
+        std::vector<uint8_t> captured_pixels;
+        const bool capturing = g_capture.IsOpen();
+        const int64_t arrival_us = capturing ? g_capture.ElapsedUs() : 0;
 
-        auto t0 = std::chrono::high_resolution_clock::now();
-        const int token_count = g_ocrInference->InferTokens(
-            image_data,
-            tokens,
-            MAX_SEQUENCE_LENGTH
-        );
-        auto t1 = std::chrono::high_resolution_clock::now();
-        auto diff = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
-        LOGI("app.mihonocr.dev: Native inference overall time: %lld ms", static_cast<long long>(diff));
+        const auto preprocess_start = std::chrono::steady_clock::now();
+        {
+            mihon::ScopedAllocPhase preprocess_phase(mihon::AllocPhase::kPreprocess);
+            PreprocessBitmap(env, bitmap, engine, sourceWidth, sourceHeight, capturing ? &captured_pixels : nullptr);
+        }
+        const auto preprocess_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - preprocess_start).count();
 
-        if (token_count <= 0) {
-            LOGE("Inference failed or produced no tokens");
-            return env->NewStringUTF("");
+        std::pmr::string raw_text(arena);
+        std::pmr::string text(arena);
+        const RecognitionResult result = RunRecognition(engine, request_profile, sourceWidth, sourceHeight,
+                                                        raw_text, text, nullptr, DeadlineFromNanos(deadlineNanos));
+        if (capturing) {
+            CaptureRequest(engine, request_profile, result, arrival_us, preprocess_us, std::move(captured_pixels));
+        }
+        ReportPartial(env, partial, result.stats.partial);
+        return env->NewStringUTF(text.c_str());
+
+    } catch (const std::exception& e) {
+        LOGE("Exception during recognition: %s", e.what());
+        return env->NewStringUTF("");
+    }
+}
+
+// Starts a speculative request for the in-progress selection `session`, cancelling the one in
+// flight at its next model run. Returns the generation to pass to nativeRecognizeSpeculative.
+// Does not take g_inferenceMutex, so it cancels a request that holds it.
+JNIEXPORT jlong JNICALL
+Java_mihon_data_ocr_OcrRepositoryImpl_nativeBeginSpeculation(
+    JNIEnv* /* env */,
+    jobject /* this */,
+    jlong session,
+    jfloat left,
+    jfloat top,
+    jfloat right,
+    jfloat bottom) {
+    return static_cast<jlong>(g_selectionSpeculation.Begin(session, {left, top, right, bottom}));
+}
+
+// Recognizes a model-sized crop of the in-progress selection `session` at low priority, keeping
+// its encoder output and tokens for nativeRecognizeSelection. Returns false if a newer request
+// superseded it.
+JNIEXPORT jboolean JNICALL
+Java_mihon_data_ocr_OcrRepositoryImpl_nativeRecognizeSpeculative(
+    JNIEnv* env,
+    jobject /* this */,
+    jobject bitmap,
+    jint profile,
+    jint sourceWidth,
+    jint sourceHeight,
+    jlong session,
+    jfloat left,
+    jfloat top,
+    jfloat right,
+    jfloat bottom,
+    jlong generation) {
+
+    std::lock_guard<std::mutex> lock(g_inferenceMutex);
+
+    const uint64_t request_generation = static_cast<uint64_t>(generation);
+    if (!g_selectionSpeculation.IsCurrent(request_generation)) {
+        return JNI_FALSE;
+    }
+
+    const mihon::OcrProfile request_profile = mihon::ProfileFromInt(profile, SessionProfile());
+    mihon::OcrInference* engine = AcquireRequestEngine(env, request_profile);
+    if (!engine || !engine->IsInitialized()) {
+        LOGE("OcrInference not initialized");
+        return JNI_FALSE;
+    }
+
+    try {
+        ScopedThreadNice low_priority(SPECULATIVE_THREAD_NICE);
+        g_selectionSpeculation.SetRunner(request_generation, gettid());
+
+        {
+            mihon::ScopedAllocPhase preprocess_phase(mihon::AllocPhase::kPreprocess);
+            PreprocessBitmap(env, bitmap, engine, sourceWidth, sourceHeight);
+        }
+
+        // Not recorded in the profile stats: cancelled runs would skew them
+        mihon::DecodeOptions decode = mihon::GetProfileConfig(request_profile).decode;
+        decode.source_width = sourceWidth;
+        decode.source_height = sourceHeight;
+        decode.cancel_generation = &g_selectionSpeculation.Generation();
+        decode.generation = request_generation;
+        decode.input_size = g_imageSize;
+        decode.patch_mask = g_patchMask.IsComputed() ? &g_patchMask : nullptr;
+        mihon::InferenceStats stats;
+        const int token_count = engine->InferTokens(
+            g_imageBuffer.data(), g_tokenBuffer.data(), MAX_SEQUENCE_LENGTH, decode, &stats);
+        g_imageSize = IMAGE_SIZE;
+        g_patchMask.keep.clear();
+        g_selectionSpeculation.SetRunner(request_generation, 0);
+
+        // The encoder output is kept even when decoding was cancelled, the tokens even when the
+        // encoder output cannot be (early exits and lower input resolutions leave none)
+        const bool finished = !stats.cancelled && token_count > 0;
+        std::vector<float> hidden_states;
+        const bool has_hidden_states = engine->CopyHiddenStates(hidden_states);
+        if (finished || has_hidden_states) {
+            mihon::SelectionSpeculation::Result& result = g_selectionSpeculation.Store(
+                session, {left, top, right, bottom}, engine, static_cast<int>(request_profile));
+            if (has_hidden_states) {
+                result.hidden_states = std::move(hidden_states);
+            }
+            if (finished) {
+                result.tokens.assign(g_tokenBuffer.data(), g_tokenBuffer.data() + token_count);
+            }
+        }
+        LOGI("Speculative recognition %s after %lld ms encoder, %d decoder steps",
+             stats.cancelled ? "cancelled" : "finished", stats.encoder_ms, stats.decoder_runs);
+        return stats.cancelled || token_count <= 0 ? JNI_FALSE : JNI_TRUE;
+
+    } catch (const std::exception& e) {
+        LOGE("Exception during speculative recognition: %s", e.what());
+        g_selectionSpeculation.SetRunner(request_generation, 0);
+        return JNI_FALSE;
+    }
+}
+
+// Prepares for the final request of selection `session`: cancels the speculative request in flight
+// unless its rectangle matches, in which case it is raised back to normal priority so the final
+// request, which waits for it, is not held up. Does not take g_inferenceMutex.
+JNIEXPORT void JNICALL
+Java_mihon_data_ocr_OcrRepositoryImpl_nativeSettleSelection(
+    JNIEnv* /* env */,
+    jobject /* this */,
+    jlong session,
+    jfloat left,
+    jfloat top,
+    jfloat right,
+    jfloat bottom) {
+    const int runner = g_selectionSpeculation.Settle(session, {left, top, right, bottom});
+    if (runner != 0 && setpriority(PRIO_PROCESS, runner, 0) != 0) {
+        LOGW("Failed to restore speculative request priority: %s", strerror(errno));
+    }
+}
+
+JNIEXPORT void JNICALL
+Java_mihon_data_ocr_OcrRepositoryImpl_nativeCancelSpeculation(JNIEnv* /* env */, jobject /* this */) {
+    g_selectionSpeculation.Cancel();
+}
+
+// Recognizes the final crop of selection `session`. The tokens, or failing that the encoder output,
+// of a speculative request for a closely matching rectangle are reused; the crop is only encoded
+// when there is none. Drops the speculative result afterwards.
+JNIEXPORT jstring JNICALL
+Java_mihon_data_ocr_OcrRepositoryImpl_nativeRecognizeSelection(
+    JNIEnv* env,
+    jobject /* this */,
+    jobject bitmap,
+    jint profile,
+    jint sourceWidth,
+    jint sourceHeight,
+    jlong session,
+    jfloat left,
+    jfloat top,
+    jfloat right,
+    jfloat bottom) {
+
+    std::lock_guard<std::mutex> lock(g_inferenceMutex);
+
+    const mihon::OcrProfile request_profile = mihon::ProfileFromInt(profile, SessionProfile());
+    mihon::OcrInference* engine = AcquireRequestEngine(env, request_profile);
+    if (!engine || !engine->IsInitialized() || !g_requestArena) {
+        LOGE("OcrInference not initialized");
+        g_selectionSpeculation.Clear();
+        return env->NewStringUTF("");
+    }
+
+    try {
+        mihon::ScopedArenaReset arena_reset(*g_requestArena);
+        std::pmr::memory_resource* arena = g_requestArena->Resource();
+        std::pmr::string raw_text(arena);
+        std::pmr::string text(arena);
+
+        const mihon::SelectionSpeculation::Result* speculated = g_selectionSpeculation.Find(
+            session, {left, top, right, bottom}, engine, static_cast<int>(request_profile));
+        if (speculated && !speculated->tokens.empty()) {
+            LOGI("Selection recognized speculatively");
+            DecodeText(speculated->tokens.data(), static_cast<int>(speculated->tokens.size()), raw_text, text);
+        } else if (speculated && !speculated->hidden_states.empty()) {
+            LOGI("Selection reuses the speculative encoder output");
+            RunRecognition(engine, request_profile, sourceWidth, sourceHeight, raw_text, text,
+                           &speculated->hidden_states);
+        } else {
+            {
+                mihon::ScopedAllocPhase preprocess_phase(mihon::AllocPhase::kPreprocess);
+                PreprocessBitmap(env, bitmap, engine, sourceWidth, sourceHeight);
+            }
+            RunRecognition(engine, request_profile, sourceWidth, sourceHeight, raw_text, text);
         }
+        g_selectionSpeculation.Clear();
+        return env->NewStringUTF(text.c_str());
+
+    } catch (const std::exception& e) {
+        LOGE("Exception during selection recognition: %s", e.what());
+        g_selectionSpeculation.Clear();
+        return env->NewStringUTF("");
+    }
+}
+
+// Recognizes every [left, top, width, height] rectangle of `regions` in one call; regions
+// are cropped and scaled natively. Empty or out-of-bounds regions yield null entries.
+// `page_id` is the bitmap's generation ID, under which the page's pyramid is cached.
+JNIEXPORT jobjectArray JNICALL
+Java_mihon_data_ocr_OcrRepositoryImpl_nativeRecognizeRegions(
+    JNIEnv* env,
+    jobject /* this */,
+    jobject bitmap,
+    jint page_id,
+    jintArray regions,
+    jint profile) {
+
+    const jsize region_count = regions ? env->GetArrayLength(regions) / 4 : 0;
+    jclass string_class = env->FindClass("java/lang/String");
+    jobjectArray results = env->NewObjectArray(region_count, string_class, nullptr);
+    if (!results) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(g_inferenceMutex);
+
+    const mihon::OcrProfile request_profile = mihon::ProfileFromInt(profile, SessionProfile());
+    mihon::OcrInference* engine = AcquireRequestEngine(env, request_profile);
+    if (!engine || !engine->IsInitialized() || !g_requestArena) {
+        LOGE("OcrInference not initialized");
+        return results;
+    }
+
+    AndroidBitmapInfo info;
+    void* pixels = nullptr;
+    if (AndroidBitmap_getInfo(env, bitmap, &info) < 0 || info.format != ANDROID_BITMAP_FORMAT_RGBA_8888) {
+        LOGE("Regions require an ARGB_8888 bitmap");
+        return results;
+    }
+    if (AndroidBitmap_lockPixels(env, bitmap, &pixels) < 0) {
+        LOGE("Failed to lock bitmap pixels");
+        return results;
+    }
 
-        std::string result;
-        result.reserve(static_cast<size_t>(token_count) * 3);
+    try {
+        mihon::ScopedArenaReset arena_reset(*g_requestArena);
+        std::pmr::memory_resource* arena = g_requestArena->Resource();
 
-        const int vocab_size = static_cast<int>(g_vocab.size());
-        for (int i = 0; i < token_count; ++i) {
-            const int tokenId = tokens[i];
+        std::pmr::vector<jint> rects(static_cast<size_t>(region_count) * 4, arena);
+        env->GetIntArrayRegion(regions, 0, region_count * 4, rects.data());
 
-            if (tokenId < SPECIAL_TOKEN_THRESHOLD) {
+        std::pmr::vector<jsize> recognized(arena);
+        recognized.reserve(region_count);
+        for (jsize i = 0; i < region_count; ++i) {
+            if (RegionInBounds(&rects[i * 4], info)) {
+                recognized.push_back(i);
+            } else {
+                LOGW("Skipping region %d outside the %ux%u bitmap", static_cast<int>(i), info.width, info.height);
+            }
+        }
+
+        const uint64_t page_key = static_cast<uint32_t>(page_id);
+        const mihon::ImagePyramid* pyramid = g_pagePyramids.Find(page_key, info.width, info.height);
+        if (!pyramid) {
+            double downscaled_area = 0;
+            for (jsize i = 0; i < region_count; ++i) {
+                const jint width = rects[i * 4 + 2];
+                const jint height = rects[i * 4 + 3];
+                const int input_size = width > 0 && height > 0 ? engine->SelectInputSize(width, height) : 0;
+                if (input_size > 0 && width >= 2 * input_size && height >= 2 * input_size) {
+                    downscaled_area += static_cast<double>(width) * height;
+                }
+            }
+            bool build = downscaled_area >= PYRAMID_MIN_PAGE_COVERAGE * info.width * info.height;
+            if (build) {
+                // Engines are not evicted for a pyramid; without room the page is read at full resolution
+                std::lock_guard<std::mutex> init_lock(g_initMutex);
+                build = FitMemoryBudget(static_cast<int64_t>(
+                    mihon::PagePyramidCache::PyramidBytes(info.width, info.height)), nullptr, false);
+            }
+            if (build) {
+                mihon::ScopedAllocPhase preprocess_phase(mihon::AllocPhase::kPreprocess);
+                pyramid = &g_pagePyramids.Insert(page_key, static_cast<const uint8_t*>(pixels),
+                                                 info.width, info.height, info.stride);
+            }
+        }
+
+        const auto batch_start = std::chrono::steady_clock::now();
+        RecognizeBitmapRegions(engine, request_profile, static_cast<const uint8_t*>(pixels), info.stride,
+                               rects.data(), recognized.data(), recognized.size(), pyramid, arena,
+                               [env, results](jsize i, const std::pmr::string& text, bool /* recognized */) {
+                                   jstring region_text = env->NewStringUTF(text.c_str());
+                                   env->SetObjectArrayElement(results, i, region_text);
+                                   env->DeleteLocalRef(region_text);
+                               });
+        const auto batch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - batch_start).count();
+        LOGI("app.mihonocr.dev: Recognized %d regions in %lld ms", static_cast<int>(region_count),
+             static_cast<long long>(batch_ms));
+
+    } catch (const std::exception& e) {
+        LOGE("Exception during region recognition: %s", e.what());
+    }
+
+    AndroidBitmap_unlockPixels(env, bitmap);
+    return results;
+}
+
+// Recognizes every [left, top, width, height] rectangle of `regions` in `bitmap`, the latest frame
+// of screen `stream`. Regions that track a region of the previous frame, after its scroll, with
+// unchanged pixels get its text back; only new and changed ones are recognized. `frame_stats`, when
+// given, receives the FRAME_STATS_FIELD_COUNT values. Out-of-bounds regions yield null entries.
+JNIEXPORT jobjectArray JNICALL
+Java_mihon_data_ocr_OcrRepositoryImpl_nativeRecognizeFrame(
+    JNIEnv* env,
+    jobject /* this */,
+    jobject bitmap,
+    jlong stream,
+    jintArray regions,
+    jint profile,
+    jintArray frame_stats) {
+
+    const jsize region_count = regions ? env->GetArrayLength(regions) / 4 : 0;
+    jclass string_class = env->FindClass("java/lang/String");
+    jobjectArray results = env->NewObjectArray(region_count, string_class, nullptr);
+    if (!results) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(g_inferenceMutex);
+
+    const mihon::OcrProfile request_profile = mihon::ProfileFromInt(profile, SessionProfile());
+    mihon::OcrInference* engine = AcquireRequestEngine(env, request_profile);
+    if (!engine || !engine->IsInitialized() || !g_requestArena) {
+        LOGE("OcrInference not initialized");
+        return results;
+    }
+
+    AndroidBitmapInfo info;
+    void* pixels = nullptr;
+    if (AndroidBitmap_getInfo(env, bitmap, &info) < 0 || info.format != ANDROID_BITMAP_FORMAT_RGBA_8888) {
+        LOGE("Frames require an ARGB_8888 bitmap");
+        return results;
+    }
+    if (AndroidBitmap_lockPixels(env, bitmap, &pixels) < 0) {
+        LOGE("Failed to lock bitmap pixels");
+        return results;
+    }
+
+    try {
+        mihon::ScopedArenaReset arena_reset(*g_requestArena);
+        std::pmr::memory_resource* arena = g_requestArena->Resource();
+
+        std::pmr::vector<jint> rects(static_cast<size_t>(region_count) * 4, arena);
+        env->GetIntArrayRegion(regions, 0, region_count * 4, rects.data());
+
+        const auto frame_start = std::chrono::steady_clock::now();
+        const int scroll = g_frameTracker.BeginFrame(stream, static_cast<int>(request_profile),
+                                                     static_cast<const uint8_t*>(pixels),
+                                                     info.width, info.height, info.stride);
+
+        // Stable regions are answered right away; the rest are recognized as one batch
+        std::pmr::vector<jsize> changed(arena);
+        changed.reserve(region_count);
+        for (jsize i = 0; i < region_count; ++i) {
+            if (!RegionInBounds(&rects[i * 4], info)) {
+                LOGW("Skipping region %d outside the %ux%u frame", static_cast<int>(i), info.width, info.height);
                 continue;
             }
+            const mihon::FrameRegion region{rects[i * 4], rects[i * 4 + 1], rects[i * 4 + 2], rects[i * 4 + 3]};
+            if (const std::string* text = g_frameTracker.FindUnchanged(region)) {
+                g_frameTracker.Track(region, *text);
+                jstring region_text = env->NewStringUTF(text->c_str());
+                env->SetObjectArrayElement(results, i, region_text);
+                env->DeleteLocalRef(region_text);
+            } else {
+                changed.push_back(i);
+            }
+        }
+
+        std::string tracked_text;
+        RecognizeBitmapRegions(engine, request_profile, static_cast<const uint8_t*>(pixels), info.stride,
+                               rects.data(), changed.data(), changed.size(), nullptr, arena,
+                               [env, results, &rects, &tracked_text](jsize i, const std::pmr::string& text,
+                                                                     bool recognized) {
+                                   // Failed regions are recognized again next frame
+                                   if (recognized) {
+                                       tracked_text.assign(text.data(), text.size());
+                                       g_frameTracker.Track({rects[i * 4], rects[i * 4 + 1], rects[i * 4 + 2],
+                                                             rects[i * 4 + 3]}, tracked_text);
+                                   }
+                                   jstring region_text = env->NewStringUTF(text.c_str());
+                                   env->SetObjectArrayElement(results, i, region_text);
+                                   env->DeleteLocalRef(region_text);
+                               });
+        g_frameTracker.EndFrame();
+
+        const auto frame_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - frame_start).count();
+        LOGI("app.mihonocr.dev: Frame of %d regions, %zu recognized, scrolled %d px, in %lld ms",
+             static_cast<int>(region_count), changed.size(), scroll, static_cast<long long>(frame_ms));
+
+        if (frame_stats && env->GetArrayLength(frame_stats) >= FRAME_STATS_FIELD_COUNT) {
+            const jint values[FRAME_STATS_FIELD_COUNT] = {scroll, static_cast<jint>(changed.size())};
+            env->SetIntArrayRegion(frame_stats, 0, FRAME_STATS_FIELD_COUNT, values);
+        }
+
+    } catch (const std::exception& e) {
+        LOGE("Exception during frame recognition: %s", e.what());
+        g_frameTracker.Reset();
+    }
+
+    AndroidBitmap_unlockPixels(env, bitmap);
+    return results;
+}
+
+// Recognizes every [left, top, width, height] rectangle of `regions` in an encoded image (JPEG,
+// PNG, WebP, ...), held in `length` bytes at `offset` of a direct buffer or, when `buffer` is null,
+// read from `fd`. Only the regions are decoded, each at the coarsest scale the codec produces
+// natively that still covers the model input. Returns null when the image cannot be decoded
+// natively (before API 30, or an unsupported format) so the caller can fall back.
+JNIEXPORT jobjectArray JNICALL
+Java_mihon_data_ocr_OcrRepositoryImpl_nativeRecognizeEncodedRegions(
+    JNIEnv* env,
+    jobject /* this */,
+    jobject buffer,
+    jint offset,
+    jint length,
+    jint fd,
+    jintArray regions,
+    jint profile) {
+
+    if (!mihon::EncodedImageDecoder::IsAvailable()) {
+        return nullptr;
+    }
+
+    std::unique_ptr<mihon::EncodedImageDecoder> decoder;
+    if (buffer) {
+        auto* data = static_cast<const uint8_t*>(env->GetDirectBufferAddress(buffer));
+        const jlong capacity = env->GetDirectBufferCapacity(buffer);
+        if (!data || offset < 0 || length <= 0 || offset + static_cast<jlong>(length) > capacity) {
+            LOGE("Encoded image must be a direct buffer range");
+            return nullptr;
+        }
+        decoder = mihon::EncodedImageDecoder::FromBuffer(data + offset, static_cast<size_t>(length));
+    } else {
+        decoder = mihon::EncodedImageDecoder::FromFd(fd);
+    }
+    if (!decoder) {
+        LOGW("Encoded image cannot be decoded natively");
+        return nullptr;
+    }
+
+    const jsize region_count = regions ? env->GetArrayLength(regions) / 4 : 0;
+    jclass string_class = env->FindClass("java/lang/String");
+    jobjectArray results = env->NewObjectArray(region_count, string_class, nullptr);
+    if (!results) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(g_inferenceMutex);
 
-            if (tokenId < vocab_size) {
-                result += g_vocab[tokenId];
+    const mihon::OcrProfile request_profile = mihon::ProfileFromInt(profile, SessionProfile());
+    mihon::OcrInference* engine = AcquireRequestEngine(env, request_profile);
+    if (!engine || !engine->IsInitialized() || !g_requestArena) {
+        LOGE("OcrInference not initialized");
+        return results;
+    }
+
+    try {
+        mihon::ScopedArenaReset arena_reset(*g_requestArena);
+        std::pmr::memory_resource* arena = g_requestArena->Resource();
+
+        std::pmr::vector<jint> rects(static_cast<size_t>(region_count) * 4, arena);
+        env->GetIntArrayRegion(regions, 0, region_count * 4, rects.data());
+
+        std::pmr::vector<uint8_t> region_pixels(static_cast<size_t>(IMAGE_SIZE) * IMAGE_SIZE * 4, arena);
+        std::pmr::string raw_text(arena);
+        std::pmr::string text(arena);
+
+        const auto batch_start = std::chrono::steady_clock::now();
+        for (jsize i = 0; i < region_count; ++i) {
+            const jint left = rects[i * 4];
+            const jint top = rects[i * 4 + 1];
+            const jint width = rects[i * 4 + 2];
+            const jint height = rects[i * 4 + 3];
+            text.clear();
+
+            int decoded_width = 0, decoded_height = 0;
+            size_t decoded_stride = 0;
+            bool decoded;
+            {
+                mihon::ScopedAllocPhase preprocess_phase(mihon::AllocPhase::kPreprocess);
+                decoded = decoder->DecodeRegion(left, top, width, height, IMAGE_SIZE, &g_encodedRegionPixels,
+                                                &decoded_width, &decoded_height, &decoded_stride);
+            }
+            if (decoded) {
+                RecognizeRegionPixels(engine, request_profile, g_encodedRegionPixels.data(), decoded_stride,
+                                      0, 0, decoded_width, decoded_height, width, height,
+                                      region_pixels.data(), raw_text, text);
+            } else {
+                LOGW("Skipping region %d that could not be decoded from the %dx%d image",
+                     static_cast<int>(i), decoder->Width(), decoder->Height());
             }
+
+            jstring region_text = env->NewStringUTF(text.c_str());
+            env->SetObjectArrayElement(results, i, region_text);
+            env->DeleteLocalRef(region_text);
         }
+        const auto batch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - batch_start).count();
+        LOGI("app.mihonocr.dev: Decoded and recognized %d encoded regions in %lld ms",
+             static_cast<int>(region_count), static_cast<long long>(batch_ms));
+
+    } catch (const std::exception& e) {
+        LOGE("Exception during encoded region recognition: %s", e.what());
+    }
+    return results;
+}
+
+// Maps a shared image ring created by a client process; takes ownership of `fd`.
+// Returns an opaque handle, or 0 if the region is not a valid ring.
+JNIEXPORT jlong JNICALL
+Java_mihon_data_ocr_OcrRepositoryImpl_nativeMapSharedRing(JNIEnv* /* env */, jobject /* this */, jint fd) {
+    std::unique_ptr<mihon::SharedImageRing> ring = mihon::SharedImageRing::Map(fd);
+    if (!ring) {
+        LOGE("Rejected shared image ring from fd %d", fd);
+        return 0;
+    }
+    return reinterpret_cast<jlong>(ring.release());
+}
+
+JNIEXPORT void JNICALL
+Java_mihon_data_ocr_OcrRepositoryImpl_nativeUnmapSharedRing(JNIEnv* /* env */, jobject /* this */, jlong ring) {
+    delete reinterpret_cast<mihon::SharedImageRing*>(ring);
+}
+
+// Recognizes the image queued in `slot` of a shared ring and completes the slot with its text.
+// Returns false if the slot holds no queued model-sized image. The deadline is handled as in
+// nativeRecognizeText.
+JNIEXPORT jboolean JNICALL
+Java_mihon_data_ocr_OcrRepositoryImpl_nativeRecognizeSharedSlot(
+    JNIEnv* env,
+    jobject /* this */,
+    jlong ringHandle,
+    jint slot,
+    jint profile,
+    jlong deadlineNanos,
+    jbooleanArray partial) {
+
+    auto* ring = reinterpret_cast<mihon::SharedImageRing*>(ringHandle);
+    mihon::RingSlotHeader* header = ring ? ring->Header(slot) : nullptr;
+    if (!header ||
+        header->state.load(std::memory_order_acquire) != static_cast<uint32_t>(mihon::RingSlotState::kQueued) ||
+        header->width != IMAGE_SIZE || header->height != IMAGE_SIZE) {
+        LOGE("Ring slot %d holds no queued %dx%d image", slot, IMAGE_SIZE, IMAGE_SIZE);
+        return JNI_FALSE;
+    }
+
+    std::lock_guard<std::mutex> lock(g_inferenceMutex);
+
+    const mihon::OcrProfile request_profile = mihon::ProfileFromInt(profile, SessionProfile());
+    mihon::OcrInference* engine = AcquireRequestEngine(env, request_profile);
+    if (!engine || !engine->IsInitialized() || !g_requestArena) {
+        LOGE("OcrInference not initialized");
+        ring->CompleteSlot(slot, {});
+        return JNI_TRUE;
+    }
+
+    try {
+        mihon::ScopedArenaReset arena_reset(*g_requestArena);
+        std::pmr::memory_resource* arena = g_requestArena->Resource();
 
-        if (g_textPostprocessor) {
-            result = g_textPostprocessor->postprocess(result);
+        const uint8_t* pixels = ring->Pixels(slot);
+        const size_t pixel_bytes = static_cast<size_t>(IMAGE_SIZE) * IMAGE_SIZE * 4;
+        const bool capturing = g_capture.IsOpen();
+        const int64_t arrival_us = capturing ? g_capture.ElapsedUs() : 0;
+
+        const auto preprocess_start = std::chrono::steady_clock::now();
+        {
+            mihon::ScopedAllocPhase preprocess_phase(mihon::AllocPhase::kPreprocess);
+            PrepareInput(engine, pixels, static_cast<size_t>(IMAGE_SIZE) * 4, IMAGE_SIZE,
+                         header->source_width, header->source_height);
         }
+        const auto preprocess_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - preprocess_start).count();
 
-        return env->NewStringUTF(result.c_str());
+        std::pmr::string raw_text(arena);
+        std::pmr::string text(arena);
+        const RecognitionResult result =
+            RunRecognition(engine, request_profile, header->source_width, header->source_height, raw_text, text,
+                           nullptr, DeadlineFromNanos(deadlineNanos));
+        if (capturing) {
+            CaptureRequest(engine, request_profile, result, arrival_us, preprocess_us,
+                           std::vector<uint8_t>(pixels, pixels + pixel_bytes));
+        }
+        ReportPartial(env, partial, result.stats.partial);
+        ring->CompleteSlot(slot, text);
 
     } catch (const std::exception& e) {
-        LOGE("Exception during recognition: %s", e.what());
-        return env->NewStringUTF("");
+        LOGE("Exception during shared slot recognition: %s", e.what());
+        ring->CompleteSlot(slot, {});
     }
+    return JNI_TRUE;
 }
 
 JNIEXPORT void JNICALL
@@ -231,10 +1553,9 @@ Java_mihon_data_ocr_OcrRepositoryImpl_nativeOcrClose(JNIEnv* env, jobject /* thi
     }
     g_activeOcrClients.store(0);
 
-    if (g_ocrInference) {
-        g_ocrInference->Close();
-        g_ocrInference.reset();
-    }
+    ReleaseEngines(env);
+    std::fill(std::begin(g_profileStats), std::end(g_profileStats), mihon::ProfileStats{});
+    g_sessionProfile.store(static_cast<int>(mihon::kDefaultOcrProfile));
     g_textPostprocessor.reset();
     g_vocab.clear();
 
@@ -242,8 +1563,220 @@ Java_mihon_data_ocr_OcrRepositoryImpl_nativeOcrClose(JNIEnv* env, jobject /* thi
     g_imageBuffer.shrink_to_fit();
     g_tokenBuffer.clear();
     g_tokenBuffer.shrink_to_fit();
+    g_encodedRegionPixels.clear();
+    g_encodedRegionPixels.shrink_to_fit();
+    g_regionBatchInput.clear();
+    g_regionBatchInput.shrink_to_fit();
+    g_regionBatchMasks = {};
+    g_regionBatchScratch = {};
+    g_pagePyramids.Clear();
+    g_frameTracker.Reset();
+    g_scaledPixels.clear();
+    g_scaledPixels.shrink_to_fit();
+    g_patchMask = {};
+    g_selectionSpeculation.Cancel();
+    g_selectionSpeculation.Clear();
+    g_requestArena.reset();
+    g_capture.Close();
 
     LOGI("Native OCR engine closed");
 }
 
+JNIEXPORT jboolean JNICALL
+Java_mihon_data_ocr_OcrRepositoryImpl_nativeSetProfile(
+    JNIEnv* env,
+    jobject /* this */,
+    jint profile) {
+
+    if (profile < 0 || profile >= mihon::kOcrProfileCount) {
+        LOGE("Unknown OCR profile %d", profile);
+        return JNI_FALSE;
+    }
+    g_sessionProfile.store(profile);
+
+    // Compile the profile's engine now so the first request does not pay for it; creating
+    // it may evict engines, so in-flight inference must finish first
+    std::lock_guard<std::mutex> inference_lock(g_inferenceMutex);
+    std::lock_guard<std::mutex> lock(g_initMutex);
+    if (g_activeOcrClients.load() == 0) {
+        return JNI_TRUE;
+    }
+    return AcquireProfileEngine(env, static_cast<mihon::OcrProfile>(profile)) ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jlongArray JNICALL
+Java_mihon_data_ocr_OcrRepositoryImpl_nativeGetProfileStats(JNIEnv* env, jobject /* this */) {
+    constexpr int kStatsSize = mihon::kOcrProfileCount * mihon::ProfileStats::kFieldCount;
+    jlong values[kStatsSize];
+    {
+        std::lock_guard<std::mutex> lock(g_inferenceMutex);
+        int64_t fields[mihon::ProfileStats::kFieldCount];
+        for (int i = 0; i < mihon::kOcrProfileCount; ++i) {
+            g_profileStats[i].CopyTo(fields);
+            std::copy(std::begin(fields), std::end(fields), values + i * mihon::ProfileStats::kFieldCount);
+        }
+    }
+
+    jlongArray result = env->NewLongArray(kStatsSize);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, kStatsSize, values);
+    }
+    return result;
+}
+
+// Mapped then resident bytes per mihon::MemoryComponent, followed by the memory budget
+JNIEXPORT jlongArray JNICALL
+Java_mihon_data_ocr_OcrRepositoryImpl_nativeGetMemoryUsage(JNIEnv* env, jobject /* this */) {
+    constexpr int kUsageSize = mihon::kMemoryComponentCount * 2 + 1;
+    jlong values[kUsageSize];
+    {
+        // Buffers counted here are resized and freed by requests running under g_inferenceMutex
+        std::lock_guard<std::mutex> lock(g_inferenceMutex);
+        std::lock_guard<std::mutex> init_lock(g_initMutex);
+        const mihon::MemoryUsage usage = CollectMemoryUsage();
+        for (int i = 0; i < mihon::kMemoryComponentCount; ++i) {
+            values[i * 2] = usage.components[i].mapped_bytes;
+            values[i * 2 + 1] = usage.components[i].resident_bytes;
+        }
+    }
+    values[kUsageSize - 1] = g_memoryBudget.load();
+
+    jlongArray result = env->NewLongArray(kUsageSize);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, kUsageSize, values);
+    }
+    return result;
+}
+
+// Sets the memory budget (0 removes it) and evicts engines to meet it.
+// Returns false if the remaining engines alone exceed it.
+JNIEXPORT jboolean JNICALL
+Java_mihon_data_ocr_OcrRepositoryImpl_nativeSetMemoryBudget(
+    JNIEnv* /* env */,
+    jobject /* this */,
+    jlong budgetBytes) {
+
+    g_memoryBudget.store(std::max<int64_t>(budgetBytes, 0));
+
+    std::lock_guard<std::mutex> lock(g_inferenceMutex);
+    std::lock_guard<std::mutex> init_lock(g_initMutex);
+    return FitMemoryBudget(0, nullptr) ? JNI_TRUE : JNI_FALSE;
+}
+
+// Allocation counts then byte totals per mihon::AllocPhase, or null without allocation tracking
+JNIEXPORT jlongArray JNICALL
+Java_mihon_data_ocr_OcrRepositoryImpl_nativeGetAllocationStats(JNIEnv* env, jobject /* this */) {
+    if (!mihon::AllocTrackingEnabled()) {
+        return nullptr;
+    }
+    int64_t counts[mihon::kAllocPhaseCount];
+    int64_t bytes[mihon::kAllocPhaseCount];
+    mihon::GetAllocCounts(counts, bytes);
+
+    jlong values[mihon::kAllocPhaseCount * 2];
+    std::copy(std::begin(counts), std::end(counts), values);
+    std::copy(std::begin(bytes), std::end(bytes), values + mihon::kAllocPhaseCount);
+
+    jlongArray result = env->NewLongArray(mihon::kAllocPhaseCount * 2);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, mihon::kAllocPhaseCount * 2, values);
+    }
+    return result;
+}
+
+JNIEXPORT void JNICALL
+Java_mihon_data_ocr_OcrRepositoryImpl_nativeResetAllocationStats(JNIEnv* /* env */, jobject /* this */) {
+    mihon::ResetAllocCounts();
+}
+
+JNIEXPORT jboolean JNICALL
+Java_mihon_data_ocr_OcrRepositoryImpl_nativeSetCapturePath(
+    JNIEnv* env,
+    jobject /* this */,
+    jstring path) {
+
+    std::lock_guard<std::mutex> lock(g_inferenceMutex);
+    g_capture.Close();
+    if (!path) {
+        LOGI("Request capture stopped");
+        return JNI_TRUE;
+    }
+
+    const char* path_str = env->GetStringUTFChars(path, nullptr);
+    const std::string capture_path = path_str;
+    env->ReleaseStringUTFChars(path, path_str);
+
+    if (!g_capture.Open(capture_path)) {
+        LOGE("Failed to open capture file %s", capture_path.c_str());
+        return JNI_FALSE;
+    }
+    LOGI("Capturing requests to %s", capture_path.c_str());
+    return JNI_TRUE;
+}
+
+// Re-runs every captured request with its original pixels, decode options and deadline,
+// waiting out the recorded gaps between arrivals
+JNIEXPORT jlongArray JNICALL
+Java_mihon_data_ocr_OcrRepositoryImpl_nativeReplayCapture(
+    JNIEnv* env,
+    jobject /* this */,
+    jstring path) {
+
+    const char* path_str = env->GetStringUTFChars(path, nullptr);
+    const std::string capture_path = path_str;
+    env->ReleaseStringUTFChars(path, path_str);
+
+    std::vector<mihon::CaptureRecord> records;
+    if (!mihon::ReadCaptureFile(capture_path, &records)) {
+        LOGE("Failed to read capture file %s", capture_path.c_str());
+        return env->NewLongArray(0);
+    }
+    LOGI("Replaying %zu captured requests", records.size());
+
+    std::vector<jlong> values;
+    values.reserve(records.size() * REPLAY_FIELD_COUNT);
+    std::vector<int> tokens(MAX_SEQUENCE_LENGTH);
+
+    const auto replay_start = std::chrono::steady_clock::now();
+    for (const mihon::CaptureRecord& record : records) {
+        const auto arrival = replay_start + std::chrono::microseconds(record.arrival_us);
+        std::this_thread::sleep_until(arrival);
+
+        std::lock_guard<std::mutex> lock(g_inferenceMutex);
+        mihon::OcrInference* engine =
+            AcquireRequestEngine(env, mihon::ProfileFromInt(record.profile, SessionProfile()));
+
+        const bool valid_pixels = record.image_width == IMAGE_SIZE && record.image_height == IMAGE_SIZE &&
+            record.pixels.size() == static_cast<size_t>(IMAGE_SIZE) * IMAGE_SIZE * 4;
+        if (!engine || !engine->IsInitialized() || !valid_pixels) {
+            values.insert(values.end(), {-1, record.total_ms, 0});
+            continue;
+        }
+
+        PrepareInput(engine, record.pixels.data(), static_cast<size_t>(IMAGE_SIZE) * 4, IMAGE_SIZE,
+                     record.decode.source_width, record.decode.source_height);
+        mihon::DecodeOptions decode = record.decode;
+        if (record.deadline_us >= 0) {
+            decode.deadline = arrival + std::chrono::microseconds(record.deadline_us);
+        }
+        decode.input_size = g_imageSize;
+        decode.patch_mask = g_patchMask.IsComputed() ? &g_patchMask : nullptr;
+        const int token_count = engine->InferTokens(g_imageBuffer.data(), tokens.data(), MAX_SEQUENCE_LENGTH, decode);
+        g_imageSize = IMAGE_SIZE;
+        g_patchMask.keep.clear();
+
+        const bool matches = token_count == static_cast<int>(record.tokens.size()) &&
+            std::equal(record.tokens.begin(), record.tokens.end(), tokens.begin());
+        const auto latency_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - arrival).count();
+        values.insert(values.end(), {static_cast<jlong>(latency_ms), record.total_ms, matches ? 1 : 0});
+    }
+
+    jlongArray result = env->NewLongArray(static_cast<jsize>(values.size()));
+    if (result) {
+        env->SetLongArrayRegion(result, 0, static_cast<jsize>(values.size()), values.data());
+    }
+    return result;
+}
+
 } // extern "C"
@@ -0,0 +1,101 @@
+#include "ocr_profile.h"
+#include <cstdlib>
+
+namespace mihon {
+
+static constexpr ProfileConfig kProfiles[kOcrProfileCount] = {
+    // Low-end devices: smaller variant, short decoder buckets, low input sizes, early exits and
+    // two CPU threads
+    {
+        "fast",
+        "fast",
+        {ModelPrecision::kFp16, 2},
+        {32, 96, 0, 0},
+        {48, 96, 144, 0},
+        {112, 160, 0, 0},
+        {4, 6, 8, 0},
+        {DecodingStrategy::kSpeculative, 1, 4, CtcMode::kAuto, 1, 0.85f, 0.8f},
+    },
+    // Base models with plain greedy decoding
+    {
+        "balanced",
+        "",
+        {ModelPrecision::kFp16, 0},
+        {64, 0, 0, 0},
+        {64, 128, 0, 0},
+        {160, 0, 0, 0},
+        {6, 9, 0, 0},
+        {DecodingStrategy::kGreedy, 1, 0, CtcMode::kAuto, 1, 0.92f, 0.9f},
+    },
+    // Full precision with every patch encoded at full size and depth and beam search for flagships
+    {
+        "accurate",
+        "accurate",
+        {ModelPrecision::kFp32, 0},
+        {64, 128, 0, 0},
+        {0, 0, 0, 0},
+        {0, 0, 0, 0},
+        {0, 0, 0, 0},
+        {DecodingStrategy::kBeam, 4, 0, CtcMode::kAuto, 4, 0.97f, 0.0f},
+    },
+};
+
+const ProfileConfig& GetProfileConfig(OcrProfile profile) {
+    return kProfiles[static_cast<int>(profile)];
+}
+
+OcrProfile ProfileFromInt(int value, OcrProfile fallback) {
+    if (value < 0 || value >= kOcrProfileCount) {
+        return fallback;
+    }
+    return static_cast<OcrProfile>(value);
+}
+
+void ProfileStats::Record(const InferenceStats& stats, int token_count) {
+    requests++;
+    if (stats.partial) {
+        partial_requests++;
+    }
+    if (token_count <= 0) {
+        failures++;
+        return;
+    }
+    tokens += token_count;
+    encoder_ms += stats.encoder_ms;
+    decoder_ms += stats.decoder_ms;
+    decoder_runs += stats.decoder_runs;
+    if (stats.used_ctc) {
+        ctc_requests++;
+    } else if (stats.predicted_tokens > 0 && !stats.partial) {
+        predicted_requests++;
+        prediction_error_tokens += std::abs(stats.predicted_tokens - token_count);
+    }
+    if (stats.exit_layer > 0) {
+        for (int i = 0; i < kExitSlots; ++i) {
+            if (exit_layers[i] == 0 || exit_layers[i] == stats.exit_layer) {
+                exit_layers[i] = stats.exit_layer;
+                exit_requests[i]++;
+                break;
+            }
+        }
+    }
+}
+
+void ProfileStats::CopyTo(int64_t* out) const {
+    out[0] = requests;
+    out[1] = failures;
+    out[2] = tokens;
+    out[3] = encoder_ms;
+    out[4] = decoder_ms;
+    out[5] = decoder_runs;
+    out[6] = ctc_requests;
+    out[7] = partial_requests;
+    out[8] = predicted_requests;
+    out[9] = prediction_error_tokens;
+    for (int i = 0; i < kExitSlots; ++i) {
+        out[10 + 2 * i] = exit_layers[i];
+        out[11 + 2 * i] = exit_requests[i];
+    }
+}
+
+} // namespace mihon
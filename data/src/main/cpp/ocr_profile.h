@@ -0,0 +1,71 @@
+#ifndef MIHON_OCR_PROFILE_H
+#define MIHON_OCR_PROFILE_H
+
+#include <array>
+#include <cstdint>
+#include "ocr_inference.h"
+
+namespace mihon {
+
+// Speed/quality profiles; values match OcrProfile.ordinal on the Kotlin side
+enum class OcrProfile : int {
+    kFast = 0,
+    kBalanced = 1,
+    kAccurate = 2,
+};
+
+inline constexpr int kOcrProfileCount = 3;
+inline constexpr OcrProfile kDefaultOcrProfile = OcrProfile::kBalanced;
+
+struct ProfileConfig {
+    const char* name;
+    // Asset subdirectory under "ocr/" holding variant models, empty for the base models
+    const char* model_variant;
+    EngineOptions engine;
+    // Shorter decoder lengths to load as "decoder_<len>.tflite", 0-terminated
+    std::array<int, 4> decoder_buckets;
+    // Kept-patch budgets to load as "encoder_pruned_<n>.tflite", 0-terminated
+    std::array<int, 4> encoder_patch_budgets;
+    // Lower input sizes to load as "encoder_<n>px.tflite" with "decoder_<n>px.tflite", 0-terminated
+    std::array<int, 4> input_sizes;
+    // Encoder layers to load early exits for as "encoder_exit_<n>.tflite" with
+    // "decoder_exit_<n>.tflite", next to "encoder_exit_tail.tflite", 0-terminated
+    std::array<int, 4> exit_layers;
+    DecodeOptions decode;
+};
+
+const ProfileConfig& GetProfileConfig(OcrProfile profile);
+
+// Maps a JNI profile value; negative values select `fallback`
+OcrProfile ProfileFromInt(int value, OcrProfile fallback);
+
+// Accumulated per-profile counters, exported to Kotlin as a flat LongArray
+struct ProfileStats {
+    // Early exits counted per layer, one slot for each a profile can load
+    static constexpr int kExitSlots = 4;
+    static constexpr int kFieldCount = 10 + 2 * kExitSlots;
+
+    int64_t requests = 0;
+    int64_t failures = 0;
+    int64_t tokens = 0;
+    int64_t encoder_ms = 0;
+    int64_t decoder_ms = 0;
+    int64_t decoder_runs = 0;
+    // Requests answered by the CTC head without running the decoder
+    int64_t ctc_requests = 0;
+    // Requests cut short by their deadline, including ones that returned no tokens
+    int64_t partial_requests = 0;
+    // Complete decodes with a predicted length, and the sum of their absolute prediction errors
+    int64_t predicted_requests = 0;
+    int64_t prediction_error_tokens = 0;
+    // Requests whose encoder exited at exit_layers[i], exported as (layer, count) pairs
+    std::array<int64_t, kExitSlots> exit_layers{};
+    std::array<int64_t, kExitSlots> exit_requests{};
+
+    void Record(const InferenceStats& stats, int token_count);
+    void CopyTo(int64_t* out) const;
+};
+
+} // namespace mihon
+
+#endif // MIHON_OCR_PROFILE_H
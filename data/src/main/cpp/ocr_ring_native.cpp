@@ -0,0 +1,120 @@
+#include <jni.h>
+#include <android/bitmap.h>
+#include <android/log.h>
+#include <cstring>
+#include <string>
+#include "shared_image_ring.h"
+
+// Client side of the shared image ring, built into the small mihon_ocr_ring library so the
+// app process does not load the inference runtime when OCR runs in the service process.
+
+#define LOG_TAG "MihonOCR_Ring"
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+static mihon::SharedImageRing* FromHandle(jlong handle) {
+    return reinterpret_cast<mihon::SharedImageRing*>(handle);
+}
+
+extern "C" {
+
+JNIEXPORT jlong JNICALL
+Java_mihon_data_ocr_service_OcrSharedRing_nativeCreate(JNIEnv* /* env */, jclass /* clazz */, jint slotCount) {
+    std::unique_ptr<mihon::SharedImageRing> ring = mihon::SharedImageRing::Create(slotCount);
+    if (!ring) {
+        LOGE("Failed to create shared image ring with %d slots", slotCount);
+        return 0;
+    }
+    return reinterpret_cast<jlong>(ring.release());
+}
+
+JNIEXPORT void JNICALL
+Java_mihon_data_ocr_service_OcrSharedRing_nativeDestroy(JNIEnv* /* env */, jclass /* clazz */, jlong handle) {
+    delete FromHandle(handle);
+}
+
+JNIEXPORT jint JNICALL
+Java_mihon_data_ocr_service_OcrSharedRing_nativeFd(JNIEnv* /* env */, jclass /* clazz */, jlong handle) {
+    return FromHandle(handle)->Fd();
+}
+
+JNIEXPORT jint JNICALL
+Java_mihon_data_ocr_service_OcrSharedRing_nativeSlotCount(JNIEnv* /* env */, jclass /* clazz */, jlong handle) {
+    return FromHandle(handle)->SlotCount();
+}
+
+JNIEXPORT jint JNICALL
+Java_mihon_data_ocr_service_OcrSharedRing_nativeAcquireSlot(JNIEnv* /* env */, jclass /* clazz */, jlong handle) {
+    return FromHandle(handle)->AcquireSlot();
+}
+
+JNIEXPORT void JNICALL
+Java_mihon_data_ocr_service_OcrSharedRing_nativeReleaseSlot(
+    JNIEnv* /* env */, jclass /* clazz */, jlong handle, jint slot) {
+    FromHandle(handle)->ReleaseSlot(slot);
+}
+
+// Copies a model-sized ARGB_8888 bitmap into `slot` and queues it for the service
+JNIEXPORT jboolean JNICALL
+Java_mihon_data_ocr_service_OcrSharedRing_nativeWriteBitmap(
+    JNIEnv* env,
+    jclass /* clazz */,
+    jlong handle,
+    jint slot,
+    jobject bitmap,
+    jint sourceWidth,
+    jint sourceHeight) {
+
+    mihon::SharedImageRing* ring = FromHandle(handle);
+    mihon::RingSlotHeader* header = ring->Header(slot);
+    if (!header) {
+        LOGE("Invalid ring slot %d", slot);
+        return JNI_FALSE;
+    }
+
+    AndroidBitmapInfo info;
+    if (AndroidBitmap_getInfo(env, bitmap, &info) < 0 ||
+        info.format != ANDROID_BITMAP_FORMAT_RGBA_8888 ||
+        info.width != mihon::SharedImageRing::SLOT_IMAGE_SIZE ||
+        info.height != mihon::SharedImageRing::SLOT_IMAGE_SIZE) {
+        LOGE("Ring images must be %dx%d ARGB_8888",
+             mihon::SharedImageRing::SLOT_IMAGE_SIZE, mihon::SharedImageRing::SLOT_IMAGE_SIZE);
+        return JNI_FALSE;
+    }
+
+    void* pixels;
+    if (AndroidBitmap_lockPixels(env, bitmap, &pixels) < 0) {
+        LOGE("Failed to lock bitmap pixels");
+        return JNI_FALSE;
+    }
+    const size_t row_bytes = static_cast<size_t>(info.width) * 4;
+    uint8_t* dst = ring->Pixels(slot);
+    for (uint32_t y = 0; y < info.height; ++y) {
+        std::memcpy(dst + y * row_bytes, static_cast<const uint8_t*>(pixels) + static_cast<size_t>(y) * info.stride,
+                    row_bytes);
+    }
+    AndroidBitmap_unlockPixels(env, bitmap);
+
+    header->width = static_cast<int32_t>(info.width);
+    header->height = static_cast<int32_t>(info.height);
+    header->source_width = sourceWidth;
+    header->source_height = sourceHeight;
+    header->text_bytes = 0;
+    header->state.store(static_cast<uint32_t>(mihon::RingSlotState::kQueued), std::memory_order_release);
+    return JNI_TRUE;
+}
+
+// Result text of a completed slot, or null if the service has not completed it
+JNIEXPORT jstring JNICALL
+Java_mihon_data_ocr_service_OcrSharedRing_nativeReadText(
+    JNIEnv* env, jclass /* clazz */, jlong handle, jint slot) {
+    mihon::SharedImageRing* ring = FromHandle(handle);
+    mihon::RingSlotHeader* header = ring->Header(slot);
+    if (!header ||
+        header->state.load(std::memory_order_acquire) != static_cast<uint32_t>(mihon::RingSlotState::kDone)) {
+        return nullptr;
+    }
+    const std::string text(ring->Text(slot));
+    return env->NewStringUTF(text.c_str());
+}
+
+} // extern "C"
@@ -0,0 +1,57 @@
+#include "page_pyramid_cache.h"
+#include <algorithm>
+
+namespace mihon {
+
+const ImagePyramid* PagePyramidCache::Find(uint64_t key, int width, int height) {
+    for (Entry& entry : entries_) {
+        if (entry.key == key && entry.pyramid.width == width && entry.pyramid.height == height) {
+            entry.last_used = ++use_counter_;
+            return &entry.pyramid;
+        }
+    }
+    return nullptr;
+}
+
+const ImagePyramid& PagePyramidCache::Insert(
+    uint64_t key,
+    const uint8_t* pixels,
+    int width,
+    int height,
+    size_t stride) {
+    Entry* entry = nullptr;
+    for (Entry& candidate : entries_) {
+        if (candidate.key == key) {
+            entry = &candidate;
+            break;
+        }
+    }
+    if (!entry && entries_.size() < CAPACITY) {
+        entry = &entries_.emplace_back();
+    }
+    if (!entry) {
+        // BuildImagePyramid reuses the evicted page's level buffers
+        entry = &*std::min_element(entries_.begin(), entries_.end(), [](const Entry& a, const Entry& b) {
+            return a.last_used < b.last_used;
+        });
+    }
+    entry->key = key;
+    entry->last_used = ++use_counter_;
+    BuildImagePyramid(pixels, width, height, stride, MIN_LEVEL_SIDE, entry->pyramid);
+    return entry->pyramid;
+}
+
+void PagePyramidCache::Clear() {
+    entries_.clear();
+    entries_.shrink_to_fit();
+}
+
+void PagePyramidCache::AccountMemory(MemoryUsage& usage) const {
+    for (const Entry& entry : entries_) {
+        for (const ImagePyramid::Level& level : entry.pyramid.levels) {
+            usage.AddRegion(MemoryComponent::kScratch, level.pixels.data(), level.pixels.capacity());
+        }
+    }
+}
+
+} // namespace mihon
@@ -0,0 +1,50 @@
+#ifndef MIHON_PAGE_PYRAMID_CACHE_H
+#define MIHON_PAGE_PYRAMID_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "image_preprocessor.h"
+#include "memory_accounting.h"
+
+namespace mihon {
+
+// Image pyramids of the most recently used pages, so every region recognized from a page, in
+// one call or several, is resampled from reductions built once instead of from full resolution.
+// Guarded by the caller's inference lock.
+class PagePyramidCache {
+public:
+    // Pages kept; a 2000x3000 page takes about 8 MB of levels
+    static constexpr size_t CAPACITY = 2;
+    // Levels are built while their longer side is at least this
+    static constexpr int MIN_LEVEL_SIDE = 64;
+
+    // Pyramid of page `key` when cached for the same size, or null
+    const ImagePyramid* Find(uint64_t key, int width, int height);
+
+    // Bytes a pyramid of a `width` x `height` page takes
+    static size_t PyramidBytes(int width, int height) { return ImagePyramidBytes(width, height, MIN_LEVEL_SIDE); }
+
+    // Builds the pyramid of ARGB_8888 `pixels` as page `key`, replacing the least recently used page
+    const ImagePyramid& Insert(uint64_t key, const uint8_t* pixels, int width, int height, size_t stride);
+
+    bool Empty() const { return entries_.empty(); }
+
+    void Clear();
+
+    void AccountMemory(MemoryUsage& usage) const;
+
+private:
+    struct Entry {
+        uint64_t key = 0;
+        uint64_t last_used = 0;
+        ImagePyramid pyramid;
+    };
+
+    std::vector<Entry> entries_;
+    uint64_t use_counter_ = 0;
+};
+
+} // namespace mihon
+
+#endif // MIHON_PAGE_PYRAMID_CACHE_H
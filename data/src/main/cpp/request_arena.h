@@ -0,0 +1,51 @@
+#ifndef MIHON_REQUEST_ARENA_H
+#define MIHON_REQUEST_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+namespace mihon {
+
+// Monotonic scratch memory for one request at a time. Allocations are pointer bumps
+// into a buffer reserved up front; Reset() releases everything at once and only
+// returns overflow chunks to the heap.
+class RequestArena {
+public:
+    explicit RequestArena(size_t initial_bytes)
+        : initial_(std::make_unique<std::byte[]>(initial_bytes)),
+          initial_bytes_(initial_bytes),
+          resource_(initial_.get(), initial_bytes, std::pmr::new_delete_resource()) {}
+
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    std::pmr::memory_resource* Resource() { return &resource_; }
+    void Reset() { resource_.release(); }
+
+    const void* InitialBuffer() const { return initial_.get(); }
+    size_t InitialBytes() const { return initial_bytes_; }
+
+private:
+    std::unique_ptr<std::byte[]> initial_;
+    size_t initial_bytes_;
+    std::pmr::monotonic_buffer_resource resource_;
+};
+
+// Resets an arena when the request that used it goes out of scope; declare it
+// before any arena-backed container so it is destroyed last
+class ScopedArenaReset {
+public:
+    explicit ScopedArenaReset(RequestArena& arena) : arena_(arena) {}
+    ~ScopedArenaReset() { arena_.Reset(); }
+
+    ScopedArenaReset(const ScopedArenaReset&) = delete;
+    ScopedArenaReset& operator=(const ScopedArenaReset&) = delete;
+
+private:
+    RequestArena& arena_;
+};
+
+} // namespace mihon
+
+#endif // MIHON_REQUEST_ARENA_H
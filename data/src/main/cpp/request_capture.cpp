@@ -0,0 +1,236 @@
+#include "request_capture.h"
+#include <cstring>
+#include <type_traits>
+
+namespace mihon {
+
+static constexpr char CAPTURE_MAGIC[8] = {'M', 'O', 'C', 'R', 'C', 'A', 'P', '2'};
+
+// Records are little-endian fixed-width fields in declaration order, prefixed by their size
+namespace {
+
+class RecordWriter {
+public:
+    template <typename T>
+    void Put(T value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+        data_.insert(data_.end(), bytes, bytes + sizeof(T));
+    }
+
+    template <typename T>
+    void PutArray(const std::vector<T>& values) {
+        Put<uint32_t>(static_cast<uint32_t>(values.size()));
+        const auto* bytes = reinterpret_cast<const uint8_t*>(values.data());
+        data_.insert(data_.end(), bytes, bytes + values.size() * sizeof(T));
+    }
+
+    const std::vector<uint8_t>& Data() const { return data_; }
+
+private:
+    std::vector<uint8_t> data_;
+};
+
+class RecordReader {
+public:
+    RecordReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    template <typename T>
+    bool Get(T* value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (size_ - offset_ < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(value, data_ + offset_, sizeof(T));
+        offset_ += sizeof(T);
+        return true;
+    }
+
+    template <typename T>
+    bool GetArray(std::vector<T>* values) {
+        uint32_t count = 0;
+        if (!Get(&count) || (size_ - offset_) / sizeof(T) < count) {
+            return false;
+        }
+        values->resize(count);
+        std::memcpy(values->data(), data_ + offset_, count * sizeof(T));
+        offset_ += count * sizeof(T);
+        return true;
+    }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t offset_ = 0;
+};
+
+} // namespace
+
+CaptureWriter::~CaptureWriter() {
+    Close();
+}
+
+bool CaptureWriter::Open(const std::string& path) {
+    Close();
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_) {
+        return false;
+    }
+    if (std::fwrite(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC), 1, file_) != 1) {
+        Close();
+        return false;
+    }
+    bytes_written_ = sizeof(CAPTURE_MAGIC);
+    start_ = std::chrono::steady_clock::now();
+    return true;
+}
+
+void CaptureWriter::Close() {
+    if (file_) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+    bytes_written_ = 0;
+}
+
+int64_t CaptureWriter::ElapsedUs() const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start_).count();
+}
+
+int64_t CaptureWriter::OffsetUs(std::chrono::steady_clock::time_point time) const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(time - start_).count();
+}
+
+bool CaptureWriter::Append(const CaptureRecord& record) {
+    if (!file_) {
+        return false;
+    }
+
+    RecordWriter writer;
+    writer.Put<int64_t>(record.arrival_us);
+    writer.Put<int32_t>(record.profile);
+    writer.Put<int32_t>(static_cast<int32_t>(record.engine.precision));
+    writer.Put<int32_t>(record.engine.num_threads);
+    writer.Put<uint8_t>(record.encoder_using_gpu ? 1 : 0);
+    writer.Put<uint8_t>(record.decoder_using_gpu ? 1 : 0);
+    writer.Put<int32_t>(static_cast<int32_t>(record.decode.strategy));
+    writer.Put<int32_t>(record.decode.beam_width);
+    writer.Put<int32_t>(record.decode.draft_length);
+    writer.Put<int32_t>(static_cast<int32_t>(record.decode.ctc_mode));
+    writer.Put<int32_t>(record.decode.ctc_beam_width);
+    writer.Put<float>(record.decode.ctc_min_confidence);
+    writer.Put<float>(record.decode.exit_min_confidence);
+    writer.Put<uint8_t>(record.decode.complete_only ? 1 : 0);
+    writer.Put<int64_t>(record.deadline_us);
+    writer.Put<int32_t>(record.decode.source_width);
+    writer.Put<int32_t>(record.decode.source_height);
+    writer.Put<int32_t>(record.image_width);
+    writer.Put<int32_t>(record.image_height);
+    writer.PutArray(record.pixels);
+    writer.PutArray(record.tokens);
+    writer.Put<int64_t>(record.preprocess_us);
+    writer.Put<int64_t>(record.stats.encoder_ms);
+    writer.Put<int64_t>(record.stats.decoder_ms);
+    writer.Put<int32_t>(record.stats.decoder_runs);
+    writer.Put<uint8_t>(record.stats.used_ctc ? 1 : 0);
+    writer.Put<uint8_t>(record.stats.partial ? 1 : 0);
+    writer.Put<int32_t>(record.stats.exit_layer);
+    writer.Put<int64_t>(record.total_ms);
+
+    const std::vector<uint8_t>& data = writer.Data();
+    const uint32_t size = static_cast<uint32_t>(data.size());
+    if (bytes_written_ + sizeof(size) + size > MAX_CAPTURE_BYTES) {
+        return false;
+    }
+    if (std::fwrite(&size, sizeof(size), 1, file_) != 1 ||
+        std::fwrite(data.data(), 1, data.size(), file_) != data.size()) {
+        Close();
+        return false;
+    }
+    // Flushed per record so a crash keeps everything captured before it
+    std::fflush(file_);
+    bytes_written_ += sizeof(size) + size;
+    return true;
+}
+
+bool ReadCaptureFile(const std::string& path, std::vector<CaptureRecord>* records) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+
+    char magic[sizeof(CAPTURE_MAGIC)];
+    if (std::fread(magic, sizeof(magic), 1, file) != 1 ||
+        std::memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) != 0) {
+        std::fclose(file);
+        return false;
+    }
+
+    records->clear();
+    std::vector<uint8_t> data;
+    uint32_t size = 0;
+    // A truncated trailing record ends the capture
+    while (std::fread(&size, sizeof(size), 1, file) == 1) {
+        data.resize(size);
+        if (std::fread(data.data(), 1, size, file) != size) {
+            break;
+        }
+
+        RecordReader reader(data.data(), data.size());
+        CaptureRecord record;
+        int32_t precision = 0, strategy = 0, ctc_mode = 0;
+        uint8_t encoder_gpu = 0, decoder_gpu = 0, complete_only = 0, used_ctc = 0, partial = 0;
+        int64_t encoder_ms = 0, decoder_ms = 0;
+        const bool ok =
+            reader.Get(&record.arrival_us) &&
+            reader.Get(&record.profile) &&
+            reader.Get(&precision) &&
+            reader.Get(&record.engine.num_threads) &&
+            reader.Get(&encoder_gpu) &&
+            reader.Get(&decoder_gpu) &&
+            reader.Get(&strategy) &&
+            reader.Get(&record.decode.beam_width) &&
+            reader.Get(&record.decode.draft_length) &&
+            reader.Get(&ctc_mode) &&
+            reader.Get(&record.decode.ctc_beam_width) &&
+            reader.Get(&record.decode.ctc_min_confidence) &&
+            reader.Get(&record.decode.exit_min_confidence) &&
+            reader.Get(&complete_only) &&
+            reader.Get(&record.deadline_us) &&
+            reader.Get(&record.decode.source_width) &&
+            reader.Get(&record.decode.source_height) &&
+            reader.Get(&record.image_width) &&
+            reader.Get(&record.image_height) &&
+            reader.GetArray(&record.pixels) &&
+            reader.GetArray(&record.tokens) &&
+            reader.Get(&record.preprocess_us) &&
+            reader.Get(&encoder_ms) &&
+            reader.Get(&decoder_ms) &&
+            reader.Get(&record.stats.decoder_runs) &&
+            reader.Get(&used_ctc) &&
+            reader.Get(&partial) &&
+            reader.Get(&record.stats.exit_layer) &&
+            reader.Get(&record.total_ms);
+        if (!ok) {
+            break;
+        }
+
+        record.engine.precision = static_cast<ModelPrecision>(precision);
+        record.encoder_using_gpu = encoder_gpu != 0;
+        record.decoder_using_gpu = decoder_gpu != 0;
+        record.decode.strategy = static_cast<DecodingStrategy>(strategy);
+        record.decode.ctc_mode = static_cast<CtcMode>(ctc_mode);
+        record.decode.complete_only = complete_only != 0;
+        record.stats.encoder_ms = encoder_ms;
+        record.stats.decoder_ms = decoder_ms;
+        record.stats.used_ctc = used_ctc != 0;
+        record.stats.partial = partial != 0;
+        records->push_back(std::move(record));
+    }
+
+    std::fclose(file);
+    return true;
+}
+
+} // namespace mihon
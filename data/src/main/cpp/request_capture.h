@@ -0,0 +1,73 @@
+#ifndef MIHON_REQUEST_CAPTURE_H
+#define MIHON_REQUEST_CAPTURE_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "ocr_inference.h"
+
+namespace mihon {
+
+// One recognition request as seen by the engine, enough to re-run it with identical input
+struct CaptureRecord {
+    // Microseconds since the capture was started; replay reproduces the gaps between requests
+    int64_t arrival_us = 0;
+    int32_t profile = 0;
+
+    // Engine configuration the request ran with
+    EngineOptions engine;
+    bool encoder_using_gpu = false;
+    bool decoder_using_gpu = false;
+    // Without the deadline, which is kept relative to the arrival in deadline_us
+    DecodeOptions decode;
+    // Microseconds from arrival to DecodeOptions::deadline, -1 without one
+    int64_t deadline_us = -1;
+
+    // Model-sized ARGB_8888 pixels, rows tightly packed
+    int32_t image_width = 0;
+    int32_t image_height = 0;
+    std::vector<uint8_t> pixels;
+
+    // Result and per-phase timings
+    std::vector<int32_t> tokens;
+    int64_t preprocess_us = 0;
+    InferenceStats stats;
+    int64_t total_ms = 0;
+};
+
+// Appends capture records to a file; not thread-safe, callers serialize access
+class CaptureWriter {
+public:
+    // Stops recording once a capture grows past this size
+    static constexpr size_t MAX_CAPTURE_BYTES = 64u << 20;
+
+    CaptureWriter() = default;
+    ~CaptureWriter();
+
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+    // Truncates `path` and starts a new capture
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const { return file_ != nullptr; }
+
+    int64_t ElapsedUs() const;
+    // Microseconds from the start of the capture to `time`
+    int64_t OffsetUs(std::chrono::steady_clock::time_point time) const;
+    bool Append(const CaptureRecord& record);
+
+private:
+    FILE* file_ = nullptr;
+    size_t bytes_written_ = 0;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Reads every complete record of a capture file
+bool ReadCaptureFile(const std::string& path, std::vector<CaptureRecord>* records);
+
+} // namespace mihon
+
+#endif // MIHON_REQUEST_CAPTURE_H
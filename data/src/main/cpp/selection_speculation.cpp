@@ -0,0 +1,96 @@
+#include "selection_speculation.h"
+#include <algorithm>
+
+namespace mihon {
+
+float SelectionOverlap(const SelectionRect& a, const SelectionRect& b) noexcept {
+    const float a_area = std::max(a.right - a.left, 0.0f) * std::max(a.bottom - a.top, 0.0f);
+    const float b_area = std::max(b.right - b.left, 0.0f) * std::max(b.bottom - b.top, 0.0f);
+    if (a_area <= 0.0f || b_area <= 0.0f) {
+        return 0.0f;
+    }
+    const float width = std::min(a.right, b.right) - std::max(a.left, b.left);
+    const float height = std::min(a.bottom, b.bottom) - std::max(a.top, b.top);
+    if (width <= 0.0f || height <= 0.0f) {
+        return 0.0f;
+    }
+    const float intersection = width * height;
+    return intersection / (a_area + b_area - intersection);
+}
+
+uint64_t SelectionSpeculation::Begin(int64_t session, const SelectionRect& rect) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_session_ = session;
+    running_rect_ = rect;
+    running_tid_ = 0;
+    running_generation_ = generation_.fetch_add(1) + 1;
+    return running_generation_;
+}
+
+void SelectionSpeculation::SetRunner(uint64_t generation, int tid) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_generation_ == generation) {
+        running_tid_ = tid;
+    }
+}
+
+int SelectionSpeculation::Settle(int64_t session, const SelectionRect& rect) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_generation_ != 0 && running_generation_ == generation_.load() &&
+        running_session_ == session && SelectionOverlap(running_rect_, rect) >= REUSE_MIN_OVERLAP) {
+        return running_tid_;
+    }
+    generation_.fetch_add(1);
+    running_generation_ = 0;
+    running_tid_ = 0;
+    return 0;
+}
+
+void SelectionSpeculation::Cancel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    generation_.fetch_add(1);
+    running_generation_ = 0;
+    running_tid_ = 0;
+}
+
+SelectionSpeculation::Result& SelectionSpeculation::Store(
+    int64_t session,
+    const SelectionRect& rect,
+    const OcrInference* engine,
+    int profile) {
+    has_result_ = true;
+    result_.session = session;
+    result_.rect = rect;
+    result_.engine = engine;
+    result_.profile = profile;
+    result_.hidden_states.clear();
+    result_.tokens.clear();
+    return result_;
+}
+
+const SelectionSpeculation::Result* SelectionSpeculation::Find(
+    int64_t session,
+    const SelectionRect& rect,
+    const OcrInference* engine,
+    int profile) const {
+    if (!has_result_ || result_.session != session || result_.engine != engine || result_.profile != profile) {
+        return nullptr;
+    }
+    return SelectionOverlap(result_.rect, rect) >= REUSE_MIN_OVERLAP ? &result_ : nullptr;
+}
+
+void SelectionSpeculation::Clear() {
+    has_result_ = false;
+    result_.engine = nullptr;
+    // Released rather than kept, since selections are rare compared to other requests
+    std::vector<float>().swap(result_.hidden_states);
+    std::vector<int>().swap(result_.tokens);
+}
+
+void SelectionSpeculation::AccountMemory(MemoryUsage& usage) const {
+    usage.AddRegion(MemoryComponent::kScratch, result_.hidden_states.data(),
+                    result_.hidden_states.capacity() * sizeof(float));
+    usage.AddRegion(MemoryComponent::kScratch, result_.tokens.data(), result_.tokens.capacity() * sizeof(int));
+}
+
+} // namespace mihon
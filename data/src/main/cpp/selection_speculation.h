@@ -0,0 +1,92 @@
+#ifndef MIHON_SELECTION_SPECULATION_H
+#define MIHON_SELECTION_SPECULATION_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "memory_accounting.h"
+
+namespace mihon {
+
+class OcrInference;
+
+// Selection rectangle in view coordinates
+struct SelectionRect {
+    float left = 0.0f;
+    float top = 0.0f;
+    float right = 0.0f;
+    float bottom = 0.0f;
+};
+
+// Intersection over union of two rectangles, 0 when either is empty
+float SelectionOverlap(const SelectionRect& a, const SelectionRect& b) noexcept;
+
+// Speculative recognition of an OCR selection while it is still being dragged.
+//
+// Each speculative request takes a new generation, which cancels the one in flight at its next
+// model run. The encoder output of the latest one, and its tokens once decoding finished, are
+// kept so the final request of the same drag session skips that work when its rectangle matches.
+class SelectionSpeculation {
+public:
+    // Final rectangles overlapping a speculative one at least this much reuse its result
+    static constexpr float REUSE_MIN_OVERLAP = 0.9f;
+
+    struct Result {
+        int64_t session = 0;
+        SelectionRect rect;
+        const OcrInference* engine = nullptr;
+        int profile = 0;
+        // Empty when the encoder stopped early or ran below full resolution
+        std::vector<float> hidden_states;
+        // Empty unless decoding finished
+        std::vector<int> tokens;
+    };
+
+    // Starts a speculative request for `rect`, cancelling the one in flight; returns its generation
+    uint64_t Begin(int64_t session, const SelectionRect& rect);
+
+    // Records the thread running `generation`, 0 once it is done
+    void SetRunner(uint64_t generation, int tid);
+
+    // Prepares for the final request of `session`: cancels the speculative request in flight
+    // unless its rectangle matches `rect`. Returns the thread still running a matching request
+    // so the caller can restore its priority, or 0.
+    int Settle(int64_t session, const SelectionRect& rect);
+
+    // Cancels whatever speculative request is in flight
+    void Cancel();
+
+    // Polled by the decoder; a request is cancelled once this moves past its generation
+    const std::atomic<uint64_t>& Generation() const { return generation_; }
+    bool IsCurrent(uint64_t generation) const { return generation_.load() == generation; }
+
+    // The cached result is guarded by the caller's inference lock
+
+    // Keeps the result of a speculative request, replacing the previous one; fill in its outputs
+    Result& Store(int64_t session, const SelectionRect& rect, const OcrInference* engine, int profile);
+
+    // Result reusable by the final request of `session` for `rect`, or null
+    const Result* Find(int64_t session, const SelectionRect& rect, const OcrInference* engine, int profile) const;
+
+    void Clear();
+
+    void AccountMemory(MemoryUsage& usage) const;
+
+private:
+    std::atomic<uint64_t> generation_{0};
+
+    // Request in flight, guarded by mutex_
+    std::mutex mutex_;
+    int64_t running_session_ = 0;
+    SelectionRect running_rect_;
+    uint64_t running_generation_ = 0;
+    int running_tid_ = 0;
+
+    Result result_;
+    bool has_result_ = false;
+};
+
+} // namespace mihon
+
+#endif // MIHON_SELECTION_SPECULATION_H
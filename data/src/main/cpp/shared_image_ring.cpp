@@ -0,0 +1,190 @@
+#include "shared_image_ring.h"
+#include <algorithm>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __ANDROID__
+#include <android/sharedmem.h>
+#endif
+
+namespace mihon {
+
+namespace {
+
+constexpr uint32_t RING_MAGIC = 0x4d4f4352; // "MOCR"
+constexpr uint32_t RING_VERSION = 1;
+constexpr size_t RING_ALIGNMENT = 64;
+
+struct RingRegionHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t slot_bytes;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "slot states are shared between processes and must be lock-free");
+
+constexpr size_t AlignUp(size_t value) {
+    return (value + RING_ALIGNMENT - 1) & ~(RING_ALIGNMENT - 1);
+}
+
+constexpr size_t REGION_HEADER_BYTES = AlignUp(sizeof(RingRegionHeader));
+constexpr size_t SLOT_HEADER_BYTES = AlignUp(sizeof(RingSlotHeader));
+constexpr size_t SLOT_BYTES = AlignUp(
+    SLOT_HEADER_BYTES + SharedImageRing::SLOT_PIXEL_BYTES + SharedImageRing::SLOT_TEXT_BYTES);
+
+int CreateRegionFd(size_t size) {
+#ifdef __ANDROID__
+    return ASharedMemory_create("mihon-ocr-ring", size);
+#else
+    const int fd = memfd_create("mihon-ocr-ring", MFD_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+#endif
+}
+
+size_t RegionSize(int fd) {
+#ifdef __ANDROID__
+    return ASharedMemory_getSize(fd);
+#else
+    struct stat st;
+    return fstat(fd, &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+#endif
+}
+
+// Length of the longest prefix of `text` within `limit` bytes that ends on a code point boundary
+size_t Utf8Prefix(std::string_view text, size_t limit) {
+    if (text.size() <= limit) {
+        return text.size();
+    }
+    size_t length = limit;
+    while (length > 0 && (static_cast<uint8_t>(text[length]) & 0xC0) == 0x80) {
+        --length;
+    }
+    return length;
+}
+
+} // namespace
+
+std::unique_ptr<SharedImageRing> SharedImageRing::Create(int slot_count) {
+    if (slot_count <= 0 || slot_count > MAX_SLOTS) {
+        return nullptr;
+    }
+    const size_t size = REGION_HEADER_BYTES + SLOT_BYTES * static_cast<size_t>(slot_count);
+    const int fd = CreateRegionFd(size);
+    if (fd < 0) {
+        return nullptr;
+    }
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+    }
+
+    // Fresh shared memory is zero-filled, so every slot starts out kFree
+    auto* header = static_cast<RingRegionHeader*>(base);
+    header->magic = RING_MAGIC;
+    header->version = RING_VERSION;
+    header->slot_count = static_cast<uint32_t>(slot_count);
+    header->slot_bytes = static_cast<uint32_t>(SLOT_BYTES);
+    return std::unique_ptr<SharedImageRing>(
+        new SharedImageRing(fd, static_cast<uint8_t*>(base), size, slot_count));
+}
+
+std::unique_ptr<SharedImageRing> SharedImageRing::Map(int fd) {
+    const size_t size = RegionSize(fd);
+    if (size < REGION_HEADER_BYTES) {
+        close(fd);
+        return nullptr;
+    }
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+    }
+
+    // The layout is validated before any slot is trusted, since the fd comes from another process
+    const auto* header = static_cast<const RingRegionHeader*>(base);
+    const bool valid = header->magic == RING_MAGIC &&
+                       header->version == RING_VERSION &&
+                       header->slot_bytes == SLOT_BYTES &&
+                       header->slot_count > 0 &&
+                       header->slot_count <= static_cast<uint32_t>(MAX_SLOTS) &&
+                       REGION_HEADER_BYTES + SLOT_BYTES * header->slot_count <= size;
+    if (!valid) {
+        munmap(base, size);
+        close(fd);
+        return nullptr;
+    }
+    return std::unique_ptr<SharedImageRing>(new SharedImageRing(
+        fd, static_cast<uint8_t*>(base), size, static_cast<int>(header->slot_count)));
+}
+
+SharedImageRing::~SharedImageRing() {
+    munmap(base_, size_);
+    close(fd_);
+}
+
+uint8_t* SharedImageRing::Slot(int slot) {
+    if (slot < 0 || slot >= slot_count_) {
+        return nullptr;
+    }
+    return base_ + REGION_HEADER_BYTES + SLOT_BYTES * static_cast<size_t>(slot);
+}
+
+RingSlotHeader* SharedImageRing::Header(int slot) {
+    return reinterpret_cast<RingSlotHeader*>(Slot(slot));
+}
+
+uint8_t* SharedImageRing::Pixels(int slot) {
+    uint8_t* base = Slot(slot);
+    return base ? base + SLOT_HEADER_BYTES : nullptr;
+}
+
+int SharedImageRing::AcquireSlot() {
+    for (int slot = 0; slot < slot_count_; ++slot) {
+        uint32_t expected = static_cast<uint32_t>(RingSlotState::kFree);
+        if (Header(slot)->state.compare_exchange_strong(
+                expected, static_cast<uint32_t>(RingSlotState::kWriting), std::memory_order_acquire)) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+void SharedImageRing::ReleaseSlot(int slot) {
+    if (RingSlotHeader* header = Header(slot)) {
+        header->state.store(static_cast<uint32_t>(RingSlotState::kFree), std::memory_order_release);
+    }
+}
+
+void SharedImageRing::CompleteSlot(int slot, std::string_view text) {
+    RingSlotHeader* header = Header(slot);
+    if (!header) {
+        return;
+    }
+    const size_t length = Utf8Prefix(text, SLOT_TEXT_BYTES);
+    std::memcpy(Pixels(slot) + SLOT_PIXEL_BYTES, text.data(), length);
+    header->text_bytes = static_cast<uint32_t>(length);
+    header->state.store(static_cast<uint32_t>(RingSlotState::kDone), std::memory_order_release);
+}
+
+std::string_view SharedImageRing::Text(int slot) {
+    RingSlotHeader* header = Header(slot);
+    if (!header || header->state.load(std::memory_order_acquire) != static_cast<uint32_t>(RingSlotState::kDone)) {
+        return {};
+    }
+    const size_t length = std::min<size_t>(header->text_bytes, SLOT_TEXT_BYTES);
+    return {reinterpret_cast<const char*>(Pixels(slot) + SLOT_PIXEL_BYTES), length};
+}
+
+} // namespace mihon
@@ -0,0 +1,80 @@
+#ifndef MIHON_SHARED_IMAGE_RING_H
+#define MIHON_SHARED_IMAGE_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+namespace mihon {
+
+// Lifecycle of a ring slot. The client moves kFree -> kWriting -> kQueued and back to kFree
+// once it has read the result; the service only moves kQueued -> kDone.
+enum class RingSlotState : uint32_t {
+    kFree = 0,
+    kWriting,
+    kQueued,
+    kDone,
+};
+
+struct RingSlotHeader {
+    std::atomic<uint32_t> state;
+    int32_t width;
+    int32_t height;
+    // Size of the page crop before scaling, used for routing like nativeRecognizeText
+    int32_t source_width;
+    int32_t source_height;
+    uint32_t text_bytes;
+};
+
+// Fixed-size slots in one shared memory region mapped by both the app and the OCR service
+// process. A slot carries one model-sized ARGB_8888 image in and its UTF-8 text out, so the
+// IPC channel itself only carries slot indices.
+class SharedImageRing {
+public:
+    static constexpr int MAX_SLOTS = 16;
+    static constexpr int SLOT_IMAGE_SIZE = 224;
+    static constexpr size_t SLOT_PIXEL_BYTES = static_cast<size_t>(SLOT_IMAGE_SIZE) * SLOT_IMAGE_SIZE * 4;
+    static constexpr size_t SLOT_TEXT_BYTES = 16 * 1024;
+
+    // Allocates a new region (ashmem on Android, memfd elsewhere)
+    static std::unique_ptr<SharedImageRing> Create(int slot_count);
+    // Maps a region created by another process; takes ownership of `fd`
+    static std::unique_ptr<SharedImageRing> Map(int fd);
+
+    ~SharedImageRing();
+
+    SharedImageRing(const SharedImageRing&) = delete;
+    SharedImageRing& operator=(const SharedImageRing&) = delete;
+
+    int Fd() const { return fd_; }
+    int SlotCount() const { return slot_count_; }
+
+    // Claims a free slot for writing, or returns -1 when all are in use
+    int AcquireSlot();
+    void ReleaseSlot(int slot);
+
+    // Null for out-of-range slots
+    RingSlotHeader* Header(int slot);
+    uint8_t* Pixels(int slot);
+
+    // Stores `text`, truncated at a UTF-8 boundary if it does not fit, and marks the slot kDone
+    void CompleteSlot(int slot, std::string_view text);
+    std::string_view Text(int slot);
+
+private:
+    SharedImageRing(int fd, uint8_t* base, size_t size, int slot_count)
+        : fd_(fd), base_(base), size_(size), slot_count_(slot_count) {}
+
+    uint8_t* Slot(int slot);
+
+    int fd_;
+    uint8_t* base_;
+    size_t size_;
+    int slot_count_;
+};
+
+} // namespace mihon
+
+#endif // MIHON_SHARED_IMAGE_RING_H
@@ -1,9 +1,64 @@
 #include "text_postprocessor.h"
-#include <codecvt>
-#include <locale>
+#include <cwctype>
 
 namespace mihon {
 
+static constexpr char32_t REPLACEMENT_CHARACTER = 0xFFFD;
+
+// Decodes the UTF-8 sequence at `pos` and advances past it
+static char32_t DecodeUtf8(std::string_view text, size_t& pos) {
+    const auto lead = static_cast<unsigned char>(text[pos++]);
+    if (lead < 0x80) {
+        return lead;
+    }
+
+    int length = 0;
+    char32_t c = 0;
+    if ((lead & 0xE0) == 0xC0) {
+        length = 1;
+        c = lead & 0x1F;
+    } else if ((lead & 0xF0) == 0xE0) {
+        length = 2;
+        c = lead & 0x0F;
+    } else if ((lead & 0xF8) == 0xF0) {
+        length = 3;
+        c = lead & 0x07;
+    } else {
+        return REPLACEMENT_CHARACTER;
+    }
+
+    for (int i = 0; i < length; i++) {
+        if (pos >= text.size() || (static_cast<unsigned char>(text[pos]) & 0xC0) != 0x80) {
+            return REPLACEMENT_CHARACTER;
+        }
+        c = (c << 6) | (static_cast<unsigned char>(text[pos++]) & 0x3F);
+    }
+    return c;
+}
+
+template <typename String>
+static void AppendUtf8(String& out, char32_t c) {
+    if (c < 0x80) {
+        out += static_cast<char>(c);
+    } else if (c < 0x800) {
+        out += static_cast<char>(0xC0 | (c >> 6));
+        out += static_cast<char>(0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+        out += static_cast<char>(0xE0 | (c >> 12));
+        out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (c & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (c >> 18));
+        out += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (c & 0x3F));
+    }
+}
+
+static bool IsDot(char32_t c) {
+    return c == U'.' || c == U'・';
+}
+
 TextPostprocessor::TextPostprocessor() {
     initializeConversionTable();
 }
@@ -51,65 +106,72 @@ void TextPostprocessor::initializeConversionTable() {
 }
 
 std::string TextPostprocessor::postprocess(const std::string& text) {
-    if (text.empty()) {
-        return text;
-    }
-    
-    // Convert to wide string for Unicode processing
-    std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
-    std::wstring wtext = converter.from_bytes(text);
-    
-    std::wstring result;
-    result.reserve(wtext.length());
-    
+    std::string result;
+    result.reserve(text.size() * 3);
+    postprocessInto(text, result);
+    return result;
+}
+
+void TextPostprocessor::postprocess(std::string_view text, std::pmr::string& out) const {
+    // Postprocessing at most triples the size (ASCII to full-width)
+    out.reserve(text.size() * 3);
+    postprocessInto(text, out);
+}
+
+template <typename String>
+void TextPostprocessor::postprocessInto(std::string_view text, String& out) const {
+    out.clear();
+
+    // Decodes UTF-8 in place instead of converting through a wide string
     size_t i = 0;
-    size_t len = wtext.length();
-    
+    const size_t len = text.size();
+
     while (i < len) {
-        wchar_t c = wtext[i];
-        
+        size_t next = i;
+        const char32_t c = DecodeUtf8(text, next);
+
         // Skip whitespace
-        if (std::iswspace(c)) {
-            i++;
+        if (std::iswspace(static_cast<wint_t>(c))) {
+            i = next;
             continue;
         }
-        
+
         // Replace ellipsis
-        if (c == L'…') {
-            result += L"...";
-            i++;
+        if (c == U'…') {
+            out += "...";
+            i = next;
             continue;
         }
-        
+
         // Handle dot sequences
-        if (c == L'.' || c == L'・') {
+        if (IsDot(c)) {
             int dotCount = 1;
-            size_t laterIndex = i + 1;
-            while (laterIndex < len && (wtext[laterIndex] == L'.' || wtext[laterIndex] == L'・')) {
+            size_t laterIndex = next;
+            while (laterIndex < len) {
+                size_t afterDot = laterIndex;
+                if (!IsDot(DecodeUtf8(text, afterDot))) {
+                    break;
+                }
                 dotCount++;
-                laterIndex++;
+                laterIndex = afterDot;
             }
-            
+
             if (dotCount >= 2) {
-                for (int j = 0; j < dotCount; j++) {
-                    result += L'.';
-                }
+                out.append(dotCount, '.');
                 i = laterIndex;
                 continue;
             }
         }
-        
+
         // Convert half-width to full-width
         if (c < TABLE_SIZE) {
-            result += halfToFullTable_[c];
+            AppendUtf8(out, static_cast<char32_t>(halfToFullTable_[c]));
         } else {
-            result += c;
+            AppendUtf8(out, c);
         }
-        
-        i++;
+
+        i = next;
     }
-    
-    return converter.to_bytes(result);
 }
 
 } // namespace mihon
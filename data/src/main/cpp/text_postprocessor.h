@@ -2,6 +2,8 @@
 #define MIHON_TEXT_POSTPROCESSOR_H
 
 #include <string>
+#include <string_view>
+#include <memory_resource>
 #include <array>
 
 namespace mihon {
@@ -10,12 +12,17 @@ class TextPostprocessor {
 public:
     TextPostprocessor();
     std::string postprocess(const std::string& text);
+    // Replaces `out` with the processed text, allocating from `out`'s resource
+    void postprocess(std::string_view text, std::pmr::string& out) const;
 
 private:
     static constexpr size_t TABLE_SIZE = 127;
     std::array<wchar_t, TABLE_SIZE> halfToFullTable_;
     
     void initializeConversionTable();
+
+    template <typename String>
+    void postprocessInto(std::string_view text, String& out) const;
 };
 
 } // namespace mihon
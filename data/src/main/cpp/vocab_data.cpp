@@ -6152,4 +6152,18 @@ std::vector<std::string> getVocabulary() {
     };
 }
 
+std::vector<int> getCompactVocabularyIds() {
+    static constexpr size_t SPECIAL_TOKEN_COUNT = 5;
+
+    const std::vector<std::string> vocab = getVocabulary();
+    std::vector<int> ids;
+    ids.reserve(vocab.size());
+    for (size_t i = 0; i < vocab.size(); ++i) {
+        if (i < SPECIAL_TOKEN_COUNT || !vocab[i].empty()) {
+            ids.push_back(static_cast<int>(i));
+        }
+    }
+    return ids;
+}
+
 } // namespace mihon
@@ -9,6 +9,10 @@ namespace mihon {
 // Returns the vocabulary array
 std::vector<std::string> getVocabulary();
 
+// Vocab ids kept by compact decoder output heads, in compact id order.
+// Compact heads drop the empty placeholder entries; special tokens are kept.
+std::vector<int> getCompactVocabularyIds();
+
 } // namespace mihon
 
 #endif // MIHON_VOCAB_DATA_H
@@ -0,0 +1,165 @@
+#include "work_pool.h"
+#include <algorithm>
+
+namespace mihon {
+
+// State of one ParallelFor call, shared with its helper tasks so that helpers which start
+// after the loop finished find no chunks left instead of a dangling loop
+struct WorkPool::Loop {
+    WorkClass work_class = WorkClass::kPreprocess;
+    const std::function<void(size_t, size_t)>* fn = nullptr;
+    size_t count = 0;
+    size_t grain = 1;
+    size_t chunks = 0;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> done{0};
+    std::mutex mutex;
+    std::condition_variable finished;
+};
+
+WorkPool& WorkPool::Shared() {
+    static WorkPool pool(static_cast<int>(std::max(1u, std::thread::hardware_concurrency())) - 1);
+    return pool;
+}
+
+WorkPool::WorkPool(int worker_count) {
+    const int workers = std::max(worker_count, 0);
+    for (auto& quota : quotas_) {
+        quota.store(workers);
+    }
+    for (auto& active : active_helpers_) {
+        active.store(0);
+    }
+    workers_.reserve(workers);
+    for (int i = 0; i < workers; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        workers_[i]->thread = std::thread(&WorkPool::RunWorker, this, i);
+    }
+}
+
+WorkPool::~WorkPool() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+        worker->thread.join();
+    }
+}
+
+void WorkPool::SetQuota(WorkClass work_class, int workers) {
+    quotas_[static_cast<int>(work_class)].store(std::clamp(workers, 0, WorkerCount()));
+}
+
+int WorkPool::Quota(WorkClass work_class) const {
+    return quotas_[static_cast<int>(work_class)].load();
+}
+
+void WorkPool::ParallelFor(
+    WorkClass work_class,
+    size_t count,
+    size_t grain,
+    const std::function<void(size_t, size_t)>& fn) {
+    if (count == 0) {
+        return;
+    }
+    grain = std::max<size_t>(grain, 1);
+    const size_t chunks = (count + grain - 1) / grain;
+
+    // Cores held by running inference are not handed out; the workers are the cores beyond the
+    // calling thread
+    const int free_cores = WorkerCount() - inference_threads_.load(std::memory_order_relaxed);
+    const int helpers = static_cast<int>(std::min<size_t>(
+        std::max(std::min(Quota(work_class), free_cores), 0), chunks - 1));
+    if (helpers == 0) {
+        fn(0, count);
+        return;
+    }
+
+    auto loop = std::make_shared<Loop>();
+    loop->work_class = work_class;
+    loop->fn = &fn;
+    loop->count = count;
+    loop->grain = grain;
+    loop->chunks = chunks;
+
+    for (int i = 0; i < helpers; ++i) {
+        Worker& worker = *workers_[next_worker_.fetch_add(1, std::memory_order_relaxed) % workers_.size()];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(Task{loop});
+    }
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        queued_.fetch_add(helpers);
+    }
+    wake_.notify_all();
+
+    RunChunks(*loop);
+    std::unique_lock<std::mutex> lock(loop->mutex);
+    loop->finished.wait(lock, [&loop] { return loop->done.load() == loop->chunks; });
+}
+
+void WorkPool::RunChunks(Loop& loop) {
+    for (size_t chunk = loop.next.fetch_add(1); chunk < loop.chunks; chunk = loop.next.fetch_add(1)) {
+        const size_t begin = chunk * loop.grain;
+        (*loop.fn)(begin, std::min(loop.count, begin + loop.grain));
+        if (loop.done.fetch_add(1) + 1 == loop.chunks) {
+            std::lock_guard<std::mutex> lock(loop.mutex);
+            loop.finished.notify_all();
+        }
+    }
+}
+
+void WorkPool::Help(Loop& loop) {
+    // Over quota, the helper leaves its share to the loop's other threads
+    auto& active = active_helpers_[static_cast<int>(loop.work_class)];
+    if (active.fetch_add(1) < Quota(loop.work_class)) {
+        RunChunks(loop);
+    }
+    active.fetch_sub(1);
+}
+
+bool WorkPool::TryTake(size_t index, Task& task) {
+    {
+        Worker& own = *workers_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued_.fetch_sub(1);
+            return true;
+        }
+    }
+    for (size_t offset = 1; offset < workers_.size(); ++offset) {
+        Worker& victim = *workers_[(index + offset) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued_.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkPool::RunWorker(size_t index) {
+    Task task;
+    while (true) {
+        if (TryTake(index, task)) {
+            Help(*task.loop);
+            task.loop.reset();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        wake_.wait(lock, [this] { return stopping_ || queued_.load() > 0; });
+        if (stopping_ && queued_.load() == 0) {
+            return;
+        }
+    }
+}
+
+} // namespace mihon
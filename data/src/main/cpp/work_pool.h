@@ -0,0 +1,103 @@
+#ifndef MIHON_WORK_POOL_H
+#define MIHON_WORK_POOL_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mihon {
+
+// Kinds of host work run on the pool, each with its own concurrency quota
+enum class WorkClass : int {
+    // Cropping, resampling and normalizing images for the encoder
+    kPreprocess = 0,
+    // Finding text regions and changed areas in pages and frames
+    kDetection = 1,
+};
+
+inline constexpr int kWorkClassCount = 2;
+
+// Process-wide work-stealing pool for host-side parallel loops.
+//
+// Every worker keeps a deque of tasks. A loop pushes one helper task per worker it may use,
+// idle workers steal them from each other, and the helpers and the calling thread claim chunks
+// of the loop until none are left. LiteRT has no hook to run XNNPack kernels on an external
+// pool, so CPU inference reserves its threads here while a model runs instead; loops started
+// meanwhile only get the cores left over, which keeps the process at or under the core count.
+class WorkPool {
+public:
+    // Pool with a worker per core beyond the calling thread, started on first use
+    static WorkPool& Shared();
+
+    // `worker_count` is also the number of cores the pool assumes it may use beyond the caller
+    explicit WorkPool(int worker_count);
+    ~WorkPool();
+
+    WorkPool(const WorkPool&) = delete;
+    WorkPool& operator=(const WorkPool&) = delete;
+
+    // Calls `fn(begin, end)` over [0, `count`) in chunks of `grain`, on the calling thread and
+    // up to Quota(`work_class`) workers; returns once every chunk has run
+    void ParallelFor(WorkClass work_class, size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+    // Most workers that loops of `work_class` may use at once, beyond their calling threads
+    void SetQuota(WorkClass work_class, int workers);
+    int Quota(WorkClass work_class) const;
+
+    int WorkerCount() const { return static_cast<int>(workers_.size()); }
+
+    // Holds `threads` cores for CPU inference while in scope
+    class InferenceScope {
+    public:
+        InferenceScope(WorkPool& pool, int threads) : pool_(pool), threads_(threads) {
+            pool_.inference_threads_.fetch_add(threads_, std::memory_order_relaxed);
+        }
+        ~InferenceScope() { pool_.inference_threads_.fetch_sub(threads_, std::memory_order_relaxed); }
+
+        InferenceScope(const InferenceScope&) = delete;
+        InferenceScope& operator=(const InferenceScope&) = delete;
+
+    private:
+        WorkPool& pool_;
+        const int threads_;
+    };
+
+private:
+    struct Loop;
+    struct Task {
+        std::shared_ptr<Loop> loop;
+    };
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    void RunWorker(size_t index);
+    // Own tasks are taken newest first, stolen ones oldest first
+    bool TryTake(size_t index, Task& task);
+    void Help(Loop& loop);
+    static void RunChunks(Loop& loop);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::array<std::atomic<int>, kWorkClassCount> quotas_;
+    std::array<std::atomic<int>, kWorkClassCount> active_helpers_;
+    std::atomic<int> inference_threads_{0};
+    std::atomic<size_t> next_worker_{0};
+
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    std::atomic<int> queued_{0};
+    bool stopping_ = false;
+};
+
+} // namespace mihon
+
+#endif // MIHON_WORK_POOL_H
@@ -0,0 +1,107 @@
+package mihon.data.ocr
+
+import android.graphics.Bitmap
+import android.graphics.BitmapFactory
+import android.graphics.BitmapRegionDecoder
+import android.graphics.Rect
+import androidx.core.graphics.scale
+import java.io.FileDescriptor
+import java.io.IOException
+import java.nio.ByteBuffer
+
+/** Side length of the square image the OCR models take. */
+internal const val OCR_IMAGE_SIZE = 224
+
+/**
+ * Prepare the input image for OCR by converting to the correct size and format.
+ * Returns the original bitmap if no conversion is needed.
+ */
+internal fun prepareOcrImage(bitmap: Bitmap): Bitmap {
+    val needsResize = bitmap.width != OCR_IMAGE_SIZE || bitmap.height != OCR_IMAGE_SIZE
+    val needsConversion = bitmap.config != Bitmap.Config.ARGB_8888
+
+    return when {
+        needsConversion && needsResize -> {
+            val converted = bitmap.copy(Bitmap.Config.ARGB_8888, false)
+                ?: throw IllegalStateException("Failed to convert bitmap to ARGB_8888")
+            val scaled = converted.scale(OCR_IMAGE_SIZE, OCR_IMAGE_SIZE, filter = true)
+            if (scaled !== converted) {
+                converted.recycle()
+            }
+            scaled
+        }
+        needsConversion -> {
+            bitmap.copy(Bitmap.Config.ARGB_8888, false)
+                ?: throw IllegalStateException("Failed to convert bitmap to ARGB_8888")
+        }
+        needsResize -> bitmap.scale(OCR_IMAGE_SIZE, OCR_IMAGE_SIZE, filter = true)
+        else -> bitmap
+    }
+}
+
+/**
+ * Largest power-of-two subsampling that keeps [region] at least [OCR_IMAGE_SIZE] pixels on both
+ * sides, matching the scale the native region decoder picks.
+ */
+internal fun regionSampleSize(region: Rect): Int {
+    var sampleSize = 1
+    while (
+        region.width() / (sampleSize * 2) >= OCR_IMAGE_SIZE &&
+        region.height() / (sampleSize * 2) >= OCR_IMAGE_SIZE
+    ) {
+        sampleSize *= 2
+    }
+    return sampleSize
+}
+
+/**
+ * Decodes each of [regions] with [decoder] at [regionSampleSize] and passes it to [recognize].
+ * Regions outside the image yield empty strings. Recycles [decoder].
+ */
+internal inline fun recognizeDecodedRegions(
+    decoder: BitmapRegionDecoder,
+    regions: List<Rect>,
+    recognize: (Bitmap) -> String,
+): List<String> {
+    try {
+        val bounds = Rect(0, 0, decoder.width, decoder.height)
+        return regions.map { region ->
+            if (region.isEmpty || !bounds.contains(region)) {
+                return@map ""
+            }
+            val options = BitmapFactory.Options().apply {
+                inSampleSize = regionSampleSize(region)
+                inPreferredConfig = Bitmap.Config.ARGB_8888
+            }
+            val crop = decoder.decodeRegion(region, options) ?: return@map ""
+            try {
+                recognize(crop)
+            } finally {
+                crop.recycle()
+            }
+        }
+    } finally {
+        decoder.recycle()
+    }
+}
+
+/** Region decoder over the bytes between the position and limit of [data], or null if it is not an image. */
+@Suppress("DEPRECATION")
+internal fun newRegionDecoder(data: ByteBuffer): BitmapRegionDecoder? {
+    val bytes = ByteArray(data.remaining())
+    data.duplicate().get(bytes)
+    return try {
+        BitmapRegionDecoder.newInstance(bytes, 0, bytes.size, false)
+    } catch (e: IOException) {
+        null
+    }
+}
+
+@Suppress("DEPRECATION")
+internal fun newRegionDecoder(fd: FileDescriptor): BitmapRegionDecoder? {
+    return try {
+        BitmapRegionDecoder.newInstance(fd, false)
+    } catch (e: IOException) {
+        null
+    }
+}
@@ -2,7 +2,9 @@ package mihon.data.ocr
 
 import android.content.Context
 import android.graphics.Bitmap
-import androidx.core.graphics.scale
+import android.graphics.Rect
+import android.graphics.RectF
+import android.os.ParcelFileDescriptor
 import kotlinx.coroutines.CoroutineScope
 import kotlinx.coroutines.Deferred
 import kotlinx.coroutines.Dispatchers
@@ -11,10 +13,19 @@ import kotlinx.coroutines.async
 import kotlinx.coroutines.runBlocking
 import kotlinx.coroutines.sync.Mutex
 import kotlinx.coroutines.sync.withLock
+import kotlinx.coroutines.withContext
 import logcat.LogPriority
 import kotlinx.coroutines.cancel
+import mihon.domain.ocr.model.OcrFrameResult
+import mihon.domain.ocr.model.OcrMemoryUsage
+import mihon.domain.ocr.model.OcrProfile
+import mihon.domain.ocr.model.OcrProfileStats
+import mihon.domain.ocr.model.OcrReplayResult
+import mihon.domain.ocr.model.OcrTextResult
 import mihon.domain.ocr.repository.OcrRepository
 import tachiyomi.core.common.util.system.logcat
+import java.io.File
+import java.nio.ByteBuffer
 import java.util.concurrent.atomic.AtomicBoolean
 
 /**
@@ -34,8 +45,16 @@ class OcrRepositoryImpl(
     private val initialized = AtomicBoolean(false)
 
     companion object {
-        private const val IMAGE_SIZE = 224
         private const val NS_TO_MS = 1_000_000L
+        private const val SESSION_PROFILE = -1
+        private const val NO_DEADLINE = 0L
+        private const val CAPTURE_FILE_NAME = "ocr_capture.bin"
+
+        /** Values nativeRecognizeFrame reports: scroll in pixels, regions recognized. */
+        private const val FRAME_STATS_FIELDS = 2
+
+        /** Native allocation phases, in the order of mihon::AllocPhase. */
+        val ALLOCATION_PHASES = listOf("other", "preprocess", "encoder", "decoder", "postprocess", "runtime")
 
         init {
             // Load the GPU accelerator library first (if available)
@@ -82,32 +101,53 @@ class OcrRepositoryImpl(
         }
     }
 
-    override suspend fun recognizeText(image: Bitmap): String {
+    override suspend fun recognizeText(image: Bitmap, profile: OcrProfile?): String {
+        return recognize(image, profile, NO_DEADLINE).text
+    }
+
+    override suspend fun recognizeTextWithin(image: Bitmap, timeLimitMs: Long, profile: OcrProfile?): OcrTextResult {
+        require(timeLimitMs > 0) { "Time limit must be positive" }
+        // The clock starts now, so preparing the image and waiting for the engine count against it
+        return recognize(image, profile, System.nanoTime() + timeLimitMs * NS_TO_MS)
+    }
+
+    /** [deadlineNanos] is a [System.nanoTime] value, or [NO_DEADLINE]. */
+    private suspend fun recognize(image: Bitmap, profile: OcrProfile?, deadlineNanos: Long): OcrTextResult {
         // Wait for initialization to complete
         if (!initDeferred.await()) {
             throw OcrException.InitializationError()
         }
 
-        val result = inferenceMutex.withLock {
-            check(!image.isRecycled) { "Input bitmap is recycled" }
-
-            val prepStart = System.nanoTime()
-            val workingBitmap = prepareImage(image)
-            val prepMs = (System.nanoTime() - prepStart) / NS_TO_MS
-            if (prepMs > 0) {
-                // Log only if there was measurable preparation time to reduce noise
-                logcat(LogPriority.INFO) { "OCR: prepareImage took $prepMs ms" }
-                logcat(LogPriority.INFO) { "app.mihonocr.dev: OCR Prep: prepareImage took $prepMs ms" }
-            }
+        check(!image.isRecycled) { "Input bitmap is recycled" }
+
+        // Prepared outside the lock so the next request's scaling overlaps the current inference
+        val prepStart = System.nanoTime()
+        val workingBitmap = prepareOcrImage(image)
+        val prepMs = (System.nanoTime() - prepStart) / NS_TO_MS
+        if (prepMs > 0) {
+            // Log only if there was measurable preparation time to reduce noise
+            logcat(LogPriority.INFO) { "OCR: prepareImage took $prepMs ms" }
+            logcat(LogPriority.INFO) { "app.mihonocr.dev: OCR Prep: prepareImage took $prepMs ms" }
+        }
 
+        val result = inferenceMutex.withLock {
             try {
-                val recognizedText = nativeRecognizeText(workingBitmap)
+                // The original size lets the native router pick the CTC path for single-line crops
+                val partial = BooleanArray(1)
+                val recognizedText = nativeRecognizeText(
+                    workingBitmap,
+                    profile?.ordinal ?: SESSION_PROFILE,
+                    image.width,
+                    image.height,
+                    deadlineNanos,
+                    partial,
+                )
 
-                if (recognizedText.isEmpty()) {
+                if (recognizedText.isEmpty() && !partial[0]) {
                     logcat(LogPriority.WARN) { "OCR returned empty text" }
                 }
 
-                recognizedText
+                OcrTextResult(recognizedText, partial[0])
             } finally {
                 // Clean up working bitmap if we created a new one
                 if (workingBitmap !== image && !workingBitmap.isRecycled) {
@@ -119,33 +159,333 @@ class OcrRepositoryImpl(
         return result
     }
 
+    override suspend fun recognizeRegions(image: Bitmap, regions: List<Rect>, profile: OcrProfile?): List<String> {
+        if (!initDeferred.await()) {
+            throw OcrException.InitializationError()
+        }
+        if (regions.isEmpty()) {
+            return emptyList()
+        }
+
+        check(!image.isRecycled) { "Input bitmap is recycled" }
+
+        val page = if (image.config == Bitmap.Config.ARGB_8888) {
+            image
+        } else {
+            image.copy(Bitmap.Config.ARGB_8888, false)
+                ?: throw IllegalStateException("Failed to convert bitmap to ARGB_8888")
+        }
+        val rects = regionArray(regions)
+
+        return try {
+            inferenceMutex.withLock {
+                // A converted copy has the same pixels, so the original identifies the page
+                nativeRecognizeRegions(page, image.generationId, rects, profile?.ordinal ?: SESSION_PROFILE)
+            }.map { it ?: "" }
+        } finally {
+            if (page !== image) {
+                page.recycle()
+            }
+        }
+    }
+
+    override suspend fun recognizeFrame(
+        frame: Bitmap,
+        stream: Long,
+        regions: List<Rect>,
+        profile: OcrProfile?,
+    ): OcrFrameResult {
+        if (!initDeferred.await()) {
+            throw OcrException.InitializationError()
+        }
+        check(!frame.isRecycled) { "Input bitmap is recycled" }
+
+        val page = if (frame.config == Bitmap.Config.ARGB_8888) {
+            frame
+        } else {
+            frame.copy(Bitmap.Config.ARGB_8888, false)
+                ?: throw IllegalStateException("Failed to convert bitmap to ARGB_8888")
+        }
+        val rects = regionArray(regions)
+
+        return try {
+            val stats = IntArray(FRAME_STATS_FIELDS)
+            val texts = inferenceMutex.withLock {
+                nativeRecognizeFrame(page, stream, rects, profile?.ordinal ?: SESSION_PROFILE, stats)
+            }
+            OcrFrameResult(texts.map { it ?: "" }, recognized = stats[1], scrollY = stats[0])
+        } finally {
+            if (page !== frame) {
+                page.recycle()
+            }
+        }
+    }
+
+    override suspend fun recognizeEncodedRegions(
+        data: ByteBuffer,
+        regions: List<Rect>,
+        profile: OcrProfile?,
+    ): List<String> {
+        if (!initDeferred.await()) {
+            throw OcrException.InitializationError()
+        }
+        if (regions.isEmpty()) {
+            return emptyList()
+        }
+
+        // The native decoder reads the bytes in place, so heap buffers are copied once
+        val direct = if (data.isDirect) {
+            data
+        } else {
+            ByteBuffer.allocateDirect(data.remaining()).apply {
+                put(data.duplicate())
+                flip()
+            }
+        }
+        val results = inferenceMutex.withLock {
+            nativeRecognizeEncodedRegions(
+                direct,
+                direct.position(),
+                direct.remaining(),
+                -1,
+                regionArray(regions),
+                profile?.ordinal ?: SESSION_PROFILE,
+            )
+        }
+        if (results != null) {
+            return results.map { it ?: "" }
+        }
+
+        val decoder = newRegionDecoder(data) ?: return regions.map { "" }
+        return recognizeDecodedRegions(decoder, regions) { recognizeText(it, profile) }
+    }
+
     /**
-     * Prepare the input image for OCR by converting to the correct size and format.
-     * Returns the original bitmap if no conversion is needed.
+     * Like [recognizeEncodedRegions], reading the encoded page from [file] at its current offset.
      */
-    private fun prepareImage(bitmap: Bitmap): Bitmap {
-        val needsResize = bitmap.width != IMAGE_SIZE || bitmap.height != IMAGE_SIZE
-        val needsConversion = bitmap.config != Bitmap.Config.ARGB_8888
-
-        return when {
-            needsConversion && needsResize -> {
-                val converted = bitmap.copy(Bitmap.Config.ARGB_8888, false)
-                    ?: throw IllegalStateException("Failed to convert bitmap to ARGB_8888")
-                val scaled = converted.scale(IMAGE_SIZE, IMAGE_SIZE, filter = true)
-                if (scaled !== converted) {
-                    converted.recycle()
-                }
-                scaled
+    suspend fun recognizeEncodedRegions(
+        file: ParcelFileDescriptor,
+        regions: List<Rect>,
+        profile: OcrProfile? = null,
+    ): List<String> {
+        if (!initDeferred.await()) {
+            throw OcrException.InitializationError()
+        }
+        if (regions.isEmpty()) {
+            return emptyList()
+        }
+
+        val results = inferenceMutex.withLock {
+            nativeRecognizeEncodedRegions(
+                null,
+                0,
+                0,
+                file.fd,
+                regionArray(regions),
+                profile?.ordinal ?: SESSION_PROFILE,
+            )
+        }
+        if (results != null) {
+            return results.map { it ?: "" }
+        }
+
+        val decoder = newRegionDecoder(file.fileDescriptor) ?: return regions.map { "" }
+        return recognizeDecodedRegions(decoder, regions) { recognizeText(it, profile) }
+    }
+
+    override suspend fun recognizeSpeculative(
+        image: Bitmap,
+        session: Long,
+        selection: RectF,
+        profile: OcrProfile?,
+    ): Boolean {
+        if (!initDeferred.await()) {
+            return false
+        }
+        check(!image.isRecycled) { "Input bitmap is recycled" }
+
+        // Taken before waiting for the lock, so the speculative request holding it stops early
+        val generation = nativeBeginSpeculation(session, selection.left, selection.top, selection.right, selection.bottom)
+        val workingBitmap = prepareOcrImage(image)
+        return try {
+            inferenceMutex.withLock {
+                nativeRecognizeSpeculative(
+                    workingBitmap,
+                    profile?.ordinal ?: SESSION_PROFILE,
+                    image.width,
+                    image.height,
+                    session,
+                    selection.left,
+                    selection.top,
+                    selection.right,
+                    selection.bottom,
+                    generation,
+                )
+            }
+        } finally {
+            if (workingBitmap !== image && !workingBitmap.isRecycled) {
+                workingBitmap.recycle()
+            }
+        }
+    }
+
+    override suspend fun recognizeSelection(
+        image: Bitmap,
+        session: Long,
+        selection: RectF,
+        profile: OcrProfile?,
+    ): String {
+        if (!initDeferred.await()) {
+            throw OcrException.InitializationError()
+        }
+        check(!image.isRecycled) { "Input bitmap is recycled" }
+
+        // Cancels a speculative request for a different rectangle before queueing behind it
+        nativeSettleSelection(session, selection.left, selection.top, selection.right, selection.bottom)
+        val workingBitmap = prepareOcrImage(image)
+        return try {
+            inferenceMutex.withLock {
+                nativeRecognizeSelection(
+                    workingBitmap,
+                    profile?.ordinal ?: SESSION_PROFILE,
+                    image.width,
+                    image.height,
+                    session,
+                    selection.left,
+                    selection.top,
+                    selection.right,
+                    selection.bottom,
+                )
             }
-            needsConversion -> {
-                bitmap.copy(Bitmap.Config.ARGB_8888, false)
-                    ?: throw IllegalStateException("Failed to convert bitmap to ARGB_8888")
+        } finally {
+            if (workingBitmap !== image && !workingBitmap.isRecycled) {
+                workingBitmap.recycle()
             }
-            needsResize -> bitmap.scale(IMAGE_SIZE, IMAGE_SIZE, filter = true)
-            else -> bitmap
         }
     }
 
+    override fun cancelSpeculation() {
+        if (initialized.get()) {
+            nativeCancelSpeculation()
+        }
+    }
+
+    override suspend fun setProfile(profile: OcrProfile) {
+        if (!initDeferred.await()) {
+            throw OcrException.InitializationError()
+        }
+        val ready = inferenceMutex.withLock { nativeSetProfile(profile.ordinal) }
+        if (!ready) {
+            logcat(LogPriority.WARN) { "OCR profile $profile could not be prepared, falling back per request" }
+        }
+    }
+
+    override suspend fun getProfileStats(): Map<OcrProfile, OcrProfileStats> {
+        if (!initDeferred.await()) {
+            return emptyMap()
+        }
+        return decodeProfileStats(nativeGetProfileStats())
+    }
+
+    override suspend fun getMemoryUsage(): OcrMemoryUsage {
+        if (!initDeferred.await()) {
+            return OcrMemoryUsage(emptyMap(), 0L)
+        }
+        return decodeMemoryUsage(nativeGetMemoryUsage())
+    }
+
+    override suspend fun setMemoryBudget(bytes: Long) {
+        require(bytes >= 0) { "Memory budget must not be negative" }
+        if (!initDeferred.await()) {
+            throw OcrException.InitializationError()
+        }
+        val withinBudget = inferenceMutex.withLock { nativeSetMemoryBudget(bytes) }
+        if (!withinBudget) {
+            logcat(LogPriority.WARN) { "OCR session engine alone exceeds the $bytes byte memory budget" }
+        }
+    }
+
+    override suspend fun setCaptureEnabled(enabled: Boolean) {
+        if (!initDeferred.await()) {
+            throw OcrException.InitializationError()
+        }
+        val path = if (enabled) File(context.cacheDir, CAPTURE_FILE_NAME).absolutePath else null
+        if (!nativeSetCapturePath(path)) {
+            logcat(LogPriority.WARN) { "OCR request capture could not be started" }
+        }
+    }
+
+    override suspend fun replayCapture(): List<OcrReplayResult> {
+        if (!initDeferred.await()) {
+            throw OcrException.InitializationError()
+        }
+        val capture = File(context.cacheDir, CAPTURE_FILE_NAME)
+        if (!capture.exists()) {
+            return emptyList()
+        }
+        // Held for the whole replay so live requests do not skew the measured latencies
+        val values = inferenceMutex.withLock {
+            withContext(Dispatchers.IO) { nativeReplayCapture(capture.absolutePath) }
+        }
+        return decodeReplayResults(values)
+    }
+
+    /**
+     * Native heap allocations per pipeline phase since the last [resetAllocationCounts], or null
+     * when the library was built without allocation tracking (`-PocrAllocTracking=ON`).
+     */
+    fun getAllocationCounts(): Map<String, Long>? {
+        val values = nativeGetAllocationStats() ?: return null
+        return ALLOCATION_PHASES.withIndex().associate { (index, phase) -> phase to values[index] }
+    }
+
+    fun resetAllocationCounts() {
+        nativeResetAllocationStats()
+    }
+
+    /**
+     * Maps a shared image ring created by a client process, taking ownership of [fd].
+     * Returns a handle for [recognizeSharedSlot], or 0 if [fd] is not a valid ring.
+     */
+    internal fun mapSharedRing(fd: Int): Long = nativeMapSharedRing(fd)
+
+    /** The ring must not be in use by a [recognizeSharedSlot] call. */
+    internal fun unmapSharedRing(ring: Long) {
+        nativeUnmapSharedRing(ring)
+    }
+
+    /**
+     * Recognizes the image queued in [slot] of a shared ring and stores the text in the slot.
+     * Returns false if the engine is not available or the slot holds no queued image.
+     * [deadlineNanos] is a [System.nanoTime] value or 0; [partial] receives whether it was reached.
+     */
+    internal suspend fun recognizeSharedSlot(
+        ring: Long,
+        slot: Int,
+        profile: OcrProfile?,
+        deadlineNanos: Long = NO_DEADLINE,
+        partial: BooleanArray? = null,
+    ): Boolean {
+        if (!initDeferred.await()) {
+            return false
+        }
+        return inferenceMutex.withLock {
+            nativeRecognizeSharedSlot(ring, slot, profile?.ordinal ?: SESSION_PROFILE, deadlineNanos, partial)
+        }
+    }
+
+    /** Flattens [regions] into the [left, top, width, height] layout the native calls take. */
+    private fun regionArray(regions: List<Rect>): IntArray {
+        val rects = IntArray(regions.size * 4)
+        regions.forEachIndexed { index, region ->
+            rects[index * 4] = region.left
+            rects[index * 4 + 1] = region.top
+            rects[index * 4 + 2] = region.width()
+            rects[index * 4 + 3] = region.height()
+        }
+        return rects
+    }
+
     override fun close() {
         runBlocking {
             if (initDeferred.isActive) {
@@ -167,7 +507,109 @@ class OcrRepositoryImpl(
         nativeLibDir: String
     ): Boolean
 
-    private external fun nativeRecognizeText(bitmap: Bitmap): String
+    private external fun nativeRecognizeText(
+        bitmap: Bitmap,
+        profile: Int,
+        sourceWidth: Int,
+        sourceHeight: Int,
+        deadlineNanos: Long,
+        partial: BooleanArray?,
+    ): String
+
+    private external fun nativeRecognizeRegions(
+        bitmap: Bitmap,
+        pageId: Int,
+        regions: IntArray,
+        profile: Int,
+    ): Array<String?>
+
+    private external fun nativeRecognizeFrame(
+        bitmap: Bitmap,
+        stream: Long,
+        regions: IntArray,
+        profile: Int,
+        frameStats: IntArray?,
+    ): Array<String?>
+
+    private external fun nativeRecognizeEncodedRegions(
+        buffer: ByteBuffer?,
+        offset: Int,
+        length: Int,
+        fd: Int,
+        regions: IntArray,
+        profile: Int,
+    ): Array<String?>?
+
+    private external fun nativeBeginSpeculation(
+        session: Long,
+        left: Float,
+        top: Float,
+        right: Float,
+        bottom: Float,
+    ): Long
+
+    private external fun nativeRecognizeSpeculative(
+        bitmap: Bitmap,
+        profile: Int,
+        sourceWidth: Int,
+        sourceHeight: Int,
+        session: Long,
+        left: Float,
+        top: Float,
+        right: Float,
+        bottom: Float,
+        generation: Long,
+    ): Boolean
+
+    private external fun nativeSettleSelection(
+        session: Long,
+        left: Float,
+        top: Float,
+        right: Float,
+        bottom: Float,
+    )
+
+    private external fun nativeCancelSpeculation()
+
+    private external fun nativeRecognizeSelection(
+        bitmap: Bitmap,
+        profile: Int,
+        sourceWidth: Int,
+        sourceHeight: Int,
+        session: Long,
+        left: Float,
+        top: Float,
+        right: Float,
+        bottom: Float,
+    ): String
+
+    private external fun nativeSetProfile(profile: Int): Boolean
+
+    private external fun nativeGetProfileStats(): LongArray
+
+    private external fun nativeGetMemoryUsage(): LongArray
+
+    private external fun nativeSetMemoryBudget(budgetBytes: Long): Boolean
+
+    private external fun nativeSetCapturePath(path: String?): Boolean
+
+    private external fun nativeGetAllocationStats(): LongArray?
+
+    private external fun nativeResetAllocationStats()
+
+    private external fun nativeReplayCapture(path: String): LongArray
+
+    private external fun nativeMapSharedRing(fd: Int): Long
+
+    private external fun nativeUnmapSharedRing(ring: Long)
+
+    private external fun nativeRecognizeSharedSlot(
+        ring: Long,
+        slot: Int,
+        profile: Int,
+        deadlineNanos: Long,
+        partial: BooleanArray?,
+    ): Boolean
 
     private external fun nativeOcrClose()
 }
@@ -0,0 +1,111 @@
+package mihon.data.ocr
+
+import mihon.domain.ocr.model.OcrMemoryBytes
+import mihon.domain.ocr.model.OcrMemoryComponent
+import mihon.domain.ocr.model.OcrMemoryUsage
+import mihon.domain.ocr.model.OcrProfile
+import mihon.domain.ocr.model.OcrProfileStats
+import mihon.domain.ocr.model.OcrReplayResult
+
+/*
+ * Flat LongArray layouts returned by the native library. The OCR service process uses the
+ * same layouts to send results back to the app.
+ */
+
+private const val PROFILE_STATS_EXIT_SLOTS = 4
+private const val PROFILE_STATS_FIELDS = 10 + 2 * PROFILE_STATS_EXIT_SLOTS
+private const val REPLAY_FIELDS = 3
+
+/**
+ * [PROFILE_STATS_FIELDS] values per profile, in [OcrProfile] order, ending with
+ * [PROFILE_STATS_EXIT_SLOTS] (layer, count) pairs whose unused slots have layer 0.
+ */
+internal fun decodeProfileStats(values: LongArray): Map<OcrProfile, OcrProfileStats> {
+    return OcrProfile.entries.associateWith { profile ->
+        val offset = profile.ordinal * PROFILE_STATS_FIELDS
+        OcrProfileStats(
+            requests = values[offset],
+            failures = values[offset + 1],
+            tokens = values[offset + 2],
+            encoderMs = values[offset + 3],
+            decoderMs = values[offset + 4],
+            decoderRuns = values[offset + 5],
+            ctcRequests = values[offset + 6],
+            partialRequests = values[offset + 7],
+            predictedRequests = values[offset + 8],
+            predictionErrorTokens = values[offset + 9],
+            earlyExits = (0 until PROFILE_STATS_EXIT_SLOTS)
+                .map { slot -> offset + 10 + slot * 2 }
+                .filter { values[it] > 0 }
+                .associate { values[it].toInt() to values[it + 1] },
+        )
+    }
+}
+
+internal fun encodeProfileStats(stats: Map<OcrProfile, OcrProfileStats>): LongArray {
+    val values = LongArray(OcrProfile.entries.size * PROFILE_STATS_FIELDS)
+    stats.forEach { (profile, profileStats) ->
+        val offset = profile.ordinal * PROFILE_STATS_FIELDS
+        values[offset] = profileStats.requests
+        values[offset + 1] = profileStats.failures
+        values[offset + 2] = profileStats.tokens
+        values[offset + 3] = profileStats.encoderMs
+        values[offset + 4] = profileStats.decoderMs
+        values[offset + 5] = profileStats.decoderRuns
+        values[offset + 6] = profileStats.ctcRequests
+        values[offset + 7] = profileStats.partialRequests
+        values[offset + 8] = profileStats.predictedRequests
+        values[offset + 9] = profileStats.predictionErrorTokens
+        profileStats.earlyExits.entries.take(PROFILE_STATS_EXIT_SLOTS).forEachIndexed { slot, (layer, count) ->
+            values[offset + 10 + slot * 2] = layer.toLong()
+            values[offset + 11 + slot * 2] = count
+        }
+    }
+    return values
+}
+
+/** Mapped and resident bytes per component, in [OcrMemoryComponent] order, then the budget. */
+internal fun decodeMemoryUsage(values: LongArray): OcrMemoryUsage {
+    return OcrMemoryUsage(
+        components = OcrMemoryComponent.entries.associateWith { component ->
+            OcrMemoryBytes(
+                mappedBytes = values[component.ordinal * 2],
+                residentBytes = values[component.ordinal * 2 + 1],
+            )
+        },
+        budgetBytes = values[OcrMemoryComponent.entries.size * 2],
+    )
+}
+
+internal fun encodeMemoryUsage(usage: OcrMemoryUsage): LongArray {
+    val values = LongArray(OcrMemoryComponent.entries.size * 2 + 1)
+    usage.components.forEach { (component, bytes) ->
+        values[component.ordinal * 2] = bytes.mappedBytes
+        values[component.ordinal * 2 + 1] = bytes.residentBytes
+    }
+    values[OcrMemoryComponent.entries.size * 2] = usage.budgetBytes
+    return values
+}
+
+/** [REPLAY_FIELDS] values per replayed request. */
+internal fun decodeReplayResults(values: LongArray): List<OcrReplayResult> {
+    return (0 until values.size / REPLAY_FIELDS).map { index ->
+        val offset = index * REPLAY_FIELDS
+        OcrReplayResult(
+            latencyMs = values[offset],
+            recordedMs = values[offset + 1],
+            tokensMatch = values[offset + 2] != 0L,
+        )
+    }
+}
+
+internal fun encodeReplayResults(results: List<OcrReplayResult>): LongArray {
+    val values = LongArray(results.size * REPLAY_FIELDS)
+    results.forEachIndexed { index, result ->
+        val offset = index * REPLAY_FIELDS
+        values[offset] = result.latencyMs
+        values[offset + 1] = result.recordedMs
+        values[offset + 2] = if (result.tokensMatch) 1L else 0L
+    }
+    return values
+}
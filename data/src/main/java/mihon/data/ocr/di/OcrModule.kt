@@ -2,6 +2,7 @@ package mihon.data.ocr.di
 
 import android.content.Context
 import mihon.data.ocr.OcrRepositoryImpl
+import mihon.data.ocr.service.RemoteOcrRepository
 import mihon.domain.ocr.interactor.OcrProcessor
 import mihon.domain.ocr.repository.OcrRepository
 
@@ -14,7 +15,22 @@ object OcrModule {
     @Volatile
     private var ocrRepository: OcrRepository? = null
 
-    private fun provideOcrRepository(context: Context): OcrRepository {
+    /**
+     * Runs inference in the separate `:ocr` service process instead of the app process.
+     * Changing it closes the current repository, so the next one runs in the selected process.
+     */
+    @Volatile
+    var runOutOfProcess: Boolean = false
+        set(value) {
+            synchronized(this) {
+                if (field != value) {
+                    field = value
+                    cleanup()
+                }
+            }
+        }
+
+    fun provideOcrRepository(context: Context): OcrRepository {
         return ocrRepository ?: synchronized(this) {
             ocrRepository ?: createOcrRepository(context).also {
                 ocrRepository = it
@@ -23,6 +39,11 @@ object OcrModule {
     }
 
     private fun createOcrRepository(context: Context): OcrRepository {
+        if (runOutOfProcess) {
+            return RemoteOcrRepository(
+                context = context.applicationContext
+            )
+        }
         return OcrRepositoryImpl(
             context = context.applicationContext
         )
@@ -37,7 +58,7 @@ object OcrModule {
         synchronized(this) {
             val repository = ocrRepository
             if (repository != null) {
-                (repository as? OcrRepositoryImpl)?.close()
+                repository.close()
                 ocrRepository = null
             }
         }
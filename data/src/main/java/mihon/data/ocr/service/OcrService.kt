@@ -0,0 +1,147 @@
+package mihon.data.ocr.service
+
+import android.app.Service
+import android.content.Intent
+import android.os.Bundle
+import android.os.Handler
+import android.os.HandlerThread
+import android.os.IBinder
+import android.os.Message
+import android.os.Messenger
+import android.os.ParcelFileDescriptor
+import android.os.RemoteException
+import androidx.core.os.BundleCompat
+import kotlinx.coroutines.CoroutineScope
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.SupervisorJob
+import kotlinx.coroutines.cancel
+import kotlinx.coroutines.launch
+import kotlinx.coroutines.runBlocking
+import kotlinx.coroutines.sync.Mutex
+import kotlinx.coroutines.sync.withLock
+import logcat.LogPriority
+import mihon.data.ocr.OcrRepositoryImpl
+import mihon.data.ocr.encodeMemoryUsage
+import mihon.data.ocr.encodeProfileStats
+import mihon.data.ocr.encodeReplayResults
+import mihon.domain.ocr.model.OcrProfile
+import tachiyomi.core.common.util.system.logcat
+
+/**
+ * Hosts the OCR engine in the separate `:ocr` process, so its models, GPU context and caches
+ * can be reclaimed, or crash, without taking down the reader.
+ *
+ * Clients bind with [RemoteOcrRepository]; see [OcrServiceProtocol] for the messages.
+ */
+class OcrService : Service() {
+
+    private val scope = CoroutineScope(Dispatchers.IO + SupervisorJob())
+    private lateinit var repository: OcrRepositoryImpl
+    private lateinit var handlerThread: HandlerThread
+    private lateinit var messenger: Messenger
+
+    // Guards the mapped ring; held for a whole recognition so the ring is never unmapped mid-request
+    private val ringMutex = Mutex()
+    private var ring = 0L
+
+    override fun onCreate() {
+        super.onCreate()
+        repository = OcrRepositoryImpl(applicationContext)
+        handlerThread = HandlerThread("OcrService").apply { start() }
+        messenger = Messenger(Handler(handlerThread.looper, ::handleMessage))
+    }
+
+    override fun onBind(intent: Intent?): IBinder = messenger.binder
+
+    override fun onDestroy() {
+        scope.cancel()
+        runBlocking { ringMutex.withLock { replaceRing(0L) } }
+        repository.close()
+        handlerThread.quitSafely()
+        super.onDestroy()
+    }
+
+    private fun handleMessage(msg: Message): Boolean {
+        // The message is recycled once this returns, so copy out everything the reply needs
+        val what = msg.what
+        val requestId = msg.arg1
+        val arg = msg.arg2
+        val data = msg.data
+        val replyTo = msg.replyTo
+
+        if (what == OcrServiceProtocol.MSG_ATTACH_RING) {
+            // Attached synchronously so it precedes every request queued after it
+            val pfd = BundleCompat.getParcelable(data, OcrServiceProtocol.KEY_RING, ParcelFileDescriptor::class.java)
+            if (pfd != null) {
+                val mapped = repository.mapSharedRing(pfd.detachFd())
+                if (mapped == 0L) {
+                    logcat(LogPriority.ERROR) { "OCR service rejected the shared image ring" }
+                }
+                runBlocking { ringMutex.withLock { replaceRing(mapped) } }
+            }
+            return true
+        }
+
+        scope.launch {
+            val values = Bundle()
+            val ok = try {
+                handleRequest(what, arg, data, values)
+            } catch (e: Exception) {
+                logcat(LogPriority.ERROR, e) { "OCR service request $what failed" }
+                false
+            }
+            val status = if (ok) OcrServiceProtocol.STATUS_OK else OcrServiceProtocol.STATUS_FAILED
+            try {
+                replyTo?.send(Message.obtain(null, what, requestId, status).apply { this.data = values })
+            } catch (e: RemoteException) {
+                logcat(LogPriority.WARN, e) { "OCR client went away before its reply" }
+            }
+        }
+        return true
+    }
+
+    private suspend fun handleRequest(what: Int, arg: Int, data: Bundle, values: Bundle): Boolean {
+        when (what) {
+            OcrServiceProtocol.MSG_RECOGNIZE -> {
+                val profile = OcrProfile.entries.getOrNull(data.getInt(OcrServiceProtocol.KEY_PROFILE))
+                // CLOCK_MONOTONIC is system-wide, so the client's deadline holds in this process
+                val deadline = data.getLong(OcrServiceProtocol.KEY_DEADLINE)
+                val partial = BooleanArray(1)
+                val ok = ringMutex.withLock {
+                    ring != 0L && repository.recognizeSharedSlot(ring, arg, profile, deadline, partial)
+                }
+                values.putBoolean(OcrServiceProtocol.KEY_PARTIAL, partial[0])
+                return ok
+            }
+            OcrServiceProtocol.MSG_SET_PROFILE -> {
+                val profile = OcrProfile.entries.getOrNull(arg) ?: return false
+                repository.setProfile(profile)
+            }
+            OcrServiceProtocol.MSG_GET_PROFILE_STATS -> {
+                values.putLongArray(OcrServiceProtocol.KEY_VALUES, encodeProfileStats(repository.getProfileStats()))
+            }
+            OcrServiceProtocol.MSG_GET_MEMORY_USAGE -> {
+                values.putLongArray(OcrServiceProtocol.KEY_VALUES, encodeMemoryUsage(repository.getMemoryUsage()))
+            }
+            OcrServiceProtocol.MSG_SET_MEMORY_BUDGET -> {
+                repository.setMemoryBudget(data.getLong(OcrServiceProtocol.KEY_BUDGET))
+            }
+            OcrServiceProtocol.MSG_SET_CAPTURE -> {
+                repository.setCaptureEnabled(arg != 0)
+            }
+            OcrServiceProtocol.MSG_REPLAY_CAPTURE -> {
+                values.putLongArray(OcrServiceProtocol.KEY_VALUES, encodeReplayResults(repository.replayCapture()))
+            }
+            else -> return false
+        }
+        return true
+    }
+
+    // Caller must hold ringMutex
+    private fun replaceRing(newRing: Long) {
+        if (ring != 0L) {
+            repository.unmapSharedRing(ring)
+        }
+        ring = newRing
+    }
+}
@@ -0,0 +1,50 @@
+package mihon.data.ocr.service
+
+/**
+ * Messages exchanged with [OcrService] over its Messenger.
+ *
+ * Requests carry a request id in `arg1` and their argument in `arg2`; the reply repeats
+ * `what` and the id, with [STATUS_OK] or [STATUS_FAILED] in `arg2` and any values in `data`.
+ * Images and recognized text never travel in messages, only through the [OcrSharedRing].
+ */
+internal object OcrServiceProtocol {
+    /** Hands the ring to the service; `data` holds its file descriptor under [KEY_RING]. No reply. */
+    const val MSG_ATTACH_RING = 1
+
+    /**
+     * `arg2` is the ring slot, `data` holds the profile under [KEY_PROFILE] and optionally a
+     * [System.nanoTime] deadline under [KEY_DEADLINE]. The reply sets [KEY_PARTIAL] when it was reached.
+     */
+    const val MSG_RECOGNIZE = 2
+
+    /** `arg2` is the profile ordinal. */
+    const val MSG_SET_PROFILE = 3
+
+    /** Replies with the native profile stats layout under [KEY_VALUES]. */
+    const val MSG_GET_PROFILE_STATS = 4
+
+    /** Replies with the native memory usage layout under [KEY_VALUES]. */
+    const val MSG_GET_MEMORY_USAGE = 5
+
+    /** `data` holds the budget under [KEY_BUDGET]. */
+    const val MSG_SET_MEMORY_BUDGET = 6
+
+    /** `arg2` is 1 to start capturing and 0 to stop. */
+    const val MSG_SET_CAPTURE = 7
+
+    /** Replies with the native replay layout under [KEY_VALUES]. */
+    const val MSG_REPLAY_CAPTURE = 8
+
+    const val STATUS_FAILED = 0
+    const val STATUS_OK = 1
+
+    /** Profile value meaning the session profile. */
+    const val SESSION_PROFILE = -1
+
+    const val KEY_RING = "ring"
+    const val KEY_PROFILE = "profile"
+    const val KEY_BUDGET = "budget"
+    const val KEY_DEADLINE = "deadline"
+    const val KEY_PARTIAL = "partial"
+    const val KEY_VALUES = "values"
+}
@@ -0,0 +1,81 @@
+package mihon.data.ocr.service
+
+import android.graphics.Bitmap
+import java.io.Closeable
+
+/**
+ * Client side of the shared memory ring the app and [OcrService] exchange images and results
+ * through. Each slot holds one model-sized ARGB_8888 image and, once recognized, its text.
+ *
+ * Slot acquisition is lock-free; callers bound concurrent use to [slotCount].
+ */
+internal class OcrSharedRing private constructor(private val handle: Long) : Closeable {
+
+    /** File descriptor of the shared region, to be duplicated into the service process. */
+    val fd: Int get() = nativeFd(handle)
+
+    val slotCount: Int = nativeSlotCount(handle)
+
+    /** Returns a free slot index, or -1 when every slot is in use. */
+    fun acquireSlot(): Int = nativeAcquireSlot(handle)
+
+    fun releaseSlot(slot: Int) {
+        nativeReleaseSlot(handle, slot)
+    }
+
+    /**
+     * Copies a model-sized ARGB_8888 [bitmap] into [slot] and queues it for recognition.
+     * The source size is that of the crop before scaling.
+     */
+    fun write(slot: Int, bitmap: Bitmap, sourceWidth: Int, sourceHeight: Int): Boolean {
+        return nativeWriteBitmap(handle, slot, bitmap, sourceWidth, sourceHeight)
+    }
+
+    /** Text the service stored in [slot], or null if it has not completed the slot. */
+    fun readText(slot: Int): String? = nativeReadText(handle, slot)
+
+    override fun close() {
+        nativeDestroy(handle)
+    }
+
+    companion object {
+        init {
+            System.loadLibrary("mihon_ocr_ring")
+        }
+
+        fun create(slotCount: Int): OcrSharedRing? {
+            val handle = nativeCreate(slotCount)
+            return if (handle != 0L) OcrSharedRing(handle) else null
+        }
+
+        @JvmStatic
+        private external fun nativeCreate(slotCount: Int): Long
+
+        @JvmStatic
+        private external fun nativeDestroy(handle: Long)
+
+        @JvmStatic
+        private external fun nativeFd(handle: Long): Int
+
+        @JvmStatic
+        private external fun nativeSlotCount(handle: Long): Int
+
+        @JvmStatic
+        private external fun nativeAcquireSlot(handle: Long): Int
+
+        @JvmStatic
+        private external fun nativeReleaseSlot(handle: Long, slot: Int)
+
+        @JvmStatic
+        private external fun nativeWriteBitmap(
+            handle: Long,
+            slot: Int,
+            bitmap: Bitmap,
+            sourceWidth: Int,
+            sourceHeight: Int,
+        ): Boolean
+
+        @JvmStatic
+        private external fun nativeReadText(handle: Long, slot: Int): String?
+    }
+}
@@ -0,0 +1,289 @@
+package mihon.data.ocr.service
+
+import android.content.ComponentName
+import android.content.Context
+import android.content.Intent
+import android.content.ServiceConnection
+import android.graphics.Bitmap
+import android.graphics.Rect
+import android.graphics.RectF
+import android.os.Bundle
+import android.os.Handler
+import android.os.HandlerThread
+import android.os.IBinder
+import android.os.Message
+import android.os.Messenger
+import android.os.ParcelFileDescriptor
+import android.os.RemoteException
+import kotlinx.coroutines.CompletableDeferred
+import kotlinx.coroutines.NonCancellable
+import kotlinx.coroutines.sync.Semaphore
+import kotlinx.coroutines.sync.withPermit
+import kotlinx.coroutines.withContext
+import logcat.LogPriority
+import mihon.data.ocr.decodeMemoryUsage
+import mihon.data.ocr.decodeProfileStats
+import mihon.data.ocr.decodeReplayResults
+import mihon.data.ocr.newRegionDecoder
+import mihon.data.ocr.prepareOcrImage
+import mihon.data.ocr.recognizeDecodedRegions
+import mihon.domain.ocr.exception.OcrException
+import mihon.domain.ocr.model.OcrFrameResult
+import mihon.domain.ocr.model.OcrMemoryUsage
+import mihon.domain.ocr.model.OcrProfile
+import mihon.domain.ocr.model.OcrProfileStats
+import mihon.domain.ocr.model.OcrReplayResult
+import mihon.domain.ocr.model.OcrTextResult
+import mihon.domain.ocr.repository.OcrRepository
+import tachiyomi.core.common.util.system.logcat
+import java.nio.ByteBuffer
+import java.util.concurrent.ConcurrentHashMap
+import java.util.concurrent.atomic.AtomicInteger
+
+/**
+ * OCR repository that runs recognition in [OcrService]'s separate process.
+ *
+ * Images are scaled here and written into an [OcrSharedRing] slot; only the slot index crosses
+ * the binder, and the service writes the text back into the same slot. If the service process
+ * dies, in-flight requests fail with [OcrException.ServiceUnavailable] and later requests wait
+ * for the system to restart it.
+ */
+class RemoteOcrRepository(
+    private val context: Context,
+) : OcrRepository {
+
+    companion object {
+        private const val RING_SLOTS = 4
+    }
+
+    private val ring = OcrSharedRing.create(RING_SLOTS) ?: throw OcrException.ServiceUnavailable()
+    private val slots = Semaphore(ring.slotCount)
+
+    private val nextRequestId = AtomicInteger()
+    private val pending = ConcurrentHashMap<Int, CompletableDeferred<Message>>()
+
+    private val replyThread = HandlerThread("OcrServiceReplies").apply { start() }
+    private val replyMessenger = Messenger(
+        Handler(replyThread.looper) { msg ->
+            pending.remove(msg.arg1)?.complete(Message.obtain(msg))
+            true
+        },
+    )
+
+    @Volatile
+    private var service = CompletableDeferred<Messenger>()
+
+    private val connection = object : ServiceConnection {
+        override fun onServiceConnected(name: ComponentName?, binder: IBinder) {
+            val messenger = Messenger(binder)
+            try {
+                attachRing(messenger)
+                service.complete(messenger)
+            } catch (e: RemoteException) {
+                logcat(LogPriority.ERROR, e) { "Failed to hand the image ring to the OCR service" }
+            }
+        }
+
+        override fun onServiceDisconnected(name: ComponentName?) {
+            // The system rebinds once the process restarts; requests sent to the old one are lost
+            logcat(LogPriority.WARN) { "OCR service process died" }
+            service = CompletableDeferred()
+            failPending()
+        }
+    }
+
+    init {
+        context.bindService(Intent(context, OcrService::class.java), connection, Context.BIND_AUTO_CREATE)
+    }
+
+    override suspend fun recognizeText(image: Bitmap, profile: OcrProfile?): String {
+        return recognize(image, profile, 0L).text
+    }
+
+    override suspend fun recognizeTextWithin(image: Bitmap, timeLimitMs: Long, profile: OcrProfile?): OcrTextResult {
+        require(timeLimitMs > 0) { "Time limit must be positive" }
+        return recognize(image, profile, System.nanoTime() + timeLimitMs * 1_000_000L)
+    }
+
+    /** [deadlineNanos] is a [System.nanoTime] value, or 0 for none. */
+    private suspend fun recognize(image: Bitmap, profile: OcrProfile?, deadlineNanos: Long): OcrTextResult {
+        check(!image.isRecycled) { "Input bitmap is recycled" }
+
+        val workingBitmap = prepareOcrImage(image)
+        return slots.withPermit {
+            val slot = ring.acquireSlot()
+            check(slot >= 0) { "No free OCR ring slot" }
+            try {
+                val written = try {
+                    ring.write(slot, workingBitmap, image.width, image.height)
+                } finally {
+                    if (workingBitmap !== image && !workingBitmap.isRecycled) {
+                        workingBitmap.recycle()
+                    }
+                }
+                check(written) { "Failed to write the image into the OCR ring" }
+
+                // Not cancellable: the slot must not be reused while the service may still write to it
+                val reply = withContext(NonCancellable) {
+                    val data = Bundle().apply {
+                        putInt(OcrServiceProtocol.KEY_PROFILE, profile?.ordinal ?: OcrServiceProtocol.SESSION_PROFILE)
+                        putLong(OcrServiceProtocol.KEY_DEADLINE, deadlineNanos)
+                    }
+                    request(OcrServiceProtocol.MSG_RECOGNIZE, slot, data)
+                }
+                if (reply.arg2 != OcrServiceProtocol.STATUS_OK) {
+                    throw OcrException.InitializationError()
+                }
+                OcrTextResult(
+                    ring.readText(slot).orEmpty(),
+                    reply.data.getBoolean(OcrServiceProtocol.KEY_PARTIAL),
+                )
+            } finally {
+                ring.releaseSlot(slot)
+            }
+        }
+    }
+
+    // Regions are cropped here and each goes through the ring like a single request
+    override suspend fun recognizeRegions(image: Bitmap, regions: List<Rect>, profile: OcrProfile?): List<String> {
+        check(!image.isRecycled) { "Input bitmap is recycled" }
+        return regions.map { region ->
+            val inBounds = !region.isEmpty && region.left >= 0 && region.top >= 0 &&
+                region.right <= image.width && region.bottom <= image.height
+            if (!inBounds) {
+                return@map ""
+            }
+            val crop = Bitmap.createBitmap(image, region.left, region.top, region.width(), region.height())
+            try {
+                recognizeText(crop, profile)
+            } finally {
+                if (crop !== image) {
+                    crop.recycle()
+                }
+            }
+        }
+    }
+
+    // Regions are decoded here at reduced scale; only the model-sized crops go through the ring
+    override suspend fun recognizeEncodedRegions(
+        data: ByteBuffer,
+        regions: List<Rect>,
+        profile: OcrProfile?,
+    ): List<String> {
+        if (regions.isEmpty()) {
+            return emptyList()
+        }
+        val decoder = newRegionDecoder(data) ?: return regions.map { "" }
+        return recognizeDecodedRegions(decoder, regions) { recognizeText(it, profile) }
+    }
+
+    // Frame tracking state lives in the app process's native library, so every region is recognized
+    override suspend fun recognizeFrame(
+        frame: Bitmap,
+        stream: Long,
+        regions: List<Rect>,
+        profile: OcrProfile?,
+    ): OcrFrameResult = OcrFrameResult(recognizeRegions(frame, regions, profile), regions.size, 0)
+
+    // Speculation does not cross the process boundary: its cancellation is a native atomic the
+    // service would have to poll per message, so selections are recognized once they are final
+    override suspend fun recognizeSpeculative(
+        image: Bitmap,
+        session: Long,
+        selection: RectF,
+        profile: OcrProfile?,
+    ): Boolean = false
+
+    override suspend fun recognizeSelection(
+        image: Bitmap,
+        session: Long,
+        selection: RectF,
+        profile: OcrProfile?,
+    ): String = recognizeText(image, profile)
+
+    override fun cancelSpeculation() {}
+
+    override suspend fun setProfile(profile: OcrProfile) {
+        val reply = request(OcrServiceProtocol.MSG_SET_PROFILE, profile.ordinal)
+        if (reply.arg2 != OcrServiceProtocol.STATUS_OK) {
+            throw OcrException.InitializationError()
+        }
+    }
+
+    override suspend fun getProfileStats(): Map<OcrProfile, OcrProfileStats> {
+        val values = request(OcrServiceProtocol.MSG_GET_PROFILE_STATS).data
+            .getLongArray(OcrServiceProtocol.KEY_VALUES) ?: return emptyMap()
+        return decodeProfileStats(values)
+    }
+
+    override suspend fun getMemoryUsage(): OcrMemoryUsage {
+        val values = request(OcrServiceProtocol.MSG_GET_MEMORY_USAGE).data
+            .getLongArray(OcrServiceProtocol.KEY_VALUES) ?: return OcrMemoryUsage(emptyMap(), 0L)
+        return decodeMemoryUsage(values)
+    }
+
+    override suspend fun setMemoryBudget(bytes: Long) {
+        require(bytes >= 0) { "Memory budget must not be negative" }
+        val data = Bundle().apply { putLong(OcrServiceProtocol.KEY_BUDGET, bytes) }
+        val reply = request(OcrServiceProtocol.MSG_SET_MEMORY_BUDGET, data = data)
+        if (reply.arg2 != OcrServiceProtocol.STATUS_OK) {
+            throw OcrException.InitializationError()
+        }
+    }
+
+    override suspend fun setCaptureEnabled(enabled: Boolean) {
+        val reply = request(OcrServiceProtocol.MSG_SET_CAPTURE, if (enabled) 1 else 0)
+        if (reply.arg2 != OcrServiceProtocol.STATUS_OK) {
+            throw OcrException.InitializationError()
+        }
+    }
+
+    override suspend fun replayCapture(): List<OcrReplayResult> {
+        val reply = request(OcrServiceProtocol.MSG_REPLAY_CAPTURE)
+        if (reply.arg2 != OcrServiceProtocol.STATUS_OK) {
+            throw OcrException.InitializationError()
+        }
+        return decodeReplayResults(reply.data.getLongArray(OcrServiceProtocol.KEY_VALUES) ?: LongArray(0))
+    }
+
+    override fun close() {
+        context.unbindService(connection)
+        failPending()
+        replyThread.quitSafely()
+        ring.close()
+    }
+
+    private fun attachRing(messenger: Messenger) {
+        // The binder duplicates the descriptor into the service, so ours is closed right after
+        ParcelFileDescriptor.fromFd(ring.fd).use { pfd ->
+            val data = Bundle().apply { putParcelable(OcrServiceProtocol.KEY_RING, pfd) }
+            messenger.send(Message.obtain(null, OcrServiceProtocol.MSG_ATTACH_RING).apply { this.data = data })
+        }
+    }
+
+    private suspend fun request(what: Int, arg: Int = 0, data: Bundle = Bundle()): Message {
+        val messenger = service.await()
+        val requestId = nextRequestId.incrementAndGet()
+        val reply = CompletableDeferred<Message>()
+        pending[requestId] = reply
+        try {
+            messenger.send(
+                Message.obtain(null, what, requestId, arg).apply {
+                    this.data = data
+                    replyTo = replyMessenger
+                },
+            )
+            return reply.await()
+        } catch (e: RemoteException) {
+            throw OcrException.ServiceUnavailable(e)
+        } finally {
+            pending.remove(requestId)
+        }
+    }
+
+    private fun failPending() {
+        pending.keys.forEach { requestId ->
+            pending.remove(requestId)?.completeExceptionally(OcrException.ServiceUnavailable())
+        }
+    }
+}
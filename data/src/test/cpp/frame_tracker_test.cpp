@@ -0,0 +1,132 @@
+#include "frame_tracker.h"
+#include "test_util.h"
+#include <string>
+#include <vector>
+
+using mihon::FrameRegion;
+using mihon::FrameTracker;
+
+namespace {
+
+constexpr int WIDTH = 200;
+constexpr int HEIGHT = 480;
+constexpr int64_t STREAM = 1;
+constexpr int PROFILE = 0;
+
+// Opaque pixel of row `row` of an endless page, distinct for every row and column
+uint32_t PagePixel(int row, int x) {
+    uint64_t hash = (static_cast<uint64_t>(row) << 20 | static_cast<uint64_t>(x)) * 0x9E3779B97F4A7C15ull;
+    hash ^= hash >> 29;
+    return static_cast<uint32_t>(hash) | 0xFF000000u;
+}
+
+// Frame showing the page scrolled so that page row `top` is at the top
+std::vector<uint32_t> PageFrame(int top) {
+    std::vector<uint32_t> frame(static_cast<size_t>(WIDTH) * HEIGHT);
+    for (int y = 0; y < HEIGHT; ++y) {
+        for (int x = 0; x < WIDTH; ++x) {
+            frame[static_cast<size_t>(y) * WIDTH + x] = PagePixel(top + y, x);
+        }
+    }
+    return frame;
+}
+
+int BeginFrame(FrameTracker& tracker, const std::vector<uint32_t>& frame, int profile = PROFILE) {
+    return tracker.BeginFrame(STREAM, profile, reinterpret_cast<const uint8_t*>(frame.data()),
+                              WIDTH, HEIGHT, static_cast<size_t>(WIDTH) * 4);
+}
+
+// Tracks `region` with `text` on a first frame at page row 100
+void TrackFirstFrame(FrameTracker& tracker, const FrameRegion& region, const std::string& text) {
+    BeginFrame(tracker, PageFrame(100));
+    tracker.Track(region, text);
+    tracker.EndFrame();
+}
+
+void TestEstimatesScroll() {
+    FrameTracker tracker;
+    EXPECT_EQ(BeginFrame(tracker, PageFrame(100)), 0);
+    tracker.EndFrame();
+    // Content moves down when the page scrolls back up
+    EXPECT_EQ(BeginFrame(tracker, PageFrame(63)), 37);
+    tracker.EndFrame();
+    EXPECT_EQ(BeginFrame(tracker, PageFrame(88)), -25);
+    tracker.EndFrame();
+    EXPECT_EQ(BeginFrame(tracker, PageFrame(88)), 0);
+    tracker.EndFrame();
+}
+
+void TestBlankFrameReportsNoScroll() {
+    FrameTracker tracker;
+    const std::vector<uint32_t> blank(static_cast<size_t>(WIDTH) * HEIGHT, 0xFFFFFFFFu);
+    BeginFrame(tracker, blank);
+    tracker.EndFrame();
+    EXPECT_EQ(BeginFrame(tracker, blank), 0);
+}
+
+void TestUnchangedRegionKeepsText() {
+    FrameTracker tracker;
+    const FrameRegion region{10, 100, 120, 40};
+    TrackFirstFrame(tracker, region, "text");
+
+    BeginFrame(tracker, PageFrame(100));
+    const std::string* text = tracker.FindUnchanged(region);
+    EXPECT_TRUE(text != nullptr && *text == "text");
+    tracker.Track(region, *text);
+    tracker.EndFrame();
+
+    // Scrolled along with the page
+    EXPECT_EQ(BeginFrame(tracker, PageFrame(63)), 37);
+    text = tracker.FindUnchanged({10, 137, 120, 40});
+    EXPECT_TRUE(text != nullptr && *text == "text");
+    // Where the region was before scrolling there is other content now
+    EXPECT_TRUE(tracker.FindUnchanged(region) == nullptr);
+}
+
+void TestOnePixelChangeInvalidatesRegion() {
+    FrameTracker tracker;
+    const FrameRegion region{10, 100, 120, 40};
+    const FrameRegion other{10, 300, 120, 40};
+    BeginFrame(tracker, PageFrame(100));
+    tracker.Track(region, "text");
+    tracker.Track(other, "other");
+    tracker.EndFrame();
+
+    std::vector<uint32_t> frame = PageFrame(100);
+    frame[static_cast<size_t>(region.y + 20) * WIDTH + region.x + 60] ^= 1;
+    BeginFrame(tracker, frame);
+    EXPECT_TRUE(tracker.FindUnchanged(region) == nullptr);
+    const std::string* text = tracker.FindUnchanged(other);
+    EXPECT_TRUE(text != nullptr && *text == "other");
+}
+
+void TestProfileSwitchDropsRegions() {
+    FrameTracker tracker;
+    const FrameRegion region{10, 100, 120, 40};
+    TrackFirstFrame(tracker, region, "text");
+
+    BeginFrame(tracker, PageFrame(100), PROFILE + 1);
+    EXPECT_TRUE(tracker.FindUnchanged(region) == nullptr);
+}
+
+void TestUntrackedRegionIsRecognizedAgain() {
+    FrameTracker tracker;
+    const FrameRegion region{10, 100, 120, 40};
+    BeginFrame(tracker, PageFrame(100));
+    tracker.EndFrame();
+
+    BeginFrame(tracker, PageFrame(100));
+    EXPECT_TRUE(tracker.FindUnchanged(region) == nullptr);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(TestEstimatesScroll);
+    RUN_TEST(TestBlankFrameReportsNoScroll);
+    RUN_TEST(TestUnchangedRegionKeepsText);
+    RUN_TEST(TestOnePixelChangeInvalidatesRegion);
+    RUN_TEST(TestProfileSwitchDropsRegions);
+    RUN_TEST(TestUntrackedRegionIsRecognizedAgain);
+    return g_testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+#include "shared_image_ring.h"
+#include "test_util.h"
+#include <cstring>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using mihon::RingSlotState;
+using mihon::SharedImageRing;
+
+namespace {
+
+uint32_t State(SharedImageRing& ring, int slot) {
+    return ring.Header(slot)->state.load();
+}
+
+constexpr uint32_t ToInt(RingSlotState state) {
+    return static_cast<uint32_t>(state);
+}
+
+// Second mapping of `ring`, as the other process would map the fd it was sent
+std::unique_ptr<SharedImageRing> MapPeer(const SharedImageRing& ring) {
+    return SharedImageRing::Map(dup(ring.Fd()));
+}
+
+// Overwrites 32-bit word `index` of the region header (magic, version, slot count, slot bytes)
+void CorruptHeader(const SharedImageRing& ring, size_t index, uint32_t value) {
+    void* base = mmap(nullptr, 16, PROT_READ | PROT_WRITE, MAP_SHARED, ring.Fd(), 0);
+    static_cast<uint32_t*>(base)[index] = value;
+    munmap(base, 16);
+}
+
+void TestCreateRejectsSlotCounts() {
+    EXPECT_TRUE(SharedImageRing::Create(0) == nullptr);
+    EXPECT_TRUE(SharedImageRing::Create(SharedImageRing::MAX_SLOTS + 1) == nullptr);
+    auto ring = SharedImageRing::Create(SharedImageRing::MAX_SLOTS);
+    EXPECT_TRUE(ring != nullptr);
+    EXPECT_EQ(ring->SlotCount(), SharedImageRing::MAX_SLOTS);
+    EXPECT_TRUE(ring->Header(-1) == nullptr);
+    EXPECT_TRUE(ring->Header(SharedImageRing::MAX_SLOTS) == nullptr);
+    EXPECT_TRUE(ring->Pixels(SharedImageRing::MAX_SLOTS) == nullptr);
+}
+
+void TestSlotStateTransitions() {
+    auto ring = SharedImageRing::Create(2);
+    EXPECT_EQ(State(*ring, 0), ToInt(RingSlotState::kFree));
+
+    const int first = ring->AcquireSlot();
+    const int second = ring->AcquireSlot();
+    EXPECT_EQ(first, 0);
+    EXPECT_EQ(second, 1);
+    EXPECT_EQ(State(*ring, first), ToInt(RingSlotState::kWriting));
+    EXPECT_EQ(ring->AcquireSlot(), -1);
+
+    // Only kDone slots have text
+    ring->Header(first)->state.store(ToInt(RingSlotState::kQueued));
+    EXPECT_TRUE(ring->Text(first).empty());
+    ring->CompleteSlot(first, "text");
+    EXPECT_EQ(State(*ring, first), ToInt(RingSlotState::kDone));
+    EXPECT_EQ(ring->Text(first), "text");
+
+    ring->ReleaseSlot(first);
+    EXPECT_EQ(State(*ring, first), ToInt(RingSlotState::kFree));
+    EXPECT_TRUE(ring->Text(first).empty());
+    EXPECT_EQ(ring->AcquireSlot(), first);
+}
+
+void TestPeerSharesSlots() {
+    auto ring = SharedImageRing::Create(4);
+    auto peer = MapPeer(*ring);
+    EXPECT_TRUE(peer != nullptr);
+    if (!peer) {
+        return;
+    }
+    EXPECT_EQ(peer->SlotCount(), 4);
+
+    const int slot = ring->AcquireSlot();
+    std::memset(ring->Pixels(slot), 0x5A, SharedImageRing::SLOT_PIXEL_BYTES);
+    ring->Header(slot)->source_width = 640;
+    ring->Header(slot)->state.store(ToInt(RingSlotState::kQueued));
+
+    EXPECT_EQ(State(*peer, slot), ToInt(RingSlotState::kQueued));
+    EXPECT_EQ(peer->Header(slot)->source_width, 640);
+    EXPECT_EQ(peer->Pixels(slot)[SharedImageRing::SLOT_PIXEL_BYTES - 1], 0x5A);
+    // Slots taken through either mapping are taken for both
+    EXPECT_EQ(peer->AcquireSlot(), slot + 1);
+
+    peer->CompleteSlot(slot, "\xE6\x96\x87\xE5\xAD\x97");
+    EXPECT_EQ(ring->Text(slot), "\xE6\x96\x87\xE5\xAD\x97");
+}
+
+void TestCompleteSlotTruncatesOnCodePoints() {
+    auto ring = SharedImageRing::Create(1);
+    const int slot = ring->AcquireSlot();
+
+    // A three-byte character straddles the end of the text area
+    std::string text(SharedImageRing::SLOT_TEXT_BYTES - 1, 'a');
+    text += "\xE6\x96\x87";
+    ring->CompleteSlot(slot, text);
+    EXPECT_EQ(ring->Text(slot).size(), SharedImageRing::SLOT_TEXT_BYTES - 1);
+
+    ring->CompleteSlot(slot, std::string(SharedImageRing::SLOT_TEXT_BYTES + 10, 'b'));
+    EXPECT_EQ(ring->Text(slot).size(), SharedImageRing::SLOT_TEXT_BYTES);
+
+    // Out-of-range slots are ignored
+    ring->CompleteSlot(1, "ignored");
+    EXPECT_TRUE(ring->Text(1).empty());
+}
+
+void TestMapValidatesLayout() {
+    {
+        auto ring = SharedImageRing::Create(2);
+        CorruptHeader(*ring, 0, 0);
+        EXPECT_TRUE(MapPeer(*ring) == nullptr);
+    }
+    {
+        auto ring = SharedImageRing::Create(2);
+        CorruptHeader(*ring, 1, 99);
+        EXPECT_TRUE(MapPeer(*ring) == nullptr);
+    }
+    {
+        // More slots than the region holds
+        auto ring = SharedImageRing::Create(2);
+        CorruptHeader(*ring, 2, 3);
+        EXPECT_TRUE(MapPeer(*ring) == nullptr);
+    }
+    {
+        auto ring = SharedImageRing::Create(2);
+        CorruptHeader(*ring, 2, 0);
+        EXPECT_TRUE(MapPeer(*ring) == nullptr);
+    }
+    {
+        auto ring = SharedImageRing::Create(2);
+        CorruptHeader(*ring, 3, 4096);
+        EXPECT_TRUE(MapPeer(*ring) == nullptr);
+    }
+    {
+        // Too small to hold the region header
+        const int fd = memfd_create("mihon-ocr-ring-test", MFD_CLOEXEC);
+        EXPECT_EQ(ftruncate(fd, 8), 0);
+        EXPECT_TRUE(SharedImageRing::Map(fd) == nullptr);
+    }
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(TestCreateRejectsSlotCounts);
+    RUN_TEST(TestSlotStateTransitions);
+    RUN_TEST(TestPeerSharesSlots);
+    RUN_TEST(TestCompleteSlotTruncatesOnCodePoints);
+    RUN_TEST(TestMapValidatesLayout);
+    return g_testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,28 @@
+#ifndef MIHON_TEST_UTIL_H
+#define MIHON_TEST_UTIL_H
+
+#include <cstdio>
+
+// Minimal checks for the native host tests: failures are reported and counted, and the test
+// binary exits non-zero when any check failed so ctest marks it failed
+
+inline int g_testFailures = 0;
+
+#define EXPECT_TRUE(condition)                                                            \
+    do {                                                                                  \
+        if (!(condition)) {                                                               \
+            std::fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #condition); \
+            ++g_testFailures;                                                             \
+        }                                                                                 \
+    } while (0)
+
+#define EXPECT_EQ(actual, expected) EXPECT_TRUE((actual) == (expected))
+
+#define RUN_TEST(test)                                                              \
+    do {                                                                            \
+        const int failures_before = g_testFailures;                                 \
+        test();                                                                     \
+        std::fprintf(stderr, "%s %s\n", g_testFailures == failures_before ? "PASS" : "FAIL", #test); \
+    } while (0)
+
+#endif // MIHON_TEST_UTIL_H
@@ -0,0 +1,135 @@
+#include "work_pool.h"
+#include "test_util.h"
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+using mihon::WorkClass;
+using mihon::WorkPool;
+
+namespace {
+
+// Threads that ran chunks of a loop and the most that ran at once
+struct Concurrency {
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    int active = 0;
+    int peak = 0;
+
+    void Enter() {
+        std::lock_guard<std::mutex> lock(mutex);
+        threads.insert(std::this_thread::get_id());
+        peak = std::max(peak, ++active);
+    }
+
+    void Leave() {
+        std::lock_guard<std::mutex> lock(mutex);
+        --active;
+    }
+};
+
+// Runs 64 slow chunks of `work_class` on `pool`
+void RunSlowLoop(WorkPool& pool, WorkClass work_class, Concurrency& concurrency) {
+    pool.ParallelFor(work_class, 64, 1, [&](size_t, size_t) {
+        concurrency.Enter();
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+        concurrency.Leave();
+    });
+}
+
+void TestCoversEveryIndexOnce() {
+    WorkPool pool(3);
+    std::vector<int> hits(1000);
+    pool.ParallelFor(WorkClass::kPreprocess, hits.size(), 7, [&](size_t begin, size_t end) {
+        EXPECT_TRUE(end - begin <= 7);
+        for (size_t i = begin; i < end; ++i) {
+            ++hits[i];
+        }
+    });
+    for (int count : hits) {
+        EXPECT_EQ(count, 1);
+    }
+}
+
+void TestQuotaIsClamped() {
+    WorkPool pool(3);
+    EXPECT_EQ(pool.Quota(WorkClass::kPreprocess), 3);
+    pool.SetQuota(WorkClass::kPreprocess, 10);
+    EXPECT_EQ(pool.Quota(WorkClass::kPreprocess), 3);
+    pool.SetQuota(WorkClass::kPreprocess, -2);
+    EXPECT_EQ(pool.Quota(WorkClass::kPreprocess), 0);
+    // Quotas are per class
+    EXPECT_EQ(pool.Quota(WorkClass::kDetection), 3);
+}
+
+void TestQuotaLimitsHelpers() {
+    WorkPool pool(3);
+
+    pool.SetQuota(WorkClass::kPreprocess, 0);
+    Concurrency serial;
+    RunSlowLoop(pool, WorkClass::kPreprocess, serial);
+    EXPECT_EQ(serial.threads.size(), 1u);
+    EXPECT_TRUE(serial.threads.count(std::this_thread::get_id()) == 1);
+
+    pool.SetQuota(WorkClass::kPreprocess, 1);
+    Concurrency limited;
+    RunSlowLoop(pool, WorkClass::kPreprocess, limited);
+    EXPECT_TRUE(limited.peak <= 2);
+
+    Concurrency full;
+    RunSlowLoop(pool, WorkClass::kDetection, full);
+    EXPECT_TRUE(full.peak <= 4);
+    EXPECT_TRUE(full.threads.size() > 1);
+}
+
+void TestInferenceHoldsCores() {
+    WorkPool pool(3);
+    WorkPool::InferenceScope inference(pool, 3);
+    Concurrency concurrency;
+    RunSlowLoop(pool, WorkClass::kDetection, concurrency);
+    EXPECT_EQ(concurrency.threads.size(), 1u);
+}
+
+void TestNestedLoopFromWorker() {
+    WorkPool pool(3);
+    const std::thread::id caller = std::this_thread::get_id();
+    constexpr size_t OUTER = 8;
+    constexpr size_t INNER = 500;
+    std::vector<std::vector<int>> hits(OUTER, std::vector<int>(INNER));
+    std::atomic<int> outer_on_workers{0};
+
+    pool.ParallelFor(WorkClass::kDetection, OUTER, 1, [&](size_t begin, size_t end) {
+        for (size_t outer = begin; outer < end; ++outer) {
+            if (std::this_thread::get_id() != caller) {
+                outer_on_workers.fetch_add(1);
+            }
+            // Slow enough that the other threads pick up outer chunks meanwhile
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            pool.ParallelFor(WorkClass::kPreprocess, INNER, 16, [&](size_t inner_begin, size_t inner_end) {
+                for (size_t i = inner_begin; i < inner_end; ++i) {
+                    ++hits[outer][i];
+                }
+            });
+        }
+    });
+
+    EXPECT_TRUE(outer_on_workers.load() > 0);
+    for (const auto& row : hits) {
+        for (int count : row) {
+            EXPECT_EQ(count, 1);
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(TestCoversEveryIndexOnce);
+    RUN_TEST(TestQuotaIsClamped);
+    RUN_TEST(TestQuotaLimitsHelpers);
+    RUN_TEST(TestInferenceHoldsCores);
+    RUN_TEST(TestNestedLoopFromWorker);
+    return g_testFailures == 0 ? 0 : 1;
+}
@@ -1,3 +1,4 @@
 sealed class OcrException(message: String, cause: Throwable? = null) : Exception(message, cause) {
     class InitializationError(cause: Throwable? = null) : OcrException("OCR engine failed to initialize", cause)
+    class ServiceUnavailable(cause: Throwable? = null) : OcrException("OCR service process is not available", cause)
 }
@@ -1,12 +1,51 @@
 package mihon.domain.ocr.interactor
 
 import android.graphics.Bitmap
+import android.graphics.Rect
+import android.graphics.RectF
+import mihon.domain.ocr.model.OcrFrameResult
+import mihon.domain.ocr.model.OcrProfile
+import mihon.domain.ocr.model.OcrTextResult
 import mihon.domain.ocr.repository.OcrRepository
+import java.nio.ByteBuffer
 
 class OcrProcessor(
     private val ocrRepository: OcrRepository
 ) {
-    suspend fun getText(image: Bitmap): String {
-        return ocrRepository.recognizeText(image)
+    suspend fun getText(image: Bitmap, profile: OcrProfile? = null): String {
+        return ocrRepository.recognizeText(image, profile)
+    }
+
+    suspend fun getTextWithin(image: Bitmap, timeLimitMs: Long, profile: OcrProfile? = null): OcrTextResult {
+        return ocrRepository.recognizeTextWithin(image, timeLimitMs, profile)
+    }
+
+    suspend fun getTexts(image: Bitmap, regions: List<Rect>, profile: OcrProfile? = null): List<String> {
+        return ocrRepository.recognizeRegions(image, regions, profile)
+    }
+
+    suspend fun getTexts(data: ByteBuffer, regions: List<Rect>, profile: OcrProfile? = null): List<String> {
+        return ocrRepository.recognizeEncodedRegions(data, regions, profile)
+    }
+
+    suspend fun getFrameTexts(
+        frame: Bitmap,
+        stream: Long,
+        regions: List<Rect>,
+        profile: OcrProfile? = null,
+    ): OcrFrameResult {
+        return ocrRepository.recognizeFrame(frame, stream, regions, profile)
+    }
+
+    suspend fun speculate(image: Bitmap, session: Long, selection: RectF, profile: OcrProfile? = null): Boolean {
+        return ocrRepository.recognizeSpeculative(image, session, selection, profile)
+    }
+
+    suspend fun getSelectionText(image: Bitmap, session: Long, selection: RectF, profile: OcrProfile? = null): String {
+        return ocrRepository.recognizeSelection(image, session, selection, profile)
+    }
+
+    fun cancelSpeculation() {
+        ocrRepository.cancelSpeculation()
     }
 }
@@ -0,0 +1,14 @@
+package mihon.domain.ocr.model
+
+/**
+ * Text of the regions of one frame of a stream.
+ *
+ * [texts] has one entry per requested region. [recognized] regions were new or changed and
+ * went through the model; the others kept their text from the previous frame. [scrollY] is
+ * how far the content moved down since the previous frame, in pixels.
+ */
+data class OcrFrameResult(
+    val texts: List<String>,
+    val recognized: Int,
+    val scrollY: Int,
+)
@@ -0,0 +1,34 @@
+package mihon.domain.ocr.model
+
+/**
+ * Native memory held by the OCR engine, per component.
+ *
+ * Mapped bytes are the address space a component owns; resident bytes are the part of it
+ * currently in RAM. [budgetBytes] is the configured limit, 0 when unlimited.
+ */
+data class OcrMemoryUsage(
+    val components: Map<OcrMemoryComponent, OcrMemoryBytes>,
+    val budgetBytes: Long,
+) {
+    val mappedBytes: Long
+        get() = components.values.sumOf { it.mappedBytes }
+
+    val residentBytes: Long
+        get() = components.values.sumOf { it.residentBytes }
+}
+
+data class OcrMemoryBytes(
+    val mappedBytes: Long,
+    val residentBytes: Long,
+)
+
+/**
+ * Native memory owners. The ordinal is passed to the native layer and must stay in sync.
+ */
+enum class OcrMemoryComponent {
+    MODELS,
+    EMBEDDINGS,
+    TENSOR_BUFFERS,
+    HOST_BUFFERS,
+    SCRATCH,
+}
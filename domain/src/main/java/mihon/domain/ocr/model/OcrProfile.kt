@@ -0,0 +1,34 @@
+package mihon.domain.ocr.model
+
+/**
+ * Speed/quality trade-off of the OCR engine.
+ *
+ * Each profile selects the model variant, precision, decoder lengths, decoding strategy and
+ * thread budget natively. The ordinal is passed to the native layer and must stay in sync.
+ */
+enum class OcrProfile {
+    FAST,
+    BALANCED,
+    ACCURATE,
+}
+
+/**
+ * Accumulated native counters for requests served with one [OcrProfile].
+ */
+data class OcrProfileStats(
+    val requests: Long,
+    val failures: Long,
+    val tokens: Long,
+    val encoderMs: Long,
+    val decoderMs: Long,
+    val decoderRuns: Long,
+    val ctcRequests: Long,
+    /** Requests stopped at their deadline with partial or no text. */
+    val partialRequests: Long,
+    /** Complete decodes whose output length was predicted from the encoder output. */
+    val predictedRequests: Long,
+    /** Sum of the absolute token count errors of [predictedRequests]. */
+    val predictionErrorTokens: Long,
+    /** Requests whose encoder stopped at an early exit, by encoder layer. */
+    val earlyExits: Map<Int, Long> = emptyMap(),
+)
@@ -0,0 +1,13 @@
+package mihon.domain.ocr.model
+
+/**
+ * Outcome of re-running one captured OCR request.
+ *
+ * [latencyMs] is measured from the request's replayed arrival time and is negative when the
+ * request could not be run. [recordedMs] is the latency observed when it was captured.
+ */
+data class OcrReplayResult(
+    val latencyMs: Long,
+    val recordedMs: Long,
+    val tokensMatch: Boolean,
+)
@@ -0,0 +1,12 @@
+package mihon.domain.ocr.model
+
+/**
+ * Text recognized under a time limit.
+ *
+ * When [partial] is true, decoding was stopped at the deadline and [text] holds what was
+ * decoded by then, possibly nothing.
+ */
+data class OcrTextResult(
+    val text: String,
+    val partial: Boolean,
+)
@@ -1,8 +1,112 @@
 package mihon.domain.ocr.repository
 
 import android.graphics.Bitmap
+import android.graphics.Rect
+import android.graphics.RectF
+import mihon.domain.ocr.model.OcrFrameResult
+import mihon.domain.ocr.model.OcrMemoryUsage
+import mihon.domain.ocr.model.OcrProfile
+import mihon.domain.ocr.model.OcrProfileStats
+import mihon.domain.ocr.model.OcrReplayResult
+import mihon.domain.ocr.model.OcrTextResult
+import java.nio.ByteBuffer
 
 interface OcrRepository {
-    suspend fun recognizeText(image: Bitmap): String
+    /**
+     * Recognizes the text in [image] using [profile], or the session profile when null.
+     */
+    suspend fun recognizeText(image: Bitmap, profile: OcrProfile? = null): String
+
+    /**
+     * Recognizes the text in [image] within [timeLimitMs] of the call. Decoding stops before a step
+     * that would overrun the limit, returning the text decoded so far as a partial result.
+     */
+    suspend fun recognizeTextWithin(image: Bitmap, timeLimitMs: Long, profile: OcrProfile? = null): OcrTextResult
+
+    /**
+     * Recognizes the text of every region of a page in one native call. Regions are cropped and
+     * scaled natively; the result has one entry per region, empty for regions outside [image].
+     */
+    suspend fun recognizeRegions(image: Bitmap, regions: List<Rect>, profile: OcrProfile? = null): List<String>
+
+    /**
+     * Recognizes the text of every region of an encoded page (JPEG, PNG, WebP, ...) held in [data]
+     * between its position and limit. Only the regions are decoded, at reduced scale where the codec
+     * supports it, without a full-page Bitmap. The result has one entry per region, empty for
+     * regions outside the image.
+     */
+    suspend fun recognizeEncodedRegions(
+        data: ByteBuffer,
+        regions: List<Rect>,
+        profile: OcrProfile? = null,
+    ): List<String>
+
+    /**
+     * Recognizes the [regions] of [frame], the latest frame of screen stream [stream], for live OCR.
+     * Regions that track a region of the previous frame, after scrolling, with unchanged pixels
+     * keep its text; only new and changed regions are recognized. A new [stream] starts over.
+     */
+    suspend fun recognizeFrame(
+        frame: Bitmap,
+        stream: Long,
+        regions: List<Rect>,
+        profile: OcrProfile? = null,
+    ): OcrFrameResult
+
+    /**
+     * Speculatively recognizes [image], the crop of [selection] while selection [session] is still
+     * being dragged, at low priority. Each call cancels the speculative request in flight at its next
+     * model run. The work is kept for [recognizeSelection]; returns false if a newer request
+     * superseded it.
+     */
+    suspend fun recognizeSpeculative(
+        image: Bitmap,
+        session: Long,
+        selection: RectF,
+        profile: OcrProfile? = null,
+    ): Boolean
+
+    /**
+     * Recognizes [image], the crop of the finished [selection] of [session]. The encoder output, or
+     * the whole result, of a speculative request for a closely matching rectangle is reused.
+     */
+    suspend fun recognizeSelection(
+        image: Bitmap,
+        session: Long,
+        selection: RectF,
+        profile: OcrProfile? = null,
+    ): String
+
+    /**
+     * Cancels the speculative request of an abandoned selection.
+     */
+    fun cancelSpeculation()
+
+    /**
+     * Sets the profile used by requests that do not specify one.
+     */
+    suspend fun setProfile(profile: OcrProfile)
+
+    suspend fun getProfileStats(): Map<OcrProfile, OcrProfileStats>
+
+    suspend fun getMemoryUsage(): OcrMemoryUsage
+
+    /**
+     * Limits the resident native memory of OCR to [bytes], or removes the limit when 0.
+     * Engines of profiles other than the session profile are evicted or not created to honour it.
+     */
+    suspend fun setMemoryBudget(bytes: Long)
+
+    /**
+     * Starts or stops recording each request's input, engine config, output and timings
+     * into a capture file in the cache directory. Starting discards the previous capture.
+     */
+    suspend fun setCaptureEnabled(enabled: Boolean)
+
+    /**
+     * Re-runs the captured requests with identical inputs and their original arrival gaps.
+     */
+    suspend fun replayCapture(): List<OcrReplayResult>
+
     fun close()
 }